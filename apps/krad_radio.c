@@ -8,11 +8,11 @@ void krad_radio_command_help () {
 	
 	printf ("ls uptime info tag tags stag remoteon remoteoff webon weboff oscon oscoff setrate rate fps mix");
 	printf ("\n");
-	printf ("setdir lm ll lc tone input output unplug map mixmap xmms2 noxmms2 listen_on listen_off link");
+	printf ("setdir freewheel lm ll lc tone input output unplug map mixmap xmms2 noxmms2 listen_on listen_off link");
 	printf ("\n");
 	printf ("transmitter_on transmitter_off closedisplay display lstext rmtext addtest lssprites addsprite rmsprite");
 	printf ("\n");
-	printf ("setsprite comp res snap setport update play recieve record capture");
+	printf ("setsprite comp res snap setport update play recieve record capture simulcast repair");
 	printf ("\n");
 }
 
@@ -37,6 +37,17 @@ int main (int argc, char *argv[]) {
 			return 0;
 		}	
 
+		/* finishing a recording that was cut off is done here, no station needed */
+		if (strncmp(argv[2], "repair", 6) == 0) {
+			if (argc == 4) {
+				if (krad_ebml_repair_file (argv[3]) < 0) {
+					failfast ("Could not repair %s", argv[3]);
+				}
+				printf ("Repaired %s\n", argv[3]);
+			}
+			return 0;
+		}
+
 		client = krad_ipc_connect (argv[1]);
 	
 		if (client != NULL) {
@@ -147,6 +158,16 @@ int main (int argc, char *argv[]) {
 				}
 			}		
 			
+			if (strncmp(argv[2], "freewheel", 9) == 0) {
+				if (argc == 4) {
+					if ((strncmp(argv[3], "on", 2) == 0) || (strncmp(argv[3], "1", 1) == 0)) {
+						krad_ipc_radio_set_freewheel (client, 1);
+					} else {
+						krad_ipc_radio_set_freewheel (client, 0);
+					}
+				}
+			}
+			
 			/* Krad Mixer Commands */
 			
 			if (strncmp(argv[2], "lm", 2) == 0) {
@@ -312,9 +333,37 @@ int main (int argc, char *argv[]) {
 				
 			}		
 
+			if (strncmp(argv[2], "simulcast", 9) == 0) {
+				if (argc == 8) {
+					krad_ipc_create_simulcast_link (client, AUDIO_AND_VIDEO, argv[3], atoi(argv[4]), argv[5], argv[6], NULL,
+													0, 0, 0, 0, argv[7]);
+				}
+				if (argc == 9) {
+					krad_ipc_create_simulcast_link (client, AUDIO_AND_VIDEO, argv[3], atoi(argv[4]), argv[5], argv[6], argv[8],
+													0, 0, 0, 0, argv[7]);
+				}
+			}
+
 			if (strncmp(argv[2], "capture", 7) == 0) {
 				if (argc == 4) {
-					krad_ipc_create_capture_link (client, krad_link_string_to_video_source (argv[3]));
+					krad_ipc_create_capture_link (client, krad_link_string_to_video_source (argv[3]), NULL);
+				}
+				if (argc > 4) {
+					/* synth / file sources take the rest of the line as their spec,
+					   v4l2 takes its capture options, ie. mjpeg yuv threads=4 */
+					char spec[1024];
+					int a;
+					spec[0] = '\0';
+					for (a = 4; a < argc; a++) {
+						if ((strlen(spec) + strlen(argv[a]) + 2) > sizeof(spec)) {
+							break;
+						}
+						if (a > 4) {
+							strcat (spec, " ");
+						}
+						strcat (spec, argv[a]);
+					}
+					krad_ipc_create_capture_link (client, krad_link_string_to_video_source (argv[3]), spec);
 				}
 			}
 			
@@ -368,6 +417,9 @@ int main (int argc, char *argv[]) {
 				if (argc == 4) {
 					krad_ipc_create_playback_link (client, argv[3]);
 				}
+				if (argc == 5) {
+					krad_ipc_create_playback_link_from (client, argv[3], atof(argv[4]) * 1000);
+				}
 				if (argc == 6) {
 					krad_ipc_create_remote_playback_link (client, argv[3], atoi(argv[4]), argv[5] );
 				}
@@ -392,7 +444,54 @@ int main (int argc, char *argv[]) {
 				
 					if (strcmp(argv[4], "vp8_bitrate") == 0) {
 						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_BITRATE, atoi(argv[5]));
-					}				
+					}
+					if (strcmp(argv[4], "vp8_threads") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_THREADS, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "vp8_speed") == 0) {
+						if (strcmp(argv[5], "auto") == 0) {
+							krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_SPEED, 255);
+						} else {
+							krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_SPEED, atoi(argv[5]));
+						}
+					}
+					if (strcmp(argv[4], "vp8_deadline") == 0) {
+						if (strcmp(argv[5], "realtime") == 0) {
+							krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_DEADLINE, 1);
+						} else if (strcmp(argv[5], "auto") == 0) {
+							krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_DEADLINE,
+														  KRAD_LINK_VP8_DEADLINE_AUTO);
+						} else {
+							krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_DEADLINE, atoi(argv[5]));
+						}
+					}
+					if (strcmp(argv[4], "vp8_rc") == 0) {
+						krad_ipc_update_link_adv (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_RATE_CONTROL, argv[5]);
+					}
+					if (strcmp(argv[4], "vp8_buffer") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_VP8_BUFFER, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "add_output") == 0) {
+						krad_ipc_update_link_adv (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_ADD_OUTPUT, argv[5]);
+					}
+					if (strcmp(argv[4], "rm_output") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_REMOVE_OUTPUT, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "seek") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_SEEK_MS, atof(argv[5]) * 1000);
+					}
+					if (strcmp(argv[4], "interleave") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_MAX_INTERLEAVE, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "cluster_ms") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_LIVE_CLUSTER_MS, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "cluster_bytes") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_LIVE_CLUSTER_BYTES, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "flush_ms") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_LIVE_FLUSH_MS, atoi(argv[5]));
+					}
 					if (strcmp(argv[4], "opus_bitrate") == 0) {
 						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_OPUS_BITRATE, atoi(argv[5]));
 					}				
@@ -411,6 +510,18 @@ int main (int argc, char *argv[]) {
 					if (strcmp(argv[4], "ogg_maxpackets") == 0) {
 						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_OGG_MAX_PACKETS_PER_PAGE, atoi(argv[5]));
 					}
+					if (strcmp(argv[4], "udp_pace_kbps") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_UDP_PACE_KBPS, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "udp_txtime") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_UDP_PACE_TXTIME, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "udp_fec") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_UDP_FEC_GROUP, atoi(argv[5]));
+					}
+					if (strcmp(argv[4], "udp_latency") == 0) {
+						krad_ipc_update_link_adv_num (client, atoi(argv[3]), EBML_ID_KRAD_LINK_LINK_UDP_LATENCY_MS, atoi(argv[5]));
+					}
 				}				
 			}
 			
@@ -0,0 +1,473 @@
+#include "krad_radio.h"
+
+#include <getopt.h>
+
+/* Runs the real video path, synth source -> compositor -> yuv -> encoder -> container,
+   one frame at a time with no ticker, and prints one JSON object per scenario
+   on stdout so runs can be diffed and graphed. Human readable notes go to stderr. */
+
+#define KRAD_BENCH_DEFAULT_FRAMES 300
+#define KRAD_BENCH_DEFAULT_WARMUP 15
+
+typedef enum {
+	KRAD_BENCH_SOURCE,
+	KRAD_BENCH_COMPOSITE,
+	KRAD_BENCH_CONVERT,
+	KRAD_BENCH_ENCODE,
+	KRAD_BENCH_MUX,
+	KRAD_BENCH_TOTAL,
+	KRAD_BENCH_STAGES,
+} krad_bench_stage_t;
+
+static char *krad_bench_stage_names[KRAD_BENCH_STAGES] = { "source", "composite", "convert",
+														   "encode", "mux", "total" };
+
+typedef struct {
+
+	krad_codec_t codec;
+	char *pattern;
+	int width;
+	int height;
+	int fps_numerator;
+	int fps_denominator;
+	int bitrate;
+	int frames;
+	int warmup;
+	int keep;
+	char *output_dir;
+
+	uint64_t *samples[KRAD_BENCH_STAGES];
+	uint64_t bytes;
+	uint64_t packets;
+	int compositor_frames_peak;
+	int link_frames_peak;
+
+} krad_bench_t;
+
+static uint64_t krad_bench_now () {
+
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+
+}
+
+static int krad_bench_compare (const void *a, const void *b) {
+
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+
+}
+
+static int krad_bench_proc_status_kb (char *field) {
+
+	FILE *status;
+	char line[256];
+	int kb;
+
+	kb = -1;
+
+	status = fopen ("/proc/self/status", "r");
+
+	if (status == NULL) {
+		return -1;
+	}
+
+	while (fgets (line, sizeof(line), status) != NULL) {
+		if (strncmp (line, field, strlen(field)) == 0) {
+			sscanf (line + strlen(field), ": %d", &kb);
+			break;
+		}
+	}
+
+	fclose (status);
+
+	return kb;
+
+}
+
+static cJSON *krad_bench_stage_json (uint64_t *samples, int count) {
+
+	cJSON *stage;
+	uint64_t total;
+	int s;
+
+	stage = cJSON_CreateObject ();
+
+	total = 0;
+
+	for (s = 0; s < count; s++) {
+		total += samples[s];
+	}
+
+	qsort (samples, count, sizeof(uint64_t), krad_bench_compare);
+
+	cJSON_AddNumberToObject (stage, "mean_us", (total / count) / 1000.0);
+	cJSON_AddNumberToObject (stage, "min_us", samples[0] / 1000.0);
+	cJSON_AddNumberToObject (stage, "p50_us", samples[count / 2] / 1000.0);
+	cJSON_AddNumberToObject (stage, "p95_us", samples[(count * 95) / 100] / 1000.0);
+	cJSON_AddNumberToObject (stage, "p99_us", samples[(count * 99) / 100] / 1000.0);
+	cJSON_AddNumberToObject (stage, "max_us", samples[count - 1] / 1000.0);
+
+	return stage;
+
+}
+
+static void krad_bench_report (krad_bench_t *bench, char *scenario, uint64_t elapsed, int vm_hwm_setup) {
+
+	cJSON *report;
+	cJSON *stages;
+	cJSON *memory;
+	char *out;
+	int count;
+	int s;
+
+	count = bench->frames - bench->warmup;
+
+	report = cJSON_CreateObject ();
+
+	cJSON_AddStringToObject (report, "scenario", scenario);
+	cJSON_AddStringToObject (report, "codec", krad_codec_to_string (bench->codec));
+	cJSON_AddStringToObject (report, "pattern", bench->pattern);
+	cJSON_AddNumberToObject (report, "width", bench->width);
+	cJSON_AddNumberToObject (report, "height", bench->height);
+	cJSON_AddNumberToObject (report, "frames", count);
+	cJSON_AddNumberToObject (report, "seconds", elapsed / 1000000000.0);
+	cJSON_AddNumberToObject (report, "fps", count / (elapsed / 1000000000.0));
+	cJSON_AddNumberToObject (report, "packets", bench->packets);
+	cJSON_AddNumberToObject (report, "bytes", bench->bytes);
+	cJSON_AddNumberToObject (report, "kbps", ((bench->bytes * 8.0) / 1000.0) /
+							 ((double)bench->frames * bench->fps_denominator / bench->fps_numerator));
+
+	cJSON_AddItemToObject (report, "stages", stages = cJSON_CreateObject ());
+
+	for (s = 0; s < KRAD_BENCH_STAGES; s++) {
+		cJSON_AddItemToObject (stages, krad_bench_stage_names[s],
+							   krad_bench_stage_json (bench->samples[s] + bench->warmup, count));
+	}
+
+	cJSON_AddItemToObject (report, "memory", memory = cJSON_CreateObject ());
+	cJSON_AddNumberToObject (memory, "vm_hwm_kb", krad_bench_proc_status_kb ("VmHWM"));
+	cJSON_AddNumberToObject (memory, "vm_hwm_setup_kb", vm_hwm_setup);
+	cJSON_AddNumberToObject (memory, "vm_rss_kb", krad_bench_proc_status_kb ("VmRSS"));
+	cJSON_AddNumberToObject (memory, "compositor_frames_peak", bench->compositor_frames_peak);
+	cJSON_AddNumberToObject (memory, "source_frames_peak", bench->link_frames_peak);
+
+	out = cJSON_PrintUnformatted (report);
+	printf ("%s\n", out);
+	fflush (stdout);
+	free (out);
+
+	cJSON_Delete (report);
+
+}
+
+static void krad_bench_run (krad_bench_t *bench) {
+
+	krad_compositor_t *krad_compositor;
+	krad_compositor_port_t *input_port;
+	krad_compositor_port_t *output_port;
+	krad_framepool_t *krad_framepool;
+	krad_synth_t *krad_synth;
+	krad_frame_t *krad_frame;
+	krad_vpx_encoder_t *krad_vpx_encoder;
+	krad_theora_encoder_t *krad_theora_encoder;
+	krad_container_t *krad_container;
+	unsigned char *planes[3];
+	int strides[3];
+	unsigned char *packet;
+	int packet_size;
+	int keyframe;
+	int track;
+	int f;
+	int s;
+	int in_use;
+	int vm_hwm_setup;
+	uint64_t stamp[KRAD_BENCH_STAGES + 1];
+	uint64_t start;
+	char spec[256];
+	char scenario[256];
+	char filename[512];
+
+	krad_vpx_encoder = NULL;
+	krad_theora_encoder = NULL;
+
+	sprintf (scenario, "%s_%s_%dx%d", krad_codec_to_string (bench->codec), bench->pattern,
+			 bench->width, bench->height);
+
+	sprintf (filename, "%s/krad_radio_bench_%s.%s", bench->output_dir, scenario,
+			 bench->codec == THEORA ? "ogg" : "webm");
+
+	for (s = 0; s < KRAD_BENCH_STAGES; s++) {
+		bench->samples[s] = calloc (bench->frames, sizeof(uint64_t));
+	}
+
+	bench->bytes = 0;
+	bench->packets = 0;
+	bench->compositor_frames_peak = 0;
+	bench->link_frames_peak = 0;
+
+	/* Setup, the same calls the daemon makes */
+
+	sprintf (spec, "%s %dx%d %d/%d", bench->pattern, bench->width, bench->height,
+			 bench->fps_numerator, bench->fps_denominator);
+
+	krad_synth = krad_synth_create (spec);
+
+	krad_compositor = krad_compositor_create (bench->width, bench->height,
+											  bench->fps_numerator, bench->fps_denominator);
+
+	krad_framepool = krad_framepool_create (bench->width, bench->height, DEFAULT_CAPTURE_BUFFER_FRAMES);
+
+	input_port = krad_compositor_port_create (krad_compositor, "BenchIn", INPUT, bench->width, bench->height);
+	output_port = krad_compositor_port_create (krad_compositor, "BenchOut", OUTPUT, bench->width, bench->height);
+
+	if (bench->codec == VP8) {
+
+		krad_vpx_encoder = krad_vpx_encoder_create (bench->width, bench->height,
+													bench->fps_numerator, bench->fps_denominator,
+													bench->bitrate);
+
+		krad_vpx_encoder_config_set (krad_vpx_encoder, &krad_vpx_encoder->cfg);
+
+		krad_vpx_encoder_quality_set (krad_vpx_encoder,
+									  (((1000 / (bench->fps_numerator / bench->fps_denominator)) / 3) * 2) * 1000);
+
+		planes[0] = krad_vpx_encoder->image->planes[0];
+		planes[1] = krad_vpx_encoder->image->planes[1];
+		planes[2] = krad_vpx_encoder->image->planes[2];
+		strides[0] = krad_vpx_encoder->image->stride[0];
+		strides[1] = krad_vpx_encoder->image->stride[1];
+		strides[2] = krad_vpx_encoder->image->stride[2];
+	} else {
+
+		krad_theora_encoder = krad_theora_encoder_create (bench->width, bench->height,
+														  bench->fps_numerator, bench->fps_denominator,
+														  DEFAULT_THEORA_QUALITY);
+
+		planes[0] = krad_theora_encoder->ycbcr[0].data;
+		planes[1] = krad_theora_encoder->ycbcr[1].data;
+		planes[2] = krad_theora_encoder->ycbcr[2].data;
+		strides[0] = krad_theora_encoder->ycbcr[0].stride;
+		strides[1] = krad_theora_encoder->ycbcr[1].stride;
+		strides[2] = krad_theora_encoder->ycbcr[2].stride;
+	}
+
+	krad_container = krad_container_open_file (filename, KRAD_EBML_IO_WRITEONLY);
+
+	if (bench->codec == VP8) {
+		krad_ebml_header (krad_container->krad_ebml, "webm", APPVERSION);
+		track = krad_container_add_video_track (krad_container, VP8,
+												bench->fps_numerator, bench->fps_denominator,
+												bench->width, bench->height);
+	} else {
+		track = krad_container_add_video_track_with_private_data (krad_container, THEORA,
+																  bench->fps_numerator, bench->fps_denominator,
+																  bench->width, bench->height,
+																  &krad_theora_encoder->krad_codec_header);
+	}
+
+	vm_hwm_setup = krad_bench_proc_status_kb ("VmHWM");
+
+	/* Frame loop */
+
+	start = 0;
+
+	for (f = 0; f < bench->frames; f++) {
+
+		if (f == bench->warmup) {
+			start = krad_bench_now ();
+		}
+
+		stamp[0] = krad_bench_now ();
+
+		krad_frame = krad_framepool_getframe (krad_framepool);
+
+		if (krad_frame == NULL) {
+			failfast ("Krad Bench: source framepool ran dry at frame %d", f);
+		}
+
+		krad_synth_render (krad_synth, krad_frame->pixels, bench->width);
+		krad_frame->timecode = (f * 1000LL * bench->fps_denominator) / bench->fps_numerator;
+		krad_compositor_port_push_rgba_frame (input_port, krad_frame);
+		krad_framepool_unref_frame (krad_frame);
+		krad_synth_next_frame (krad_synth);
+
+		stamp[1] = krad_bench_now ();
+
+		krad_compositor_process (krad_compositor);
+
+		stamp[2] = krad_bench_now ();
+
+		krad_frame = krad_compositor_port_pull_yuv_frame (output_port, planes, strides);
+
+		if (krad_frame == NULL) {
+			failfast ("Krad Bench: compositor produced no frame at frame %d", f);
+		}
+
+		in_use = krad_framepool_frames_in_use (krad_compositor->krad_framepool);
+		if (in_use > bench->compositor_frames_peak) {
+			bench->compositor_frames_peak = in_use;
+		}
+		in_use = krad_framepool_frames_in_use (krad_framepool);
+		if (in_use > bench->link_frames_peak) {
+			bench->link_frames_peak = in_use;
+		}
+
+		krad_framepool_unref_frame (krad_frame);
+
+		stamp[3] = krad_bench_now ();
+
+		if (bench->codec == VP8) {
+			packet_size = krad_vpx_encoder_write (krad_vpx_encoder, &packet, &keyframe);
+		} else {
+			packet_size = krad_theora_encoder_write (krad_theora_encoder, &packet, &keyframe);
+		}
+
+		stamp[4] = krad_bench_now ();
+
+		if (packet_size > 0) {
+			krad_container_add_video (krad_container, track, packet, packet_size, keyframe);
+			bench->bytes += packet_size;
+			bench->packets++;
+		}
+
+		stamp[5] = krad_bench_now ();
+
+		for (s = 0; s < KRAD_BENCH_TOTAL; s++) {
+			bench->samples[s][f] = stamp[s + 1] - stamp[s];
+		}
+		bench->samples[KRAD_BENCH_TOTAL][f] = stamp[5] - stamp[0];
+	}
+
+	/* encoder lag is part of the cost of a run */
+
+	if (bench->codec == VP8) {
+		krad_vpx_encoder_finish (krad_vpx_encoder);
+		while ((packet_size = krad_vpx_encoder_write (krad_vpx_encoder, &packet, &keyframe)) > 0) {
+			krad_container_add_video (krad_container, track, packet, packet_size, keyframe);
+			bench->bytes += packet_size;
+			bench->packets++;
+		}
+	}
+
+	krad_bench_report (bench, scenario, krad_bench_now () - start, vm_hwm_setup);
+
+	/* Teardown */
+
+	krad_container_destroy (krad_container);
+
+	if (krad_vpx_encoder != NULL) {
+		krad_vpx_encoder_destroy (krad_vpx_encoder);
+	}
+
+	if (krad_theora_encoder != NULL) {
+		krad_theora_encoder_destroy (krad_theora_encoder);
+	}
+
+	krad_compositor_port_destroy (krad_compositor, input_port);
+	krad_compositor_port_destroy (krad_compositor, output_port);
+	krad_compositor_destroy (krad_compositor);
+	krad_framepool_destroy (krad_framepool);
+	krad_synth_destroy (krad_synth);
+
+	for (s = 0; s < KRAD_BENCH_STAGES; s++) {
+		free (bench->samples[s]);
+	}
+
+	if (!bench->keep) {
+		unlink (filename);
+	} else {
+		fprintf (stderr, "Krad Bench: kept %s\n", filename);
+	}
+}
+
+static void krad_bench_usage (char *name) {
+
+	fprintf (stderr, "Usage: %s [-c vp8|theora|all] [-p bars|gradient|noise] [-s WxH] [-r fps]\n"
+					 "          [-n frames] [-w warmup] [-b vp8 bitrate] [-d outdir] [-k]\n", name);
+	exit (1);
+
+}
+
+int main (int argc, char *argv[]) {
+
+	krad_bench_t bench;
+	char *codecs;
+	int opt;
+
+	krad_system_init ();
+
+	memset (&bench, 0, sizeof(krad_bench_t));
+
+	bench.pattern = "bars";
+	bench.width = DEFAULT_COMPOSITOR_WIDTH;
+	bench.height = DEFAULT_COMPOSITOR_HEIGHT;
+	bench.fps_numerator = DEFAULT_FPS_NUMERATOR;
+	bench.fps_denominator = DEFAULT_FPS_DENOMINATOR;
+	bench.bitrate = DEFAULT_VPX_BITRATE;
+	bench.frames = KRAD_BENCH_DEFAULT_FRAMES;
+	bench.warmup = KRAD_BENCH_DEFAULT_WARMUP;
+	bench.output_dir = "/tmp";
+
+	codecs = "all";
+
+	while ((opt = getopt (argc, argv, "c:p:s:r:n:w:b:d:kh")) != -1) {
+		switch (opt) {
+			case 'c':
+				codecs = optarg;
+				break;
+			case 'p':
+				bench.pattern = optarg;
+				break;
+			case 's':
+				if (sscanf (optarg, "%dx%d", &bench.width, &bench.height) != 2) {
+					krad_bench_usage (argv[0]);
+				}
+				break;
+			case 'r':
+				bench.fps_numerator = atoi (optarg) * 1000;
+				bench.fps_denominator = 1000;
+				break;
+			case 'n':
+				bench.frames = atoi (optarg);
+				break;
+			case 'w':
+				bench.warmup = atoi (optarg);
+				break;
+			case 'b':
+				bench.bitrate = atoi (optarg);
+				break;
+			case 'd':
+				bench.output_dir = optarg;
+				break;
+			case 'k':
+				bench.keep = 1;
+				break;
+			default:
+				krad_bench_usage (argv[0]);
+		}
+	}
+
+	if ((bench.frames - bench.warmup < 1) || (bench.fps_numerator < 1000) ||
+		(bench.width < 16) || (bench.height < 16)) {
+		krad_bench_usage (argv[0]);
+	}
+
+	if ((strcmp (codecs, "all") == 0) || (strcmp (codecs, "vp8") == 0)) {
+		bench.codec = VP8;
+		krad_bench_run (&bench);
+	}
+
+	if ((strcmp (codecs, "all") == 0) || (strcmp (codecs, "theora") == 0)) {
+		bench.codec = THEORA;
+		krad_bench_run (&bench);
+	}
+
+	return 0;
+
+}
@@ -0,0 +1,3 @@
+gcc -g -Wall -fgnu89-inline -I../tools/krad_ebml/ -I../tools/krad_system/ \
+../tools/krad_ebml/krad_ebml.c ../tools/krad_system/krad_system.c \
+krad_ebml_live_test.c -o krad_ebml_live_test -lm -lpthread
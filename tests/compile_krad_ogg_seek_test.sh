@@ -0,0 +1,5 @@
+gcc -g -Wall -pthread -I../tools/krad_ogg/ -I../tools/krad_io/ -I../tools/krad_transmitter/ -I../tools/krad_radio/ \
+-I../tools/krad_ring/ -I../tools/krad_system/ \
+../tools/krad_ogg/krad_ogg.c ../tools/krad_io/krad_io.c ../tools/krad_transmitter/krad_transmitter.c \
+../tools/krad_ring/krad_ring.c ../tools/krad_system/krad_system.c \
+krad_ogg_seek_test.c -o krad_ogg_seek_test `pkg-config --libs --cflags ogg vorbis vorbisenc theora theoradec theoraenc` -lm
@@ -0,0 +1,5 @@
+gcc -g -Wall -fgnu89-inline -I../tools/krad_opus/ -I../tools/krad_system/ -I../tools/krad_ring/ \
+-I../tools/krad_container/ -I../tools/krad_radio/ -I../tools/krad_blockpool/ \
+../tools/krad_opus/krad_opus.c ../tools/krad_opus/opus_header.c ../tools/krad_ring/krad_ring.c \
+../tools/krad_system/krad_system.c \
+krad_opus_interleave_test.c -o krad_opus_interleave_test `pkg-config --libs --cflags opus samplerate ogg` -lm -lpthread
@@ -0,0 +1,3 @@
+gcc -g -Wall -fgnu89-inline -I../tools/krad_io/ -I../tools/krad_system/ \
+../tools/krad_io/krad_prefetch.c ../tools/krad_system/krad_system.c \
+krad_prefetch_test.c -o krad_prefetch_test -lm -lpthread
@@ -0,0 +1,4 @@
+gcc -g -Wall -I../tools/krad_ring/ -I../tools/krad_system/ \
+../tools/krad_ring/krad_resample_ring.c ../tools/krad_ring/krad_ring.c \
+../tools/krad_system/krad_system.c krad_resample_ring_drift_test.c -o krad_resample_ring_drift_test \
+-lsamplerate -lm -lpthread
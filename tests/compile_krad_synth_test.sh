@@ -0,0 +1,4 @@
+gcc -g -Wall -pthread -I../tools/krad_synth/ -I../tools/krad_ticker/ -I../tools/krad_system/ \
+../tools/krad_synth/krad_synth.c ../tools/krad_ticker/krad_ticker.c \
+../tools/krad_system/krad_system.c krad_synth_test.c -o krad_synth_test \
+-lm -lrt
@@ -0,0 +1,3 @@
+gcc -g -Wall -I../tools/krad_udp/ -I../tools/krad_system/ \
+../tools/krad_udp/krad_udp.c ../tools/krad_system/krad_system.c \
+krad_udp_loss_test.c -o krad_udp_loss_test -lm -lpthread
@@ -0,0 +1,3 @@
+gcc -g -Wall -I../tools/krad_v4l2/ -I../tools/krad_system/ \
+../tools/krad_v4l2/krad_v4l2.c ../tools/krad_system/krad_system.c krad_v4l2_test.c -o krad_v4l2_test \
+-lturbojpeg -lm
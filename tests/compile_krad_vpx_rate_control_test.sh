@@ -0,0 +1,3 @@
+gcc -g -Wall -fgnu89-inline -I../tools/krad_vpx/ -I../tools/krad_system/ \
+../tools/krad_vpx/krad_vpx.c ../tools/krad_system/krad_system.c \
+krad_vpx_rate_control_test.c -o krad_vpx_rate_control_test `pkg-config --libs --cflags vpx` -lm -lpthread
@@ -0,0 +1,254 @@
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "krad_ebml.h"
+
+/* Writes a recording with a keyframe every 2 seconds and checks the
+   seekhead finds the cues and every cue lands on a cluster. Then has a
+   child process write another one and exit without finishing it, like
+   a crash would, and checks repairing it from the sidecar index gives
+   the same, less the cluster that was still buffered. */
+
+#define TEST_FILE "/tmp/krad_ebml_cues_test.webm"
+#define TEST_INDEX TEST_FILE KRAD_EBML_INDEX_SUFFIX
+#define TEST_SECONDS 35
+#define TEST_KEYFRAME_INTERVAL 60
+#define TEST_VIDEO_SIZE 3000
+#define TEST_AUDIO_SIZE 160
+#define TEST_AUDIO_FRAMES 960
+
+static const unsigned char segment_id[4] = { 0x18, 0x53, 0x80, 0x67 };
+static const unsigned char seekhead_id[4] = { 0x11, 0x4D, 0x9B, 0x74 };
+static const unsigned char cues_id[4] = { 0x1C, 0x53, 0xBB, 0x6B };
+static const unsigned char cluster_id[4] = { 0x1F, 0x43, 0xB6, 0x75 };
+
+static void write_recording (int finish) {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char video[TEST_VIDEO_SIZE];
+	unsigned char audio[TEST_AUDIO_SIZE];
+	int video_track;
+	int audio_track;
+	int frame;
+	int64_t video_timecode;
+	int64_t audio_timecode;
+
+	memset (video, 0, sizeof(video));
+	memset (audio, 0, sizeof(audio));
+	audio_timecode = 0;
+
+	krad_ebml = krad_ebml_open_file (TEST_FILE, KRAD_EBML_IO_WRITEONLY);
+	krad_ebml_header (krad_ebml, "webm", "krad_ebml_cues_test");
+	video_track = krad_ebml_add_video_track (krad_ebml, VP8, 30, 1, 640, 360);
+	audio_track = krad_ebml_add_audio_track (krad_ebml, VORBIS, 48000, 2, NULL, 0);
+
+	for (frame = 0; frame < TEST_SECONDS * 30; frame++) {
+
+		video_timecode = frame * 1000 / 30;
+
+		while (audio_timecode < video_timecode) {
+			krad_ebml_add_audio_timecode (krad_ebml, audio_track, audio, sizeof(audio),
+										  TEST_AUDIO_FRAMES, audio_timecode);
+			audio_timecode += TEST_AUDIO_FRAMES * 1000 / 48000;
+		}
+
+		krad_ebml_add_video_timecode (krad_ebml, video_track, video, sizeof(video),
+									  (frame % TEST_KEYFRAME_INTERVAL) == 0, video_timecode);
+	}
+
+	if (finish) {
+		krad_ebml_destroy (krad_ebml);
+	}
+}
+
+static uint64_t read_vint (unsigned char *data, int *length) {
+
+	uint64_t value;
+	int b;
+
+	for (*length = 1; *length < 8; (*length)++) {
+		if (data[0] & (0x80 >> (*length - 1))) {
+			break;
+		}
+	}
+
+	value = data[0] & (0xFF >> *length);
+	for (b = 1; b < *length; b++) {
+		value = (value << 8) | data[b];
+	}
+
+	return value;
+}
+
+static uint64_t read_uint (unsigned char *data, int length) {
+
+	uint64_t value;
+	int b;
+
+	value = 0;
+	for (b = 0; b < length; b++) {
+		value = (value << 8) | data[b];
+	}
+
+	return value;
+}
+
+static unsigned char *find (unsigned char *file, long size, const unsigned char *id) {
+
+	long pos;
+
+	for (pos = 0; pos + 4 < size; pos++) {
+		if (memcmp (file + pos, id, 4) == 0) {
+			return file + pos;
+		}
+	}
+
+	return NULL;
+}
+
+/* returns the number of cues, or -1 if anything is off */
+
+static int check_recording (char *name) {
+
+	unsigned char *file;
+	unsigned char *segment;
+	unsigned char *seekhead;
+	unsigned char *cues;
+	unsigned char *cue;
+	unsigned char *end;
+	FILE *fp;
+	struct stat st;
+	uint64_t size;
+	uint64_t id;
+	uint64_t position;
+	int length;
+	int cue_count;
+	int cues_found;
+
+	if (stat (TEST_INDEX, &st) == 0) {
+		printf ("%s: index was left behind\n", name);
+		return -1;
+	}
+
+	stat (TEST_FILE, &st);
+	file = malloc (st.st_size);
+	fp = fopen (TEST_FILE, "rb");
+	if ((fp == NULL) || (fread (file, 1, st.st_size, fp) != st.st_size)) {
+		printf ("%s: could not read back %s\n", name, TEST_FILE);
+		return -1;
+	}
+	fclose (fp);
+
+	cue_count = -1;
+	cues_found = 0;
+
+	segment = find (file, st.st_size, segment_id);
+	seekhead = find (file, st.st_size, seekhead_id);
+	cues = NULL;
+	if (seekhead != NULL) {
+		/* past the seekhead, which has the cues id in it */
+		size = read_vint (seekhead + 4, &length);
+		end = seekhead + 4 + length + size;
+		cues = find (end, file + st.st_size - end, cues_id);
+	}
+
+	if ((segment == NULL) || (seekhead == NULL) || (cues == NULL)) {
+		printf ("%s: segment, seekhead or cues missing\n", name);
+		goto done;
+	}
+
+	size = read_vint (segment + 4, &length);
+	segment += 4 + length;
+	if (segment + size != file + st.st_size) {
+		printf ("%s: segment size %"PRIu64" does not reach the end of the file\n", name, size);
+		goto done;
+	}
+
+	/* seekhead entries are seek, seekid (4 byte id), seekposition */
+	size = read_vint (seekhead + 4, &length);
+	end = seekhead + 4 + length + size;
+	seekhead += 4 + length;
+	while (seekhead < end) {
+		seekhead += 2;
+		size = read_vint (seekhead, &length);
+		seekhead += length;
+		id = read_uint (seekhead + 3, 4);
+		size = read_vint (seekhead + 9, &length);
+		position = read_uint (seekhead + 9 + length, size);
+		if ((id == EBML_ID_CUES) && (segment + position == cues)) {
+			cues_found = 1;
+		}
+		seekhead += 9 + length + size;
+	}
+
+	if (!cues_found) {
+		printf ("%s: seekhead does not point at the cues\n", name);
+		goto done;
+	}
+
+	/* cuepoint, cuetime, cuetrackpositions, cuetrack, cueclusterposition */
+	size = read_vint (cues + 4, &length);
+	end = cues + 4 + length + size;
+	cue = cues + 4 + length;
+	cue_count = 0;
+	while (cue < end) {
+		size = read_vint (cue + 1, &length);
+		position = read_uint (cue + 1 + length + 2 + 8 + 1 + 8 + 3 + 2, 8);
+		if (memcmp (segment + position, cluster_id, 4) != 0) {
+			printf ("%s: cue %d at %"PRIu64" is not a cluster\n", name, cue_count, position);
+			cue_count = -1;
+			goto done;
+		}
+		cue_count++;
+		cue += 1 + length + size;
+	}
+
+done:
+	free (file);
+
+	return cue_count;
+}
+
+int main (int argc, char *argv[]) {
+
+	pid_t child;
+	int finished_cues;
+	int repaired_cues;
+
+	unlink (TEST_FILE);
+	unlink (TEST_INDEX);
+
+	write_recording (1);
+	finished_cues = check_recording ("finished");
+
+	unlink (TEST_FILE);
+
+	child = fork ();
+	if (child == 0) {
+		write_recording (0);
+		_exit (0);
+	}
+	waitpid (child, NULL, 0);
+
+	if (krad_ebml_repair_file (TEST_FILE) < 0) {
+		repaired_cues = -1;
+	} else {
+		repaired_cues = check_recording ("repaired");
+	}
+
+	unlink (TEST_FILE);
+	unlink (TEST_INDEX);
+
+	printf ("finished recording has %d cues, repaired recording has %d cues\n",
+			finished_cues, repaired_cues);
+
+	if ((finished_cues != (TEST_SECONDS * 30 + TEST_KEYFRAME_INTERVAL - 1) / TEST_KEYFRAME_INTERVAL) || (repaired_cues < finished_cues - 1)) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
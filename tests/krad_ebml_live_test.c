@@ -0,0 +1,136 @@
+#include <sys/stat.h>
+
+#include "krad_ebml.h"
+
+/* Writes ten seconds of 30fps video with a keyframe every 3 seconds and
+   20ms audio packets in live mode, checks every block was out on disk
+   as soon as it was added, then reads the clusters back and checks they
+   are unknown size and no longer than the limit. */
+
+#define TEST_FILE "/tmp/krad_ebml_live_test.webm"
+#define TEST_SECONDS 10
+#define TEST_CLUSTER_MS 500
+#define TEST_CLUSTER_BYTES 64 * 1024
+#define TEST_KEYFRAME_INTERVAL 90
+#define TEST_VIDEO_SIZE 3000
+#define TEST_AUDIO_SIZE 160
+#define TEST_AUDIO_FRAMES 960
+
+static const unsigned char cluster_id[4] = { 0x1F, 0x43, 0xB6, 0x75 };
+static const unsigned char unknown_size[8] = { 0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static int check_flushed (krad_ebml_t *krad_ebml) {
+
+	struct stat st;
+
+	if (stat (TEST_FILE, &st) != 0) {
+		return 0;
+	}
+
+	return ((krad_ebml->io_adapter.write_buffer_pos == 0) &&
+			(st.st_size == krad_ebml->io_adapter.write_buffer_base));
+}
+
+int main (int argc, char *argv[]) {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char video[TEST_VIDEO_SIZE];
+	unsigned char audio[TEST_AUDIO_SIZE];
+	unsigned char *file;
+	FILE *fp;
+	struct stat st;
+	int video_track;
+	int audio_track;
+	int frame;
+	int64_t video_timecode;
+	int64_t audio_timecode;
+	int not_flushed;
+	int clusters;
+	int sized;
+	int too_long;
+	int64_t timecode;
+	int64_t last_timecode;
+	long pos;
+	int b;
+
+	not_flushed = 0;
+	clusters = 0;
+	sized = 0;
+	too_long = 0;
+	last_timecode = -1;
+	audio_timecode = 0;
+
+	memset (video, 0, sizeof(video));
+	memset (audio, 0, sizeof(audio));
+
+	unlink (TEST_FILE);
+
+	krad_ebml = krad_ebml_open_file (TEST_FILE, KRAD_EBML_IO_WRITEONLY);
+	krad_ebml_set_live (krad_ebml, TEST_CLUSTER_MS, TEST_CLUSTER_BYTES, 0);
+	krad_ebml_header (krad_ebml, "webm", "krad_ebml_live_test");
+	video_track = krad_ebml_add_video_track (krad_ebml, VP8, 30, 1, 640, 360);
+	audio_track = krad_ebml_add_audio_track (krad_ebml, VORBIS, 48000, 2, NULL, 0);
+
+	for (frame = 0; frame < TEST_SECONDS * 30; frame++) {
+
+		video_timecode = frame * 1000 / 30;
+
+		while (audio_timecode < video_timecode) {
+			krad_ebml_add_audio_timecode (krad_ebml, audio_track, audio, sizeof(audio),
+										  TEST_AUDIO_FRAMES, audio_timecode);
+			not_flushed += !check_flushed (krad_ebml);
+			audio_timecode += TEST_AUDIO_FRAMES * 1000 / 48000;
+		}
+
+		krad_ebml_add_video_timecode (krad_ebml, video_track, video, sizeof(video),
+									  (frame % TEST_KEYFRAME_INTERVAL) == 0, video_timecode);
+		not_flushed += !check_flushed (krad_ebml);
+	}
+
+	krad_ebml_destroy (krad_ebml);
+
+	stat (TEST_FILE, &st);
+	file = malloc (st.st_size);
+	fp = fopen (TEST_FILE, "rb");
+	if ((fp == NULL) || (fread (file, 1, st.st_size, fp) != st.st_size)) {
+		printf ("could not read back %s\n", TEST_FILE);
+		return 1;
+	}
+	fclose (fp);
+
+	// blocks are all zeros so the cluster id can't turn up in them
+	for (pos = 0; pos + 22 < st.st_size; pos++) {
+		if (memcmp (file + pos, cluster_id, 4) != 0) {
+			continue;
+		}
+		clusters++;
+		if (memcmp (file + pos + 4, unknown_size, 8) != 0) {
+			sized++;
+		}
+		timecode = 0;
+		for (b = 0; b < 8; b++) {
+			timecode = (timecode << 8) | file[pos + 14 + b];
+		}
+		// a cluster may run one frame past the limit before it is cut
+		if ((last_timecode != -1) && (timecode - last_timecode > TEST_CLUSTER_MS + 34)) {
+			too_long++;
+		}
+		last_timecode = timecode;
+	}
+
+	free (file);
+	unlink (TEST_FILE);
+
+	printf ("%d clusters, %d sized, %d longer than %dms, %d blocks left buffered\n",
+			clusters, sized, too_long, TEST_CLUSTER_MS, not_flushed);
+
+	if ((clusters < TEST_SECONDS * 1000 / TEST_CLUSTER_MS) || (sized) || (too_long) || (not_flushed)) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
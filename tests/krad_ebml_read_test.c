@@ -0,0 +1,207 @@
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "krad_ebml.h"
+
+/* Writes a recording where every frame is filled with its own number,
+   a few of them bigger than the read buffer, then reads it back from
+   the mapped file and through a pipe, copied out and in place, and
+   checks every packet comes back whole and in order. */
+
+#define TEST_FILE "/tmp/krad_ebml_read_test.webm"
+#define TEST_FRAMES 300
+#define TEST_BIG_FRAME_INTERVAL 100
+#define TEST_BIG_FRAME_SIZE KRAD_EBML_READ_BUFFER_SIZE + 12345
+#define TEST_AUDIO_SIZE 160
+#define TEST_AUDIO_FRAMES 960
+
+static int video_frame_size (int frame) {
+
+	if ((frame % TEST_BIG_FRAME_INTERVAL) == TEST_BIG_FRAME_INTERVAL - 1) {
+		return TEST_BIG_FRAME_SIZE;
+	}
+
+	return 1000 + (frame * 37) % 5000;
+}
+
+static void write_recording () {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char *video;
+	unsigned char audio[TEST_AUDIO_SIZE];
+	int video_track;
+	int audio_track;
+	int frame;
+	int audio_packet;
+	int64_t video_timecode;
+	int64_t audio_timecode;
+
+	video = malloc (TEST_BIG_FRAME_SIZE);
+	audio_timecode = 0;
+	audio_packet = 0;
+
+	krad_ebml = krad_ebml_open_file (TEST_FILE, KRAD_EBML_IO_WRITEONLY);
+	krad_ebml_header (krad_ebml, "webm", "krad_ebml_read_test");
+	video_track = krad_ebml_add_video_track (krad_ebml, VP8, 30, 1, 640, 360);
+	audio_track = krad_ebml_add_audio_track (krad_ebml, VORBIS, 48000, 2, NULL, 0);
+
+	for (frame = 0; frame < TEST_FRAMES; frame++) {
+
+		video_timecode = frame * 1000 / 30;
+
+		while (audio_timecode < video_timecode) {
+			memset (audio, audio_packet++ & 0xff, sizeof(audio));
+			krad_ebml_add_audio_timecode (krad_ebml, audio_track, audio, sizeof(audio),
+										  TEST_AUDIO_FRAMES, audio_timecode);
+			audio_timecode += TEST_AUDIO_FRAMES * 1000 / 48000;
+		}
+
+		memset (video, frame & 0xff, video_frame_size (frame));
+		krad_ebml_add_video_timecode (krad_ebml, video_track, video, video_frame_size (frame),
+									  (frame % 30) == 0, video_timecode);
+	}
+
+	krad_ebml_destroy (krad_ebml);
+	free (video);
+}
+
+static int check_frame (unsigned char *data, int size, int expected_size, int fill) {
+
+	int b;
+
+	if (size != expected_size) {
+		return 0;
+	}
+
+	for (b = 0; b < size; b++) {
+		if (data[b] != fill) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* returns the number of bad packets, or -1 if it stopped early */
+
+static int read_recording (char *name, char *filename, int in_place) {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char *buffer;
+	unsigned char *frame;
+	uint64_t timecode;
+	int track;
+	int size;
+	int video_frames;
+	int audio_packets;
+	int bad;
+
+	buffer = malloc (TEST_BIG_FRAME_SIZE);
+	video_frames = 0;
+	audio_packets = 0;
+	bad = 0;
+
+	krad_ebml = krad_ebml_open_file (filename, KRAD_EBML_IO_READONLY);
+
+	printf ("%s: %s\n", name, krad_ebml->io_adapter.read_buffer_mapped ? "mapped" : "buffered");
+
+	while (1) {
+
+		if (in_place) {
+			size = krad_ebml_read_packet_in_place (krad_ebml, &track, &timecode, &frame);
+		} else {
+			size = krad_ebml_read_packet (krad_ebml, &track, &timecode, buffer);
+			frame = buffer;
+		}
+
+		if (size <= 0) {
+			break;
+		}
+
+		if (track == 1) {
+			if (!check_frame (frame, size, video_frame_size (video_frames), video_frames & 0xff)) {
+				printf ("%s: video frame %d is wrong\n", name, video_frames);
+				bad++;
+			}
+			video_frames++;
+		} else {
+			if (!check_frame (frame, size, TEST_AUDIO_SIZE, audio_packets & 0xff)) {
+				printf ("%s: audio packet %d is wrong\n", name, audio_packets);
+				bad++;
+			}
+			audio_packets++;
+		}
+	}
+
+	krad_ebml_destroy (krad_ebml);
+	free (buffer);
+
+	printf ("%s: %d video frames %d audio packets %d bad\n", name, video_frames, audio_packets, bad);
+
+	if (video_frames != TEST_FRAMES) {
+		return -1;
+	}
+
+	return bad;
+}
+
+static int read_recording_from_pipe (char *name, int in_place) {
+
+	int fds[2];
+	int saved_stdin;
+	pid_t child;
+	int ret;
+
+	if (pipe (fds) != 0) {
+		return -1;
+	}
+
+	child = fork ();
+	if (child == 0) {
+		close (fds[0]);
+		dup2 (fds[1], 1);
+		execlp ("cat", "cat", TEST_FILE, NULL);
+		_exit (1);
+	}
+	close (fds[1]);
+
+	/* an empty filename reads stdin */
+	saved_stdin = dup (0);
+	dup2 (fds[0], 0);
+	close (fds[0]);
+
+	ret = read_recording (name, "", in_place);
+
+	dup2 (saved_stdin, 0);
+	close (saved_stdin);
+	waitpid (child, NULL, 0);
+
+	return ret;
+}
+
+int main (int argc, char *argv[]) {
+
+	int failed;
+
+	failed = 0;
+
+	unlink (TEST_FILE);
+	write_recording ();
+
+	failed += read_recording ("mapped copy", TEST_FILE, 0) != 0;
+	failed += read_recording ("mapped in place", TEST_FILE, 1) != 0;
+	failed += read_recording_from_pipe ("pipe copy", 0) != 0;
+	failed += read_recording_from_pipe ("pipe in place", 1) != 0;
+
+	unlink (TEST_FILE);
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
@@ -0,0 +1,247 @@
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "krad_ebml.h"
+
+/* Writes a recording where every video frame has its own size and is
+   filled with its own number, scribbles over a few spots in the middle
+   and cuts the end off partway through a block, then checks reading it
+   back mapped and through a pipe gets past every spot to the end with
+   only a few frames lost. Also feeds garbage to a buffer like the ipc
+   server does and checks that is reported rather than fatal. */
+
+#define TEST_FILE "/tmp/krad_ebml_resync_test.webm"
+#define TEST_FRAMES 300
+#define TEST_AUDIO_SIZE 160
+#define TEST_AUDIO_FRAMES 960
+#define TEST_SPOTS 3
+#define TEST_SPOT_SIZE 500
+#define TEST_TRUNCATE 1500
+
+static int video_frame_size (int frame) {
+	return 1000 + frame * 7;
+}
+
+static void write_recording () {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char video[1000 + TEST_FRAMES * 7];
+	unsigned char audio[TEST_AUDIO_SIZE];
+	int video_track;
+	int audio_track;
+	int frame;
+	int64_t video_timecode;
+	int64_t audio_timecode;
+
+	audio_timecode = 0;
+	memset (audio, 0, sizeof(audio));
+
+	krad_ebml = krad_ebml_open_file (TEST_FILE, KRAD_EBML_IO_WRITEONLY);
+	krad_ebml_header (krad_ebml, "webm", "krad_ebml_resync_test");
+	video_track = krad_ebml_add_video_track (krad_ebml, VP8, 30, 1, 640, 360);
+	audio_track = krad_ebml_add_audio_track (krad_ebml, VORBIS, 48000, 2, NULL, 0);
+
+	for (frame = 0; frame < TEST_FRAMES; frame++) {
+
+		video_timecode = frame * 1000 / 30;
+
+		while (audio_timecode < video_timecode) {
+			krad_ebml_add_audio_timecode (krad_ebml, audio_track, audio, sizeof(audio),
+										  TEST_AUDIO_FRAMES, audio_timecode);
+			audio_timecode += TEST_AUDIO_FRAMES * 1000 / 48000;
+		}
+
+		memset (video, frame & 0xff, video_frame_size (frame));
+		krad_ebml_add_video_timecode (krad_ebml, video_track, video, video_frame_size (frame),
+									  (frame % 30) == 0, video_timecode);
+	}
+
+	krad_ebml_destroy (krad_ebml);
+}
+
+static void damage_recording () {
+
+	struct stat st;
+	unsigned char garbage[TEST_SPOT_SIZE];
+	FILE *fp;
+	int spot;
+	int b;
+
+	stat (TEST_FILE, &st);
+
+	fp = fopen (TEST_FILE, "r+b");
+
+	srand (42);
+	for (spot = 0; spot < TEST_SPOTS; spot++) {
+		for (b = 0; b < TEST_SPOT_SIZE; b++) {
+			garbage[b] = rand () & 0xff;
+		}
+		fseek (fp, st.st_size / (TEST_SPOTS + 1) * (spot + 1), SEEK_SET);
+		fwrite (garbage, 1, sizeof(garbage), fp);
+	}
+
+	fclose (fp);
+
+	truncate (TEST_FILE, st.st_size - TEST_TRUNCATE);
+}
+
+/* returns 0 if it read past all the damage to near the end */
+
+static int read_recording (char *name, char *filename, int in_place) {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char *buffer;
+	unsigned char *frame;
+	uint64_t timecode;
+	int track;
+	int size;
+	int number;
+	int video_frames;
+	int last_frame;
+	int bad;
+	int b;
+	uint64_t corruptions;
+
+	buffer = malloc (KRAD_EBML_MAX_BLOCK_SIZE);
+	video_frames = 0;
+	last_frame = -1;
+	bad = 0;
+
+	krad_ebml = krad_ebml_open_file (filename, KRAD_EBML_IO_READONLY);
+
+	while (1) {
+
+		if (in_place) {
+			size = krad_ebml_read_packet_in_place (krad_ebml, &track, &timecode, &frame);
+		} else {
+			size = krad_ebml_read_packet (krad_ebml, &track, &timecode, buffer);
+			frame = buffer;
+		}
+
+		if (size <= 0) {
+			break;
+		}
+
+		if (track != 1) {
+			continue;
+		}
+
+		video_frames++;
+
+		number = (size - 1000) / 7;
+		if ((size < 1000) || ((size - 1000) % 7) || (number >= TEST_FRAMES) || (number <= last_frame)) {
+			bad++;
+			continue;
+		}
+
+		for (b = 0; b < size; b++) {
+			if (frame[b] != (number & 0xff)) {
+				bad++;
+				break;
+			}
+		}
+
+		last_frame = number;
+	}
+
+	corruptions = krad_ebml->corruptions;
+
+	printf ("%s: %d video frames, last was %d, %d bad, %"PRIu64" corruptions %"PRIu64" bytes skipped\n",
+			name, video_frames, last_frame, bad, corruptions, krad_ebml->corrupt_bytes);
+
+	krad_ebml_destroy (krad_ebml);
+	free (buffer);
+
+	if ((corruptions == 0) || (bad > TEST_SPOTS * 2) ||
+		(video_frames < TEST_FRAMES - TEST_SPOTS * 5) || (last_frame < TEST_FRAMES - 2)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static int read_recording_from_pipe (char *name, int in_place) {
+
+	int fds[2];
+	int saved_stdin;
+	pid_t child;
+	int ret;
+
+	if (pipe (fds) != 0) {
+		return 1;
+	}
+
+	child = fork ();
+	if (child == 0) {
+		close (fds[0]);
+		dup2 (fds[1], 1);
+		execlp ("cat", "cat", TEST_FILE, NULL);
+		_exit (1);
+	}
+	close (fds[1]);
+
+	/* an empty filename reads stdin */
+	saved_stdin = dup (0);
+	dup2 (fds[0], 0);
+	close (fds[0]);
+
+	ret = read_recording (name, "", in_place);
+
+	dup2 (saved_stdin, 0);
+	close (saved_stdin);
+	waitpid (child, NULL, 0);
+
+	return ret;
+}
+
+static int read_garbage_command () {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char garbage[16];
+	uint32_t ebml_id;
+	uint64_t ebml_data_size;
+	int ret;
+
+	memset (garbage, 0, sizeof(garbage));
+
+	krad_ebml = krad_ebml_open_buffer (KRAD_EBML_IO_READONLY);
+	krad_ebml_io_buffer_push (&krad_ebml->io_adapter, garbage, sizeof(garbage));
+
+	ret = krad_ebml_read_element (krad_ebml, &ebml_id, &ebml_data_size);
+
+	printf ("garbage command: read %d, %"PRIu64" corruptions\n", ret, krad_ebml->corruptions);
+
+	ret = (ret != 0) || (krad_ebml->corruptions != 1) || (ebml_id != 0) || (ebml_data_size != 0);
+
+	krad_ebml_destroy (krad_ebml);
+
+	return ret;
+}
+
+int main (int argc, char *argv[]) {
+
+	int failed;
+
+	failed = 0;
+
+	unlink (TEST_FILE);
+	write_recording ();
+	damage_recording ();
+
+	failed += read_recording ("mapped in place", TEST_FILE, 1);
+	failed += read_recording ("mapped copy", TEST_FILE, 0);
+	failed += read_recording_from_pipe ("pipe copy", 0);
+	failed += read_garbage_command ();
+
+	unlink (TEST_FILE);
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
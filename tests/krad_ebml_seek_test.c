@@ -0,0 +1,261 @@
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "krad_ebml.h"
+
+/* Writes a recording with a keyframe a second where every video frame
+   has its own size and is filled with its own number, then seeks around
+   it using its cues, with the cues cut off so the clusters have to be
+   indexed, and the same for a live recording with clusters of unknown
+   size. Each seek has to land on the keyframe at or before the time
+   asked for and carry on in order from there. */
+
+#define TEST_FILE "/tmp/krad_ebml_seek_test.webm"
+#define TEST_FRAMES 300
+#define TEST_KEYFRAME_INTERVAL 30
+#define TEST_AUDIO_SIZE 160
+#define TEST_AUDIO_FRAMES 960
+
+static int video_frame_size (int frame) {
+	return 1000 + frame * 7;
+}
+
+static uint64_t video_frame_timecode (int frame) {
+	return frame * 1000 / 30;
+}
+
+static void write_recording (int live) {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char video[1000 + TEST_FRAMES * 7];
+	unsigned char audio[TEST_AUDIO_SIZE];
+	int video_track;
+	int audio_track;
+	int frame;
+	int64_t video_timecode;
+	int64_t audio_timecode;
+
+	audio_timecode = 0;
+	memset (audio, 0, sizeof(audio));
+
+	krad_ebml = krad_ebml_open_file (TEST_FILE, KRAD_EBML_IO_WRITEONLY);
+	if (live) {
+		krad_ebml_set_live (krad_ebml, KRAD_EBML_LIVE_DEFAULT_MAX_CLUSTER_MS,
+							KRAD_EBML_LIVE_DEFAULT_MAX_CLUSTER_BYTES, 0);
+	}
+	krad_ebml_header (krad_ebml, "webm", "krad_ebml_seek_test");
+	video_track = krad_ebml_add_video_track (krad_ebml, VP8, 30, 1, 640, 360);
+	audio_track = krad_ebml_add_audio_track (krad_ebml, VORBIS, 48000, 2, NULL, 0);
+
+	for (frame = 0; frame < TEST_FRAMES; frame++) {
+
+		video_timecode = video_frame_timecode (frame);
+
+		while (audio_timecode < video_timecode) {
+			krad_ebml_add_audio_timecode (krad_ebml, audio_track, audio, sizeof(audio),
+										  TEST_AUDIO_FRAMES, audio_timecode);
+			audio_timecode += TEST_AUDIO_FRAMES * 1000 / 48000;
+		}
+
+		memset (video, frame & 0xff, video_frame_size (frame));
+		krad_ebml_add_video_timecode (krad_ebml, video_track, video, video_frame_size (frame),
+									  (frame % TEST_KEYFRAME_INTERVAL) == 0, video_timecode);
+	}
+
+	krad_ebml_destroy (krad_ebml);
+}
+
+/* the cues are the last thing written, frames are all one byte over
+   and over so their id can't turn up anywhere else */
+
+static int cut_cues () {
+
+	struct stat st;
+	unsigned char *data;
+	FILE *fp;
+	int64_t b;
+
+	stat (TEST_FILE, &st);
+	data = malloc (st.st_size);
+
+	fp = fopen (TEST_FILE, "rb");
+	fread (data, 1, st.st_size, fp);
+	fclose (fp);
+
+	for (b = st.st_size - 4; b > 0; b--) {
+		if ((data[b] == 0x1C) && (data[b + 1] == 0x53) && (data[b + 2] == 0xBB) && (data[b + 3] == 0x6B)) {
+			break;
+		}
+	}
+
+	free (data);
+
+	if (b == 0) {
+		return 1;
+	}
+
+	truncate (TEST_FILE, b);
+
+	return 0;
+}
+
+/* the next video frame has to be the keyframe at or before timecode,
+   then the rest have to follow it in order */
+
+static int check_seek (krad_ebml_t *krad_ebml, char *name, uint64_t timecode, unsigned char *buffer) {
+
+	int64_t seeked;
+	uint64_t packet_timecode;
+	int track;
+	int size;
+	int frame;
+	int expected;
+	int checked;
+
+	expected = timecode * 30 / 1000;
+	if (expected >= TEST_FRAMES) {
+		expected = TEST_FRAMES - 1;
+	}
+	while (video_frame_timecode (expected) > timecode) {
+		expected--;
+	}
+	expected -= expected % TEST_KEYFRAME_INTERVAL;
+
+	seeked = krad_ebml_seek_timecode (krad_ebml, timecode);
+
+	if (seeked != video_frame_timecode (expected)) {
+		printf ("%s: seek to %"PRIu64" went to %"PRId64" not %"PRIu64"\n", name, timecode, seeked,
+				video_frame_timecode (expected));
+		return 1;
+	}
+
+	checked = 0;
+
+	while (checked < TEST_KEYFRAME_INTERVAL + 5) {
+
+		size = krad_ebml_read_packet (krad_ebml, &track, &packet_timecode, buffer);
+
+		if (size <= 0) {
+			break;
+		}
+
+		if (track != 1) {
+			continue;
+		}
+
+		frame = (size - 1000) / 7;
+
+		if ((frame != expected) || (buffer[0] != (frame & 0xff)) || (buffer[size - 1] != (frame & 0xff)) ||
+			(packet_timecode != video_frame_timecode (frame))) {
+			printf ("%s: after seeking to %"PRIu64" got frame %d at %"PRIu64" instead of %d\n", name, timecode,
+					frame, packet_timecode, expected);
+			return 1;
+		}
+
+		expected++;
+		checked++;
+	}
+
+	if ((checked < TEST_KEYFRAME_INTERVAL + 5) && (expected != TEST_FRAMES)) {
+		printf ("%s: after seeking to %"PRIu64" reading stopped at frame %d\n", name, timecode, expected);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int seek_recording (char *name) {
+
+	krad_ebml_t *krad_ebml;
+	unsigned char *buffer;
+	uint64_t targets[] = { 5500, 0, 9999, 2000, 1999, 7034, 20000, 3000 };
+	int failed;
+	int t;
+
+	buffer = malloc (KRAD_EBML_MAX_BLOCK_SIZE);
+	failed = 0;
+
+	krad_ebml = krad_ebml_open_file (TEST_FILE, KRAD_EBML_IO_READONLY);
+
+	for (t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+		failed += check_seek (krad_ebml, name, targets[t], buffer);
+	}
+
+	printf ("%s: %d cues, %d seeks failed\n", name, krad_ebml->cue_count, failed);
+
+	krad_ebml_destroy (krad_ebml);
+	free (buffer);
+
+	return failed;
+}
+
+static int seek_pipe () {
+
+	int fds[2];
+	int saved_stdin;
+	pid_t child;
+	krad_ebml_t *krad_ebml;
+	int64_t seeked;
+
+	if (pipe (fds) != 0) {
+		return 1;
+	}
+
+	child = fork ();
+	if (child == 0) {
+		close (fds[0]);
+		dup2 (fds[1], 1);
+		execlp ("cat", "cat", TEST_FILE, NULL);
+		_exit (1);
+	}
+	close (fds[1]);
+
+	/* an empty filename reads stdin */
+	saved_stdin = dup (0);
+	dup2 (fds[0], 0);
+	close (fds[0]);
+
+	krad_ebml = krad_ebml_open_file ("", KRAD_EBML_IO_READONLY);
+	seeked = krad_ebml_seek_timecode (krad_ebml, 5000);
+	krad_ebml_destroy (krad_ebml);
+
+	dup2 (saved_stdin, 0);
+	close (saved_stdin);
+	waitpid (child, NULL, 0);
+
+	printf ("pipe: seek gave %"PRId64"\n", seeked);
+
+	return seeked != -1;
+}
+
+int main (int argc, char *argv[]) {
+
+	int failed;
+
+	failed = 0;
+
+	unlink (TEST_FILE);
+	write_recording (0);
+	failed += seek_recording ("cues");
+	failed += seek_pipe ();
+	failed += cut_cues ();
+	failed += seek_recording ("no cues");
+
+	unlink (TEST_FILE);
+	write_recording (1);
+	failed += cut_cues ();
+	failed += seek_recording ("live no cues");
+
+	unlink (TEST_FILE);
+	unlink (TEST_FILE KRAD_EBML_INDEX_SUFFIX);
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
@@ -0,0 +1,166 @@
+#include "krad_v4l2.h"
+
+/* feeds a recorded mjpeg file through the threaded decoder and checks every
+   frame against a plain single threaded decode of the same frame,
+   ie. ffmpeg -f v4l2 -input_format mjpeg -i /dev/video0 -c copy -f mjpeg test.mjpeg */
+
+typedef struct {
+	int width;
+	int height;
+	int yuv;
+	uint64_t next_sequence;
+	uint64_t out_of_order;
+	uint64_t failed;
+	uint64_t mismatched;
+	tjhandle jpeg_dec;
+	unsigned char *reference;
+	unsigned char *jpeg;
+} mjpeg_test_t;
+
+/* the reference decode, frames without huffman tables get the
+   standard ones added the way the decoder does */
+
+static int mjpeg_test_reference (mjpeg_test_t *mjpeg_test, krad_v4l2_mjpeg_job_t *job) {
+
+	unsigned char *jpeg;
+	unsigned long jpeg_size;
+	int a;
+
+	jpeg = job->mjpeg;
+	jpeg_size = job->mjpeg_size;
+
+	for (a = 0; a < 2; a++) {
+		if (mjpeg_test->yuv) {
+			if (tjDecompressToYUV (mjpeg_test->jpeg_dec, jpeg, jpeg_size, mjpeg_test->reference, 0) == 0) {
+				return 0;
+			}
+		} else {
+			if (tjDecompress2 (mjpeg_test->jpeg_dec, jpeg, jpeg_size, mjpeg_test->reference, mjpeg_test->width,
+							   mjpeg_test->width * 4, mjpeg_test->height, TJPF_BGRA, 0) == 0) {
+				return 0;
+			}
+		}
+		if (job->mjpeg_size + 1024 > KRAD_V4L2_JPEG_BUFFER_SIZE) {
+			break;
+		}
+		jpeg_size = kradv4l2_mjpeg_to_jpeg (NULL, mjpeg_test->jpeg, job->mjpeg, job->mjpeg_size);
+		jpeg = mjpeg_test->jpeg;
+	}
+
+	return -1;
+}
+
+void mjpeg_test_frame (void *pointer, krad_v4l2_mjpeg_job_t *job) {
+
+	mjpeg_test_t *mjpeg_test = (mjpeg_test_t *)pointer;
+	unsigned char *decoded;
+	unsigned long size;
+
+	if (job->sequence != mjpeg_test->next_sequence) {
+		mjpeg_test->out_of_order++;
+	}
+
+	mjpeg_test->next_sequence = job->sequence + 1;
+
+	if (job->failed) {
+		mjpeg_test->failed++;
+	} else {
+		if (mjpeg_test->yuv) {
+			decoded = job->yuv;
+			size = tjBufSizeYUV (mjpeg_test->width, mjpeg_test->height, job->yuv_subsampling);
+		} else {
+			decoded = job->argb;
+			size = mjpeg_test->width * mjpeg_test->height * 4;
+		}
+		if ((mjpeg_test_reference (mjpeg_test, job) != 0) || (memcmp (decoded, mjpeg_test->reference, size) != 0)) {
+			printf ("frame %"PRIu64" does not match the reference decode\n", job->sequence);
+			mjpeg_test->mismatched++;
+		}
+	}
+
+	printf ("frame %"PRIu64" %u bytes decoded in %"PRIu64"us\n", job->sequence, job->mjpeg_size, job->decode_time_us);
+
+	free (job->mjpeg);
+	free (job->argb);
+}
+
+int main (int argc, char *argv[]) {
+
+	krad_v4l2_mjpeg_decoder_t *decoder;
+	mjpeg_test_t mjpeg_test;
+	unsigned char *file;
+	unsigned char *frame;
+	unsigned char *argb;
+	struct stat st;
+	size_t start;
+	size_t pos;
+	int threads;
+	int fd;
+
+	if (argc < 4) {
+		printf ("krad_mjpeg_decode_test file.mjpeg width height [threads] [yuv]\n");
+		return 1;
+	}
+
+	memset (&mjpeg_test, 0, sizeof (mjpeg_test_t));
+
+	mjpeg_test.width = atoi (argv[2]);
+	mjpeg_test.height = atoi (argv[3]);
+	threads = KRAD_V4L2_MJPEG_DEFAULT_THREADS;
+
+	if (argc > 4) {
+		threads = atoi (argv[4]);
+	}
+
+	if (argc > 5) {
+		mjpeg_test.yuv = atoi (argv[5]);
+	}
+
+	fd = open (argv[1], O_RDONLY);
+
+	if ((fd < 0) || (fstat (fd, &st) != 0)) {
+		printf ("could not open %s\n", argv[1]);
+		return 1;
+	}
+
+	file = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	mjpeg_test.jpeg_dec = tjInitDecompress ();
+	mjpeg_test.jpeg = malloc (KRAD_V4L2_JPEG_BUFFER_SIZE);
+	/* big enough for argb or any of the yuv layouts */
+	mjpeg_test.reference = malloc (mjpeg_test.width * mjpeg_test.height * 4 + tjBufSizeYUV (mjpeg_test.width, mjpeg_test.height, TJSAMP_444));
+
+	decoder = kradv4l2_mjpeg_decoder_create (mjpeg_test.width, mjpeg_test.height, threads, mjpeg_test.yuv,
+											 mjpeg_test_frame, &mjpeg_test);
+
+	start = 0;
+
+	for (pos = 0; pos + 1 < st.st_size; pos++) {
+		if ((file[pos] == 0xFF) && (file[pos + 1] == 0xD8)) {
+			start = pos;
+		}
+		if ((file[pos] == 0xFF) && (file[pos + 1] == 0xD9)) {
+			frame = malloc (pos + 2 - start);
+			memcpy (frame, file + start, pos + 2 - start);
+			/* each frame decodes into its own buffer, freed once it has been checked */
+			argb = malloc (mjpeg_test.width * mjpeg_test.height * 4);
+			while (kradv4l2_mjpeg_decoder_submit (decoder, frame, pos + 2 - start, argb, NULL) < 0) {
+				usleep (1000);
+			}
+		}
+	}
+
+	kradv4l2_mjpeg_decoder_destroy (decoder);
+
+	munmap (file, st.st_size);
+	close (fd);
+	tjDestroy (mjpeg_test.jpeg_dec);
+	free (mjpeg_test.reference);
+	free (mjpeg_test.jpeg);
+
+	printf ("%"PRIu64" frames, %"PRIu64" failed, %"PRIu64" out of order, %"PRIu64" mismatched\n",
+			mjpeg_test.next_sequence, mjpeg_test.failed, mjpeg_test.out_of_order, mjpeg_test.mismatched);
+
+	return (mjpeg_test.out_of_order != 0) || (mjpeg_test.mismatched != 0) || (mjpeg_test.next_sequence == 0);
+
+}
@@ -0,0 +1,180 @@
+#include <sys/stat.h>
+
+#include "krad_ogg.h"
+
+/* Writes an opus recording where every packet is 20ms, carries its own
+   number and has its own size, a handful of packets to a page so there
+   are plenty to bisect over, then seeks around it. Each seek has to land
+   on the start of a page at or before the time asked for, no further
+   back than the bisection chunk, and carry on in order from there. */
+
+#define TEST_FILE "/tmp/krad_ogg_seek_test.opus"
+#define TEST_PACKETS 10000
+#define TEST_PACKET_FRAMES 960
+#define TEST_PACKET_MS 20
+#define TEST_PACKETS_PER_PAGE 5
+#define TEST_MIN_PACKET_SIZE 100
+/* bisection stops within a chunk, so a seek can be that much early */
+#define TEST_MAX_EARLY_MS (KRAD_OGG_SEEK_CHUNK_SIZE / TEST_MIN_PACKET_SIZE * TEST_PACKET_MS)
+
+static int packet_size (int packet) {
+	return TEST_MIN_PACKET_SIZE + packet % 97;
+}
+
+static void write_recording () {
+
+	krad_ogg_t *krad_ogg;
+	unsigned char opus_head[19];
+	unsigned char opus_tags[16];
+	unsigned char *header[2];
+	int header_size[2];
+	unsigned char packet[TEST_MIN_PACKET_SIZE + 97];
+	int track;
+	int p;
+
+	memset (opus_head, 0, sizeof(opus_head));
+	memcpy (opus_head, "OpusHead", 8);
+	opus_head[8] = 1;
+	opus_head[9] = 2;
+	/* 48000 little endian */
+	opus_head[12] = 0x80;
+	opus_head[13] = 0xBB;
+
+	memset (opus_tags, 0, sizeof(opus_tags));
+	memcpy (opus_tags, "OpusTags", 8);
+
+	header[0] = opus_head;
+	header_size[0] = sizeof(opus_head);
+	header[1] = opus_tags;
+	header_size[1] = sizeof(opus_tags);
+
+	krad_ogg = krad_ogg_open_file (TEST_FILE, KRAD_IO_WRITEONLY);
+	track = krad_ogg_add_audio_track (krad_ogg, OPUS, 48000, 2, header, header_size, 2);
+	krad_ogg_set_max_packets_per_page (krad_ogg, TEST_PACKETS_PER_PAGE);
+
+	for (p = 0; p < TEST_PACKETS; p++) {
+		memset (packet, p & 0xff, packet_size (p));
+		packet[0] = (p >> 8) & 0xff;
+		packet[1] = p & 0xff;
+		krad_ogg_add_audio (krad_ogg, track, packet, packet_size (p), TEST_PACKET_FRAMES);
+	}
+
+	krad_ogg_destroy (krad_ogg);
+}
+
+static int packet_number (unsigned char *buffer, int size) {
+
+	int p;
+
+	p = (buffer[0] << 8) | buffer[1];
+
+	if ((size != packet_size (p)) || (buffer[size - 1] != (p & 0xff))) {
+		return -1;
+	}
+
+	return p;
+}
+
+/* the first packet has to start at the time the seek gave, which is
+   at or before timecode, and the rest have to follow it in order */
+
+static int check_seek (krad_ogg_t *krad_ogg, uint64_t timecode, unsigned char *buffer) {
+
+	int64_t seeked;
+	uint64_t packet_timecode;
+	uint64_t target;
+	int track;
+	int size;
+	int packet;
+	int expected;
+	int checked;
+
+	target = timecode;
+	if (target > (TEST_PACKETS - 1) * TEST_PACKET_MS) {
+		target = (TEST_PACKETS - 1) * TEST_PACKET_MS;
+	}
+
+	seeked = krad_ogg_seek_timecode (krad_ogg, timecode);
+
+	if ((seeked < 0) || (seeked > target) || (target - seeked > TEST_MAX_EARLY_MS)) {
+		printf ("seek to %"PRIu64" went to %"PRId64"\n", timecode, seeked);
+		return 1;
+	}
+
+	/* granule to ms goes through a float, so it can come up a ms short */
+	expected = (seeked + 1) / TEST_PACKET_MS;
+
+	checked = 0;
+
+	while (checked < TEST_PACKETS_PER_PAGE * 4) {
+
+		size = krad_ogg_read_packet (krad_ogg, &track, &packet_timecode, buffer);
+
+		if (size <= 0) {
+			break;
+		}
+
+		packet = packet_number (buffer, size);
+
+		if (packet != expected) {
+			printf ("after seeking to %"PRIu64" (%"PRId64") got packet %d instead of %d\n", timecode, seeked,
+					packet, expected);
+			return 1;
+		}
+
+		expected++;
+		checked++;
+	}
+
+	if ((checked < TEST_PACKETS_PER_PAGE * 4) && (expected != TEST_PACKETS)) {
+		printf ("after seeking to %"PRIu64" reading stopped at packet %d\n", timecode, expected);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int seek_recording () {
+
+	krad_ogg_t *krad_ogg;
+	unsigned char *buffer;
+	uint64_t targets[] = { 55000, 0, 199999, 20000, 19999, 100, 70340, 400000, 30000, 1 };
+	int failed;
+	int t;
+
+	buffer = malloc (KRAD_OGG_FILE_INPUT_BUFFER_SIZE);
+	failed = 0;
+
+	krad_ogg = krad_ogg_open_file (TEST_FILE, KRAD_IO_READONLY);
+
+	for (t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+		failed += check_seek (krad_ogg, targets[t], buffer);
+	}
+
+	printf ("%d seeks failed\n", failed);
+
+	krad_ogg_destroy (krad_ogg);
+	free (buffer);
+
+	return failed;
+}
+
+int main (int argc, char *argv[]) {
+
+	int failed;
+
+	unlink (TEST_FILE);
+	write_recording ();
+	failed = seek_recording ();
+	unlink (TEST_FILE);
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
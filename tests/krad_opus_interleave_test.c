@@ -0,0 +1,117 @@
+#include "krad_opus.h"
+
+/* Writes stereo to a 48000 encoder, which interleaves straight into its
+   pending buffer, four frames at a time with SSE and the rest one at a
+   time. Writes of frame counts that are not a multiple of four land at
+   odd places in pending, and everything there has to match a plain
+   interleave of what was written, before and after frames are encoded
+   out of it. */
+
+#define TEST_CHANNELS 2
+#define TEST_MAX_WRITE 4096
+
+static int failed;
+
+/* every sample is different, so anything out of place shows */
+
+static float test_sample (int frame, int channel) {
+	return (float)(frame * TEST_CHANNELS + channel + 1) / 100000.0f;
+}
+
+static void check_pending (krad_opus_t *krad_opus, int first_frame, char *when) {
+
+	int f;
+	int c;
+	float expected;
+
+	for (f = 0; f < krad_opus->pending_frames; f++) {
+		for (c = 0; c < TEST_CHANNELS; c++) {
+			expected = test_sample (first_frame + f, c);
+			if (krad_opus->pending[f * TEST_CHANNELS + c] != expected) {
+				printf ("%s: pending frame %d channel %d is %f not %f\n", when, f, c,
+						krad_opus->pending[f * TEST_CHANNELS + c], expected);
+				failed++;
+				return;
+			}
+		}
+	}
+
+}
+
+int main (int argc, char *argv[]) {
+
+	krad_opus_t *krad_opus;
+	float *samples[TEST_CHANNELS];
+	unsigned char *buffer;
+	int writes[] = { 1, 2, 3, 5, 7, 9, 13, 257, 1, 959, 961, 1023, 4095, 6, 3 };
+	int frames_written;
+	int frames_encoded;
+	int framecnt;
+	int bytes;
+	int frames;
+	int w;
+	int f;
+	int c;
+
+	for (c = 0; c < TEST_CHANNELS; c++) {
+		samples[c] = malloc (TEST_MAX_WRITE * sizeof(float));
+	}
+	buffer = malloc (500000);
+
+	krad_opus = krad_opus_encoder_create (TEST_CHANNELS, 48000, KRAD_DEFAULT_OPUS_BITRATE, OPUS_APPLICATION_AUDIO);
+
+	frames_written = 0;
+	frames_encoded = 0;
+
+	for (w = 0; w < sizeof(writes) / sizeof(writes[0]); w++) {
+
+		frames = writes[w];
+
+		for (f = 0; f < frames; f++) {
+			for (c = 0; c < TEST_CHANNELS; c++) {
+				samples[c][f] = test_sample (frames_written + f, c);
+			}
+		}
+
+		krad_opus_encoder_write (krad_opus, samples, frames);
+		frames_written += frames;
+
+		check_pending (krad_opus, frames_encoded, "after a write");
+
+		/* every other write is read out, so some writes land on a
+		   pending buffer with more than a frame already in it */
+		if (w % 2) {
+			while ((bytes = krad_opus_encoder_read (krad_opus, buffer, &framecnt)) > 0) {
+				frames_encoded += framecnt;
+				check_pending (krad_opus, frames_encoded, "after a read");
+			}
+		}
+	}
+
+	if (frames_encoded + krad_opus->pending_frames != frames_written) {
+		printf ("%d frames written, %d encoded and %d pending\n", frames_written, frames_encoded,
+				krad_opus->pending_frames);
+		failed++;
+	}
+
+	krad_opus_encoder_destroy (krad_opus);
+
+	for (c = 0; c < TEST_CHANNELS; c++) {
+		free (samples[c]);
+	}
+	free (buffer);
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+#ifdef __SSE__
+	printf ("PASS (sse)\n");
+#else
+	printf ("PASS (no sse, scalar only)\n");
+#endif
+
+	return 0;
+
+}
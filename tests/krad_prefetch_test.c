@@ -0,0 +1,101 @@
+#include "krad_prefetch.h"
+
+/* Plays a pretend 1MB/s file by telling the prefetcher where the
+   demuxer has got to, checks it reads ten seconds ahead and no further,
+   then moves it back to the start like a seek would and checks it reads
+   ahead from there. */
+
+#define TEST_FILE "/tmp/krad_prefetch_test.bin"
+#define TEST_FILE_SIZE 32 * 1024 * 1024
+#define TEST_BYTES_PER_SECOND 1000 * 1000
+
+static int wait_for_buffered_ms (krad_prefetch_t *krad_prefetch, int ms) {
+
+	int tries;
+
+	for (tries = 0; tries < 500; tries++) {
+		if (krad_prefetch_buffered_ms (krad_prefetch) >= ms) {
+			return 1;
+		}
+		usleep (10000);
+	}
+
+	return 0;
+}
+
+int main (int argc, char *argv[]) {
+
+	krad_prefetch_t *krad_prefetch;
+	unsigned char *data;
+	FILE *fp;
+	int fd;
+	int fds[2];
+	int failed;
+	int ahead;
+	int back;
+	uint64_t window_end;
+
+	failed = 0;
+
+	data = calloc (1, TEST_FILE_SIZE);
+	fp = fopen (TEST_FILE, "wb");
+	fwrite (data, 1, TEST_FILE_SIZE, fp);
+	fclose (fp);
+	free (data);
+
+	fd = open (TEST_FILE, O_RDONLY);
+
+	krad_prefetch = krad_prefetch_create (fd, KRAD_PREFETCH_DEFAULT_SECONDS);
+
+	pipe (fds);
+
+	if ((krad_prefetch == NULL) || (krad_prefetch_create (fds[0], KRAD_PREFETCH_DEFAULT_SECONDS) != NULL)) {
+		printf ("prefetch should be made for files and only files\n");
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	krad_prefetch_update (krad_prefetch, TEST_BYTES_PER_SECOND / 10, 100);
+	krad_prefetch_update (krad_prefetch, TEST_BYTES_PER_SECOND * 21 / 10, 2100);
+
+	ahead = wait_for_buffered_ms (krad_prefetch, KRAD_PREFETCH_DEFAULT_SECONDS * 1000 - 100);
+
+	/* it should stop at the window rather than read the whole file */
+	usleep (100000);
+	pthread_mutex_lock (&krad_prefetch->lock);
+	window_end = krad_prefetch->prefetched;
+	pthread_mutex_unlock (&krad_prefetch->lock);
+
+	printf ("%d ms read ahead, read in to %"PRIu64" of %d\n",
+			krad_prefetch_buffered_ms (krad_prefetch), window_end, TEST_FILE_SIZE);
+
+	if ((!ahead) || (window_end > TEST_BYTES_PER_SECOND * 21 / 10 + TEST_BYTES_PER_SECOND * KRAD_PREFETCH_DEFAULT_SECONDS)) {
+		failed = 1;
+	}
+
+	krad_prefetch_update (krad_prefetch, 0, 0);
+
+	back = wait_for_buffered_ms (krad_prefetch, KRAD_PREFETCH_DEFAULT_SECONDS * 1000 - 100);
+
+	printf ("after seeking back %d ms read ahead\n", krad_prefetch_buffered_ms (krad_prefetch));
+
+	if (!back) {
+		failed = 1;
+	}
+
+	krad_prefetch_destroy (krad_prefetch);
+	close (fd);
+	close (fds[0]);
+	close (fds[1]);
+	unlink (TEST_FILE);
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
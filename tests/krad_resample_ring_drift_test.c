@@ -0,0 +1,167 @@
+#include "krad_resample_ring.h"
+
+/* Simulated clocks, a sender whose clock is off from ours by drift_ppm pushes
+   20ms packets with some jitter, we pull 256 frame periods. Checks the drift
+   loop holds the fill at the target without underruns. */
+
+#define SAMPLE_RATE 48000
+#define PACKET_FRAMES 960
+#define PERIOD_FRAMES 256
+#define TARGET_MS 200
+#define SIM_MINUTES 30
+
+static uint32_t jitter_state = 2463534242;
+
+static double jitter () {
+
+	jitter_state ^= jitter_state << 13;
+	jitter_state ^= jitter_state >> 17;
+	jitter_state ^= jitter_state << 5;
+
+	return (jitter_state % 1000) / 1000.0;
+
+}
+
+static int krad_resample_ring_drift_test (double drift_ppm) {
+
+	krad_resample_ring_t *ring[2];
+	float packet[PACKET_FRAMES];
+	float period[PERIOD_FRAMES];
+	double now;
+	double next_packet;
+	double next_period;
+	double packet_interval;
+	double adjust;
+	uint64_t packets;
+	int playing;
+	int underruns;
+	int minute;
+	int c;
+	int s;
+	int fill_ms;
+	int worst;
+
+	for (s = 0; s < PACKET_FRAMES; s++) {
+		packet[s] = sinf (s * 2.0f * M_PI / 96.0f);
+	}
+
+	for (c = 0; c < 2; c++) {
+		ring[c] = krad_resample_ring_create (4000000, SAMPLE_RATE, SAMPLE_RATE);
+		krad_resample_ring_set_target_latency (ring[c], TARGET_MS);
+	}
+
+	/* their 20ms is a bit longer or shorter than ours */
+	packet_interval = ((double)PACKET_FRAMES / SAMPLE_RATE) / (1.0 + drift_ppm / 1000000.0);
+
+	now = 0.0;
+	next_packet = 0.0;
+	next_period = 0.0;
+	packets = 0;
+	playing = 0;
+	underruns = 0;
+	minute = 0;
+	worst = 0;
+
+	while (now < SIM_MINUTES * 60.0) {
+
+		if (next_packet <= next_period) {
+
+			now = next_packet;
+
+			for (c = 0; c < 2; c++) {
+				krad_resample_ring_write (ring[c], (unsigned char *)packet, PACKET_FRAMES * 4);
+			}
+
+			if (playing) {
+				adjust = krad_resample_ring_track_drift (ring[0]);
+				for (c = 0; c < 2; c++) {
+					krad_resample_ring_set_drift_adjust (ring[c], adjust);
+				}
+			} else if (krad_resample_ring_fill_ms (ring[0]) >= TARGET_MS) {
+				playing = 1;
+				next_period = now;
+			}
+
+			packets++;
+			/* network jitter up to 15ms, arrival order kept */
+			next_packet = (packets * packet_interval) + (jitter () * 0.015);
+			if (next_packet < now) {
+				next_packet = now;
+			}
+
+		} else {
+
+			now = next_period;
+
+			if (playing) {
+				if (krad_resample_ring_read_space (ring[0]) >= PERIOD_FRAMES * 4) {
+					for (c = 0; c < 2; c++) {
+						krad_resample_ring_read (ring[c], (unsigned char *)period, PERIOD_FRAMES * 4);
+					}
+				} else {
+					underruns++;
+				}
+			}
+
+			next_period += (double)PERIOD_FRAMES / SAMPLE_RATE;
+
+			if (!playing) {
+				next_period = next_packet + 1.0;
+			}
+		}
+
+		if (now >= (minute + 1) * 60.0) {
+			minute++;
+			fill_ms = krad_resample_ring_fill_ms (ring[0]);
+			if ((minute > 10) && (abs (fill_ms - TARGET_MS) > worst)) {
+				worst = abs (fill_ms - TARGET_MS);
+			}
+			if ((minute % 5) == 0) {
+				printf ("drift %+.0fppm minute %d fill %dms adjust %+.1fppm underruns %d\n",
+						drift_ppm, minute, fill_ms, ring[0]->drift_adjust * 1000000.0, underruns);
+			}
+		}
+	}
+
+	if (krad_resample_ring_read_space (ring[0]) != krad_resample_ring_read_space (ring[1])) {
+		printf ("channels came apart\n");
+		return 1;
+	}
+
+	for (c = 0; c < 2; c++) {
+		krad_resample_ring_destroy (ring[c]);
+	}
+
+	printf ("drift %+.0fppm worst settled error %dms underruns %d\n", drift_ppm, worst, underruns);
+
+	if ((worst > 40) || (underruns > 0)) {
+		return 1;
+	}
+
+	return 0;
+
+}
+
+int main (int argc, char *argv[]) {
+
+	int failed;
+
+	krad_system_init ();
+
+	failed = 0;
+
+	failed += krad_resample_ring_drift_test (0.0);
+	failed += krad_resample_ring_drift_test (250.0);
+	failed += krad_resample_ring_drift_test (-250.0);
+	failed += krad_resample_ring_drift_test (1000.0);
+
+	if (failed) {
+		printf ("FAILED\n");
+		return 1;
+	}
+
+	printf ("Clean Exit\n");
+
+	return 0;
+
+}
@@ -0,0 +1,195 @@
+#include "krad_synth.h"
+#include "krad_ticker.h"
+
+#define TEST_FRAMES 120
+
+static uint64_t now_usecs () {
+
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000);
+
+}
+
+static void write_test_files (char *yuv_filename, char *wav_filename, int width, int height, int frames) {
+
+	FILE *file;
+	unsigned char header[44];
+	int16_t sample;
+	int data_size;
+	int frame_size;
+	int i;
+
+	frame_size = (width * height * 3) / 2;
+
+	file = fopen (yuv_filename, "wb");
+	for (i = 0; i < frame_size * frames; i++) {
+		fputc (i & 0xFF, file);
+	}
+	fclose (file);
+
+	data_size = 48000 * 2 * 2;
+
+	memcpy (header, "RIFF", 4);
+	header[4] = (36 + data_size) & 0xFF;
+	header[5] = ((36 + data_size) >> 8) & 0xFF;
+	header[6] = ((36 + data_size) >> 16) & 0xFF;
+	header[7] = ((36 + data_size) >> 24) & 0xFF;
+	memcpy (header + 8, "WAVEfmt ", 8);
+	memcpy (header + 16, "\x10\x00\x00\x00\x01\x00\x02\x00\x80\xbb\x00\x00\x00\xee\x02\x00\x04\x00\x10\x00", 20);
+	memcpy (header + 36, "data", 4);
+	header[40] = data_size & 0xFF;
+	header[41] = (data_size >> 8) & 0xFF;
+	header[42] = (data_size >> 16) & 0xFF;
+	header[43] = (data_size >> 24) & 0xFF;
+
+	file = fopen (wav_filename, "wb");
+	fwrite (header, 1, 44, file);
+	for (i = 0; i < data_size / 2; i++) {
+		sample = (i % 200) * 100;
+		fwrite (&sample, 2, 1, file);
+	}
+	fclose (file);
+
+}
+
+static void krad_synth_test (char *spec) {
+
+	krad_synth_t *krad_synth;
+	int *pixels;
+	float *samples[2];
+	uint8_t *yuv_pixels[4];
+	int yuv_strides[4];
+	uint64_t start;
+	uint64_t elapsed;
+	uint64_t audio_total;
+	int audio_frames;
+	int f;
+
+	krad_synth = krad_synth_create (spec);
+
+	if (krad_synth == NULL) {
+		failfast ("could not create synth for %s", spec);
+	}
+
+	krad_synth_set_sample_rate (krad_synth, 48000);
+
+	pixels = calloc (1, krad_synth->width * krad_synth->height * 4);
+	samples[0] = malloc (48000 * sizeof(float));
+	samples[1] = malloc (48000 * sizeof(float));
+
+	audio_total = 0;
+	start = now_usecs ();
+
+	for (f = 0; f < TEST_FRAMES; f++) {
+
+		if (krad_synth->pattern == KRAD_SYNTH_YUV_FILE) {
+			if (krad_synth_read_yuv (krad_synth, yuv_pixels, yuv_strides) < 0) {
+				failfast ("yuv read failed");
+			}
+		} else {
+			krad_synth_render (krad_synth, pixels, krad_synth->width);
+		}
+
+		audio_frames = krad_synth_audio_frames_for_video_frame (krad_synth);
+		krad_synth_read_audio (krad_synth, samples, 2, audio_frames);
+		audio_total += audio_frames;
+
+		krad_synth_next_frame (krad_synth);
+	}
+
+	elapsed = now_usecs () - start;
+
+	printf ("%s: %d frames in %"PRIu64"us (%.1f fps) audio frames %"PRIu64" expected %"PRIu64"\n",
+			spec, TEST_FRAMES, elapsed, TEST_FRAMES / (elapsed / 1000000.0),
+			audio_total, (uint64_t)TEST_FRAMES * 48000 * krad_synth->fps_denominator / krad_synth->fps_numerator);
+
+	if (audio_total != (uint64_t)TEST_FRAMES * 48000 * krad_synth->fps_denominator / krad_synth->fps_numerator) {
+		failfast ("audio drifted from video");
+	}
+
+	free (pixels);
+	free (samples[0]);
+	free (samples[1]);
+
+	krad_synth_destroy (krad_synth);
+
+}
+
+static void krad_ticker_freewheel_test () {
+
+	krad_ticker_t *krad_ticker;
+	uint64_t start;
+	uint64_t elapsed;
+	int t;
+
+	krad_ticker = krad_ticker_create (30000, 1000);
+
+	krad_ticker_set_freewheel (1);
+
+	start = now_usecs ();
+	krad_ticker_start (krad_ticker);
+
+	for (t = 0; t < 300; t++) {
+		krad_ticker_wait (krad_ticker);
+	}
+
+	elapsed = now_usecs () - start;
+
+	printf ("freewheel: 300 ticks at 30fps took %"PRIu64"us\n", elapsed);
+
+	if (elapsed > 1000000) {
+		failfast ("freewheel did not freewheel");
+	}
+
+	krad_ticker_set_freewheel (0);
+
+	start = now_usecs ();
+
+	for (t = 0; t < 15; t++) {
+		krad_ticker_wait (krad_ticker);
+	}
+
+	elapsed = now_usecs () - start;
+
+	printf ("realtime again: 15 ticks at 30fps took %"PRIu64"us\n", elapsed);
+
+	if ((elapsed < 400000) || (elapsed > 700000)) {
+		failfast ("ticker did not resync after freewheel");
+	}
+
+	krad_ticker_destroy (krad_ticker);
+
+}
+
+int main (int argc, char *argv[]) {
+
+	char spec[1024];
+
+	krad_system_init ();
+
+	if (argc > 1) {
+		krad_synth_test (argv[1]);
+		return 0;
+	}
+
+	write_test_files ("/tmp/krad_synth_test.yuv", "/tmp/krad_synth_test.wav", 320, 240, 25);
+
+	krad_synth_test ("bars 1280x720 30");
+	krad_synth_test ("gradient 1280x720 60");
+	krad_synth_test ("noise 1920x1080 30000/1001 fast");
+	sprintf (spec, "/tmp/krad_synth_test.yuv 320x240 25 /tmp/krad_synth_test.wav");
+	krad_synth_test (spec);
+
+	krad_ticker_freewheel_test ();
+
+	unlink ("/tmp/krad_synth_test.yuv");
+	unlink ("/tmp/krad_synth_test.wav");
+
+	printf ("Clean Exit\n");
+
+	return 0;
+
+}
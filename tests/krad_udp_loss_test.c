@@ -0,0 +1,572 @@
+#include <pthread.h>
+
+#include "krad_udp.h"
+
+/* Pushes slices through the slicer and rebuilder over loopback while
+   dropping, duplicating and reordering datagrams in between, then checks
+   everything that comes out is whole and in order. */
+
+#define TEST_PORT 42667
+#define TEST_SLICES 2000
+#define TEST_LATENCY_MS 40
+#define TEST_HOLD 4
+
+static uint32_t rand_state = 2463534242u;
+
+static uint32_t test_rand () {
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return rand_state;
+}
+
+static int slice_size (int num) {
+	return 64 + ((num * 1237) % 6000);
+}
+
+static void fill_slice (unsigned char *data, int num) {
+
+	int b;
+	int size;
+	
+	size = slice_size (num);
+	memcpy (data, &num, 4);
+	for (b = 4; b < size; b++) {
+		data[b] = (num * 7 + b) & 0xff;
+	}
+}
+
+typedef struct {
+	int delivered;
+	int corrupt;
+	int out_of_order;
+	int last;
+} test_result_t;
+
+static void check_slice (test_result_t *result, unsigned char *data, int size) {
+
+	int num;
+	unsigned char *expected;
+	
+	expected = malloc (KRAD_UDP_MAX_SLICE_SIZE);
+	
+	memcpy (&num, data, 4);
+	
+	if ((num < 0) || (num >= TEST_SLICES) || (size != slice_size (num))) {
+		result->corrupt++;
+	} else {
+		fill_slice (expected, num);
+		if (memcmp (expected, data, size) != 0) {
+			result->corrupt++;
+		}
+		if (num <= result->last) {
+			result->out_of_order++;
+		}
+		result->last = num;
+	}
+	
+	result->delivered++;
+	free (expected);
+}
+
+static void run (char *name, int fec_group, int nack, int loss_percent, int malformed, int *failed) {
+
+	krad_slicer_t *krad_slicer;
+	krad_rebuilder_t *krad_rebuilder;
+	test_result_t result;
+	struct sockaddr_in local_address;
+	struct sockaddr_in remote_address;
+	socklen_t rsize;
+	unsigned char *slice;
+	unsigned char *packet;
+	unsigned char buffer[2048];
+	unsigned char held[TEST_HOLD][2048];
+	int held_size[TEST_HOLD];
+	unsigned char nack_packet[KRAD_UDP_HEADER_SIZE];
+	int sd;
+	int ret;
+	int num;
+	int h;
+	int nack_size;
+	int loops;
+	uint64_t done;
+	
+	memset (&result, 0, sizeof(result));
+	result.last = -1;
+	memset (held_size, 0, sizeof(held_size));
+	memset (&remote_address, 0, sizeof(remote_address));
+	
+	slice = malloc (KRAD_UDP_MAX_SLICE_SIZE);
+	packet = malloc (KRAD_UDP_MAX_SLICE_SIZE);
+	
+	sd = socket (AF_INET, SOCK_DGRAM, 0);
+	memset (&local_address, 0, sizeof(local_address));
+	local_address.sin_family = AF_INET;
+	local_address.sin_port = htons (TEST_PORT);
+	local_address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+	if (bind (sd, (struct sockaddr *)&local_address, sizeof(local_address)) == -1) {
+		printf ("bind error\n");
+		exit (1);
+	}
+	
+	krad_slicer = krad_slicer_create ();
+	krad_slicer_set_fec_group (krad_slicer, fec_group);
+	krad_rebuilder = krad_rebuilder_create ();
+	krad_rebuilder_set_latency (krad_rebuilder, TEST_LATENCY_MS);
+	krad_rebuilder_set_nack (krad_rebuilder, nack);
+	
+	if (malformed) {
+		memset (buffer, 0, sizeof(buffer));
+		krad_rebuilder_write (krad_rebuilder, buffer, 100);
+		memcpy (buffer, "KQN", 3);
+		krad_rebuilder_write (krad_rebuilder, buffer, 10);
+		buffer[3] = KRAD_UDP_DATA;
+		num = 1;
+		memcpy (buffer + 4, &num, 4);
+		num = KRAD_UDP_MAX_SLICE_SIZE * 4;
+		memcpy (buffer + 16, &num, 4);
+		krad_rebuilder_write (krad_rebuilder, buffer, 200);
+		buffer[3] = 77;
+		krad_rebuilder_write (krad_rebuilder, buffer, 200);
+	}
+	
+	done = 0;
+	num = 0;
+	loops = 0;
+	
+	while (1) {
+	
+		if (num < TEST_SLICES) {
+			fill_slice (slice, num);
+			krad_slicer_sendto (krad_slicer, slice, slice_size (num), K_OPUS, "127.0.0.1", TEST_PORT);
+			num++;
+		} else if (done == 0) {
+			done = krad_udp_now_ms ();
+		} else if (krad_udp_now_ms () > done + TEST_LATENCY_MS * 4) {
+			break;
+		}
+	
+		while (1) {
+		
+			rsize = sizeof(remote_address);
+			ret = recvfrom (sd, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr *)&remote_address, &rsize);
+		
+			if (ret < 0) {
+				break;
+			}
+			
+			if ((test_rand () % 100) < loss_percent) {
+				continue;
+			}
+			
+			if ((test_rand () % 100) < 2) {
+				krad_rebuilder_write (krad_rebuilder, buffer, ret);
+			}
+			
+			// hold some back and let them out later, out of order
+			h = test_rand () % TEST_HOLD;
+			if ((test_rand () % 100) < 10) {
+				if (held_size[h]) {
+					krad_rebuilder_write (krad_rebuilder, held[h], held_size[h]);
+				}
+				memcpy (held[h], buffer, ret);
+				held_size[h] = ret;
+				continue;
+			}
+			
+			krad_rebuilder_write (krad_rebuilder, buffer, ret);
+		}
+		
+		while ((nack_size = krad_rebuilder_get_nack (krad_rebuilder, nack_packet)) > 0) {
+			sendto (sd, nack_packet, nack_size, 0, (struct sockaddr *)&remote_address, sizeof(remote_address));
+		}
+		
+		// nothing stays held for more than a few ms
+		if ((++loops % 8) == 0) {
+			for (h = 0; h < TEST_HOLD; h++) {
+				if (held_size[h]) {
+					krad_rebuilder_write (krad_rebuilder, held[h], held_size[h]);
+					held_size[h] = 0;
+				}
+			}
+		}
+		
+		krad_slicer_service_nacks (krad_slicer);
+		
+		while ((ret = krad_rebuilder_read_packet (krad_rebuilder, packet, K_OPUS)) > 0) {
+			check_slice (&result, packet, ret);
+		}
+		
+		usleep (500);
+	}
+	
+	printf ("%-10s fec %d nack %d loss %2d%%: delivered %d/%d lost %"PRIu64" late %"PRIu64" dup %"PRIu64" "
+			"recovered %"PRIu64" nacks %"PRIu64" retransmitted %"PRIu64" malformed %"PRIu64" jitter %.1fms\n",
+			name, fec_group, nack, loss_percent, result.delivered, TEST_SLICES,
+			krad_rebuilder->tracks[K_OPUS].lost, krad_rebuilder->tracks[K_OPUS].late,
+			krad_rebuilder->tracks[K_OPUS].duplicates, krad_rebuilder->tracks[K_OPUS].recovered,
+			krad_rebuilder->nacks_sent, krad_slicer->retransmitted, krad_rebuilder->malformed,
+			krad_rebuilder->tracks[K_OPUS].jitter_ms);
+	
+	if ((result.corrupt) || (result.out_of_order)) {
+		printf ("FAIL: %d corrupt %d out of order\n", result.corrupt, result.out_of_order);
+		*failed = 1;
+	}
+	
+	if ((malformed) && (krad_rebuilder->malformed != 4)) {
+		printf ("FAIL: expected 4 malformed packets\n");
+		*failed = 1;
+	}
+	
+	if ((loss_percent == 0) && (result.delivered != TEST_SLICES)) {
+		printf ("FAIL: lost slices without any loss\n");
+		*failed = 1;
+	}
+
+	if ((nack) && (result.delivered < TEST_SLICES * 99 / 100)) {
+		printf ("FAIL: NACK should hold delivery above 99%%\n");
+		*failed = 1;
+	}
+	
+	if ((fec_group) && (!nack) && (krad_rebuilder->tracks[K_OPUS].recovered == 0)) {
+		printf ("FAIL: FEC never recovered anything\n");
+		*failed = 1;
+	}
+	
+	krad_rebuilder_destroy (krad_rebuilder);
+	krad_slicer_destroy (krad_slicer);
+	close (sd);
+	free (slice);
+	free (packet);
+}
+
+/* no meddling this time, the rebuilder reads the socket itself so the
+   sendmmsg / UDP_SEGMENT and recvmmsg / UDP_GRO paths get exercised */
+
+static void run_batched (char *name, int gso, int gro, int *failed) {
+
+	krad_slicer_t *krad_slicer;
+	krad_rebuilder_t *krad_rebuilder;
+	test_result_t result;
+	struct sockaddr_in local_address;
+	unsigned char *slice;
+	unsigned char *packet;
+	int sd;
+	int ret;
+	int num;
+	int buffer_size;
+	uint64_t datagrams;
+	uint64_t done;
+	
+	memset (&result, 0, sizeof(result));
+	result.last = -1;
+	
+	slice = malloc (KRAD_UDP_MAX_SLICE_SIZE);
+	packet = malloc (KRAD_UDP_MAX_SLICE_SIZE);
+	
+	sd = socket (AF_INET, SOCK_DGRAM, 0);
+	memset (&local_address, 0, sizeof(local_address));
+	local_address.sin_family = AF_INET;
+	local_address.sin_port = htons (TEST_PORT);
+	local_address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	buffer_size = 4 * 1024 * 1024;
+	setsockopt (sd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+	if (bind (sd, (struct sockaddr *)&local_address, sizeof(local_address)) == -1) {
+		printf ("bind error\n");
+		exit (1);
+	}
+	
+	krad_slicer = krad_slicer_create ();
+	krad_slicer_set_gso (krad_slicer, gso);
+	krad_rebuilder = krad_rebuilder_create ();
+	krad_rebuilder_set_latency (krad_rebuilder, TEST_LATENCY_MS);
+	if (gro) {
+		krad_rebuilder_set_gro (krad_rebuilder, sd);
+	}
+	
+	datagrams = 0;
+	done = 0;
+	num = 0;
+	
+	while (1) {
+	
+		if (num < TEST_SLICES) {
+			fill_slice (slice, num);
+			krad_slicer_sendto (krad_slicer, slice, slice_size (num) * 10, K_VP8, "127.0.0.1", TEST_PORT);
+			num++;
+		} else if (done == 0) {
+			done = krad_udp_now_ms ();
+		} else if (krad_udp_now_ms () > done + TEST_LATENCY_MS * 2) {
+			break;
+		}
+		
+		while ((ret = krad_rebuilder_recv (krad_rebuilder, sd, NULL)) > 0) {
+			datagrams += ret;
+		}
+		
+		while ((ret = krad_rebuilder_read_packet (krad_rebuilder, packet, K_VP8)) > 0) {
+			// only the front of each slice is patterned, the rest rode along
+			check_slice (&result, packet, slice_size (*(int *)packet));
+		}
+		
+		if (num == TEST_SLICES) {
+			usleep (1000);
+		}
+	}
+	
+	printf ("%-10s gso %d gro %d: delivered %d/%d lost %"PRIu64" datagrams %"PRIu64" "
+			"send syscalls %"PRIu64" recv syscalls %"PRIu64"\n",
+			name, krad_slicer->gso, krad_rebuilder->gro, result.delivered, TEST_SLICES,
+			krad_rebuilder->tracks[K_VP8].lost, datagrams, krad_slicer->syscalls, krad_rebuilder->syscalls);
+	
+	if ((result.corrupt) || (result.out_of_order) || (result.delivered != TEST_SLICES)) {
+		printf ("FAIL: %d corrupt %d out of order %d delivered\n", result.corrupt, result.out_of_order,
+				result.delivered);
+		*failed = 1;
+	}
+	
+	if (krad_slicer->syscalls >= krad_slicer->sent) {
+		printf ("FAIL: sends were not batched\n");
+		*failed = 1;
+	}
+	
+	krad_rebuilder_destroy (krad_rebuilder);
+	krad_slicer_destroy (krad_slicer);
+	close (sd);
+	free (slice);
+	free (packet);
+}
+
+/* watches the wire from the other side to see how bursty it really is */
+
+#define PACE_MAX_ARRIVALS 100000
+
+typedef struct {
+	int sd;
+	int stop;
+	int count;
+	uint64_t arrival_ns[PACE_MAX_ARRIVALS];
+	int bytes[PACE_MAX_ARRIVALS];
+} pace_watch_t;
+
+static uint64_t test_now_ns () {
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void *pace_watch_thread (void *arg) {
+
+	pace_watch_t *watch;
+	struct pollfd sockets[1];
+	unsigned char buffer[2048];
+	int ret;
+	
+	watch = arg;
+	
+	while (!watch->stop) {
+		sockets[0].fd = watch->sd;
+		sockets[0].events = POLLIN;
+		if (poll (sockets, 1, 20) < 1) {
+			continue;
+		}
+		while ((ret = recv (watch->sd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+			if (watch->count < PACE_MAX_ARRIVALS) {
+				watch->arrival_ns[watch->count] = test_now_ns ();
+				watch->bytes[watch->count] = ret;
+				watch->count++;
+			}
+		}
+	}
+	
+	return NULL;
+}
+
+/* most bytes seen inside any window_ms */
+static int pace_watch_peak (pace_watch_t *watch, int window_ms) {
+
+	int first;
+	int last;
+	int bytes;
+	int peak;
+	
+	first = 0;
+	bytes = 0;
+	peak = 0;
+	
+	for (last = 0; last < watch->count; last++) {
+		bytes += watch->bytes[last];
+		while (watch->arrival_ns[last] - watch->arrival_ns[first] >= (uint64_t)window_ms * 1000000) {
+			bytes -= watch->bytes[first];
+			first++;
+		}
+		if (bytes > peak) {
+			peak = bytes;
+		}
+	}
+	
+	return peak;
+}
+
+/* a real time producer, a slice every interval_ms, every keyframe_interval
+   slices one is keyframe_size instead */
+
+static void run_paced (char *name, int kbps, int spread_ms, int slices, int interval_ms, int size,
+					   int keyframe_interval, int keyframe_size, int expect_drops, int *failed) {
+
+	krad_slicer_t *krad_slicer;
+	pace_watch_t *watch;
+	pthread_t watch_thread;
+	struct sockaddr_in local_address;
+	unsigned char *slice;
+	int buffer_size;
+	int num;
+	int this_size;
+	int wait_us;
+	int peak_10ms;
+	int allowed_10ms;
+	uint64_t started;
+	uint64_t next_frame;
+	uint64_t now;
+	uint64_t span_ms;
+	uint64_t bytes;
+	
+	watch = calloc (1, sizeof(pace_watch_t));
+	slice = calloc (1, KRAD_UDP_MAX_SLICE_SIZE);
+	
+	watch->sd = socket (AF_INET, SOCK_DGRAM, 0);
+	memset (&local_address, 0, sizeof(local_address));
+	local_address.sin_family = AF_INET;
+	local_address.sin_port = htons (TEST_PORT);
+	local_address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	buffer_size = 8 * 1024 * 1024;
+	setsockopt (watch->sd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+	if (bind (watch->sd, (struct sockaddr *)&local_address, sizeof(local_address)) == -1) {
+		printf ("bind error\n");
+		exit (1);
+	}
+	
+	pthread_create (&watch_thread, NULL, pace_watch_thread, watch);
+	
+	krad_slicer = krad_slicer_create ();
+	krad_slicer_set_pacing (krad_slicer, kbps, spread_ms, 0);
+	
+	started = test_now_ns ();
+	next_frame = started;
+	
+	for (num = 0; num < slices; num++) {
+	
+		this_size = size;
+		if ((keyframe_interval) && ((num % keyframe_interval) == 0)) {
+			this_size = keyframe_size;
+		}
+	
+		fill_slice (slice, num);
+		krad_slicer_sendto (krad_slicer, slice, this_size, K_VP8, "127.0.0.1", TEST_PORT);
+		
+		next_frame += (uint64_t)interval_ms * 1000000;
+		
+		while ((now = test_now_ns ()) < next_frame) {
+			wait_us = krad_slicer_service (krad_slicer);
+			if ((wait_us < 0) || (now + (uint64_t)wait_us * 1000 > next_frame)) {
+				wait_us = (next_frame - now) / 1000;
+			}
+			usleep (wait_us + 1);
+		}
+	}
+	
+	krad_slicer_drain (krad_slicer);
+	
+	usleep (100000);
+	watch->stop = 1;
+	pthread_join (watch_thread, NULL);
+	
+	bytes = 0;
+	for (num = 0; num < watch->count; num++) {
+		bytes += watch->bytes[num];
+	}
+	
+	span_ms = 0;
+	if (watch->count > 1) {
+		span_ms = (watch->arrival_ns[watch->count - 1] - watch->arrival_ns[0]) / 1000000;
+	}
+	
+	peak_10ms = pace_watch_peak (watch, 10);
+	
+	printf ("%-10s %d kbps spread %dms: %d slices every %dms, %d datagrams over %"PRIu64"ms "
+			"peak %d bytes/10ms dropped %"PRIu64" backlog peak %dms\n",
+			name, kbps, spread_ms, slices, interval_ms, watch->count, span_ms, peak_10ms,
+			krad_slicer->paced_dropped, krad_slicer->backlog_peak_ms);
+	
+	if (kbps) {
+		// a 10ms window may hold the idle burst on top of the rate
+		allowed_10ms = (kbps * 1000 / 8) / 100 + KRAD_UDP_PACE_BURST_BYTES * 2;
+		if (peak_10ms > allowed_10ms) {
+			printf ("FAIL: %d bytes in 10ms is over the %d the ceiling allows\n", peak_10ms, allowed_10ms);
+			*failed = 1;
+		}
+		if ((bytes * 8 / kbps) > span_ms + 20) {
+			printf ("FAIL: sent faster than the ceiling\n");
+			*failed = 1;
+		}
+	}
+	
+	if (krad_slicer->backlog_peak_ms > KRAD_UDP_DEFAULT_PACE_MAX_DELAY_MS) {
+		printf ("FAIL: backlog went past the max delay\n");
+		*failed = 1;
+	}
+	
+	if ((expect_drops) != (krad_slicer->paced_dropped > 0)) {
+		printf ("FAIL: %s drops\n", expect_drops ? "expected" : "unexpected");
+		*failed = 1;
+	}
+	
+	if ((spread_ms) && (!kbps)) {
+		if ((span_ms < spread_ms * 3 / 4) || (span_ms > spread_ms * 2)) {
+			printf ("FAIL: slice was not spread over %dms\n", spread_ms);
+			*failed = 1;
+		}
+	}
+	
+	krad_slicer_destroy (krad_slicer);
+	close (watch->sd);
+	free (watch);
+	free (slice);
+}
+
+int main (int argc, char *argv[]) {
+
+	int failed;
+	
+	failed = 0;
+
+	krad_system_init ();
+
+	run ("clean", 0, 0, 0, 1, &failed);
+	run ("plain", 0, 0, 3, 0, &failed);
+	run ("fec", 5, 0, 3, 0, &failed);
+	run ("nack", 0, 1, 3, 0, &failed);
+	run ("fec+nack", 5, 1, 3, 0, &failed);
+	run ("fec+nack", 5, 1, 10, 0, &failed);
+	
+	run_batched ("mmsg", 0, 0, &failed);
+	run_batched ("gso+gro", 1, 1, &failed);
+	
+	// twice what the ceiling lets out, has to shed slices
+	run_paced ("ceiling", 8000, 0, 100, 10, 20000, 0, 0, 1, &failed);
+	run_paced ("spread", 0, 40, 1, 40, 200000, 0, 0, 0, &failed);
+	// keyframes get spread past a frame but fit in the max delay
+	run_paced ("both", 40000, 33, 60, 33, 30000, 10, 300000, 0, &failed);
+	
+	if (failed) {
+		printf ("FAILED\n");
+		return 1;
+	}
+	
+	printf ("PASSED\n");
+	
+	return 0;
+}
@@ -1,11 +1,17 @@
 #include "krad_v4l2.h"
 
 #define DEFAULT_DEVICE "/dev/video0"
+#define HELD_BUFFERS 3
+
+/* works with the vivid or v4l2loopback virtual devices, ie. modprobe vivid */
 
 int main (int argc, char *argv[]) {
 
 	char *device;
 	krad_v4l2_t *kradv4l2;
+	int held[HELD_BUFFERS];
+	int frames;
+	int h;
 	
 	if (argc < 2) {
 		device = DEFAULT_DEVICE;
@@ -26,14 +32,33 @@ int main (int argc, char *argv[]) {
 	
 	kradv4l2_start_capturing (kradv4l2);
 	
-//	kradv4l2_read_frame_wait (kradv4l2);
+	/* hold a few buffers at once like wrapped compositor frames do,
+	   then hand them back by index */
 
+	frames = 0;
+	h = 0;
 
-	usleep(400000);
-	
+	while (frames < 30) {
+		if (kradv4l2_read_frame_wait_adv (kradv4l2) == NULL) {
+			continue;
+		}
+		held[h++] = kradv4l2->buf.index;
+		frames++;
+		if (h == HELD_BUFFERS) {
+			printf("holding buffers %d %d %d, requeueing\n", held[0], held[1], held[2]);
+			while (h > 0) {
+				kradv4l2_buffer_done (kradv4l2, held[--h]);
+			}
+		}
+	}
 
 	kradv4l2_stop_capturing (kradv4l2);
 
+	/* after stream off this is a no op */
+	while (h > 0) {
+		kradv4l2_buffer_done (kradv4l2, held[--h]);
+	}
+
 	kradv4l2_close(kradv4l2);
 
 	kradv4l2_destroy(kradv4l2);
@@ -0,0 +1,175 @@
+#include "krad_vpx.h"
+
+/* Drives the speed ladder with made up encode times and checks it steps
+   one level at a time, no sooner than the holdoff and the run of frames
+   over or under budget allow, that a backlog jumps it to realtime and
+   that pinning speed and deadline stops it. Then switches rate control
+   to cbr and back and checks libvpx's own vbr settings come back. */
+
+#define TEST_WIDTH 640
+#define TEST_HEIGHT 360
+#define TEST_FPS 30
+#define TEST_BITRATE 500
+#define TEST_BUFFER_MS 500
+
+static int failed;
+
+static void check (int ok, char *what) {
+	if (!ok) {
+		printf ("failed: %s\n", what);
+		failed++;
+	}
+}
+
+/* feeds frames at load times the frame budget, returns the level reached
+   and checks every step is one level, holdoff frames or more apart */
+
+static int run_load (krad_vpx_encoder_t *kradvpx, float load, int frames_queued, int frames, int run) {
+
+	int f;
+	int level;
+	int since_step;
+
+	level = kradvpx->speed_level;
+	since_step = kradvpx->frames_since_change;
+
+	for (f = 0; f < frames; f++) {
+
+		kradvpx->encode_us_average = kradvpx->frame_budget_us * load;
+		krad_vpx_encoder_adapt (kradvpx, frames_queued);
+		since_step++;
+
+		if (kradvpx->speed_level != level) {
+			check ((kradvpx->speed_level == level + 1) || (kradvpx->speed_level == level - 1),
+				   "speed level moved more than one step");
+			check (since_step >= KRAD_VPX_ADAPT_HOLDOFF, "speed level moved inside the holdoff");
+			check (since_step >= run, "speed level moved before a long enough run");
+			level = kradvpx->speed_level;
+			since_step = 0;
+		}
+	}
+
+	return level;
+
+}
+
+static void test_ladder () {
+
+	krad_vpx_encoder_t *kradvpx;
+	int level;
+
+	kradvpx = krad_vpx_encoder_create (TEST_WIDTH, TEST_HEIGHT, TEST_FPS, 1, TEST_BITRATE);
+
+	check (kradvpx->speed_level == 0, "encoder did not start at the bottom of the ladder");
+	check (kradvpx->quality != VPX_DL_REALTIME, "encoder started at the realtime deadline");
+
+	/* in between high and low it should stay put */
+	level = run_load (kradvpx, (KRAD_VPX_LOAD_HIGH + KRAD_VPX_LOAD_LOW) / 2, 0, 500, KRAD_VPX_FRAMES_OVER);
+	check (level == 0, "speed level moved with the load in between");
+
+	/* over budget it climbs all the way and stops at the top */
+	level = run_load (kradvpx, KRAD_VPX_LOAD_HIGH + 0.1f, 0,
+					  KRAD_VPX_SPEED_LEVELS * KRAD_VPX_ADAPT_HOLDOFF + 100, KRAD_VPX_FRAMES_OVER);
+	check (level == KRAD_VPX_SPEED_LEVELS - 1, "speed level did not climb to the top");
+	check (kradvpx->quality == VPX_DL_REALTIME, "top of the ladder is not realtime");
+
+	/* a short dip under budget does not bring it down */
+	level = run_load (kradvpx, KRAD_VPX_LOAD_LOW / 2, 0, KRAD_VPX_FRAMES_UNDER - 1, KRAD_VPX_FRAMES_UNDER);
+	check (level == KRAD_VPX_SPEED_LEVELS - 1, "speed level came down on a short run under budget");
+
+	/* a long one brings it all the way back */
+	level = run_load (kradvpx, KRAD_VPX_LOAD_LOW / 2, 0,
+					  KRAD_VPX_SPEED_LEVELS * KRAD_VPX_FRAMES_UNDER + 100, KRAD_VPX_FRAMES_UNDER);
+	check (level == 0, "speed level did not come back down");
+	check (kradvpx->quality != VPX_DL_REALTIME, "bottom of the ladder is realtime");
+
+	/* a backlog goes straight to realtime whatever the encode time */
+	kradvpx->encode_us_average = kradvpx->frame_budget_us * KRAD_VPX_LOAD_LOW / 2;
+	krad_vpx_encoder_adapt (kradvpx, KRAD_VPX_BACKLOG_PANIC + 1);
+	check (kradvpx->speed_level > 0, "backlog did not move the speed level");
+	check (kradvpx->quality == VPX_DL_REALTIME, "backlog did not go to the realtime deadline");
+
+	/* pinned speed and deadline, adapt leaves them be */
+	krad_vpx_encoder_speed_set (kradvpx, 8);
+	krad_vpx_encoder_quality_set (kradvpx, 20000);
+	level = kradvpx->speed_level;
+	run_load (kradvpx, KRAD_VPX_LOAD_HIGH + 0.1f, 0, 500, KRAD_VPX_FRAMES_OVER);
+	check (kradvpx->speed_level == level, "speed level moved while pinned");
+	check (kradvpx->cpu_used == 8, "pinned cpu-used did not stick");
+	check (kradvpx->quality == 20000, "pinned deadline did not stick");
+
+	/* handing the deadline back, it follows the ladder again */
+	krad_vpx_encoder_speed_set (kradvpx, KRAD_VPX_SPEED_AUTO);
+	krad_vpx_encoder_quality_set (kradvpx, KRAD_VPX_DEADLINE_AUTO);
+	level = run_load (kradvpx, KRAD_VPX_LOAD_HIGH + 0.1f, 0,
+					  KRAD_VPX_SPEED_LEVELS * KRAD_VPX_ADAPT_HOLDOFF + 100, KRAD_VPX_FRAMES_OVER);
+	check (level == KRAD_VPX_SPEED_LEVELS - 1, "speed level did not climb after unpinning");
+	check (kradvpx->quality == VPX_DL_REALTIME, "deadline did not follow the ladder after unpinning");
+
+	krad_vpx_encoder_destroy (kradvpx);
+
+}
+
+static int same_vbr_settings (vpx_codec_enc_cfg_t *cfg, vpx_codec_enc_cfg_t *default_cfg) {
+
+	return ((cfg->g_lag_in_frames == default_cfg->g_lag_in_frames) &&
+			(cfg->rc_buf_sz == default_cfg->rc_buf_sz) &&
+			(cfg->rc_buf_initial_sz == default_cfg->rc_buf_initial_sz) &&
+			(cfg->rc_buf_optimal_sz == default_cfg->rc_buf_optimal_sz) &&
+			(cfg->rc_undershoot_pct == default_cfg->rc_undershoot_pct) &&
+			(cfg->rc_overshoot_pct == default_cfg->rc_overshoot_pct) &&
+			(cfg->rc_min_quantizer == default_cfg->rc_min_quantizer) &&
+			(cfg->rc_max_quantizer == default_cfg->rc_max_quantizer));
+
+}
+
+static void test_rate_control () {
+
+	krad_vpx_encoder_t *kradvpx;
+	vpx_codec_enc_cfg_t default_cfg;
+
+	vpx_codec_enc_config_default (interface, &default_cfg, 0);
+
+	kradvpx = krad_vpx_encoder_create (TEST_WIDTH, TEST_HEIGHT, TEST_FPS, 1, TEST_BITRATE);
+
+	check (kradvpx->cfg.rc_end_usage == VPX_VBR, "encoder did not start on vbr");
+	check (same_vbr_settings (&kradvpx->cfg, &default_cfg), "encoder did not start on libvpx's vbr settings");
+
+	krad_vpx_encoder_rate_control_set (kradvpx, VPX_CBR, TEST_BUFFER_MS);
+	check (kradvpx->cfg.rc_end_usage == VPX_CBR, "cbr was not set");
+	check (kradvpx->cfg.rc_buf_sz == TEST_BUFFER_MS, "cbr buffer was not set");
+	check (kradvpx->cfg.rc_buf_initial_sz == TEST_BUFFER_MS / 2, "cbr initial buffer was not set");
+	check (kradvpx->cfg.g_lag_in_frames == 0, "cbr left lag in");
+	check (kradvpx->update_config == 1, "cbr did not ask for the config to be applied");
+
+	krad_vpx_encoder_rate_control_set (kradvpx, VPX_VBR, 0);
+	check (kradvpx->cfg.rc_end_usage == VPX_VBR, "vbr was not set");
+	check (same_vbr_settings (&kradvpx->cfg, &default_cfg), "vbr settings did not come back after cbr");
+
+	/* no buffer given, cbr goes back to the last one */
+	krad_vpx_encoder_rate_control_set (kradvpx, VPX_CBR, 0);
+	check (kradvpx->cfg.rc_buf_sz == TEST_BUFFER_MS, "cbr did not keep its buffer");
+
+	krad_vpx_encoder_rate_control_set (kradvpx, VPX_CQ, 0);
+	check (kradvpx->cfg.rc_end_usage == VPX_CQ, "cq was not set");
+	check (same_vbr_settings (&kradvpx->cfg, &default_cfg), "cq did not get libvpx's settings back after cbr");
+
+	krad_vpx_encoder_destroy (kradvpx);
+
+}
+
+int main (int argc, char *argv[]) {
+
+	test_ladder ();
+	test_rate_control ();
+
+	if (failed) {
+		printf ("FAIL\n");
+		return 1;
+	}
+
+	printf ("PASS\n");
+
+	return 0;
+
+}
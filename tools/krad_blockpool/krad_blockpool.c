@@ -0,0 +1,87 @@
+#include "krad_blockpool.h"
+
+krad_block_t *krad_blockpool_getblock (krad_blockpool_t *krad_blockpool) {
+
+	int b;
+
+	for (b = 0; b < krad_blockpool->count; b++ ) {
+		if (__sync_bool_compare_and_swap (&krad_blockpool->blocks[b].refs, 0, 1)) {
+			return &krad_blockpool->blocks[b];
+		}
+	}
+	
+	return NULL;
+
+}
+
+void krad_blockpool_ref_block (krad_block_t *block) {
+
+	__sync_fetch_and_add (&block->refs, 1);
+
+}
+
+void krad_blockpool_unref_block (krad_block_t *block) {
+
+	__sync_fetch_and_sub (&block->refs, 1);
+
+}
+
+int krad_blockpool_blocks_in_use (krad_blockpool_t *krad_blockpool) {
+
+	int b;
+	int in_use;
+
+	in_use = 0;
+
+	for (b = 0; b < krad_blockpool->count; b++ ) {
+		if (__sync_fetch_and_add (&krad_blockpool->blocks[b].refs, 0) > 0) {
+			in_use++;
+		}
+	}
+
+	return in_use;
+
+}
+
+void krad_blockpool_destroy (krad_blockpool_t *krad_blockpool) {
+
+	int b;
+	int c;
+
+	for (b = 0; b < krad_blockpool->count; b++ ) {
+		for (c = 0; c < krad_blockpool->channels; c++ ) {
+			free (krad_blockpool->blocks[b].samples[c]);
+		}
+	}
+
+	free (krad_blockpool->blocks);
+	free (krad_blockpool);
+
+}
+
+krad_blockpool_t *krad_blockpool_create (int channels, int count) {
+
+	krad_blockpool_t *krad_blockpool;
+	int b;
+	int c;
+
+	if (channels > KRAD_BLOCKPOOL_MAX_CHANNELS) {
+		channels = KRAD_BLOCKPOOL_MAX_CHANNELS;
+	}
+
+	krad_blockpool = calloc (1, sizeof(krad_blockpool_t));
+
+	krad_blockpool->channels = channels;
+	krad_blockpool->count = count;
+	krad_blockpool->blocks = calloc (krad_blockpool->count, sizeof(krad_block_t));
+
+	for (b = 0; b < krad_blockpool->count; b++ ) {
+		krad_blockpool->blocks[b].channels = krad_blockpool->channels;
+		for (c = 0; c < krad_blockpool->channels; c++ ) {
+			krad_blockpool->blocks[b].samples[c] = calloc (KRAD_BLOCKPOOL_MAX_FRAMES, sizeof(float));
+		}
+	}
+
+	return krad_blockpool;
+
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include <pthread.h>
+
+#include "krad_system.h"
+
+#ifndef KRAD_BLOCKPOOL_H
+#define KRAD_BLOCKPOOL_H
+
+/* the most frames a block holds, a longer mixer period is split across blocks */
+#define KRAD_BLOCKPOOL_MAX_FRAMES 4096
+#define KRAD_BLOCKPOOL_MAX_CHANNELS 8
+
+typedef struct krad_blockpool_St krad_blockpool_t;
+typedef struct krad_block_St krad_block_t;
+
+/* One period of planar audio as the mixer made it, handed to any number
+   of consumers by reference. position is where its first frame falls in
+   the mixer's count of frames since it started, so a consumer can tell
+   exactly where it is and whether it missed any. */
+
+struct krad_block_St {
+
+	float *samples[KRAD_BLOCKPOOL_MAX_CHANNELS];
+	int channels;
+	int frames;
+	uint64_t position;
+
+	/* only ever changed atomically, the mixer thread takes and drops
+	   refs without a lock */
+	int refs;
+
+};
+
+struct krad_blockpool_St {
+
+	int channels;
+	int count;
+
+	krad_block_t *blocks;
+
+};
+
+/* NULL if every block is in use, the block comes with one ref */
+krad_block_t *krad_blockpool_getblock (krad_blockpool_t *krad_blockpool);
+
+void krad_blockpool_ref_block (krad_block_t *block);
+void krad_blockpool_unref_block (krad_block_t *block);
+int krad_blockpool_blocks_in_use (krad_blockpool_t *krad_blockpool);
+
+void krad_blockpool_destroy (krad_blockpool_t *krad_blockpool);
+krad_blockpool_t *krad_blockpool_create (int channels, int count);
+
+#endif
@@ -640,46 +640,56 @@ void krad_compositor_port_set_io_params (krad_compositor_port_t *krad_compositor
 
 void krad_compositor_port_push_yuv_frame (krad_compositor_port_t *krad_compositor_port, krad_frame_t *krad_frame) {
 
+	krad_compositor_port_convert_yuv_frame (krad_compositor_port, krad_frame);
+
+	krad_compositor_port_push_frame (krad_compositor_port, krad_frame);
+
+}
+
+void krad_compositor_port_convert_yuv_frame (krad_compositor_port_t *krad_compositor_port, krad_frame_t *krad_frame) {
+
 	int rgb_stride_arr[3] = {4*krad_compositor_port->krad_compositor->width, 0, 0};
 	unsigned char *dst[4];
-	
-	if ((krad_compositor_port->io_params_updated) || (krad_compositor_port->comp_params_updated)) {
-		if (krad_compositor_port->sws_converter != NULL) {
-			sws_freeContext ( krad_compositor_port->sws_converter );
-			krad_compositor_port->sws_converter = NULL;
-		}
-		krad_compositor_port->io_params_updated = 0;
-		krad_compositor_port->comp_params_updated = 0;
+	struct SwsContext *sws_converter;
+	
+	krad_compositor_port->io_params_updated = 0;
+	krad_compositor_port->comp_params_updated = 0;
+
+	/* frames can change format or size from one to the next, ie. a
+	   capture restarting or a file with a new stream, the cached
+	   context is only rebuilt when they do */
+	sws_converter =
+		sws_getCachedContext ( krad_compositor_port->sws_converter,
+							   krad_compositor_port->source_width,
+							   krad_compositor_port->source_height,
+							   krad_frame->format,
+							   krad_compositor_port->width,
+							   krad_compositor_port->height,
+							   PIX_FMT_RGB32, 
+							   SWS_BICUBIC,
+							   NULL, NULL, NULL);
+
+	if (sws_converter == NULL) {
+		printke ("Krad Compositor: can't convert frames of format %d at %dx%d",
+				 krad_frame->format, krad_compositor_port->source_width, krad_compositor_port->source_height);
+		krad_compositor_port->sws_converter = NULL;
+		return;
 	}
-	
-	if (krad_compositor_port->sws_converter == NULL) {
 
-		krad_compositor_port->sws_converter =
-			sws_getContext ( krad_compositor_port->source_width,
-							 krad_compositor_port->source_height,
-							 krad_frame->format,
-							 krad_compositor_port->width,
-							 krad_compositor_port->height,
-							 PIX_FMT_RGB32, 
-							 SWS_BICUBIC,
-							 NULL, NULL, NULL);
-							 
+	if (sws_converter != krad_compositor_port->sws_converter) {
+		krad_compositor_port->sws_converter = sws_converter;
 		printk ("set scaling to w %d h %d sw %d sh %d",
 				krad_compositor_port->width,
 				krad_compositor_port->height,
 				krad_compositor_port->source_width,
-				krad_compositor_port->source_height);							 
-							 
-
-	}									 
+				krad_compositor_port->source_height);
+	}
 
 	dst[0] = (unsigned char *)krad_frame->pixels;
 
 	sws_scale (krad_compositor_port->sws_converter, (const uint8_t * const*)krad_frame->yuv_pixels,
 			   krad_frame->yuv_strides, 0, krad_compositor_port->source_height, dst, rgb_stride_arr);
 
-	krad_compositor_port_push_frame (krad_compositor_port, krad_frame);
-
 }
 
 krad_frame_t *krad_compositor_port_pull_yuv_frame (krad_compositor_port_t *krad_compositor_port,
@@ -818,6 +828,35 @@ krad_frame_t *krad_compositor_port_pull_frame (krad_compositor_port_t *krad_comp
 
 	if (krad_compositor_port->direction == INPUT) {
 
+		if (krad_compositor_port->source_paced) {
+
+			/* anything pushed before the newest frame was already due */
+			krad_frame = NULL;
+			while (krad_ringbuffer_read_space (krad_compositor_port->frame_ring) >= sizeof(krad_frame_t *)) {
+				if (krad_frame != NULL) {
+					krad_framepool_unref_frame (krad_frame);
+				}
+				krad_ringbuffer_read (krad_compositor_port->frame_ring, (char *)&krad_frame, sizeof(krad_frame_t *));
+			}
+
+			if (krad_frame != NULL) {
+				if (krad_compositor_port->last_frame != NULL) {
+					krad_framepool_unref_frame (krad_compositor_port->last_frame);
+				} else {
+					krad_compositor_port->start_timecode = krad_compositor_port->krad_compositor->timecode;
+				}
+				krad_framepool_ref_frame (krad_frame);
+				krad_compositor_port->last_frame = krad_frame;
+				return krad_frame;
+			}
+
+			if (krad_compositor_port->last_frame != NULL) {
+				krad_framepool_ref_frame (krad_compositor_port->last_frame);
+				return krad_compositor_port->last_frame;
+			}
+
+			return NULL;
+		}
 
 		if (krad_compositor_port->last_frame != NULL) {
 
@@ -1012,6 +1051,7 @@ krad_compositor_port_t *krad_compositor_port_create (krad_compositor_t *krad_com
 	strcpy (krad_compositor_port->sysname, sysname);	
 	
 	krad_compositor_port->start_timecode = 1;
+	krad_compositor_port->source_paced = 0;
 	
 	krad_compositor_port->frame_ring = 
 		krad_ringbuffer_create ( DEFAULT_COMPOSITOR_BUFFER_FRAMES * sizeof(krad_frame_t *) );
@@ -1049,6 +1089,8 @@ krad_compositor_port_t *krad_compositor_mjpeg_port_create (krad_compositor_t *kr
 
 void krad_compositor_port_destroy (krad_compositor_t *krad_compositor, krad_compositor_port_t *krad_compositor_port) {
 
+	krad_frame_t *krad_frame;
+
 	pthread_mutex_lock (&krad_compositor->settings_lock);	
 	krad_compositor_port->active = 3;
 
@@ -1059,6 +1101,11 @@ void krad_compositor_port_destroy (krad_compositor_t *krad_compositor, krad_comp
 		krad_compositor->active_output_ports--;
 	}
 
+	while (krad_ringbuffer_read_space (krad_compositor_port->frame_ring) >= sizeof(krad_frame_t *)) {
+		krad_ringbuffer_read (krad_compositor_port->frame_ring, (char *)&krad_frame, sizeof(krad_frame_t *));
+		krad_framepool_unref_frame (krad_frame);
+	}
+
 	krad_ringbuffer_free ( krad_compositor_port->frame_ring );
 	krad_compositor_port->start_timecode = 0;
 	krad_compositor_port->active = 0;
@@ -76,6 +76,8 @@ struct krad_compositor_port_St {
 	int comp_params_updated;
 	
 	uint64_t start_timecode;
+	/* the source pushes each frame when it is due, the newest is shown */
+	int source_paced;
 	
 };
 
@@ -207,6 +209,8 @@ void krad_compositor_port_set_comp_params (krad_compositor_port_t *krad_composit
 
 void krad_compositor_port_push_rgba_frame (krad_compositor_port_t *krad_compositor_port, krad_frame_t *krad_frame);
 void krad_compositor_port_push_yuv_frame (krad_compositor_port_t *krad_compositor_port, krad_frame_t *krad_frame);
+/* the sws_scale half of push_yuv_frame, for sources that convert on their own thread */
+void krad_compositor_port_convert_yuv_frame (krad_compositor_port_t *krad_compositor_port, krad_frame_t *krad_frame);
 void krad_compositor_port_push_frame (krad_compositor_port_t *krad_compositor_port, krad_frame_t *krad_frame);
 krad_frame_t *krad_compositor_port_pull_frame (krad_compositor_port_t *krad_compositor_port);
 
@@ -81,15 +81,71 @@ int krad_container_track_header_count (krad_container_t *krad_container, int tra
 
 
 
+static void krad_container_prefetch_update (krad_container_t *krad_container, uint64_t timecode) {
+
+	if (krad_container->container_type == OGG) {
+		krad_prefetch_update (krad_container->krad_prefetch, krad_io_tell (krad_container->krad_ogg->krad_io), timecode);
+	} else {
+		krad_prefetch_update (krad_container->krad_prefetch, krad_ebml_tell (krad_container->krad_ebml), timecode);
+	}
+
+}
+
 int krad_container_read_packet (krad_container_t *krad_container, int *track, uint64_t *timecode,
 								unsigned char *buffer) {
 
+	int ret;
+
 	if (krad_container->container_type == OGG) {
-		return krad_ogg_read_packet ( krad_container->krad_ogg, track, timecode, buffer );
+		ret = krad_ogg_read_packet ( krad_container->krad_ogg, track, timecode, buffer );
 	} else {
-		return krad_ebml_read_packet ( krad_container->krad_ebml, track, timecode, buffer );		
+		ret = krad_ebml_read_packet ( krad_container->krad_ebml, track, timecode, buffer );		
 	}
 
+	if (krad_container->krad_prefetch != NULL) {
+		krad_container_prefetch_update (krad_container, *timecode);
+	}
+
+	return ret;
+
+}
+
+int krad_container_read_packet_in_place (krad_container_t *krad_container, int *track, uint64_t *timecode,
+										 unsigned char *buffer, unsigned char **frame) {
+
+	int ret;
+
+	if (krad_container->container_type == OGG) {
+		*frame = buffer;
+		ret = krad_ogg_read_packet ( krad_container->krad_ogg, track, timecode, buffer );
+	} else {
+		ret = krad_ebml_read_packet_in_place ( krad_container->krad_ebml, track, timecode, frame );
+	}
+
+	if (krad_container->krad_prefetch != NULL) {
+		krad_container_prefetch_update (krad_container, *timecode);
+	}
+
+	return ret;
+
+}
+
+int64_t krad_container_seek (krad_container_t *krad_container, uint64_t timecode) {
+
+	int64_t ret;
+
+	if (krad_container->container_type == OGG) {
+		ret = krad_ogg_seek_timecode ( krad_container->krad_ogg, timecode );
+	} else {
+		ret = krad_ebml_seek_timecode ( krad_container->krad_ebml, timecode );
+	}
+
+	if ((ret >= 0) && (krad_container->krad_prefetch != NULL)) {
+		krad_container_prefetch_update (krad_container, ret);
+	}
+
+	return ret;
+
 }
 
 krad_container_t *krad_container_open_stream (char *host, int port, char *mount, char *password) {
@@ -132,6 +188,16 @@ krad_container_t *krad_container_open_file (char *filename, krad_io_mode_t mode)
 		}
 	}
 
+	if (mode == KRAD_IO_READONLY) {
+		if (krad_container->container_type == OGG) {
+			krad_container->krad_prefetch = krad_prefetch_create (krad_container->krad_ogg->krad_io->ptr,
+																  KRAD_PREFETCH_DEFAULT_SECONDS);
+		} else {
+			krad_container->krad_prefetch = krad_prefetch_create (krad_container->krad_ebml->io_adapter.ptr,
+																  KRAD_PREFETCH_DEFAULT_SECONDS);
+		}
+	}
+
 	return krad_container;
 
 }
@@ -156,6 +222,10 @@ krad_container_t *krad_container_open_transmission (krad_transmission_t *krad_tr
 }
 
 void krad_container_destroy (krad_container_t *krad_container) {
+
+	if (krad_container->krad_prefetch != NULL) {
+		krad_prefetch_destroy (krad_container->krad_prefetch);
+	}
 						
 	if (krad_container->container_type == OGG) {
 		krad_ogg_destroy (krad_container->krad_ogg);
@@ -166,6 +236,52 @@ void krad_container_destroy (krad_container_t *krad_container) {
 }	
 
 
+/* ogg pages already go out as they fill */
+
+void krad_container_set_live (krad_container_t *krad_container, int max_cluster_ms, int max_cluster_bytes,
+							  int flush_ms) {
+
+	if (krad_container->container_type == EBML) {
+		krad_ebml_set_live (krad_container->krad_ebml, max_cluster_ms, max_cluster_bytes, flush_ms);
+	}
+
+}
+
+int krad_container_failed (krad_container_t *krad_container) {
+
+	if (krad_container->container_type == OGG) {
+		if (krad_container->krad_ogg->krad_io != NULL) {
+			return krad_container->krad_ogg->krad_io->failed;
+		}
+		return 0;
+	} else {
+		return krad_container->krad_ebml->io_adapter.failed;
+	}
+
+}
+
+int krad_container_buffered_ms (krad_container_t *krad_container) {
+
+	if (krad_container->krad_prefetch != NULL) {
+		return krad_prefetch_buffered_ms (krad_container->krad_prefetch);
+	}
+
+	return 0;
+
+}
+
+uint64_t krad_container_corruptions (krad_container_t *krad_container, uint64_t *corrupt_bytes) {
+
+	if (krad_container->container_type == OGG) {
+		*corrupt_bytes = krad_container->krad_ogg->corrupt_bytes;
+		return krad_container->krad_ogg->corruptions;
+	} else {
+		*corrupt_bytes = krad_container->krad_ebml->corrupt_bytes;
+		return krad_container->krad_ebml->corruptions;
+	}
+
+}
+
 int krad_container_add_video_track_with_private_data (krad_container_t *krad_container, krad_codec_t codec,
 													  int fps_numerator, int fps_denominator, int width, int height,
 													  krad_codec_header_t *krad_codec_header) {
@@ -233,4 +349,28 @@ void krad_container_add_audio (krad_container_t *krad_container, int track, unsi
 
 }
 
+/* ogg pages carry granulepos worked out from the frame counts, so only ebml uses the timecode */
+
+void krad_container_add_video_timecode (krad_container_t *krad_container, int track, unsigned char *buffer,
+										int buffer_size, int keyframe, int64_t timecode) {
+
+	if (krad_container->container_type == OGG) {
+		krad_ogg_add_video (krad_container->krad_ogg, track, buffer, buffer_size, keyframe);
+	} else {
+		krad_ebml_add_video_timecode (krad_container->krad_ebml, track, buffer, buffer_size, keyframe, timecode);
+	}
+
+}
+
+void krad_container_add_audio_timecode (krad_container_t *krad_container, int track, unsigned char *buffer,
+										int buffer_size, int frames, int64_t timecode) {
+
+	if (krad_container->container_type == OGG) {
+		krad_ogg_add_audio (krad_container->krad_ogg, track, buffer, buffer_size, frames);
+	} else {
+		krad_ebml_add_audio_timecode (krad_container->krad_ebml, track, buffer, buffer_size, frames, timecode);
+	}
+
+}
+
 
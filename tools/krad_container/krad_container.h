@@ -1,6 +1,10 @@
 #include "krad_ebml.h"
 #include "krad_ogg.h"
 #include "krad_codec_header.h"
+#include "krad_prefetch.h"
+
+#ifndef KRAD_CONTAINER_H
+#define KRAD_CONTAINER_H
 
 typedef enum {
 	EBML = 100,
@@ -16,6 +20,8 @@ struct krad_container_St {
 	krad_container_type_t container_type;
 	krad_ogg_t *krad_ogg;
 	krad_ebml_t *krad_ebml;
+	/* files being played are read ahead of the demuxer */
+	krad_prefetch_t *krad_prefetch;
 	
 };
 
@@ -30,10 +36,26 @@ int krad_container_track_changed (krad_container_t *krad_container, int track);
 
 int krad_container_read_packet (krad_container_t *krad_container, int *track, uint64_t *timecode, 
 								unsigned char *buffer);
+/* frame is left pointing into the demuxer where it can be, good until the
+   next read, ogg still copies it into buffer */
+int krad_container_read_packet_in_place (krad_container_t *krad_container, int *track, uint64_t *timecode,
+										 unsigned char *buffer, unsigned char **frame);
+/* files only, reading carries on from the last keyframe at or before timecode,
+   returns the timecode it carries on from or -1 */
+int64_t krad_container_seek (krad_container_t *krad_container, uint64_t timecode);
 krad_container_t *krad_container_open_stream (char *host, int port, char *mount, char *password);
 krad_container_t *krad_container_open_file (char *filename, krad_io_mode_t mode);
 krad_container_t *krad_container_open_transmission (krad_transmission_t *krad_transmission);
 void krad_container_destroy (krad_container_t *krad_container);
+/* bounded clusters flushed as they are written, for stream outputs */
+void krad_container_set_live (krad_container_t *krad_container, int max_cluster_ms, int max_cluster_bytes,
+							  int flush_ms);
+/* true once a stream output has lost its server */
+int krad_container_failed (krad_container_t *krad_container);
+/* playback time of a file read in ahead of the demuxer */
+int krad_container_buffered_ms (krad_container_t *krad_container);
+/* corrupt stretches of input the demuxer has skipped so far */
+uint64_t krad_container_corruptions (krad_container_t *krad_container, uint64_t *corrupt_bytes);
 
 
 int krad_container_add_video_track_with_private_data (krad_container_t *krad_container, krad_codec_t codec,
@@ -52,3 +74,11 @@ void krad_container_add_video (krad_container_t *krad_container, int track, unsi
 void krad_container_add_audio (krad_container_t *krad_container, int track, unsigned char *buffer, int buffer_size,
 							   int frames);
 
+/* timecode in ms from the start of the stream */
+void krad_container_add_video_timecode (krad_container_t *krad_container, int track, unsigned char *buffer,
+										int buffer_size, int keyframe, int64_t timecode);
+
+void krad_container_add_audio_timecode (krad_container_t *krad_container, int track, unsigned char *buffer,
+										int buffer_size, int frames, int64_t timecode);
+
+#endif
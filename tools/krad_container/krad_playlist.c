@@ -0,0 +1,276 @@
+#include "krad_playlist.h"
+
+/* the item that comes after item, or -1 at the end of the list */
+
+static int krad_playlist_after (krad_playlist_t *krad_playlist, int item) {
+
+	item++;
+
+	if (item == krad_playlist->item_count) {
+		if (!krad_playlist->loop) {
+			return -1;
+		}
+		item = 0;
+	}
+
+	return item;
+
+}
+
+/* called with lock held */
+
+static void krad_playlist_failed (krad_playlist_t *krad_playlist) {
+
+	krad_playlist->failures++;
+
+	if (krad_playlist->failures >= krad_playlist->item_count) {
+		printke ("Krad Playlist: nothing left that can be played");
+		krad_playlist->next_item = -1;
+		if (krad_playlist->next != NULL) {
+			krad_container_destroy (krad_playlist->next);
+			krad_playlist->next = NULL;
+		}
+		pthread_cond_broadcast (&krad_playlist->cond);
+	}
+
+}
+
+static void *krad_playlist_thread (void *arg) {
+
+	krad_playlist_t *krad_playlist = (krad_playlist_t *)arg;
+
+	krad_container_t *krad_container;
+	int item;
+
+	prctl (PR_SET_NAME, (unsigned long) "krad_playlist", 0, 0, 0);
+
+	pthread_mutex_lock (&krad_playlist->lock);
+
+	while (krad_playlist->run) {
+
+		if ((krad_playlist->next != NULL) || (krad_playlist->next_item < 0)) {
+			pthread_cond_wait (&krad_playlist->cond, &krad_playlist->lock);
+			continue;
+		}
+
+		item = krad_playlist->next_item;
+
+		/* opening maps the file, parses its headers and starts reading it
+		   in, all without holding up whoever is asking for the current one */
+		pthread_mutex_unlock (&krad_playlist->lock);
+
+		krad_container = NULL;
+
+		if (access (krad_playlist->items[item], R_OK) == 0) {
+			krad_container = krad_container_open_file (krad_playlist->items[item], KRAD_IO_READONLY);
+		} else {
+			printke ("Krad Playlist: can't read %s, skipping it", krad_playlist->items[item]);
+		}
+
+		pthread_mutex_lock (&krad_playlist->lock);
+
+		if (krad_playlist->next_item != item) {
+			/* given up on while it was being opened */
+			if (krad_container != NULL) {
+				krad_container_destroy (krad_container);
+			}
+		} else if (krad_container != NULL) {
+			krad_playlist->next = krad_container;
+		} else {
+			krad_playlist_failed (krad_playlist);
+			if (krad_playlist->next_item >= 0) {
+				krad_playlist->next_item = krad_playlist_after (krad_playlist, item);
+			}
+		}
+
+		pthread_cond_broadcast (&krad_playlist->cond);
+	}
+
+	pthread_mutex_unlock (&krad_playlist->lock);
+
+	return NULL;
+
+}
+
+krad_container_t *krad_playlist_next (krad_playlist_t *krad_playlist) {
+
+	krad_container_t *krad_container;
+
+	pthread_mutex_lock (&krad_playlist->lock);
+
+	while ((krad_playlist->next == NULL) && (krad_playlist->next_item >= 0)) {
+		pthread_cond_wait (&krad_playlist->cond, &krad_playlist->lock);
+	}
+
+	krad_container = krad_playlist->next;
+
+	if (krad_container != NULL) {
+		krad_playlist->current = krad_playlist->next_item;
+		krad_playlist->next = NULL;
+		krad_playlist->next_item = krad_playlist_after (krad_playlist, krad_playlist->current);
+		pthread_cond_broadcast (&krad_playlist->cond);
+	}
+
+	pthread_mutex_unlock (&krad_playlist->lock);
+
+	return krad_container;
+
+}
+
+void krad_playlist_item_done (krad_playlist_t *krad_playlist, int played) {
+
+	pthread_mutex_lock (&krad_playlist->lock);
+
+	if (played) {
+		krad_playlist->failures = 0;
+	} else {
+		printke ("Krad Playlist: nothing could be played from %s", krad_playlist_current (krad_playlist));
+		krad_playlist_failed (krad_playlist);
+	}
+
+	pthread_mutex_unlock (&krad_playlist->lock);
+
+}
+
+char *krad_playlist_current (krad_playlist_t *krad_playlist) {
+
+	if (krad_playlist->current < 0) {
+		return "";
+	}
+
+	return krad_playlist->items[krad_playlist->current];
+
+}
+
+int krad_playlist_is_playlist (char *filename) {
+
+	char *extension;
+
+	extension = strrchr (filename, '.');
+
+	if (extension == NULL) {
+		return 0;
+	}
+
+	return ((strcasecmp (extension, ".m3u") == 0) || (strcasecmp (extension, ".m3u8") == 0));
+
+}
+
+static void krad_playlist_add_item (krad_playlist_t *krad_playlist, char *directory, char *path) {
+
+	int len;
+	char *item;
+
+	if ((path[0] == '/') || (directory[0] == '\0')) {
+		item = strdup (path);
+	} else {
+		len = strlen (directory) + 1 + strlen (path) + 1;
+		item = malloc (len);
+		snprintf (item, len, "%s/%s", directory, path);
+	}
+
+	if ((krad_playlist->item_count % 64) == 0) {
+		krad_playlist->items = realloc (krad_playlist->items, (krad_playlist->item_count + 64) * sizeof(char *));
+	}
+
+	krad_playlist->items[krad_playlist->item_count++] = item;
+
+}
+
+void krad_playlist_destroy (krad_playlist_t *krad_playlist) {
+
+	int i;
+
+	pthread_mutex_lock (&krad_playlist->lock);
+	krad_playlist->run = 0;
+	pthread_cond_broadcast (&krad_playlist->cond);
+	pthread_mutex_unlock (&krad_playlist->lock);
+
+	pthread_join (krad_playlist->thread, NULL);
+
+	if (krad_playlist->next != NULL) {
+		krad_container_destroy (krad_playlist->next);
+	}
+
+	pthread_cond_destroy (&krad_playlist->cond);
+	pthread_mutex_destroy (&krad_playlist->lock);
+
+	for (i = 0; i < krad_playlist->item_count; i++) {
+		free (krad_playlist->items[i]);
+	}
+	free (krad_playlist->items);
+	free (krad_playlist);
+
+}
+
+krad_playlist_t *krad_playlist_open (char *filename, int loop) {
+
+	krad_playlist_t *krad_playlist;
+	FILE *fp;
+	char line[KRAD_PLAYLIST_MAX_LINE];
+	char directory[KRAD_PLAYLIST_MAX_LINE];
+	char *path;
+	char *slash;
+	int len;
+
+	fp = fopen (filename, "r");
+
+	if (fp == NULL) {
+		printke ("Krad Playlist: could not open %s", filename);
+		return NULL;
+	}
+
+	krad_playlist = calloc (1, sizeof(krad_playlist_t));
+
+	snprintf (directory, sizeof(directory), "%s", filename);
+	slash = strrchr (directory, '/');
+	if (slash != NULL) {
+		*slash = '\0';
+	} else {
+		directory[0] = '\0';
+	}
+
+	while (fgets (line, sizeof(line), fp) != NULL) {
+
+		len = strlen (line);
+		while ((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r') ||
+							 (line[len - 1] == ' ') || (line[len - 1] == '\t'))) {
+			line[--len] = '\0';
+		}
+
+		path = line;
+		while ((*path == ' ') || (*path == '\t')) {
+			path++;
+		}
+
+		if ((path[0] == '\0') || (path[0] == '#')) {
+			continue;
+		}
+
+		krad_playlist_add_item (krad_playlist, directory, path);
+	}
+
+	fclose (fp);
+
+	if (krad_playlist->item_count == 0) {
+		printke ("Krad Playlist: nothing to play in %s", filename);
+		free (krad_playlist->items);
+		free (krad_playlist);
+		return NULL;
+	}
+
+	printk ("Krad Playlist: %s has %d items", filename, krad_playlist->item_count);
+
+	krad_playlist->loop = loop;
+	krad_playlist->current = -1;
+	krad_playlist->next_item = 0;
+	krad_playlist->run = 1;
+
+	pthread_mutex_init (&krad_playlist->lock, NULL);
+	pthread_cond_init (&krad_playlist->cond, NULL);
+
+	pthread_create (&krad_playlist->thread, NULL, krad_playlist_thread, (void *)krad_playlist);
+
+	return krad_playlist;
+
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+
+#include "krad_system.h"
+#include "krad_container.h"
+
+#ifndef KRAD_PLAYLIST_H
+#define KRAD_PLAYLIST_H
+
+#define KRAD_PLAYLIST_MAX_LINE 2048
+
+typedef struct krad_playlist_St krad_playlist_t;
+
+/* An m3u style list of files, one path per line, # lines are comments and
+   relative paths are from where the list is. While one item plays the
+   next one is opened on its own thread, its headers parsed and its start
+   read in, so moving on to it costs the demuxer nothing. */
+
+struct krad_playlist_St {
+
+	char **items;
+	int item_count;
+	int loop;
+
+	/* the item being played, and the one opened for after it */
+	int current;
+	int next_item;
+	krad_container_t *next;
+	/* items in a row that could not be opened or played nothing, once
+	   that is the whole list it is given up on */
+	int failures;
+
+	int run;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+};
+
+/* by the file extension, .m3u or .m3u8 */
+int krad_playlist_is_playlist (char *filename);
+/* NULL if there is nothing in it to play, a looping list starts over at the end */
+krad_playlist_t *krad_playlist_open (char *filename, int loop);
+void krad_playlist_destroy (krad_playlist_t *krad_playlist);
+/* the next item opened and ready to read, NULL once the list is done,
+   it belongs to the caller from then on */
+krad_container_t *krad_playlist_next (krad_playlist_t *krad_playlist);
+/* once the item krad_playlist_next gave out is finished with, whether
+   anything at all could be read from it */
+void krad_playlist_item_done (krad_playlist_t *krad_playlist, int played);
+/* path of the item krad_playlist_next last gave out */
+char *krad_playlist_current (krad_playlist_t *krad_playlist);
+
+#endif
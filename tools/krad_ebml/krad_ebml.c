@@ -234,7 +234,8 @@ void krad_ebml_finish_element (krad_ebml_t *krad_ebml, uint64_t element_position
 	current_position = krad_ebml_tell(krad_ebml);
 	element_data_size = current_position - element_position - EBML_DATA_SIZE_UNKNOWN_LENGTH;
 	
-	if ((current_position - element_position) <= krad_ebml->io_adapter.write_buffer_pos) {
+	/* Once the start has been written out the element stays unknown size */
+	if (element_position >= krad_ebml->io_adapter.write_buffer_base) {
 
 		krad_ebml_seek(krad_ebml, element_position, SEEK_SET);
 		krad_ebml_write_data_size_update (krad_ebml, element_data_size);
@@ -243,6 +244,17 @@ void krad_ebml_finish_element (krad_ebml_t *krad_ebml, uint64_t element_position
 	}
 }
 
+/* size is the whole element, from 2 to 128 bytes */
+
+static void krad_ebml_write_void (krad_ebml_t *krad_ebml, int size) {
+
+	char zeros[KRAD_EBML_SEEKHEAD_RESERVE];
+
+	memset (zeros, 0, sizeof(zeros));
+	krad_ebml_write_data (krad_ebml, EBML_ID_VOID, zeros, size - 2);
+
+}
+
 void krad_ebml_header_advanced (krad_ebml_t *krad_ebml, char *doctype, int doctype_version, int doctype_read_version) {
     
     
@@ -284,10 +296,91 @@ void krad_ebml_header (krad_ebml_t *krad_ebml, char *doctype, char *appversion)
 
 }
 
+static void krad_ebml_index_filename (char *filename, char *index_filename, int size) {
+	snprintf (index_filename, size, "%s%s", filename, KRAD_EBML_INDEX_SUFFIX);
+}
+
+static void krad_ebml_write_cues (krad_ebml_t *krad_ebml) {
+
+	int c;
+	uint64_t cues;
+	uint64_t cue_point;
+	uint64_t cue_track_positions;
+
+	if (krad_ebml->cue_count == 0) {
+		return;
+	}
+
+	krad_ebml->cues_position = krad_ebml_tell (krad_ebml);
+
+	krad_ebml_start_element (krad_ebml, EBML_ID_CUES, &cues);
+
+	for (c = 0; c < krad_ebml->cue_count; c++) {
+		krad_ebml_start_element (krad_ebml, EBML_ID_CUEPOINT, &cue_point);
+		krad_ebml_write_int64 (krad_ebml, EBML_ID_CUETIME, krad_ebml->cues[c].timecode);
+		krad_ebml_start_element (krad_ebml, EBML_ID_CUETRACKPOSITIONS, &cue_track_positions);
+		krad_ebml_write_int8 (krad_ebml, EBML_ID_CUETRACK, krad_ebml->cues[c].track);
+		krad_ebml_write_int64 (krad_ebml, EBML_ID_CUECLUSTERPOSITION, krad_ebml->cues[c].position);
+		krad_ebml_finish_element (krad_ebml, cue_track_positions);
+		krad_ebml_finish_element (krad_ebml, cue_point);
+	}
+
+	krad_ebml_finish_element (krad_ebml, cues);
+	krad_ebml_write_sync (krad_ebml);
+
+}
+
+static void krad_ebml_write_seek (krad_ebml_t *krad_ebml, uint32_t element, uint64_t position) {
+
+	uint64_t seek;
+	unsigned char seek_id[4];
+
+	seek_id[0] = (element >> 24) & 0xff;
+	seek_id[1] = (element >> 16) & 0xff;
+	seek_id[2] = (element >> 8) & 0xff;
+	seek_id[3] = element & 0xff;
+
+	krad_ebml_start_element (krad_ebml, EBML_ID_SEEK, &seek);
+	krad_ebml_write_data (krad_ebml, EBML_ID_SEEKID, seek_id, 4);
+	krad_ebml_write_int64 (krad_ebml, EBML_ID_SEEKPOSITION,
+						   position - (krad_ebml->segment + EBML_DATA_SIZE_UNKNOWN_LENGTH));
+	krad_ebml_finish_element (krad_ebml, seek);
+
+}
+
+/* Goes over the void left at the start of the segment, so it does not
+   count towards the segment size */
+
+static void krad_ebml_write_seekhead (krad_ebml_t *krad_ebml) {
+
+	uint64_t seekhead;
+	uint64_t start;
+
+	if (krad_ebml->seekhead_position == 0) {
+		return;
+	}
+
+	krad_ebml_fileio_seek (&krad_ebml->io_adapter, krad_ebml->seekhead_position, SEEK_SET);
+
+	start = krad_ebml_tell (krad_ebml);
+	krad_ebml_start_element (krad_ebml, EBML_ID_SEEKHEAD, &seekhead);
+	krad_ebml_write_seek (krad_ebml, EBML_ID_SEGMENT_INFO, krad_ebml->info_position);
+	krad_ebml_write_seek (krad_ebml, EBML_ID_SEGMENT_TRACKS, krad_ebml->tracks_position);
+	if (krad_ebml->cues_position != 0) {
+		krad_ebml_write_seek (krad_ebml, EBML_ID_CUES, krad_ebml->cues_position);
+	}
+	krad_ebml_finish_element (krad_ebml, seekhead);
+	krad_ebml_write_void (krad_ebml, KRAD_EBML_SEEKHEAD_RESERVE - (krad_ebml_tell (krad_ebml) - start));
+	krad_ebml_write_sync (krad_ebml);
+
+}
+
 void krad_ebml_finish_file_segment (krad_ebml_t *krad_ebml) {
 
 	if (krad_ebml->segment != 0) {
 		krad_ebml_write_sync (krad_ebml);
+		/* from the positions, the running segment_size counts the size field too */
+		krad_ebml->segment_size = krad_ebml_tell (krad_ebml) - (krad_ebml->segment + EBML_DATA_SIZE_UNKNOWN_LENGTH);
 		krad_ebml_fileio_seek (&krad_ebml->io_adapter, krad_ebml->segment, SEEK_SET);
 		//printk ("data size is %zu pos is %zu", krad_ebml->segment_size, krad_ebml->segment);
 		//krad_ebml_write_data_size (krad_ebml, krad_ebml->segment_size);
@@ -295,12 +388,14 @@ void krad_ebml_finish_file_segment (krad_ebml_t *krad_ebml) {
 		//krad_ebml_write_data_size_update (krad_ebml, EBML_DATA_SIZE_UNKNOWN);
 		krad_ebml_write_sync (krad_ebml);
 
-		if (1) {
-			krad_ebml_fileio_seek (&krad_ebml->io_adapter, krad_ebml->segment + 20, SEEK_SET);
+		if (krad_ebml->duration_position != 0) {
+			krad_ebml_fileio_seek (&krad_ebml->io_adapter, krad_ebml->duration_position, SEEK_SET);
 			krad_ebml_write_float (krad_ebml, EBML_ID_DURATION, krad_ebml->segment_duration);
 			krad_ebml_write_sync (krad_ebml);
 		}
 
+		krad_ebml_write_seekhead (krad_ebml);
+
 		krad_ebml->segment_size = 0;
 		krad_ebml->segment = 0;
 	}
@@ -329,12 +424,16 @@ void krad_ebml_start_segment(krad_ebml_t *krad_ebml, char *appversion) {
 	if ((krad_ebml->io_adapter.mode == KRAD_EBML_IO_WRITEONLY) &&
 		(krad_ebml->io_adapter.write == krad_ebml_fileio_write)) {
 		krad_ebml_start_file_segment (krad_ebml);
+		krad_ebml->seekhead_position = krad_ebml_tell (krad_ebml);
+		krad_ebml_write_void (krad_ebml, KRAD_EBML_SEEKHEAD_RESERVE);
 	} else {
 		krad_ebml_start_element (krad_ebml, EBML_ID_SEGMENT, &krad_ebml->segment);
 	}
+	krad_ebml->info_position = krad_ebml_tell (krad_ebml);
 	krad_ebml_start_element (krad_ebml, EBML_ID_SEGMENT_INFO, &segment_info);
 	if ((krad_ebml->io_adapter.mode == KRAD_EBML_IO_WRITEONLY) &&
 		(krad_ebml->io_adapter.write == krad_ebml_fileio_write)) {
+		krad_ebml->duration_position = krad_ebml_tell (krad_ebml);
 		krad_ebml_write_data (krad_ebml, EBML_ID_VOID, "000000000", 5);
 	}
 	krad_ebml_write_string (krad_ebml, EBML_ID_SEGMENT_TITLE, "A Krad Production");
@@ -343,8 +442,16 @@ void krad_ebml_start_segment(krad_ebml_t *krad_ebml, char *appversion) {
 	krad_ebml_write_string (krad_ebml, EBML_ID_WRITINGAPP, appversion);
 	krad_ebml_finish_element (krad_ebml, segment_info);
 
+	krad_ebml->tracks_position = krad_ebml_tell (krad_ebml);
 	krad_ebml_start_element (krad_ebml, EBML_ID_SEGMENT_TRACKS, &krad_ebml->tracks_info);
 
+	if (krad_ebml->index != NULL) {
+		fprintf (krad_ebml->index, "krad_ebml_index 1 %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64" %"PRIu64"\n",
+				 krad_ebml->segment, krad_ebml->seekhead_position, krad_ebml->info_position,
+				 krad_ebml->tracks_position, krad_ebml->duration_position);
+		fflush (krad_ebml->index);
+	}
+
 }
 
 void krad_ebml_write_tag (krad_ebml_t *krad_ebml, char *name, char *value) {
@@ -474,13 +581,115 @@ int krad_ebml_add_audio_track(krad_ebml_t *krad_ebml, krad_codec_t codec, int sa
 
 }
 
+void krad_ebml_set_live (krad_ebml_t *krad_ebml, int max_cluster_ms, int max_cluster_bytes, int flush_ms) {
+
+	krad_ebml->live_max_cluster_ms = max_cluster_ms;
+	krad_ebml->live_max_cluster_bytes = max_cluster_bytes;
+	krad_ebml->live_flush_ms = flush_ms;
+	krad_ebml->live = 1;
+
+}
+
+/* A cluster has to end before block timecodes overflow,
+   live ones also end on time and size */
+
+static int krad_ebml_cluster_full (krad_ebml_t *krad_ebml, int64_t timecode) {
+
+	if (krad_ebml->cluster == 0) {
+		return 1;
+	}
+
+	if (timecode - (int64_t)krad_ebml->cluster_timecode > KRAD_EBML_MAX_BLOCK_TIMECODE) {
+		return 1;
+	}
+
+	if (krad_ebml->live) {
+		if (timecode - (int64_t)krad_ebml->cluster_timecode >= krad_ebml->live_max_cluster_ms) {
+			return 1;
+		}
+		if (krad_ebml_tell (krad_ebml) - krad_ebml->cluster >= krad_ebml->live_max_cluster_bytes) {
+			return 1;
+		}
+	}
+
+	return 0;
+
+}
+
+static void krad_ebml_live_flush (krad_ebml_t *krad_ebml, int64_t timecode) {
+
+	if ((krad_ebml->live) &&
+		((krad_ebml->live_flush_ms == 0) ||
+		 (timecode - krad_ebml->live_flushed_timecode >= krad_ebml->live_flush_ms))) {
+
+		krad_ebml_write_sync (krad_ebml);
+		krad_ebml->live_flushed_timecode = timecode;
+	}
+
+}
+
+/* The sidecar index gets the cues in batches, so a crash loses at most
+   an interval of them and repair walks the clusters from there */
+
+static void krad_ebml_write_index (krad_ebml_t *krad_ebml) {
+
+	int c;
+
+	for (c = krad_ebml->cues_indexed; c < krad_ebml->cue_count; c++) {
+		fprintf (krad_ebml->index, "%"PRIu64" %"PRIu64" %d\n", krad_ebml->cues[c].timecode,
+				 krad_ebml->cues[c].position, krad_ebml->cues[c].track);
+	}
+
+	fflush (krad_ebml->index);
+	krad_ebml->cues_indexed = krad_ebml->cue_count;
+
+}
+
+static void krad_ebml_add_cue (krad_ebml_t *krad_ebml, int track_num) {
+
+	krad_ebml_cue_t *cue;
+
+	if (krad_ebml->cues == NULL) {
+		return;
+	}
+
+	if (krad_ebml->cue_count == krad_ebml->cue_space) {
+		krad_ebml->cue_space *= 2;
+		krad_ebml->cues = realloc (krad_ebml->cues, krad_ebml->cue_space * sizeof(krad_ebml_cue_t));
+	}
+
+	/* krad_ebml->cluster is just past the 4 byte cluster id */
+	cue = &krad_ebml->cues[krad_ebml->cue_count];
+	cue->timecode = krad_ebml->cluster_timecode;
+	cue->position = (krad_ebml->cluster - 4) - (krad_ebml->segment + EBML_DATA_SIZE_UNKNOWN_LENGTH);
+	cue->track = track_num;
+	krad_ebml->cue_count++;
+
+	if ((krad_ebml->index != NULL) &&
+		((int64_t)cue->timecode - krad_ebml->index_timecode >= KRAD_EBML_INDEX_INTERVAL_MS)) {
+		krad_ebml_write_index (krad_ebml);
+		krad_ebml->index_timecode = cue->timecode;
+	}
+
+}
+
 void krad_ebml_add_video(krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len, int keyframe) {
 
+	int64_t timecode;
+
+	timecode = round (1000000000 * krad_ebml->total_video_frames / krad_ebml->fps_numerator * krad_ebml->fps_denominator / 1000000);
+
+	krad_ebml_add_video_timecode (krad_ebml, track_num, buffer, buffer_len, keyframe, timecode);
+
+}
+
+void krad_ebml_add_video_timecode (krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len,
+								   int keyframe, int64_t timecode) {
+
     uint32_t block_length;
     unsigned char track_number;
-    unsigned short block_timecode;
+    short block_timecode;
     unsigned char flags;
-	int64_t timecode;
 
 	flags = 0;
 	block_timecode = 0;
@@ -494,12 +703,13 @@ void krad_ebml_add_video(krad_ebml_t *krad_ebml, int track_num, unsigned char *b
 		flags |= 0x80;
 	}
 	
-	timecode = round (1000000000 * krad_ebml->total_video_frames / krad_ebml->fps_numerator * krad_ebml->fps_denominator / 1000000);
-
 	krad_ebml->total_video_frames++;
 		
-	if (keyframe) {
+	if ((keyframe) || (krad_ebml_cluster_full (krad_ebml, timecode))) {
 		krad_ebml_cluster (krad_ebml, timecode);
+		if (keyframe) {
+			krad_ebml_add_cue (krad_ebml, track_num);
+		}
 	}
 	
 	/* Must be after clustering esp. in case of keyframe */ 
@@ -520,13 +730,23 @@ void krad_ebml_add_video(krad_ebml_t *krad_ebml, int track_num, unsigned char *b
 	krad_ebml_write (krad_ebml, &flags, 1);
 	krad_ebml_write (krad_ebml, buffer, buffer_len);
 	
-	//krad_ebml_write_sync (krad_ebml);	
+	krad_ebml_live_flush (krad_ebml, timecode);
 	
 }
 
 void krad_ebml_add_audio(krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len, int frames) {
 
 	int64_t timecode;
+
+	timecode = round ((1000000000 * krad_ebml->total_audio_frames / krad_ebml->audio_sample_rate / 1000000));
+
+	krad_ebml_add_audio_timecode (krad_ebml, track_num, buffer, buffer_len, frames, timecode);
+
+}
+
+void krad_ebml_add_audio_timecode (krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len,
+								   int frames, int64_t timecode) {
+
 	unsigned long  block_length;
     unsigned char  track_number;
 	short block_timecode;
@@ -542,18 +762,17 @@ void krad_ebml_add_audio(krad_ebml_t *krad_ebml, int track_num, unsigned char *b
     track_number = track_num;
     track_number |= 0x80;
 
-	timecode = round ((1000000000 * krad_ebml->total_audio_frames / krad_ebml->audio_sample_rate / 1000000));
-	
 	krad_ebml->total_audio_frames += frames;
 	krad_ebml->audio_frames_since_cluster += frames;
 
-	if ((timecode == 0) && (krad_ebml->track_count == 1)) {
-			krad_ebml_cluster(krad_ebml, timecode);
-	}
-
-	if ((krad_ebml->audio_frames_since_cluster >= krad_ebml->audio_sample_rate) && (krad_ebml->track_count == 1)) {
+	/* audio only gets a cluster a second, live ones go by the live limits */
+	if ((krad_ebml_cluster_full (krad_ebml, timecode)) ||
+		((krad_ebml->track_count == 1) && (!krad_ebml->live) &&
+		 (krad_ebml->audio_frames_since_cluster >= krad_ebml->audio_sample_rate))) {
 			krad_ebml_cluster(krad_ebml, timecode);
-			krad_ebml->audio_frames_since_cluster = 0;
+			if (krad_ebml->track_count == 1) {
+				krad_ebml_add_cue (krad_ebml, track_num);
+			}
 	}
 
 	block_timecode = timecode - krad_ebml->cluster_timecode;
@@ -572,6 +791,8 @@ void krad_ebml_add_audio(krad_ebml_t *krad_ebml, int track_num, unsigned char *b
 	
 	krad_ebml_write(krad_ebml, &flags, 1);
 	krad_ebml_write(krad_ebml, buffer, buffer_len);
+	
+	krad_ebml_live_flush (krad_ebml, timecode);
 }
 
 void krad_ebml_cluster(krad_ebml_t *krad_ebml, int64_t timecode) {
@@ -583,11 +804,14 @@ void krad_ebml_cluster(krad_ebml_t *krad_ebml, int64_t timecode) {
 	}
 
 	if (krad_ebml->cluster != 0) {
-		krad_ebml_finish_element (krad_ebml, krad_ebml->cluster);
+		if (!krad_ebml->live) {
+			krad_ebml_finish_element (krad_ebml, krad_ebml->cluster);
+		}
 		krad_ebml_write_sync (krad_ebml);
 	}
 
 	krad_ebml->cluster_timecode = timecode;
+	krad_ebml->audio_frames_since_cluster = 0;
 
 	krad_ebml_start_element (krad_ebml, EBML_ID_CLUSTER, &krad_ebml->cluster);
 	krad_ebml_write_int64 (krad_ebml, EBML_ID_CLUSTER_TIMECODE, krad_ebml->cluster_timecode);
@@ -727,6 +951,221 @@ void krad_ebml_read_tags( krad_ebml_t *krad_ebml, int tags_length ) {
 	
 
 
+}
+
+/* Makes length bytes readable from the read buffer if it can, sliding
+   what is left to the front and refilling with whatever the input has.
+   Returns how many bytes are there to read. */
+
+static uint64_t krad_ebml_read_fill (krad_ebml_t *krad_ebml, uint64_t length) {
+
+	krad_ebml_io_t *io;
+	int ret;
+
+	io = &krad_ebml->io_adapter;
+
+	if ((io->read_buffer_mapped) || (io->read_buffer_len - io->read_buffer_pos >= length)) {
+		return io->read_buffer_len - io->read_buffer_pos;
+	}
+
+	if (io->read_buffer_pos > 0) {
+		memmove (io->read_buffer, io->read_buffer + io->read_buffer_pos, io->read_buffer_len - io->read_buffer_pos);
+		io->read_buffer_base += io->read_buffer_pos;
+		io->read_buffer_len -= io->read_buffer_pos;
+		io->read_buffer_pos = 0;
+	}
+
+	if (length > io->read_buffer_size) {
+		length = io->read_buffer_size;
+	}
+
+	while (io->read_buffer_len < length) {
+		ret = io->read_some (io, io->read_buffer + io->read_buffer_len, io->read_buffer_size - io->read_buffer_len);
+		if (ret <= 0) {
+			break;
+		}
+		io->read_buffer_len += ret;
+	}
+
+	return io->read_buffer_len - io->read_buffer_pos;
+
+}
+
+static void krad_ebml_read_consume (krad_ebml_t *krad_ebml, unsigned char *data, uint64_t length) {
+
+	krad_ebml->io_adapter.read_buffer_pos += length;
+
+	if (krad_ebml->read_copy == 1) {
+		memcpy (krad_ebml->read_copy_buffer + krad_ebml->read_copy_pos, data, length);
+		krad_ebml->read_copy_pos += length;
+	}
+
+}
+
+/* A cluster id with a sane size and the cluster timecode after it, or a
+   simpleblock for a track we know that ends where another element
+   starts, if that much is buffered */
+
+static int krad_ebml_sync_point (krad_ebml_t *krad_ebml, unsigned char *data, uint64_t length) {
+
+	uint32_t ebml_id;
+	uint64_t ebml_data_size;
+	uint32_t header_length;
+	uint32_t size_length;
+	unsigned char *next;
+	int tracknum;
+
+	if ((data[0] != 0x1F) && (data[0] != 0xA3)) {
+		return 0;
+	}
+
+	if ((length < 2) || (length < ebml_length (data[0]) + 1)) {
+		return 0;
+	}
+
+	size_length = ebml_length (data[ebml_length (data[0])]);
+
+	if ((size_length == 0) || (length < ebml_length (data[0]) + size_length + 1)) {
+		return 0;
+	}
+
+	header_length = krad_ebml_read_element_from_frag (data, &ebml_id, &ebml_data_size);
+
+	if (ebml_id == EBML_ID_CLUSTER) {
+		return (data[header_length] == (EBML_ID_CLUSTER_TIMECODE & 0xFF));
+	}
+
+	if ((ebml_id != EBML_ID_SIMPLEBLOCK) || (ebml_data_size < 4) || (ebml_data_size > KRAD_EBML_MAX_BLOCK_SIZE)) {
+		return 0;
+	}
+
+	tracknum = data[header_length] - 0x80;
+
+	if ((tracknum < 1) || (tracknum > krad_ebml->track_count)) {
+		return 0;
+	}
+
+	if (header_length + ebml_data_size + 4 > length) {
+		return 1;
+	}
+
+	next = data + header_length + ebml_data_size;
+
+	return ((next[0] == 0xA3) || (next[0] == 0xA0) ||
+			((next[0] == 0x1F) && (next[1] == 0x43) && (next[2] == 0xB6) && (next[3] == 0x75)) ||
+			((next[0] == 0x1C) && (next[1] == 0x53) && (next[2] == 0xBB) && (next[3] == 0x6B)) ||
+			((next[0] == 0x12) && (next[1] == 0x54) && (next[2] == 0xC3) && (next[3] == 0x67)));
+
+}
+
+/* Counts a malformed element and skips forward through the read buffer
+   to the next cluster or simpleblock so reading can carry on from there.
+   Returns 0 if the input ended first, or isn't read through the read
+   buffer so there is no scanning it. */
+
+static int krad_ebml_resync (krad_ebml_t *krad_ebml) {
+
+	krad_ebml_io_t *io;
+	uint64_t position;
+	uint64_t skipped;
+	uint64_t buffered;
+
+	io = &krad_ebml->io_adapter;
+
+	krad_ebml->corruptions++;
+	krad_ebml->read_laced_frames = 0;
+
+	if (io->read_buffer == NULL) {
+		printke ("Krad EBML: corrupt input, can't resync");
+		return 0;
+	}
+
+	position = io->read_buffer_base + io->read_buffer_pos;
+	skipped = 0;
+
+	while (1) {
+
+		if (krad_ebml_read_fill (krad_ebml, 1) == 0) {
+			break;
+		}
+
+		io->read_buffer_pos++;
+		skipped++;
+
+		buffered = krad_ebml_read_fill (krad_ebml, KRAD_EBML_RESYNC_LOOKAHEAD);
+
+		if (buffered == 0) {
+			break;
+		}
+
+		if (krad_ebml_sync_point (krad_ebml, io->read_buffer + io->read_buffer_pos, buffered)) {
+			krad_ebml->reading_cluster = 1;
+			krad_ebml->corrupt_bytes += skipped;
+			printke ("Krad EBML: corrupt input at %"PRIu64", skipped %"PRIu64" bytes to resync, %"PRIu64" corruptions so far",
+					 position, skipped, krad_ebml->corruptions);
+			return 1;
+		}
+	}
+
+	krad_ebml->corrupt_bytes += skipped;
+	printke ("Krad EBML: corrupt input at %"PRIu64", input ended %"PRIu64" bytes later without resyncing",
+			 position, skipped);
+
+	return 0;
+
+}
+
+/* Frames are left where they are in the read buffer when the caller
+   asked for that, otherwise copied into their buffer */
+
+static int krad_ebml_read_frame (krad_ebml_t *krad_ebml, unsigned char *buffer, uint64_t length) {
+
+	int ret;
+
+	if (!krad_ebml->frame_in_place) {
+		ret = krad_ebml_read (krad_ebml, buffer, length);
+		if (ret != length) {
+			printke ("Krad EBML: input ended partway through a frame");
+			return 0;
+		}
+		return ret;
+	}
+
+	krad_ebml->frame = krad_ebml_read_in_place (krad_ebml, length);
+
+	if (krad_ebml->frame != NULL) {
+		return length;
+	}
+
+	if (krad_ebml->frame_buffer_size < length) {
+		free (krad_ebml->frame_buffer);
+		krad_ebml->frame_buffer = malloc (length);
+		krad_ebml->frame_buffer_size = length;
+	}
+
+	krad_ebml->frame = krad_ebml->frame_buffer;
+
+	ret = krad_ebml_read (krad_ebml, krad_ebml->frame_buffer, length);
+	if (ret != length) {
+		printke ("Krad EBML: input ended partway through a frame");
+		return 0;
+	}
+
+	return ret;
+
+}
+
+/* Gives up on a block that doesn't add up, read_packet carries on with
+   whatever comes after resyncing */
+
+static int krad_ebml_read_corrupt_block (krad_ebml_t *krad_ebml) {
+
+	if (!krad_ebml_resync (krad_ebml)) {
+		return 0;
+	}
+
+	return KRAD_EBML_RESYNCED;
+
 }
 
 int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumber, uint64_t *timecode, unsigned char *buffer) {
@@ -740,7 +1179,8 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 	unsigned char flags;
 
 	unsigned int lacing;
-	unsigned char laced_frames;
+	unsigned int laced_frames;
+	int xiph_lace_bytes;
 	
 	unsigned int framecount;
 	int total_size_of_frames;
@@ -767,6 +1207,10 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 
 	tracknum = (byte - 0x80);	
 	*tracknumber = tracknum;
+	
+	if ((tracknum < 1) || (tracknum > krad_ebml->track_count)) {
+		return krad_ebml_read_corrupt_block (krad_ebml);
+	}
 	//printf("tracknum is %d\n", tracknum);
 	
 	krad_ebml_read ( krad_ebml, &temp, 2 );
@@ -804,14 +1248,14 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 //	krad_ebml_seek ( krad_ebml, len - 4, SEEK_CUR );
 
 	if (lacing == 0) {
-		return krad_ebml_read ( krad_ebml, buffer, len - 4 );
+		return krad_ebml_read_frame (krad_ebml, buffer, len - 4);
 	} else {
 	
-		krad_ebml_read ( krad_ebml, &laced_frames, 1 );
+		krad_ebml_read ( krad_ebml, &byte, 1 );
 		
 		block_bytes_read = 5;
 		
-		laced_frames += 1;
+		laced_frames = byte + 1;
 		
 		framecount = 0;
 		
@@ -823,6 +1267,10 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 				while (framecount != laced_frames - 1) {
 					block_bytes_read += krad_ebml_read ( krad_ebml, &byte, 1 );
 					frame_size_len = ebml_length(byte);
+					
+					if (frame_size_len == 0) {
+						return krad_ebml_read_corrupt_block (krad_ebml);
+					}
 			
 					//printf("length of frame size one is %u\n", frame_size_len);
 					
@@ -833,7 +1281,8 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 					if (frame_size_len > 1) {
 						ret = krad_ebml_read ( krad_ebml, &temp, frame_size_len - 1 );
 						if (ret != frame_size_len - 1) {
-							failfast ("Krad EBML failure reading %d", ret);
+							printke ("Krad EBML: input ended in a laced block");
+							return 0;
 						}
 						block_bytes_read += ret;
 						
@@ -888,6 +1337,10 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 					
 					//printf("frame size is %u\n", frame_size);
 					
+					if ((frame_size < 0) || (frame_size > len)) {
+						return krad_ebml_read_corrupt_block (krad_ebml);
+					}
+
 					krad_ebml->frame_sizes[framecount] = frame_size;
 					
 					total_size_of_frames += frame_size;
@@ -898,6 +1351,10 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 				
 				
 				frame_size = len - block_bytes_read - total_size_of_frames;
+				
+				if (frame_size < 0) {
+					return krad_ebml_read_corrupt_block (krad_ebml);
+				}
 				//frame_size = last_frame_size + frame_size;
 				//printf("last frame size is %u\n", frame_size);
 				
@@ -909,29 +1366,34 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 				
 				//printf("reading first ebml laced frame %u bytes\n", krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 				
-				return krad_ebml_read ( krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame] );
+				return krad_ebml_read_frame (krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 			}
 			
 			if (lacing == 2) {
 			
 			
+				xiph_lace_bytes = 0;
+			
 				while (framecount != laced_frames - 1) {
-				
-					int bytes = 0;
+					
+					if (block_bytes_read >= len) {
+						return krad_ebml_read_corrupt_block (krad_ebml);
+					}
 					
 					block_bytes_read += krad_ebml_read ( krad_ebml, &byte, 1 );
 					if (byte != 255) {
 					
-						bytes += byte;
+						xiph_lace_bytes += byte;
 						
 						
-						//printf("frame size is %d\n", bytes);
-						krad_ebml->frame_sizes[framecount] = bytes;
-						total_size_of_frames += bytes;
+						//printf("frame size is %d\n", xiph_lace_bytes);
+						krad_ebml->frame_sizes[framecount] = xiph_lace_bytes;
+						total_size_of_frames += xiph_lace_bytes;
 						framecount++;
+						xiph_lace_bytes = 0;
 					
 					} else {
-						bytes += 255;
+						xiph_lace_bytes += 255;
 					}
 				
 				
@@ -939,6 +1401,10 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 			
 			
 				frame_size = len - block_bytes_read - total_size_of_frames;
+				
+				if (frame_size < 0) {
+					return krad_ebml_read_corrupt_block (krad_ebml);
+				}
 				//frame_size = last_frame_size + frame_size;
 				//printf("last frame size is %u\n", frame_size);
 				
@@ -950,7 +1416,7 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 				
 				//printf("reading first xiph laced frame %u bytes\n", krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 				
-				return krad_ebml_read ( krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame] );
+				return krad_ebml_read_frame (krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 			
 			
 			}
@@ -972,7 +1438,7 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 				
 				//printf("reading first fixed laced frame %u bytes\n", krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 				
-				return krad_ebml_read ( krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame] );
+				return krad_ebml_read_frame (krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 			
 			
 			}
@@ -986,7 +1452,7 @@ int krad_ebml_read_simpleblock( krad_ebml_t *krad_ebml, int len , int *tracknumb
 
 uint64_t krad_ebml_read_number_from_frag (unsigned char *ebml_frag, uint64_t ebml_data_size) {
 
-	unsigned char temp[7];
+	unsigned char temp[8];
 	uint64_t number;
 	
 	number = 0;
@@ -1102,26 +1568,84 @@ int krad_ebml_read_element (krad_ebml_t *krad_ebml, uint32_t *ebml_id_ptr, uint6
 	uint32_t ebml_data_size_length;
 	unsigned char byte;
 	unsigned char temp[7];
+	unsigned char *data;
+	uint64_t buffered;
 
-	
-	if (!(ret = krad_ebml_read ( krad_ebml, &byte, 1 )) > 0) {
-		printke ("Krad EBML read failure %d", ret);
-		return 0;
-	}
-	
-	if (krad_ebml->tracks_size > 0) {
-		krad_ebml->tracks_pos += ret;
-	}
+	*ebml_id_ptr = 0;
+	*ebml_data_size_ptr = 0;
 
-	ebml_id = 0;
-	ebml_data_size = 0;
-	
+	/* id and size parsed where they sit, one refill at most, anything
+	   malformed is skipped over to the next cluster or block */
+	if (krad_ebml->io_adapter.read_buffer != NULL) {
+
+		while (1) {
+
+			buffered = krad_ebml_read_fill (krad_ebml, 12);
+			data = krad_ebml->io_adapter.read_buffer + krad_ebml->io_adapter.read_buffer_pos;
+
+			if (buffered == 0) {
+				printke ("Krad EBML read failure %d", 0);
+				return 0;
+			}
+
+			ebml_id_length = ebml_length (data[0]);
+			if ((ebml_id_length == 0) || (ebml_id_length > 4)) {
+				if (!krad_ebml_resync (krad_ebml)) {
+					return 0;
+				}
+				continue;
+			}
+
+			if (buffered <= ebml_id_length) {
+				printke ("Krad EBML: input ended partway through an element");
+				return 0;
+			}
+
+			ebml_data_size_length = ebml_length (data[ebml_id_length]);
+			if (ebml_data_size_length == 0) {
+				if (!krad_ebml_resync (krad_ebml)) {
+					return 0;
+				}
+				continue;
+			}
+
+			if (buffered < ebml_id_length + ebml_data_size_length) {
+				printke ("Krad EBML: input ended partway through an element");
+				return 0;
+			}
+
+			break;
+		}
+
+		ret = krad_ebml_read_element_from_frag (data, ebml_id_ptr, ebml_data_size_ptr);
+		krad_ebml_read_consume (krad_ebml, data, ret);
+
+		if (krad_ebml->tracks_size > 0) {
+			krad_ebml->tracks_pos += ret;
+		}
+
+		return 1;
+	}
+	
+	if (!(ret = krad_ebml_read ( krad_ebml, &byte, 1 )) > 0) {
+		printke ("Krad EBML read failure %d", ret);
+		return 0;
+	}
+	
+	if (krad_ebml->tracks_size > 0) {
+		krad_ebml->tracks_pos += ret;
+	}
+
+	ebml_id = 0;
+	ebml_data_size = 0;
+	
 	// ID length
 	ebml_id_length = ebml_length ( byte );
 
-	if (ebml_id_length > 4) {
-		failfast ("Krad EBML failure: EBML ID > 4!");
-		exit (1);
+	if ((ebml_id_length == 0) || (ebml_id_length > 4)) {
+		printke ("Krad EBML: corrupt element id length %u", ebml_id_length);
+		krad_ebml->corruptions++;
+		return 0;
 	}
 
 	//printf("id length is %u\n", ebml_id_length);
@@ -1130,6 +1654,11 @@ int krad_ebml_read_element (krad_ebml_t *krad_ebml, uint32_t *ebml_id_ptr, uint6
 	// ID
 	if (ebml_id_length > 1) {
 		ret = krad_ebml_read ( krad_ebml, &temp, ebml_id_length - 1 );
+		if (ret != ebml_id_length - 1) {
+			printke ("Krad EBML: element id cut short %d", ret);
+			krad_ebml->corruptions++;
+			return 0;
+		}
 		if (krad_ebml->tracks_size > 0) {
 			krad_ebml->tracks_pos += ret;
 		}
@@ -1139,19 +1668,29 @@ int krad_ebml_read_element (krad_ebml_t *krad_ebml, uint32_t *ebml_id_ptr, uint6
 	// data size length
 	ret = krad_ebml_read ( krad_ebml, &byte, 1 );
 	if (ret != 1) {
-		failfast ("Krad EBML failure reading data size length %d", ret);
+		printke ("Krad EBML: element data size missing %d", ret);
+		krad_ebml->corruptions++;
+		return 0;
 	}
 	if (krad_ebml->tracks_size > 0) {
 		krad_ebml->tracks_pos += ret;
 	}
 	ebml_data_size_length = ebml_length ( byte );
 	//printf("data size length is %u\n", ebml_data_size_length);
+	
+	if (ebml_data_size_length == 0) {
+		printke ("Krad EBML: corrupt element data size");
+		krad_ebml->corruptions++;
+		return 0;
+	}
 
 	// data size
 	if (ebml_data_size_length > 1) {
 		ret = krad_ebml_read ( krad_ebml, &temp, ebml_data_size_length - 1 );
 		if (ret != ebml_data_size_length - 1) {
-			failfast ("Krad EBML failure reading data %d", ret);
+			printke ("Krad EBML: element data size cut short %d", ret);
+			krad_ebml->corruptions++;
+			return 0;
 		}
 		if (krad_ebml->tracks_size > 0) {
 			krad_ebml->tracks_pos += ret;
@@ -1229,16 +1768,24 @@ uint64_t krad_ebml_read_command (krad_ebml_t *krad_ebml, unsigned char *buffer)
 uint64_t krad_ebml_read_number (krad_ebml_t *krad_ebml, uint64_t ebml_data_size) {
 
 	int ret;
-	unsigned char temp[7];
+	unsigned char temp[8];
 	uint64_t number;
 	
 	number = 0;
 	
 	memset (temp, '\0', sizeof(temp));
 
+	if (ebml_data_size > sizeof(temp)) {
+		printke ("Krad EBML: corrupt %"PRIu64" byte number", ebml_data_size);
+		krad_ebml->corruptions++;
+		return 0;
+	}
+
 	ret = krad_ebml_read ( krad_ebml, &temp, ebml_data_size );
 	if (ret != ebml_data_size) {
-		failfast ("Krad EBML failure reading a number %d %"PRIu64"", ret, ebml_data_size);
+		printke ("Krad EBML failure reading a number %d %"PRIu64"", ret, ebml_data_size);
+		krad_ebml->corruptions++;
+		return 0;
 	}
 
 	rmemcpy ( &number, &temp, ebml_data_size);
@@ -1249,16 +1796,30 @@ uint64_t krad_ebml_read_number (krad_ebml_t *krad_ebml, uint64_t ebml_data_size)
 float krad_ebml_read_float (krad_ebml_t *krad_ebml, uint64_t ebml_data_size) {
 
 	int ret;
-	unsigned char temp[7];
+	unsigned char temp[8];
 	float number;
+	double double_number;
 	
 	number = 0;
 	
 	memset (temp, '\0', sizeof(temp));
 
+	if ((ebml_data_size != 4) && (ebml_data_size != 8)) {
+		printke ("Krad EBML: corrupt %"PRIu64" byte float", ebml_data_size);
+		krad_ebml->corruptions++;
+		return 0;
+	}
+
 	ret = krad_ebml_read ( krad_ebml, &temp, ebml_data_size );
 	if (ret != ebml_data_size) {
-		failfast ("Krad EBML failure reading a float %d %"PRIu64"\n", ret, ebml_data_size);
+		printke ("Krad EBML failure reading a float %d %"PRIu64"", ret, ebml_data_size);
+		krad_ebml->corruptions++;
+		return 0;
+	}
+
+	if (ebml_data_size == 8) {
+		rmemcpy ( &double_number, &temp, ebml_data_size);
+		return double_number;
 	}
 
 	rmemcpy ( &number, &temp, ebml_data_size);
@@ -1272,13 +1833,62 @@ uint64_t krad_ebml_read_string (krad_ebml_t *krad_ebml, char *string, uint64_t e
 
 	ret = krad_ebml_read ( krad_ebml, string, ebml_data_size );
 	if (ret != ebml_data_size) {
-		failfast ("Krad EBML failure reading a string %d %"PRIu64"\n", ret, ebml_data_size);
+		printke ("Krad EBML failure reading a string %d %"PRIu64"", ret, ebml_data_size);
+		krad_ebml->corruptions++;
+		string[0] = '\0';
+		return 0;
 	}
 	string[ebml_data_size] = '\0';
 	return ebml_data_size + 1;
 
 }
 
+/* What can turn up inside a cluster: its own elements, or the start of
+   whatever comes after it. Anything else there means we lost sync. */
+
+static int krad_ebml_cluster_id (uint32_t ebml_id) {
+
+	switch (ebml_id) {
+		case EBML_ID_CLUSTER_TIMECODE:
+		case EBML_ID_SIMPLEBLOCK:
+		case EBML_ID_BLOCKGROUP:
+		case EBML_ID_CLUSTER_POSITION:
+		case EBML_ID_CLUSTER_PREVSIZE:
+		case EBML_ID_VOID:
+		case EBML_ID_CRC32:
+		case EBML_ID_CLUSTER:
+		case EBML_ID_CUES:
+		case EBML_ID_TAGS:
+		case EBML_ID_SEEKHEAD:
+		case EBML_ID_SEGMENT_INFO:
+		case EBML_ID_SEGMENT_TRACKS:
+		case EBML_ID_CHAPTERS:
+		case EBML_ID_ATTACHMENTS:
+		case EBML_ID_HEADER:
+		case EBML_ID_SEGMENT:
+			return 1;
+	}
+
+	return 0;
+
+}
+
+int krad_ebml_read_packet_in_place (krad_ebml_t *krad_ebml, int *track, uint64_t *timecode, unsigned char **frame) {
+
+	int ret;
+
+	krad_ebml->frame_in_place = 1;
+	krad_ebml->frame = NULL;
+
+	ret = krad_ebml_read_packet (krad_ebml, track, timecode, NULL);
+
+	krad_ebml->frame_in_place = 0;
+	*frame = krad_ebml->frame;
+
+	return ret;
+
+}
+
 int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecode, unsigned char *buffer) {
 
 	int ret;
@@ -1288,14 +1898,14 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 	//uint32_t ebml_data_size_length;
 	
 	//unsigned char byte;
-	unsigned char temp[7];
+	unsigned char temp[8];
 
 	int skip;
 	
 	char string[512];
 	memset(string, '\0', sizeof(string));
 	
-	int number;
+	uint64_t number;
 	int known;
 
 	known = 0;
@@ -1320,7 +1930,7 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			krad_ebml->current_laced_frame += 1;
 			krad_ebml->read_laced_frames -= 1;
 			//printf ("reading %d laced frame %"PRIu64" bytes\n", krad_ebml->current_laced_frame, krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
-			return krad_ebml_read ( krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame] );
+			return krad_ebml_read_frame (krad_ebml, buffer, krad_ebml->frame_sizes[krad_ebml->current_laced_frame]);
 		}
 	
 	
@@ -1332,6 +1942,18 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 
 		//printf("data size is %" PRIu64 "\n", ebml_data_size);
 
+		if ((krad_ebml->reading_cluster) && (!krad_ebml_cluster_id (ebml_id))) {
+			if (!krad_ebml_resync (krad_ebml)) {
+				return 0;
+			}
+			continue;
+		}
+
+		/* four byte ids are top level */
+		if (ebml_id > 0xFFFFFF) {
+			krad_ebml->reading_cluster = (ebml_id == EBML_ID_CLUSTER);
+		}
+
 		if (ebml_id == EBML_ID_HEADER) {
 			krad_ebml->ebml_level = 0;
 			skip = 0;
@@ -1340,6 +1962,7 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 		if (ebml_id == EBML_ID_SEGMENT) {
 			krad_ebml->ebml_level = 0;
 			skip = 0;
+			krad_ebml->segment_data_position = krad_ebml_tell (krad_ebml);
 		}
 
 		if (ebml_id == EBML_ID_CLUSTER) {
@@ -1376,6 +1999,12 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 		}
 
 		if (ebml_id == EBML_ID_TRACK) {
+			if (krad_ebml->track_count + 2 >= KRAD_EBML_MAX_TRACKS) {
+				if (!krad_ebml_resync (krad_ebml)) {
+					return 0;
+				}
+				continue;
+			}
 			krad_ebml->ebml_level = 2;
 			skip = 0;
 			krad_ebml->track_count++;
@@ -1393,7 +2022,8 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			if (ebml_data_size < sizeof(krad_ebml->tags)) {
 				ret = krad_ebml_read ( krad_ebml, krad_ebml->tags, ebml_data_size );
 				if (ret != ebml_data_size) {
-					failfast ("Krad EBML failure reading a tag name %d", ret);
+					printke ("Krad EBML: input ended in a tag name %d", ret);
+					return 0;
 				}
 				krad_ebml->tags[ret] = '\0';
 				strcat(krad_ebml->tags, ": ");
@@ -1407,7 +2037,8 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			if (ebml_data_size < sizeof(krad_ebml->tags) + krad_ebml->tags_position) {
 				ret = krad_ebml_read ( krad_ebml, krad_ebml->tags + krad_ebml->tags_position, ebml_data_size );
 				if (ret != ebml_data_size) {
-					failfast ("Krad EBML failure reading a tag string %d", ret);
+					printke ("Krad EBML: input ended in a tag string %d", ret);
+					return 0;
 				}
 				krad_ebml->tags[ret + krad_ebml->tags_position] = '\0';
 				//printf("Got Tag! %s\n", krad_ebml->tags);
@@ -1419,12 +2050,17 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 		if (ebml_id == EBML_ID_SIMPLEBLOCK) {
 			krad_ebml->ebml_level = 2;
 			krad_ebml->block_count++;
-			if (1) {
-				skip = 0;
-				return krad_ebml_read_simpleblock( krad_ebml, ebml_data_size, track, timecode, buffer );
-			} else {
-				skip = 1;
+			if ((ebml_data_size < 4) || (ebml_data_size > KRAD_EBML_MAX_BLOCK_SIZE)) {
+				if (!krad_ebml_resync (krad_ebml)) {
+					return 0;
+				}
+				continue;
 			}
+			ret = krad_ebml_read_simpleblock( krad_ebml, ebml_data_size, track, timecode, buffer );
+			if (ret != KRAD_EBML_RESYNCED) {
+				return ret;
+			}
+			continue;
 		}
 
 		if (ebml_id == EBML_ID_VIDEOSETTINGS) {
@@ -1442,7 +2078,8 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			&& (ebml_data_size < sizeof(string))) {
 			ret = krad_ebml_read ( krad_ebml, &string, ebml_data_size );
 			if (ret != ebml_data_size) {
-				failfast ("Krad EBML failure reading ... %d", ret);
+				printke ("Krad EBML: input ended in a string %d", ret);
+				return 0;
 			}
 			if (krad_ebml->tracks_size > 0) {
 				krad_ebml->tracks_pos += ret;
@@ -1494,6 +2131,13 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 		}
 		
 		
+		if ((ebml_id == EBML_ID_CODECDATA) && (ebml_data_size > KRAD_EBML_MAX_BLOCK_SIZE)) {
+			if (!krad_ebml_resync (krad_ebml)) {
+				return 0;
+			}
+			continue;
+		}
+		
 		if (ebml_id == EBML_ID_CODECDATA) {
 		
 			krad_ebml->tracks[krad_ebml->current_track].codec_data = calloc(1, ebml_data_size);
@@ -1502,9 +2146,8 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			
 			ret = krad_ebml_read ( krad_ebml, krad_ebml->tracks[krad_ebml->current_track].codec_data, ebml_data_size );
 			if (ret != ebml_data_size) {
-				failfast ("Krad EBML failure reading codec data %d", ret);
-			} else {
-				//printf("read %d\n", ret);
+				printke ("Krad EBML: input ended in codec data %d", ret);
+				return 0;
 			}
 			if (krad_ebml->tracks_size > 0) {
 				krad_ebml->tracks_pos += ret;
@@ -1562,9 +2205,16 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 		if ((ebml_id == EBML_ID_VIDEOWIDTH) || (ebml_id == EBML_ID_VIDEOHEIGHT) ||
 			(ebml_id == EBML_ID_AUDIOCHANNELS) || (ebml_id == EBML_ID_TRACKNUMBER) || (ebml_id == EBML_ID_DEFAULTDURATION) ||
 			(ebml_id == EBML_ID_AUDIOBITDEPTH) || (ebml_id == EBML_ID_3D) || (ebml_id == EBML_ID_CLUSTER_TIMECODE)) {
+			if (ebml_data_size > sizeof(temp)) {
+				if (!krad_ebml_resync (krad_ebml)) {
+					return 0;
+				}
+				continue;
+			}
 			ret = krad_ebml_read ( krad_ebml, &temp, ebml_data_size );
 			if (ret != ebml_data_size) {
-				failfast ("Krad EBML failure reading trackinfo item %d", ret);
+				printke ("Krad EBML: input ended in a trackinfo item %d", ret);
+				return 0;
 			}
 			if (krad_ebml->tracks_size > 0) {
 				krad_ebml->tracks_pos += ret;
@@ -1613,9 +2263,17 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			float srate;
 			double samplerate;
 			
+			if ((ebml_data_size != 4) && (ebml_data_size != 8)) {
+				if (!krad_ebml_resync (krad_ebml)) {
+					return 0;
+				}
+				continue;
+			}
+			
 			ret = krad_ebml_read ( krad_ebml, &temp, ebml_data_size );
 			if (ret != ebml_data_size) {
-				failfast ("Krad EBML failure reading Sample Rate %d", ret);
+				printke ("Krad EBML: input ended in a sample rate %d", ret);
+				return 0;
 			}
 			if (krad_ebml->tracks_size > 0) {
 				krad_ebml->tracks_pos += ret;
@@ -1623,6 +2281,7 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			int adj = 0;
 			if (ebml_data_size == 4) {
 				rmemcpy ( &srate, &temp, ebml_data_size );
+				samplerate = srate;
 				//printf("Sample Rate %f", srate);
 			} else {
 				rmemcpy ( &samplerate, &temp, ebml_data_size - adj);
@@ -1644,8 +2303,15 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 			}
 		}
 			
+		if ((skip) && (ebml_data_size > KRAD_EBML_MAX_ELEMENT_SIZE)) {
+			if (!krad_ebml_resync (krad_ebml)) {
+				return 0;
+			}
+			continue;
+		}
+			
 		if (skip) {
-			if (krad_ebml->stream == 1) {
+			if ((krad_ebml->stream == 1) && (krad_ebml->io_adapter.read_buffer == NULL)) {
 				if (ebml_data_size != EBML_DATA_SIZE_UNKNOWN) {
 					krad_ebml_read ( krad_ebml, krad_ebml->bsbuffer, ebml_data_size);
 				}
@@ -1674,6 +2340,334 @@ int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecod
 
 }
 
+/* Seeking */
+
+static int64_t krad_ebml_input_size (krad_ebml_t *krad_ebml) {
+
+	struct stat file_stat;
+
+	if (krad_ebml->io_adapter.read_buffer_mapped) {
+		return krad_ebml->io_adapter.read_buffer_len;
+	}
+
+	if (fstat (krad_ebml->io_adapter.ptr, &file_stat) != 0) {
+		return -1;
+	}
+
+	return file_stat.st_size;
+
+}
+
+/* as written by us and everyone else, all ones in 8 bytes, sizes come
+   back from reading without their length marker */
+
+static int krad_ebml_size_unknown (uint64_t ebml_data_size) {
+	return ((ebml_data_size == EBML_DATA_SIZE_UNKNOWN) || (ebml_data_size == 0x00FFFFFFFFFFFFFFLLU));
+}
+
+static int krad_ebml_video_track (krad_ebml_t *krad_ebml) {
+
+	int t;
+
+	for (t = 1; t <= krad_ebml->track_count; t++) {
+		if ((krad_ebml->tracks[t].codec == VP8) || (krad_ebml->tracks[t].codec == THEORA) ||
+			(krad_ebml->tracks[t].codec == DIRAC)) {
+			return t;
+		}
+	}
+
+	return 0;
+
+}
+
+static void krad_ebml_read_cue (krad_ebml_t *krad_ebml, uint64_t timecode, uint64_t position, int track) {
+
+	if (krad_ebml->cue_count == krad_ebml->cue_space) {
+		if (krad_ebml->cue_space == 0) {
+			krad_ebml->cue_space = 1024;
+		} else {
+			krad_ebml->cue_space *= 2;
+		}
+		krad_ebml->cues = realloc (krad_ebml->cues, krad_ebml->cue_space * sizeof(krad_ebml_cue_t));
+	}
+
+	krad_ebml->cues[krad_ebml->cue_count].timecode = timecode;
+	krad_ebml->cues[krad_ebml->cue_count].position = position;
+	krad_ebml->cues[krad_ebml->cue_count].track = track;
+	krad_ebml->cue_count++;
+
+}
+
+/* Cuepoints are gone through flat, a cue for each cluster position
+   using the time and track seen before it */
+
+static void krad_ebml_read_cues (krad_ebml_t *krad_ebml, uint64_t end) {
+
+	uint32_t ebml_id;
+	uint64_t ebml_data_size;
+	uint64_t cue_time;
+	int cue_track;
+
+	cue_time = 0;
+	cue_track = 0;
+
+	while (krad_ebml_tell (krad_ebml) < end) {
+
+		if (!krad_ebml_read_element (krad_ebml, &ebml_id, &ebml_data_size)) {
+			break;
+		}
+
+		switch (ebml_id) {
+			case EBML_ID_CUEPOINT:
+			case EBML_ID_CUETRACKPOSITIONS:
+				break;
+			case EBML_ID_CUETIME:
+				cue_time = krad_ebml_read_number (krad_ebml, ebml_data_size);
+				break;
+			case EBML_ID_CUETRACK:
+				cue_track = krad_ebml_read_number (krad_ebml, ebml_data_size);
+				break;
+			case EBML_ID_CUECLUSTERPOSITION:
+				krad_ebml_read_cue (krad_ebml, cue_time, krad_ebml_read_number (krad_ebml, ebml_data_size), cue_track);
+				break;
+			default:
+				krad_ebml_seek (krad_ebml, ebml_data_size, SEEK_CUR);
+		}
+	}
+
+}
+
+/* Goes through what comes before the first cluster for the cues, or the
+   seekhead entry pointing at them. Returns their position or -1. */
+
+static int64_t krad_ebml_find_cues (krad_ebml_t *krad_ebml, uint64_t end) {
+
+	uint32_t ebml_id;
+	uint64_t ebml_data_size;
+	uint64_t position;
+	uint32_t seek_id;
+	unsigned char temp[4];
+	int b;
+
+	seek_id = 0;
+
+	while (krad_ebml_tell (krad_ebml) < end) {
+
+		position = krad_ebml_tell (krad_ebml);
+
+		if (!krad_ebml_read_element (krad_ebml, &ebml_id, &ebml_data_size)) {
+			break;
+		}
+
+		switch (ebml_id) {
+			case EBML_ID_CUES:
+				return position;
+			case EBML_ID_CLUSTER:
+				return -1;
+			case EBML_ID_SEEKHEAD:
+			case EBML_ID_SEEK:
+				break;
+			case EBML_ID_SEEKID:
+				seek_id = 0;
+				if ((ebml_data_size > sizeof(temp)) || (krad_ebml_read (krad_ebml, temp, ebml_data_size) != ebml_data_size)) {
+					return -1;
+				}
+				for (b = 0; b < ebml_data_size; b++) {
+					seek_id = (seek_id << 8) | temp[b];
+				}
+				break;
+			case EBML_ID_SEEKPOSITION:
+				position = krad_ebml_read_number (krad_ebml, ebml_data_size);
+				if (seek_id == EBML_ID_CUES) {
+					return krad_ebml->segment_data_position + position;
+				}
+				break;
+			default:
+				if (krad_ebml_size_unknown (ebml_data_size)) {
+					return -1;
+				}
+				krad_ebml_seek (krad_ebml, ebml_data_size, SEEK_CUR);
+		}
+	}
+
+	return -1;
+
+}
+
+/* Without cues every cluster starting with a video keyframe gets one, or
+   every cluster if there is no video. Blocks are only looked at up to the
+   first video one, clusters of unknown size are walked to their end. */
+
+static void krad_ebml_index_clusters (krad_ebml_t *krad_ebml, uint64_t end) {
+
+	uint32_t ebml_id;
+	uint64_t ebml_data_size;
+	uint64_t position;
+	int64_t cluster_position;
+	uint64_t cluster_end;
+	uint64_t cluster_timecode;
+	int cluster_checked;
+	int video_track;
+	unsigned char block[4];
+
+	video_track = krad_ebml_video_track (krad_ebml);
+	cluster_position = -1;
+	cluster_end = 0;
+	cluster_timecode = 0;
+	cluster_checked = 0;
+
+	while (krad_ebml_tell (krad_ebml) < end) {
+
+		position = krad_ebml_tell (krad_ebml);
+
+		if ((cluster_position >= 0) && (cluster_checked) && (cluster_end > position)) {
+			krad_ebml_seek (krad_ebml, cluster_end, SEEK_SET);
+			continue;
+		}
+
+		if (!krad_ebml_read_element (krad_ebml, &ebml_id, &ebml_data_size)) {
+			break;
+		}
+
+		if (ebml_id == EBML_ID_CUES) {
+			/* there were cues after all, without a seekhead */
+			krad_ebml->cue_count = 0;
+			krad_ebml_read_cues (krad_ebml, krad_ebml_tell (krad_ebml) + ebml_data_size);
+			return;
+		}
+
+		if (ebml_id == EBML_ID_CLUSTER) {
+			cluster_position = position;
+			cluster_checked = 0;
+			cluster_end = 0;
+			if (!krad_ebml_size_unknown (ebml_data_size)) {
+				cluster_end = krad_ebml_tell (krad_ebml) + ebml_data_size;
+			}
+			continue;
+		}
+
+		if (ebml_id > 0xFFFFFF) {
+			cluster_position = -1;
+		}
+
+		if ((ebml_id == EBML_ID_CLUSTER_TIMECODE) && (cluster_position >= 0)) {
+			cluster_timecode = krad_ebml_read_number (krad_ebml, ebml_data_size);
+			if (video_track == 0) {
+				krad_ebml_read_cue (krad_ebml, cluster_timecode, cluster_position - krad_ebml->segment_data_position, 1);
+				cluster_checked = 1;
+			}
+			continue;
+		}
+
+		if ((ebml_id == EBML_ID_SIMPLEBLOCK) && (cluster_position >= 0) && (!cluster_checked) && (ebml_data_size >= 4)) {
+			if (krad_ebml_read (krad_ebml, block, 4) != 4) {
+				break;
+			}
+			if (block[0] - 0x80 == video_track) {
+				if (block[3] & 0x80) {
+					krad_ebml_read_cue (krad_ebml, cluster_timecode, cluster_position - krad_ebml->segment_data_position,
+										video_track);
+				}
+				cluster_checked = 1;
+			}
+			krad_ebml_seek (krad_ebml, ebml_data_size - 4, SEEK_CUR);
+			continue;
+		}
+
+		if (!krad_ebml_size_unknown (ebml_data_size)) {
+			krad_ebml_seek (krad_ebml, ebml_data_size, SEEK_CUR);
+		}
+	}
+
+}
+
+static void krad_ebml_load_cues (krad_ebml_t *krad_ebml, uint64_t end) {
+
+	uint32_t ebml_id;
+	uint64_t ebml_data_size;
+	int64_t cues;
+
+	krad_ebml->cues_loaded = 1;
+	krad_ebml->cue_count = 0;
+
+	krad_ebml_seek (krad_ebml, krad_ebml->segment_data_position, SEEK_SET);
+	cues = krad_ebml_find_cues (krad_ebml, end);
+
+	if ((cues > 0) && (cues < end)) {
+		krad_ebml_seek (krad_ebml, cues, SEEK_SET);
+		if ((krad_ebml_read_element (krad_ebml, &ebml_id, &ebml_data_size)) && (ebml_id == EBML_ID_CUES)) {
+			krad_ebml_read_cues (krad_ebml, krad_ebml_tell (krad_ebml) + ebml_data_size);
+		}
+	}
+
+	if (krad_ebml->cue_count == 0) {
+		printk ("Krad EBML: no cues, indexing clusters");
+		krad_ebml_seek (krad_ebml, krad_ebml->segment_data_position, SEEK_SET);
+		krad_ebml_index_clusters (krad_ebml, end);
+	}
+
+	printk ("Krad EBML: %d cues to seek with", krad_ebml->cue_count);
+
+}
+
+int64_t krad_ebml_seek_timecode (krad_ebml_t *krad_ebml, uint64_t timecode) {
+
+	krad_ebml_cue_t *cue;
+	int64_t end;
+	int64_t position;
+	int low;
+	int high;
+	int mid;
+
+	if ((krad_ebml->io_adapter.mode != KRAD_EBML_IO_READONLY) || (krad_ebml->io_adapter.read_buffer == NULL) ||
+		(!krad_ebml->io_adapter.seekable) || (krad_ebml->segment_data_position == 0)) {
+		printke ("Krad EBML: can't seek this input");
+		return -1;
+	}
+
+	end = krad_ebml_input_size (krad_ebml);
+
+	if (end <= 0) {
+		return -1;
+	}
+
+	position = krad_ebml_tell (krad_ebml);
+
+	if (!krad_ebml->cues_loaded) {
+		krad_ebml_load_cues (krad_ebml, end);
+	}
+
+	if (krad_ebml->cue_count == 0) {
+		krad_ebml_seek (krad_ebml, position, SEEK_SET);
+		printke ("Krad EBML: nowhere to seek to");
+		return -1;
+	}
+
+	/* the last cue at or before timecode, or the first one */
+	low = 0;
+	high = krad_ebml->cue_count - 1;
+
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if (krad_ebml->cues[mid].timecode <= timecode) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	cue = &krad_ebml->cues[low];
+
+	krad_ebml_seek (krad_ebml, krad_ebml->segment_data_position + cue->position, SEEK_SET);
+
+	krad_ebml->read_laced_frames = 0;
+	krad_ebml->reading_cluster = 0;
+	krad_ebml->current_cluster_timecode = cue->timecode;
+
+	return cue->timecode;
+
+}
+
 void krad_ebml_print_ebml_header (struct ebml_header *ebml_head) {
 
 	printk ("EBML Header:\n");
@@ -1816,9 +2810,15 @@ int krad_ebml_read_ebml_header (krad_ebml_t *krad_ebml, struct ebml_header *ebml
 
 int krad_ebml_write(krad_ebml_t *krad_ebml, void *buffer, size_t length) {
 
-//	if ((length + krad_ebml->io_adapter.write_buffer_pos) >= KRADEBML_WRITE_BUFFER_SIZE) {
-//		krad_ebml_write_sync(krad_ebml);
-//	}
+	/* Whatever is open when the buffer fills goes out unknown size */
+	if ((length + krad_ebml->io_adapter.write_buffer_pos) > KRADEBML_WRITE_BUFFER_SIZE) {
+		krad_ebml_write_sync(krad_ebml);
+		if (length > KRADEBML_WRITE_BUFFER_SIZE) {
+			krad_ebml->segment_size += length;
+			krad_ebml->io_adapter.write_buffer_base += length;
+			return krad_ebml->io_adapter.write(&krad_ebml->io_adapter, buffer, length);
+		}
+	}
 
 	memcpy(krad_ebml->io_adapter.write_buffer + krad_ebml->io_adapter.write_buffer_pos, buffer, length);
 	krad_ebml->io_adapter.write_buffer_pos += length;
@@ -1832,6 +2832,7 @@ int krad_ebml_write_sync(krad_ebml_t *krad_ebml) {
 	
 	length = krad_ebml->io_adapter.write_buffer_pos;
 	krad_ebml->io_adapter.write_buffer_pos = 0;
+	krad_ebml->io_adapter.write_buffer_base += length;
 	krad_ebml->segment_size += length;
 	return krad_ebml->io_adapter.write(&krad_ebml->io_adapter, krad_ebml->io_adapter.write_buffer, length);
 }
@@ -1857,18 +2858,77 @@ void krad_ebml_disable_read_copy ( krad_ebml_t *krad_ebml ) {
 }	
 
 
+unsigned char *krad_ebml_read_in_place (krad_ebml_t *krad_ebml, uint64_t length) {
+
+	unsigned char *data;
+
+	if ((krad_ebml->io_adapter.read_buffer == NULL) ||
+		(krad_ebml_read_fill (krad_ebml, length) < length)) {
+		return NULL;
+	}
+
+	data = krad_ebml->io_adapter.read_buffer + krad_ebml->io_adapter.read_buffer_pos;
+	krad_ebml_read_consume (krad_ebml, data, length);
+
+	return data;
+
+}
+
 int krad_ebml_read (krad_ebml_t *krad_ebml, void *buffer, size_t length) {
 
 	int ret;
+	uint64_t buffered;
+	krad_ebml_io_t *io;
 
-	ret = krad_ebml->io_adapter.read(&krad_ebml->io_adapter, buffer, length);
-	
-	if (krad_ebml->read_copy == 1) {
-		memcpy (krad_ebml->read_copy_buffer + krad_ebml->read_copy_pos, buffer, ret);
-		krad_ebml->read_copy_pos += ret;
+	io = &krad_ebml->io_adapter;
+
+	if (io->read_buffer == NULL) {
+
+		ret = io->read(io, buffer, length);
+
+		if (krad_ebml->read_copy == 1) {
+			memcpy (krad_ebml->read_copy_buffer + krad_ebml->read_copy_pos, buffer, ret);
+			krad_ebml->read_copy_pos += ret;
+		}
+
+		return ret;
 	}
 
-	return ret;
+	buffered = krad_ebml_read_fill (krad_ebml, length);
+
+	if (buffered >= length) {
+		memcpy (buffer, io->read_buffer + io->read_buffer_pos, length);
+		krad_ebml_read_consume (krad_ebml, buffer, length);
+		return length;
+	}
+
+	/* more than the buffer holds, or the input ran out, the rest goes
+	   straight into the callers buffer */
+	memcpy (buffer, io->read_buffer + io->read_buffer_pos, buffered);
+	krad_ebml_read_consume (krad_ebml, buffer, buffered);
+
+	if (io->read_buffer_mapped) {
+		return buffered;
+	}
+
+	io->read_buffer_base += io->read_buffer_len;
+	io->read_buffer_pos = 0;
+	io->read_buffer_len = 0;
+
+	while (buffered < length) {
+		ret = io->read_some(io, buffer + buffered, length - buffered);
+		if (ret <= 0) {
+			break;
+		}
+		if (krad_ebml->read_copy == 1) {
+			memcpy (krad_ebml->read_copy_buffer + krad_ebml->read_copy_pos, buffer + buffered, ret);
+			krad_ebml->read_copy_pos += ret;
+		}
+		io->read_buffer_base += ret;
+		buffered += ret;
+	}
+
+	return buffered;
 }
 
 int krad_ebml_read_copy (krad_ebml_t *krad_ebml, void *buffer ) {
@@ -1885,16 +2945,97 @@ int krad_ebml_read_copy (krad_ebml_t *krad_ebml, void *buffer ) {
 
 }
 
-int krad_ebml_seek(krad_ebml_t *krad_ebml, int64_t offset, int whence) {
+/* Seeks inside what is buffered are free, past it pipes and sockets
+   are read through and files are seeked and refilled */
+
+static int64_t krad_ebml_read_buffer_seek (krad_ebml_t *krad_ebml, int64_t offset, int whence) {
+
+	krad_ebml_io_t *io;
+	uint64_t skip;
+	uint64_t buffered;
+	int64_t position;
+
+	io = &krad_ebml->io_adapter;
+
+	if (whence == SEEK_CUR) {
+		offset += io->read_buffer_base + io->read_buffer_pos;
+		whence = SEEK_SET;
+	}
+
+	if (io->read_buffer_mapped) {
+		if (whence == SEEK_END) {
+			offset += io->read_buffer_len;
+		}
+		if (offset < 0) {
+			offset = 0;
+		}
+		if (offset > io->read_buffer_len) {
+			offset = io->read_buffer_len;
+		}
+		io->read_buffer_pos = offset;
+		return offset;
+	}
+
+	if ((whence == SEEK_SET) && (offset >= io->read_buffer_base) &&
+		(offset <= io->read_buffer_base + io->read_buffer_len)) {
+		io->read_buffer_pos = offset - io->read_buffer_base;
+		return offset;
+	}
+
+	if (!io->seekable) {
+		if ((whence != SEEK_SET) || (offset < io->read_buffer_base + io->read_buffer_pos)) {
+			return -1;
+		}
+		skip = offset - (io->read_buffer_base + io->read_buffer_pos);
+		while (skip > 0) {
+			buffered = krad_ebml_read_fill (krad_ebml, 1);
+			if (buffered == 0) {
+				break;
+			}
+			if (buffered > skip) {
+				buffered = skip;
+			}
+			io->read_buffer_pos += buffered;
+			skip -= buffered;
+		}
+		return io->read_buffer_base + io->read_buffer_pos;
+	}
+
+	if (whence == SEEK_END) {
+		position = io->seek(io, offset, SEEK_END);
+	} else {
+		position = io->seek(io, offset, SEEK_SET);
+	}
+
+	if (position >= 0) {
+		io->read_buffer_base = position;
+		io->read_buffer_pos = 0;
+		io->read_buffer_len = 0;
+	}
+
+	return position;
+
+}
+
+int64_t krad_ebml_seek(krad_ebml_t *krad_ebml, int64_t offset, int whence) {
 
 	if ((krad_ebml->io_adapter.mode == KRAD_EBML_IO_WRITEONLY) || (krad_ebml->io_adapter.mode == KRAD_EBML_IO_READWRITE)) {
 		if (whence == SEEK_CUR) {
 			krad_ebml->io_adapter.write_buffer_pos += offset;
 		}
 		if (whence == SEEK_SET) {
-			krad_ebml->io_adapter.write_buffer_pos = offset;
+			/* whatever is before the base has already been written out */
+			if ((offset < 0) || ((uint64_t)offset < krad_ebml->io_adapter.write_buffer_base)) {
+				printke ("Krad EBML: can't seek back to %"PRId64", already written out", offset);
+				offset = krad_ebml->io_adapter.write_buffer_base;
+			}
+			krad_ebml->io_adapter.write_buffer_pos = offset - krad_ebml->io_adapter.write_buffer_base;
 		}
-		return krad_ebml->io_adapter.write_buffer_pos;
+		return krad_ebml->io_adapter.write_buffer_base + krad_ebml->io_adapter.write_buffer_pos;
+	}
+
+	if (krad_ebml->io_adapter.read_buffer != NULL) {
+		return krad_ebml_read_buffer_seek (krad_ebml, offset, whence);
 	}
 
 	return krad_ebml->io_adapter.seek(&krad_ebml->io_adapter, offset, whence);
@@ -1903,7 +3044,11 @@ int krad_ebml_seek(krad_ebml_t *krad_ebml, int64_t offset, int whence) {
 int64_t krad_ebml_tell(krad_ebml_t *krad_ebml) {
 
 	if ((krad_ebml->io_adapter.mode == KRAD_EBML_IO_WRITEONLY) || (krad_ebml->io_adapter.mode == KRAD_EBML_IO_READWRITE)) {
-		return krad_ebml->io_adapter.write_buffer_pos;
+		return krad_ebml->io_adapter.write_buffer_base + krad_ebml->io_adapter.write_buffer_pos;
+	}
+
+	if (krad_ebml->io_adapter.read_buffer != NULL) {
+		return krad_ebml->io_adapter.read_buffer_base + krad_ebml->io_adapter.read_buffer_pos;
 	}
 
 	return krad_ebml->io_adapter.tell(&krad_ebml->io_adapter);
@@ -1992,6 +3137,10 @@ int krad_ebml_fileio_read(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t len
 	}
 }
 
+int krad_ebml_fileio_read_some(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t length) {
+	return read(krad_ebml_io->ptr, buffer, length);
+}
+
 int64_t krad_ebml_fileio_seek(krad_ebml_io_t *krad_ebml_io, int64_t offset, int whence) {
 
 	char c;
@@ -2017,16 +3166,26 @@ int krad_ebml_streamio_close(krad_ebml_io_t *krad_ebml_io) {
 int krad_ebml_streamio_write(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t length) {
 
 	int bytes;
+	int ret;
 	
 	bytes = 0;
+	
+	if (krad_ebml_io->failed) {
+		return -1;
+	}
 
 	while (bytes != length) {
 
-		bytes += send (krad_ebml_io->sd, buffer + bytes, length - bytes, 0);
+		ret = send (krad_ebml_io->sd, buffer + bytes, length - bytes, MSG_NOSIGNAL);
 
-		if (bytes <= 0) {
-			failfast ("Krad EBML stream io write: Got Disconnected from server. bytes ret %d len %zu", bytes, length);
+		if (ret <= 0) {
+			printke ("Krad EBML stream io write: Got Disconnected from server %s:%d%s",
+					 krad_ebml_io->host, krad_ebml_io->port, krad_ebml_io->mount);
+			krad_ebml_io->failed = 1;
+			return -1;
 		}
+		
+		bytes += ret;
 	}
 	
 	return bytes;
@@ -2053,6 +3212,10 @@ int krad_ebml_streamio_read(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t l
 }
 
 
+int krad_ebml_streamio_read_some(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t length) {
+	return recv (krad_ebml_io->sd, buffer, length, 0);
+}
+
 int krad_ebml_streamio_open(krad_ebml_io_t *krad_ebml_io) {
 
 	struct sockaddr_in serveraddr;
@@ -2070,6 +3233,11 @@ int krad_ebml_streamio_open(krad_ebml_io_t *krad_ebml_io) {
 
 	if ((krad_ebml_io->sd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
 	{
+		if (krad_ebml_io->mode == KRAD_EBML_IO_WRITEONLY) {
+			printke ("Krad EBML Source: Socket Error");
+			krad_ebml_io->failed = 1;
+			return -1;
+		}
 		failfast ("Krad EBML Source: Socket Error");
 	}
 
@@ -2084,6 +3252,11 @@ int krad_ebml_streamio_open(krad_ebml_io_t *krad_ebml_io) {
 		if(hostp == (struct hostent *)NULL)
 		{
 			close (krad_ebml_io->sd);
+			if (krad_ebml_io->mode == KRAD_EBML_IO_WRITEONLY) {
+				printke ("Krad EBML: can't resolve %s", krad_ebml_io->host);
+				krad_ebml_io->failed = 1;
+				return -1;
+			}
 			failfast ("Krad EBML: Mount problem");
 		}
 		memcpy(&serveraddr.sin_addr, hostp->h_addr, sizeof(serveraddr.sin_addr));
@@ -2092,7 +3265,12 @@ int krad_ebml_streamio_open(krad_ebml_io_t *krad_ebml_io) {
 	// connect() to server. 
 	if((sent = connect(krad_ebml_io->sd, (struct sockaddr *)&serveraddr, sizeof(serveraddr))) < 0)
 	{
-		failfast ("Krad EBML Source: Connect Error");
+		if (krad_ebml_io->mode == KRAD_EBML_IO_WRITEONLY) {
+			printke ("Krad EBML Source: Connect Error %s:%d", krad_ebml_io->host, krad_ebml_io->port);
+			krad_ebml_io->failed = 1;
+		} else {
+			failfast ("Krad EBML Source: Connect Error");
+		}
 	} else {
 
 
@@ -2145,6 +3323,7 @@ int krad_ebml_streamio_open(krad_ebml_io_t *krad_ebml_io) {
 void krad_ebml_destroy(krad_ebml_t *krad_ebml) {
 	
 	int t;
+	char index_filename[PATH_MAX];
 
 	if (krad_ebml->cluster != 0) {
 		krad_ebml_finish_element (krad_ebml, krad_ebml->cluster);
@@ -2158,7 +3337,21 @@ void krad_ebml_destroy(krad_ebml_t *krad_ebml) {
 	if ((krad_ebml->io_adapter.mode == KRAD_EBML_IO_WRITEONLY) &&
 		(krad_ebml->io_adapter.write == krad_ebml_fileio_write) &&
 		(krad_ebml->segment != 0)) {
+		krad_ebml_write_cues (krad_ebml);
 		krad_ebml_finish_file_segment (krad_ebml);
+		/* finished properly so the sidecar index is no longer needed */
+		if (krad_ebml->seekhead_position != 0) {
+			krad_ebml_index_filename (krad_ebml->io_adapter.uri, index_filename, sizeof(index_filename));
+			unlink (index_filename);
+		}
+	}
+
+	if (krad_ebml->index != NULL) {
+		fclose (krad_ebml->index);
+	}
+
+	if (krad_ebml->cues != NULL) {
+		free (krad_ebml->cues);
 	}
 
 	if (krad_ebml->io_adapter.mode != -1) {
@@ -2182,6 +3375,18 @@ void krad_ebml_destroy(krad_ebml_t *krad_ebml) {
 	if (krad_ebml->io_adapter.write_buffer != NULL) {
 		free (krad_ebml->io_adapter.write_buffer);
 	}
+
+	if (krad_ebml->io_adapter.read_buffer != NULL) {
+		if (krad_ebml->io_adapter.read_buffer_mapped) {
+			munmap (krad_ebml->io_adapter.read_buffer, krad_ebml->io_adapter.read_buffer_size);
+		} else {
+			free (krad_ebml->io_adapter.read_buffer);
+		}
+	}
+
+	if (krad_ebml->frame_buffer != NULL) {
+		free (krad_ebml->frame_buffer);
+	}
 	
 	if (krad_ebml->read_copy == 1) {
 		krad_ebml_disable_read_copy ( krad_ebml );
@@ -2204,6 +3409,37 @@ void krad_ebml_destroy(krad_ebml_t *krad_ebml) {
 
 }
 
+/* Regular files are mapped whole when they can be, anything else gets
+   a buffer that is refilled a chunk at a time */
+
+static void krad_ebml_read_buffer_create (krad_ebml_t *krad_ebml) {
+
+	krad_ebml_io_t *io;
+	struct stat file_stat;
+	void *map;
+
+	io = &krad_ebml->io_adapter;
+
+	if ((io->read == krad_ebml_fileio_read) && (fstat (io->ptr, &file_stat) == 0)) {
+		io->seekable = S_ISREG (file_stat.st_mode);
+		if ((io->seekable) && (file_stat.st_size > 0) && (lseek (io->ptr, 0, SEEK_CUR) == 0)) {
+			map = mmap (NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, io->ptr, 0);
+			if (map != MAP_FAILED) {
+				madvise (map, file_stat.st_size, MADV_SEQUENTIAL);
+				io->read_buffer = map;
+				io->read_buffer_size = file_stat.st_size;
+				io->read_buffer_len = file_stat.st_size;
+				io->read_buffer_mapped = 1;
+				return;
+			}
+		}
+	}
+
+	io->read_buffer_size = KRAD_EBML_READ_BUFFER_SIZE;
+	io->read_buffer = malloc (io->read_buffer_size);
+
+}
+
 krad_ebml_t *krad_ebml_create() {
 
 	krad_ebml_t *krad_ebml = calloc(1, sizeof(krad_ebml_t));
@@ -2255,6 +3491,8 @@ krad_ebml_t *krad_ebml_open_stream(char *host, int port, char *mount, char *pass
 	}
 	
 	if (krad_ebml->io_adapter.mode == KRAD_EBML_IO_READONLY) {
+		krad_ebml->io_adapter.read_some = krad_ebml_streamio_read_some;
+		krad_ebml_read_buffer_create (krad_ebml);
 		krad_ebml->tracks = calloc(10, sizeof(krad_ebml_track_t));
 		krad_ebml_read_ebml_header (krad_ebml, krad_ebml->header);
 		krad_ebml_check_ebml_header (krad_ebml->header);
@@ -2269,6 +3507,7 @@ krad_ebml_t *krad_ebml_open_stream(char *host, int port, char *mount, char *pass
 krad_ebml_t *krad_ebml_open_file(char *filename, krad_ebml_io_mode_t mode) {
 
 	krad_ebml_t *krad_ebml;
+	char index_filename[PATH_MAX];
 	
 	krad_ebml = krad_ebml_create();
 
@@ -2280,11 +3519,13 @@ krad_ebml_t *krad_ebml_open_file(char *filename, krad_ebml_io_mode_t mode) {
 	krad_ebml->io_adapter.write = krad_ebml_fileio_write;
 	krad_ebml->io_adapter.open = krad_ebml_fileio_open;
 	krad_ebml->io_adapter.close = krad_ebml_fileio_close;
+	krad_ebml->io_adapter.read_some = krad_ebml_fileio_read_some;
 	krad_ebml->io_adapter.uri = filename;
 	krad_ebml->io_adapter.open(&krad_ebml->io_adapter);
 	
 
 	if (krad_ebml->io_adapter.mode == KRAD_EBML_IO_READONLY) {
+		krad_ebml_read_buffer_create (krad_ebml);
 		krad_ebml->record_cluster_info = 1;
 		krad_ebml->cluster_recording_space = 5000;
 		krad_ebml->clusters = calloc(krad_ebml->cluster_recording_space, sizeof(krad_ebml_cluster_t));
@@ -2297,12 +3538,293 @@ krad_ebml_t *krad_ebml_open_file(char *filename, krad_ebml_io_mode_t mode) {
 
 	if (krad_ebml->io_adapter.mode == KRAD_EBML_IO_WRITEONLY) {
 		krad_ebml->io_adapter.write_buffer = malloc(KRADEBML_WRITE_BUFFER_SIZE);
+		krad_ebml->cue_space = 1024;
+		krad_ebml->cues = calloc(krad_ebml->cue_space, sizeof(krad_ebml_cue_t));
+		krad_ebml_index_filename (filename, index_filename, sizeof(index_filename));
+		krad_ebml->index = fopen (index_filename, "w");
+		if (krad_ebml->index == NULL) {
+			printke ("Krad EBML: could not open %s, %s will not be repairable", index_filename, filename);
+		}
 	}
 	
 	return krad_ebml;
 
 } 
 
+/* reads an ebml id (marker kept) or size (marker dropped) off the front
+   of data, returns its length or 0 if it is not a valid one */
+
+static int krad_ebml_repair_vint (unsigned char *data, uint64_t *value, int keep_marker) {
+
+	int length;
+	int b;
+
+	for (length = 1; length <= 8; length++) {
+		if (data[0] & (0x80 >> (length - 1))) {
+			break;
+		}
+	}
+
+	if (length > 8) {
+		return 0;
+	}
+
+	if (keep_marker) {
+		*value = data[0];
+	} else {
+		*value = data[0] & (0xFF >> length);
+	}
+
+	for (b = 1; b < length; b++) {
+		*value = (*value << 8) | data[b];
+	}
+
+	return length;
+
+}
+
+/* Walks the blocks of a cluster, finding where it ends when it was left
+   unknown size, the last timecode in it and whether it starts on a
+   keyframe. Returns the end of the last whole element in the cluster. */
+
+static uint64_t krad_ebml_repair_cluster (int fd, uint64_t position, uint64_t end, uint64_t *cluster_timecode,
+										  uint64_t *last_timecode, int *keyframe) {
+
+	unsigned char head[16];
+	int head_length;
+	int blocks;
+	uint64_t id;
+	uint64_t size;
+	uint64_t value;
+	int id_length;
+	int size_length;
+	int b;
+	short block_timecode;
+
+	blocks = 0;
+	*keyframe = 0;
+
+	while (position + 2 <= end) {
+
+		head_length = sizeof(head);
+		if (end - position < head_length) {
+			head_length = end - position;
+		}
+
+		memset (head, 0, sizeof(head));
+		if (pread (fd, head, head_length, position) != head_length) {
+			break;
+		}
+
+		/* anything but a one byte id is the next top level element */
+		if ((head[0] & 0x80) == 0) {
+			break;
+		}
+
+		id_length = krad_ebml_repair_vint (head, &id, 1);
+		size_length = krad_ebml_repair_vint (head + id_length, &size, 0);
+
+		if ((size_length == 0) || (position + id_length + size_length + size > end)) {
+			break;
+		}
+
+		if ((id == EBML_ID_CLUSTER_TIMECODE) && (size <= 8)) {
+			value = 0;
+			for (b = 0; b < size; b++) {
+				value = (value << 8) | head[id_length + size_length + b];
+			}
+			*cluster_timecode = value;
+			*last_timecode = value;
+		}
+
+		if ((id == EBML_ID_SIMPLEBLOCK) && (size >= 4) && (id_length + size_length + 4 <= sizeof(head))) {
+			/* one byte track number, the 16 bit block timecode then flags */
+			block_timecode = (head[id_length + size_length + 1] << 8) | head[id_length + size_length + 2];
+			if (*cluster_timecode + block_timecode > *last_timecode) {
+				*last_timecode = *cluster_timecode + block_timecode;
+			}
+			if (blocks++ == 0) {
+				*keyframe = head[id_length + size_length + 3] & 0x80;
+			}
+		}
+
+		position += id_length + size_length + size;
+	}
+
+	return position;
+
+}
+
+int krad_ebml_repair_file (char *filename) {
+
+	krad_ebml_t *krad_ebml;
+	char index_filename[PATH_MAX];
+	FILE *index;
+	struct stat file_stat;
+	unsigned char head[12];
+	krad_ebml_cue_t cue;
+	int version;
+	int fd;
+	int id_length;
+	int size_length;
+	int cue_count;
+	uint64_t data_start;
+	uint64_t position;
+	uint64_t end;
+	uint64_t id;
+	uint64_t size;
+	uint64_t cluster_end;
+	uint64_t cluster_timecode;
+	uint64_t last_timecode;
+	int keyframe;
+
+	krad_ebml_index_filename (filename, index_filename, sizeof(index_filename));
+
+	index = fopen (index_filename, "r");
+	if (index == NULL) {
+		printke ("Krad EBML: no index %s to repair %s with", index_filename, filename);
+		return -1;
+	}
+
+	fd = open (filename, O_RDWR);
+	if ((fd < 0) || (fstat (fd, &file_stat) != 0)) {
+		printke ("Krad EBML: could not open %s for repair", filename);
+		fclose (index);
+		if (fd >= 0) {
+			close (fd);
+		}
+		return -1;
+	}
+
+	krad_ebml = krad_ebml_create ();
+
+	if ((fscanf (index, "krad_ebml_index %d %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64"\n",
+				 &version, &krad_ebml->segment, &krad_ebml->seekhead_position, &krad_ebml->info_position,
+				 &krad_ebml->tracks_position, &krad_ebml->duration_position) != 6) || (version != 1) ||
+		(krad_ebml->tracks_position >= file_stat.st_size)) {
+		printke ("Krad EBML: %s is not a usable index", index_filename);
+		fclose (index);
+		close (fd);
+		krad_ebml->segment = 0;
+		krad_ebml_destroy (krad_ebml);
+		return -1;
+	}
+
+	data_start = krad_ebml->segment + EBML_DATA_SIZE_UNKNOWN_LENGTH;
+
+	krad_ebml->cue_space = 1024;
+	krad_ebml->cues = calloc (krad_ebml->cue_space, sizeof(krad_ebml_cue_t));
+
+	while (fscanf (index, "%"SCNu64" %"SCNu64" %d\n", &cue.timecode, &cue.position, &cue.track) == 3) {
+		if (data_start + cue.position >= file_stat.st_size) {
+			break;
+		}
+		if (krad_ebml->cue_count == krad_ebml->cue_space) {
+			krad_ebml->cue_space *= 2;
+			krad_ebml->cues = realloc (krad_ebml->cues, krad_ebml->cue_space * sizeof(krad_ebml_cue_t));
+		}
+		krad_ebml->cues[krad_ebml->cue_count++] = cue;
+	}
+
+	fclose (index);
+
+	/* walk the top level elements from the last indexed cluster,
+	   picking up cues for the clusters since and cutting off whatever
+	   was only partly written */
+
+	if (krad_ebml->cue_count > 0) {
+		position = data_start + krad_ebml->cues[krad_ebml->cue_count - 1].position;
+		cue.track = krad_ebml->cues[krad_ebml->cue_count - 1].track;
+	} else {
+		position = krad_ebml->tracks_position;
+		cue.track = 1;
+	}
+
+	end = position;
+	last_timecode = 0;
+
+	while (position + sizeof(head) <= file_stat.st_size) {
+
+		if (pread (fd, head, sizeof(head), position) != sizeof(head)) {
+			break;
+		}
+
+		id_length = krad_ebml_repair_vint (head, &id, 1);
+		if ((id_length == 0) || (id_length + 8 > sizeof(head))) {
+			break;
+		}
+		size_length = krad_ebml_repair_vint (head + id_length, &size, 0);
+		if (size_length == 0) {
+			break;
+		}
+
+		if (id == EBML_ID_CLUSTER) {
+			cluster_timecode = 0;
+			if ((size_length == EBML_DATA_SIZE_UNKNOWN_LENGTH) &&
+				(size == (EBML_DATA_SIZE_UNKNOWN & 0x00FFFFFFFFFFFFFFLLU))) {
+				cluster_end = krad_ebml_repair_cluster (fd, position + id_length + size_length,
+														file_stat.st_size, &cluster_timecode, &last_timecode,
+														&keyframe);
+			} else {
+				if (position + id_length + size_length + size > file_stat.st_size) {
+					break;
+				}
+				cluster_end = position + id_length + size_length + size;
+				krad_ebml_repair_cluster (fd, position + id_length + size_length,
+										  cluster_end, &cluster_timecode, &last_timecode, &keyframe);
+			}
+			if ((keyframe) && ((krad_ebml->cue_count == 0) ||
+				(position - data_start > krad_ebml->cues[krad_ebml->cue_count - 1].position))) {
+				if (krad_ebml->cue_count == krad_ebml->cue_space) {
+					krad_ebml->cue_space *= 2;
+					krad_ebml->cues = realloc (krad_ebml->cues, krad_ebml->cue_space * sizeof(krad_ebml_cue_t));
+				}
+				cue.timecode = cluster_timecode;
+				cue.position = position - data_start;
+				krad_ebml->cues[krad_ebml->cue_count++] = cue;
+			}
+			position = cluster_end;
+		} else {
+			if (position + id_length + size_length + size > file_stat.st_size) {
+				break;
+			}
+			position += id_length + size_length + size;
+		}
+
+		end = position;
+	}
+
+	if (ftruncate (fd, end) != 0) {
+		printke ("Krad EBML: could not truncate %s", filename);
+	}
+
+	/* pick up where the recording left off and finish it like destroy would */
+
+	lseek (fd, end, SEEK_SET);
+
+	krad_ebml->io_adapter.mode = KRAD_EBML_IO_WRITEONLY;
+	krad_ebml->io_adapter.seek = krad_ebml_fileio_seek;
+	krad_ebml->io_adapter.tell = krad_ebml_fileio_tell;
+	krad_ebml->io_adapter.seekable = 1;
+	krad_ebml->io_adapter.write = krad_ebml_fileio_write;
+	krad_ebml->io_adapter.close = krad_ebml_fileio_close;
+	krad_ebml->io_adapter.uri = filename;
+	krad_ebml->io_adapter.ptr = fd;
+	krad_ebml->io_adapter.write_buffer = malloc (KRADEBML_WRITE_BUFFER_SIZE);
+	krad_ebml->io_adapter.write_buffer_base = end;
+	krad_ebml->segment_duration = last_timecode;
+
+	cue_count = krad_ebml->cue_count;
+
+	krad_ebml_destroy (krad_ebml);
+
+	printk ("Krad EBML: repaired %s, %"PRIu64" bytes, %"PRIu64"ms, %d cues",
+			filename, end, last_timecode, cue_count);
+
+	return cue_count;
+
+}
+
 krad_ebml_t *krad_ebml_open_buffer(krad_ebml_io_mode_t mode) {
 
 	krad_ebml_t *krad_ebml;
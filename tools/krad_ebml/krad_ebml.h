@@ -18,6 +18,7 @@
 #include <sys/socket.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/un.h>
 #include <fcntl.h>
 #include <netinet/in.h>
@@ -45,6 +46,7 @@
 #define EBML_DATA_SIZE_UNKNOWN_LENGTH 8
 
 #define EBML_ID_VOID			   0xEC
+#define EBML_ID_CRC32			   0xBF
 
 #define EBML_ID_EBMLVERSION        0x4286
 #define EBML_ID_EBMLREADVERSION    0x42F7
@@ -68,6 +70,8 @@
 #define EBML_ID_CLUSTER_TIMECODE		0xE7
 #define EBML_ID_SIMPLEBLOCK				0xA3
 #define EBML_ID_BLOCKGROUP				0xA0
+#define EBML_ID_CLUSTER_POSITION		0xA7
+#define EBML_ID_CLUSTER_PREVSIZE		0xAB
 #define EBML_ID_DOCTYPE					0x4282
 #define EBML_ID_MUXINGAPP 				0x4D80
 #define EBML_ID_WRITINGAPP 				0x5741
@@ -92,7 +96,21 @@
 #define EBML_ID_DURATION				0x4489
 #define EBML_ID_DEFAULTDURATION			0x23E383
 
+#define EBML_ID_SEEKHEAD				0x114D9B74
+#define EBML_ID_SEEK					0x4DBB
+#define EBML_ID_SEEKID					0x53AB
+#define EBML_ID_SEEKPOSITION			0x53AC
+
+#define EBML_ID_CUES					0x1C53BB6B
+#define EBML_ID_CUEPOINT				0xBB
+#define EBML_ID_CUETIME					0xB3
+#define EBML_ID_CUETRACKPOSITIONS		0xB7
+#define EBML_ID_CUETRACK				0xF7
+#define EBML_ID_CUECLUSTERPOSITION		0xF1
+
 #define EBML_ID_TAGS					0x1254C367
+#define EBML_ID_CHAPTERS				0x1043A770
+#define EBML_ID_ATTACHMENTS				0x1941A469
 #define EBML_ID_TAG						0x7373
 #define EBML_ID_TAG_TARGETS				0x63C0
 #define EBML_ID_TAG_TARGETTYPEVALUE		0x68CA
@@ -105,6 +123,30 @@
 #define KRAD_EBML_MAX_TRACKS 10
 
 #define KRADEBML_WRITE_BUFFER_SIZE 8192 * 1024 * 2
+/* files and streams are read into this a chunk at a time and parsed in
+   place, regular files get mapped whole instead */
+#define KRAD_EBML_READ_BUFFER_SIZE 1024 * 1024
+
+/* anything claiming to be bigger than these is taken as corruption and
+   reading resyncs on the next cluster or block instead */
+#define KRAD_EBML_MAX_BLOCK_SIZE 4096 * 512
+#define KRAD_EBML_MAX_ELEMENT_SIZE 256 * 1024 * 1024
+/* enough to see a cluster id, its size and the timecode id after it */
+#define KRAD_EBML_RESYNC_LOOKAHEAD 16
+/* read_simpleblock gave up on a block and found the next one */
+#define KRAD_EBML_RESYNCED -2
+
+#define KRAD_EBML_LIVE_DEFAULT_MAX_CLUSTER_MS 1000
+#define KRAD_EBML_LIVE_DEFAULT_MAX_CLUSTER_BYTES 256 * 1024
+#define KRAD_EBML_LIVE_DEFAULT_FLUSH_MS 0
+/* block timecodes are 16 bit signed offsets from the cluster timecode */
+#define KRAD_EBML_MAX_BLOCK_TIMECODE 32767
+
+/* a void at the start of a recording that becomes the seekhead */
+#define KRAD_EBML_SEEKHEAD_RESERVE 128
+/* how much recording the sidecar index can fall behind by */
+#define KRAD_EBML_INDEX_INTERVAL_MS 10000
+#define KRAD_EBML_INDEX_SUFFIX ".index"
 
 #ifndef KRAD_CODEC_T
 typedef enum {
@@ -141,6 +183,7 @@ typedef struct krad_ebml_audiotrack_St krad_ebml_audiotrack_t;
 typedef struct krad_ebml_videotrack_St krad_ebml_videotrack_t;
 typedef struct krad_ebml_subtrack_St krad_ebml_subtrack_t;
 typedef struct krad_ebml_cluster_St krad_ebml_cluster_t;
+typedef struct krad_ebml_cue_St krad_ebml_cue_t;
 
 /* from nestegg */
 
@@ -197,6 +240,15 @@ struct krad_ebml_cluster_St {
 
 };
 
+struct krad_ebml_cue_St {
+
+	uint64_t timecode;
+	/* of the cluster, from the start of the segment data */
+	uint64_t position;
+	int track;
+
+};
+
 struct krad_ebml_track_St {
 
 	krad_codec_t codec;
@@ -236,7 +288,8 @@ struct krad_ebml_io_St {
 	char *password;
 	int port;
 	int sd;
-	
+	/* set when a write only stream loses its server */
+	int failed;
 	
 	unsigned char *buffer_io_buffer;
 	int buffer_io_read_pos;
@@ -244,6 +297,18 @@ struct krad_ebml_io_St {
 
 	unsigned char *write_buffer;
 	uint64_t write_buffer_pos;
+	/* output offset of the start of write_buffer, bytes synced so far */
+	uint64_t write_buffer_base;
+
+	/* takes whatever is there, up to length, to refill read_buffer */
+	int (* read_some)(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t length);
+	unsigned char *read_buffer;
+	uint64_t read_buffer_size;
+	uint64_t read_buffer_pos;
+	uint64_t read_buffer_len;
+	/* input offset of the start of read_buffer */
+	uint64_t read_buffer_base;
+	int read_buffer_mapped;
 
 };
 
@@ -303,6 +368,30 @@ struct krad_ebml_St {
 	int audio_channels;
 	int audio_frames_since_cluster;
 	
+	/* live writing: clusters are left unknown size, cut by time and
+	   size as well as keyframes, and blocks go out as they are added
+	   instead of a cluster at a time */
+	int live;
+	int live_max_cluster_ms;
+	int live_max_cluster_bytes;
+	int live_flush_ms;
+	int64_t live_flushed_timecode;
+	
+	/* recordings: where the top level elements went for the seekhead,
+	   a cue for each cluster, and a sidecar index file of the cues so
+	   a recording that never got finished can be repaired */
+	uint64_t seekhead_position;
+	uint64_t info_position;
+	uint64_t tracks_position;
+	uint64_t duration_position;
+	uint64_t cues_position;
+	krad_ebml_cue_t *cues;
+	int cue_count;
+	int cue_space;
+	FILE *index;
+	int cues_indexed;
+	int64_t index_timecode;
+	
 	int new_tags;
 	char tags[512];
 	int tags_position;
@@ -314,6 +403,24 @@ struct krad_ebml_St {
 	int read_copy;
 	unsigned char *read_copy_buffer;
 	uint64_t read_copy_pos;
+
+	/* set while krad_ebml_read_packet_in_place is reading, frames
+	   too big for the read buffer are copied into frame_buffer */
+	int frame_in_place;
+	unsigned char *frame;
+	unsigned char *frame_buffer;
+	uint64_t frame_buffer_size;
+
+	/* malformed elements met while reading and the bytes skipped
+	   getting back in sync after them */
+	uint64_t corruptions;
+	uint64_t corrupt_bytes;
+	int reading_cluster;
+
+	/* seeking: where the segment data starts, cues are read into cues
+	   the first time, or built from the clusters when there are none */
+	uint64_t segment_data_position;
+	int cues_loaded;
 	
 };
 
@@ -330,7 +437,14 @@ int krad_ebml_add_subtitle_track(krad_ebml_t *krad_ebml, char *codec_id);
 int krad_ebml_add_audio_track(krad_ebml_t *krad_ebml, krad_codec_t codec, int sample_rate, int channels, unsigned char *private_data, int private_data_size);
 void krad_ebml_add_video(krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len, int keyframe);
 void krad_ebml_add_audio(krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len, int frames);
+/* timecodes are in ms from the start of the segment, blocks must come in timecode order per track */
+void krad_ebml_add_video_timecode (krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len,
+								   int keyframe, int64_t timecode);
+void krad_ebml_add_audio_timecode (krad_ebml_t *krad_ebml, int track_num, unsigned char *buffer, int buffer_len,
+								   int frames, int64_t timecode);
 void krad_ebml_cluster(krad_ebml_t *krad_ebml, int64_t timecode);
+/* flush_ms 0 writes out every block as soon as it is added */
+void krad_ebml_set_live (krad_ebml_t *krad_ebml, int max_cluster_ms, int max_cluster_bytes, int flush_ms);
 
 void krad_ebml_start_segment(krad_ebml_t *krad_ebml, char *appversion);
 void krad_ebml_start_file_segment(krad_ebml_t *krad_ebml);
@@ -367,6 +481,12 @@ int krad_ebml_track_active (krad_ebml_t *krad_ebml, int track);
 int krad_ebml_track_changed (krad_ebml_t *krad_ebml, int track);
 
 int krad_ebml_read_packet (krad_ebml_t *krad_ebml, int *track, uint64_t *timecode, unsigned char *buffer);
+/* the same but frame points at the packet where it sits in the read
+   buffer rather than it being copied out, good until the next read */
+int krad_ebml_read_packet_in_place (krad_ebml_t *krad_ebml, int *track, uint64_t *timecode, unsigned char **frame);
+/* carries on reading from the cluster with the last keyframe at or before
+   timecode, returns that cluster's timecode or -1 if the input can't seek */
+int64_t krad_ebml_seek_timecode (krad_ebml_t *krad_ebml, uint64_t timecode);
 
 
 int krad_ebml_read_element_from_frag (unsigned char *ebml_frag, uint32_t *ebml_id_ptr, uint64_t *ebml_data_size_ptr);
@@ -392,6 +512,9 @@ krad_ebml_t *krad_ebml_open_active_socket (int socket, krad_ebml_io_mode_t mode)
 
 krad_ebml_t *krad_ebml_open_stream(char *host, int port, char *mount, char *password);
 krad_ebml_t *krad_ebml_open_file(char *filename, krad_ebml_io_mode_t mode);
+/* finishes a recording that was cut off using its sidecar index,
+   returns the number of cues written or -1 */
+int krad_ebml_repair_file (char *filename);
 
 void krad_ebml_destroy(krad_ebml_t *krad_ebml);
 char *krad_ebml_version();
@@ -399,7 +522,10 @@ char *krad_ebml_version();
 int64_t krad_ebml_tell(krad_ebml_t *krad_ebml);
 int krad_ebml_write(krad_ebml_t *krad_ebml, void *buffer, size_t length);
 int krad_ebml_read(krad_ebml_t *krad_ebml, void *buffer, size_t length);
-int krad_ebml_seek(krad_ebml_t *krad_ebml, int64_t offset, int whence);
+/* length bytes from the read buffer without copying, good until the
+   next read, NULL if there are not that many or it can't hold them */
+unsigned char *krad_ebml_read_in_place (krad_ebml_t *krad_ebml, uint64_t length);
+int64_t krad_ebml_seek(krad_ebml_t *krad_ebml, int64_t offset, int whence);
 
 int krad_ebml_fileio_write(krad_ebml_io_t *krad_ebml_io, void *buffer, size_t length);
 int64_t krad_ebml_fileio_seek(krad_ebml_io_t *krad_ebml_io, int64_t offset, int whence);
@@ -8,6 +8,7 @@ krad_frame_t *krad_framepool_getframe (krad_framepool_t *krad_framepool) {
 		pthread_mutex_lock (&krad_framepool->frames[f].ref_lock);
 		if (krad_framepool->frames[f].refs == 0) {
 			krad_framepool->frames[f].refs++;
+			krad_framepool->frames[f].release_callback = NULL;
 			pthread_mutex_unlock (&krad_framepool->frames[f].ref_lock);
 			return &krad_framepool->frames[f];
 		}
@@ -29,10 +30,46 @@ void krad_framepool_ref_frame (krad_frame_t *frame) {
 
 void krad_framepool_unref_frame (krad_frame_t *frame) {
 
+	void (*release_callback)(void *, int);
+	void *release_pointer;
+	int release_id;
+
+	release_callback = NULL;
+	release_pointer = NULL;
+	release_id = 0;
+
 	pthread_mutex_lock (&frame->ref_lock);
 	frame->refs--;
+	if ((frame->refs == 0) && (frame->release_callback != NULL)) {
+		release_callback = frame->release_callback;
+		release_pointer = frame->release_pointer;
+		release_id = frame->release_id;
+		frame->release_callback = NULL;
+	}
 	pthread_mutex_unlock (&frame->ref_lock);
 	//printf("refs = %d\n", frame->refs);
+	
+	if (release_callback != NULL) {
+		release_callback (release_pointer, release_id);
+	}
+}
+
+int krad_framepool_frames_in_use (krad_framepool_t *krad_framepool) {
+
+	int f;
+	int in_use;
+	
+	in_use = 0;
+
+	for (f = 0; f < krad_framepool->count; f++ ) {
+		pthread_mutex_lock (&krad_framepool->frames[f].ref_lock);
+		if (krad_framepool->frames[f].refs != 0) {
+			in_use++;
+		}
+		pthread_mutex_unlock (&krad_framepool->frames[f].ref_lock);
+	}
+	
+	return in_use;
 }
 
 void krad_framepool_destroy (krad_framepool_t *krad_framepool) {
@@ -40,6 +77,10 @@ void krad_framepool_destroy (krad_framepool_t *krad_framepool) {
 	int f;
 
 	for (f = 0; f < krad_framepool->count; f++ ) {
+		if (krad_framepool->wrapped) {
+			pthread_mutex_destroy (&krad_framepool->frames[f].ref_lock);
+			continue;
+		}
 		munlock (krad_framepool->frames[f].pixels, krad_framepool->frame_byte_size);
 		free (krad_framepool->frames[f].pixels);
 		pthread_mutex_destroy (&krad_framepool->frames[f].ref_lock);
@@ -88,3 +129,27 @@ krad_framepool_t *krad_framepool_create (int width, int height, int count) {
 	return krad_framepool;
 
 }
+
+/* frames with no pixels of their own, the user points pixels at memory
+   it owns and sets a release callback to get it back */
+
+krad_framepool_t *krad_framepool_create_wrapped (int width, int height, int count) {
+
+	krad_framepool_t *krad_framepool = calloc (1, sizeof(krad_framepool_t));
+
+	int f;
+
+	krad_framepool->width = width;
+	krad_framepool->height = height;
+	krad_framepool->count = count;
+	krad_framepool->wrapped = 1;
+	
+	krad_framepool->frames = calloc (krad_framepool->count, sizeof(krad_frame_t));
+	
+	for (f = 0; f < krad_framepool->count; f++ ) {
+		pthread_mutex_init (&krad_framepool->frames[f].ref_lock, NULL);
+	}
+	
+	return krad_framepool;
+
+}
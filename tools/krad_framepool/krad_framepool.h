@@ -32,6 +32,12 @@ struct krad_frame_St {
 	cairo_t *cr;	
 	
 	uint64_t timecode;	
+
+	/* frames wrapping someone elses memory, ie. a v4l2 mmap buffer,
+	   are handed back with this when the last ref is dropped */
+	void (*release_callback)(void *, int);
+	void *release_pointer;
+	int release_id;
 	
 };
 
@@ -41,6 +47,7 @@ struct krad_framepool_St {
 	int height;
 	int frame_byte_size;
 	int count;
+	int wrapped;
 
 	krad_frame_t *frames;
 
@@ -50,6 +57,8 @@ krad_frame_t *krad_framepool_getframe (krad_framepool_t *krad_framepool);
 
 void krad_framepool_ref_frame (krad_frame_t *frame);
 void krad_framepool_unref_frame (krad_frame_t *frame);
+int krad_framepool_frames_in_use (krad_framepool_t *krad_framepool);
 
 void krad_framepool_destroy (krad_framepool_t *krad_framepool);
 krad_framepool_t *krad_framepool_create (int width, int height, int count);
+krad_framepool_t *krad_framepool_create_wrapped (int width, int height, int count);
@@ -76,7 +76,7 @@ int krad_io_read(krad_io_t *krad_io, void *buffer, size_t length) {
 	return krad_io->read(krad_io, buffer, length);
 }
 
-int krad_io_seek(krad_io_t *krad_io, int64_t offset, int whence) {
+int64_t krad_io_seek(krad_io_t *krad_io, int64_t offset, int whence) {
 
 	if (krad_io->mode == KRAD_IO_WRITEONLY) {
 		if (whence == SEEK_CUR) {
@@ -153,15 +153,26 @@ int krad_io_stream_write(krad_io_t *krad_io, void *buffer, size_t length) {
 
 	int bytes;
 	
+	int ret;
+	
 	bytes = 0;
+	
+	if (krad_io->failed) {
+		return -1;
+	}
 
 	while (bytes != length) {
 
-		bytes += send (krad_io->sd, buffer + bytes, length - bytes, 0);
+		ret = send (krad_io->sd, buffer + bytes, length - bytes, MSG_NOSIGNAL);
 
-		if (bytes <= 0) {
-			failfast ("Krad io Source: send Got Disconnected from server");
+		if (ret <= 0) {
+			printke ("Krad io Source: send Got Disconnected from server %s:%d%s",
+					 krad_io->host, krad_io->port, krad_io->mount);
+			krad_io->failed = 1;
+			return -1;
 		}
+		
+		bytes += ret;
 	}
 	
 	return bytes;
@@ -219,6 +230,8 @@ int krad_io_stream_open(krad_io_t *krad_io) {
 	if ((krad_io->sd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
 	{
 		printkd ("Krad io Source: Socket Error");
+		krad_io->failed = 1;
+		return -1;
 	}
 
 	memset(&serveraddr, 0x00, sizeof(struct sockaddr_in));
@@ -233,6 +246,10 @@ int krad_io_stream_open(krad_io_t *krad_io) {
 		{
 			printkd ("Krad io: Mount problem\n");
 			close (krad_io->sd);
+			if (krad_io->mode == KRAD_IO_WRITEONLY) {
+				krad_io->failed = 1;
+				return -1;
+			}
 			exit (1);
 		}
 		memcpy(&serveraddr.sin_addr, hostp->h_addr, sizeof(serveraddr.sin_addr));
@@ -241,7 +258,8 @@ int krad_io_stream_open(krad_io_t *krad_io) {
 	// connect() to server. 
 	if((sent = connect(krad_io->sd, (struct sockaddr *)&serveraddr, sizeof(serveraddr))) < 0)
 	{
-		printkd ("Krad io Source: Connect Error");
+		printke ("Krad io Source: Connect Error %s:%d", krad_io->host, krad_io->port);
+		krad_io->failed = 1;
 	} else {
 
 
@@ -65,7 +65,9 @@ struct krad_io_St {
 	char *password;
 	int port;
 	int sd;
-	
+	/* a write only stream that lost its server stays failed, writes
+	   return -1 so one dead mount doesn't take the process down */
+	int failed;
 
 	unsigned char *write_buffer;
 	uint64_t write_buffer_pos;
@@ -79,7 +81,7 @@ int64_t krad_io_tell(krad_io_t *krad_io);
 int krad_io_write(krad_io_t *krad_io, void *buffer, size_t length);
 int krad_io_write_sync(krad_io_t *krad_io);
 int krad_io_read(krad_io_t *krad_io, void *buffer, size_t length);
-int krad_io_seek(krad_io_t *krad_io, int64_t offset, int whence);
+int64_t krad_io_seek(krad_io_t *krad_io, int64_t offset, int whence);
 
 krad_io_t *krad_io_open_file(char *filename, krad_io_mode_t mode);
 krad_io_t *krad_io_open_stream(char *host, int port, char *mount, char *password);
@@ -0,0 +1,171 @@
+#include "krad_prefetch.h"
+
+static uint64_t krad_prefetch_window (krad_prefetch_t *krad_prefetch) {
+
+	uint64_t window;
+
+	window = krad_prefetch->bytes_per_second * krad_prefetch->seconds;
+
+	if (window < KRAD_PREFETCH_MIN_WINDOW) {
+		window = KRAD_PREFETCH_MIN_WINDOW;
+	}
+
+	return window;
+
+}
+
+static void *krad_prefetch_thread (void *arg) {
+
+	krad_prefetch_t *krad_prefetch = (krad_prefetch_t *)arg;
+
+	uint64_t target;
+	uint64_t offset;
+	uint64_t length;
+	ssize_t ret;
+
+	prctl (PR_SET_NAME, (unsigned long) "krad_prefetch", 0, 0, 0);
+
+	pthread_mutex_lock (&krad_prefetch->lock);
+
+	while (krad_prefetch->run) {
+
+		target = krad_prefetch->position + krad_prefetch_window (krad_prefetch);
+
+		if (target > krad_prefetch->file_size) {
+			target = krad_prefetch->file_size;
+		}
+
+		if (krad_prefetch->prefetched >= target) {
+			pthread_cond_wait (&krad_prefetch->cond, &krad_prefetch->lock);
+			continue;
+		}
+
+		offset = krad_prefetch->prefetched;
+		length = target - offset;
+		if (length > KRAD_PREFETCH_CHUNK_SIZE) {
+			length = KRAD_PREFETCH_CHUNK_SIZE;
+		}
+
+		/* the slow part, done without holding up the demuxer */
+		pthread_mutex_unlock (&krad_prefetch->lock);
+		ret = pread (krad_prefetch->fd, krad_prefetch->chunk, length, offset);
+		pthread_mutex_lock (&krad_prefetch->lock);
+
+		if (ret <= 0) {
+			if ((ret < 0) && (errno == EINTR)) {
+				continue;
+			}
+			printke ("Krad Prefetch: read failed at %"PRIu64", giving up on reading ahead", offset);
+			break;
+		}
+
+		/* the demuxer may have been moved elsewhere meanwhile */
+		if (krad_prefetch->prefetched == offset) {
+			krad_prefetch->prefetched += ret;
+		}
+	}
+
+	pthread_mutex_unlock (&krad_prefetch->lock);
+
+	return NULL;
+
+}
+
+void krad_prefetch_update (krad_prefetch_t *krad_prefetch, uint64_t position, uint64_t timecode) {
+
+	pthread_mutex_lock (&krad_prefetch->lock);
+
+	/* got ahead of what was read in, or was moved back, carry on from there */
+	if (position > krad_prefetch->prefetched) {
+		krad_prefetch->prefetched = position;
+	}
+
+	if (position < krad_prefetch->position) {
+		krad_prefetch->prefetched = position;
+		krad_prefetch->started = 0;
+	}
+
+	if ((!krad_prefetch->started) && (timecode > 0)) {
+		krad_prefetch->start_position = position;
+		krad_prefetch->start_timecode = timecode;
+		krad_prefetch->started = 1;
+	}
+
+	if ((krad_prefetch->started) && (timecode > krad_prefetch->start_timecode + KRAD_PREFETCH_RATE_MIN_MS) &&
+		(position > krad_prefetch->start_position)) {
+		krad_prefetch->bytes_per_second = ((position - krad_prefetch->start_position) * 1000) /
+										  (timecode - krad_prefetch->start_timecode);
+	}
+
+	krad_prefetch->position = position;
+	krad_prefetch->timecode = timecode;
+
+	pthread_cond_signal (&krad_prefetch->cond);
+	pthread_mutex_unlock (&krad_prefetch->lock);
+
+}
+
+int krad_prefetch_buffered_ms (krad_prefetch_t *krad_prefetch) {
+
+	int buffered_ms;
+
+	buffered_ms = 0;
+
+	pthread_mutex_lock (&krad_prefetch->lock);
+
+	if ((krad_prefetch->bytes_per_second > 0) && (krad_prefetch->prefetched > krad_prefetch->position)) {
+		buffered_ms = ((krad_prefetch->prefetched - krad_prefetch->position) * 1000) / krad_prefetch->bytes_per_second;
+	}
+
+	pthread_mutex_unlock (&krad_prefetch->lock);
+
+	return buffered_ms;
+
+}
+
+void krad_prefetch_destroy (krad_prefetch_t *krad_prefetch) {
+
+	pthread_mutex_lock (&krad_prefetch->lock);
+	krad_prefetch->run = 0;
+	pthread_cond_signal (&krad_prefetch->cond);
+	pthread_mutex_unlock (&krad_prefetch->lock);
+
+	pthread_join (krad_prefetch->thread, NULL);
+
+	pthread_cond_destroy (&krad_prefetch->cond);
+	pthread_mutex_destroy (&krad_prefetch->lock);
+	free (krad_prefetch->chunk);
+	free (krad_prefetch);
+
+}
+
+/* Only regular files are worth it, returns NULL for anything else */
+
+krad_prefetch_t *krad_prefetch_create (int fd, int seconds) {
+
+	krad_prefetch_t *krad_prefetch;
+	struct stat st;
+
+	if ((fd < 0) || (fstat (fd, &st) != 0) || (!S_ISREG (st.st_mode)) || (st.st_size == 0)) {
+		return NULL;
+	}
+
+	krad_prefetch = calloc (1, sizeof(krad_prefetch_t));
+
+	krad_prefetch->fd = fd;
+	krad_prefetch->file_size = st.st_size;
+	krad_prefetch->seconds = seconds;
+	krad_prefetch->chunk = malloc (KRAD_PREFETCH_CHUNK_SIZE);
+	krad_prefetch->run = 1;
+
+	/* a bigger kernel readahead window for the demuxer's own reads */
+	posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	pthread_mutex_init (&krad_prefetch->lock, NULL);
+	pthread_cond_init (&krad_prefetch->cond, NULL);
+
+	pthread_create (&krad_prefetch->thread, NULL, krad_prefetch_thread, (void *)krad_prefetch);
+
+	return krad_prefetch;
+
+}
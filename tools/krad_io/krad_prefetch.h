@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+
+#include "krad_system.h"
+
+#ifndef KRAD_PREFETCH_H
+#define KRAD_PREFETCH_H
+
+/* how far ahead of playback a file is kept read in */
+#define KRAD_PREFETCH_DEFAULT_SECONDS 10
+/* the window until the bitrate is known, and never less than this */
+#define KRAD_PREFETCH_MIN_WINDOW 4 * 1024 * 1024
+#define KRAD_PREFETCH_CHUNK_SIZE 1024 * 1024
+/* bitrate is only trusted once this much has played */
+#define KRAD_PREFETCH_RATE_MIN_MS 1000
+
+typedef struct krad_prefetch_St krad_prefetch_t;
+
+/* Reads a file ahead of whoever is demuxing it on its own thread, so the
+   pages are in the page cache by the time the demuxer reads or faults
+   on them and a slow disk stalls this thread instead of playback. */
+
+struct krad_prefetch_St {
+
+	int fd;
+	uint64_t file_size;
+	int seconds;
+
+	/* where the demuxer is, and what it has played to get there */
+	uint64_t position;
+	uint64_t timecode;
+	uint64_t start_position;
+	uint64_t start_timecode;
+	int started;
+	uint64_t bytes_per_second;
+
+	/* everything before this has been read in */
+	uint64_t prefetched;
+
+	unsigned char *chunk;
+	int run;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+};
+
+krad_prefetch_t *krad_prefetch_create (int fd, int seconds);
+void krad_prefetch_destroy (krad_prefetch_t *krad_prefetch);
+void krad_prefetch_update (krad_prefetch_t *krad_prefetch, uint64_t position, uint64_t timecode);
+/* playback time read in ahead of the demuxer, 0 until the bitrate is known */
+int krad_prefetch_buffered_ms (krad_prefetch_t *krad_prefetch);
+
+#endif
@@ -611,6 +611,23 @@ void krad_ipc_radio_set_dir (krad_ipc_client_t *client, char *dir) {
 
 }
 
+void krad_ipc_radio_set_freewheel (krad_ipc_client_t *client, int freewheel) {
+
+	uint64_t command;
+	uint64_t setfreewheel;
+
+	krad_ebml_start_element (client->krad_ebml, EBML_ID_KRAD_RADIO_CMD, &command);
+	krad_ebml_start_element (client->krad_ebml, EBML_ID_KRAD_RADIO_CMD_SET_FREEWHEEL, &setfreewheel);
+
+	krad_ebml_write_int8 (client->krad_ebml, EBML_ID_KRAD_RADIO_FREEWHEEL, freewheel);
+	
+	krad_ebml_finish_element (client->krad_ebml, setfreewheel);
+	krad_ebml_finish_element (client->krad_ebml, command);
+		
+	krad_ebml_write_sync (client->krad_ebml);
+
+}
+
 void krad_ipc_mixer_update_portgroup_map_channel (krad_ipc_client_t *client, char *portgroupname, int in_channel, int out_channel) {
 
 	//uint64_t ipc_command;
@@ -1242,7 +1259,7 @@ void krad_ipc_compositor_info (krad_ipc_client_t *client) {
 	
 }
 
-void krad_ipc_create_capture_link (krad_ipc_client_t *client, krad_link_video_source_t video_source) {
+void krad_ipc_create_capture_link (krad_ipc_client_t *client, krad_link_video_source_t video_source, char *spec) {
 
 	//uint64_t ipc_command;
 	uint64_t linker_command;
@@ -1260,6 +1277,17 @@ void krad_ipc_create_capture_link (krad_ipc_client_t *client, krad_link_video_so
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_OPERATION_MODE, krad_link_operation_mode_to_string (CAPTURE));
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_VIDEO_SOURCE, krad_link_video_source_to_string (video_source));
 	
+	if ((video_source == SYNTH) || (video_source == YUVFILE)) {
+		if (spec == NULL) {
+			spec = "bars";
+		}
+		krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_FILENAME, spec);
+	}
+
+	/* capture options, ie. "mjpeg yuv threads=4", only when some were given */
+	if ((video_source == V4L2) && (spec != NULL) && (spec[0] != '\0')) {
+		krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_FILENAME, spec);
+	}
 	
 	krad_ebml_finish_element (client->krad_ebml, link);
 
@@ -1335,6 +1363,10 @@ void krad_ipc_create_remote_playback_link (krad_ipc_client_t *client, char *host
 }
 
 void krad_ipc_create_playback_link (krad_ipc_client_t *client, char *path) {
+	krad_ipc_create_playback_link_from (client, path, 0);
+}
+
+void krad_ipc_create_playback_link_from (krad_ipc_client_t *client, char *path, uint64_t seek_ms) {
 
 	//uint64_t ipc_command;
 	uint64_t linker_command;
@@ -1352,6 +1384,7 @@ void krad_ipc_create_playback_link (krad_ipc_client_t *client, char *path) {
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_OPERATION_MODE, krad_link_operation_mode_to_string (PLAYBACK));
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_TRANSPORT_MODE, "filesystem");
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_FILENAME, path);
+	krad_ebml_write_int64 (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_SEEK_MS, seek_ms);
 	
 	krad_ebml_finish_element (client->krad_ebml, link);
 
@@ -1367,6 +1400,16 @@ void krad_ipc_create_transmit_link (krad_ipc_client_t *client, krad_link_av_mode
 									char *host, int port, char *mount, char *password, char *codecs,
 									int video_width, int video_height, int video_bitrate, int audio_bitrate) {
 
+	krad_ipc_create_simulcast_link (client, av_mode, host, port, mount, password, codecs,
+									video_width, video_height, video_bitrate, audio_bitrate, "");
+
+}
+
+void krad_ipc_create_simulcast_link (krad_ipc_client_t *client, krad_link_av_mode_t av_mode,
+									 char *host, int port, char *mount, char *password, char *codecs,
+									 int video_width, int video_height, int video_bitrate, int audio_bitrate,
+									 char *ladder) {
+
 	//uint64_t ipc_command;
 	uint64_t linker_command;
 	uint64_t create_link;
@@ -1456,6 +1499,7 @@ void krad_ipc_create_transmit_link (krad_ipc_client_t *client, krad_link_av_mode
 	krad_ebml_write_int32 (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_PORT, port);
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_MOUNT, mount);
 	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_PASSWORD, password);	
+	krad_ebml_write_string (client->krad_ebml, EBML_ID_KRAD_LINK_LINK_SIMULCAST, ladder);
 	
 	krad_ebml_finish_element (client->krad_ebml, link);
 
@@ -1971,6 +2015,10 @@ int krad_link_rep_to_string (krad_link_rep_t *krad_link, char *text) {
 							krad_opus_bandwidth_to_string (krad_link->opus_bandwidth));
 
 		}				
+
+		if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
+			pos += sprintf (text + pos, " Audio encode CPU %dms", krad_link->audio_encode_cpu_ms);
+		}
 				
 	}
 
@@ -1983,6 +2031,10 @@ int krad_link_rep_to_string (krad_link_rep_t *krad_link, char *text) {
 		if ((krad_link->transport_mode == UDP) || (krad_link->transport_mode == TCP)) {
 			pos += sprintf (text + pos, " Port %d", krad_link->port);
 		}
+
+		if (krad_link->video_decode_us > 0) {
+			pos += sprintf (text + pos, " Video decode %dus", krad_link->video_decode_us);
+		}
 	
 	}
 	
@@ -1993,13 +2045,17 @@ int krad_link_rep_to_string (krad_link_rep_t *krad_link, char *text) {
 						krad_link_transport_mode_to_string (krad_link->transport_mode));
 						
 		if (krad_link->transport_mode == FILESYSTEM) {
-			pos += sprintf (text + pos, " File %s", krad_link->filename);
+			pos += sprintf (text + pos, " File %s Buffered %dms", krad_link->filename, krad_link->buffered_ms);
 		}
 
 		if (krad_link->transport_mode == TCP) {
 			pos += sprintf (text + pos, " %s:%d%s",
 							krad_link->host, krad_link->port, krad_link->mount);
 		}
+
+		if (krad_link->video_decode_us > 0) {
+			pos += sprintf (text + pos, " Video decode %dus", krad_link->video_decode_us);
+		}
 	
 	}
 	
@@ -2142,6 +2198,11 @@ int krad_ipc_client_read_link ( krad_ipc_client_t *client, char *text, krad_link
 
 			krad_link->port = krad_ebml_read_number (client->krad_ebml, ebml_data_size);
 		}
+
+		krad_ebml_read_element (client->krad_ebml, &ebml_id, &ebml_data_size);
+		if (ebml_id == EBML_ID_KRAD_LINK_LINK_VIDEO_DECODE_US) {
+			krad_link->video_decode_us = krad_ebml_read_number (client->krad_ebml, ebml_data_size);
+		}
 	
 	}
 	
@@ -2170,6 +2231,11 @@ int krad_ipc_client_read_link ( krad_ipc_client_t *client, char *text, krad_link
 			}
 
 			krad_ebml_read_string (client->krad_ebml, krad_link->filename, ebml_data_size);
+			
+			krad_ebml_read_element (client->krad_ebml, &ebml_id, &ebml_data_size);
+			if (ebml_id == EBML_ID_KRAD_LINK_LINK_BUFFERED_MS) {
+				krad_link->buffered_ms = krad_ebml_read_number (client->krad_ebml, ebml_data_size);
+			}
 		}
 	
 		if (krad_link->transport_mode == TCP) {
@@ -2205,7 +2271,11 @@ int krad_ipc_client_read_link ( krad_ipc_client_t *client, char *text, krad_link
 			krad_ebml_read_string (client->krad_ebml, krad_link->mount, ebml_data_size);
 		
 		}	
-	
+
+		krad_ebml_read_element (client->krad_ebml, &ebml_id, &ebml_data_size);
+		if (ebml_id == EBML_ID_KRAD_LINK_LINK_VIDEO_DECODE_US) {
+			krad_link->video_decode_us = krad_ebml_read_number (client->krad_ebml, ebml_data_size);
+		}
 	
 	}
 	
@@ -2351,6 +2421,13 @@ int krad_ipc_client_read_link ( krad_ipc_client_t *client, char *text, krad_link
 
 		}
 
+		if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
+			krad_ebml_read_element (client->krad_ebml, &ebml_id, &ebml_data_size);
+			if (ebml_id == EBML_ID_KRAD_LINK_LINK_AUDIO_ENCODE_CPU_MS) {
+				krad_link->audio_encode_cpu_ms = krad_ebml_read_number (client->krad_ebml, ebml_data_size);
+			}
+		}
+
 	}
 	
 	krad_link_rep_to_string ( krad_link, text );
@@ -99,6 +99,8 @@ void krad_ipc_disable_linker_listen (krad_ipc_client_t *client);
 void krad_ipc_enable_osc (krad_ipc_client_t *client, int port);
 void krad_ipc_disable_osc (krad_ipc_client_t *client);
 void krad_ipc_create_playback_link (krad_ipc_client_t *client, char *path);
+/* starts playing from the last keyframe at or before seek_ms */
+void krad_ipc_create_playback_link_from (krad_ipc_client_t *client, char *path, uint64_t seek_ms);
 void krad_ipc_create_remote_playback_link (krad_ipc_client_t *client, char *host, int port, char *mount);
 int krad_link_rep_to_string (krad_link_rep_t *krad_link, char *text);
 
@@ -114,6 +116,7 @@ void krad_ipc_compositor_vu (krad_ipc_client_t *client, int on_off);
 void krad_ipc_mixer_push_tone (krad_ipc_client_t *client, char *tone);
 
 void krad_ipc_radio_set_dir (krad_ipc_client_t *client, char *dir);
+void krad_ipc_radio_set_freewheel (krad_ipc_client_t *client, int freewheel);
 
 void krad_ipc_mixer_bind_portgroup_xmms2 (krad_ipc_client_t *client, char *portgroupname, char *ipc_path);
 void krad_ipc_mixer_unbind_portgroup_xmms2 (krad_ipc_client_t *client, char *portgroupname);
@@ -133,11 +136,16 @@ void krad_ipc_create_receive_link (krad_ipc_client_t *client, int port);
 void krad_ipc_create_record_link (krad_ipc_client_t *client, krad_link_av_mode_t av_mode, char *filename, char *codecs,
 								  int video_width, int video_height, int video_bitrate, int audio_bitrate);
 
-void krad_ipc_create_capture_link (krad_ipc_client_t *client, krad_link_video_source_t video_source);
+void krad_ipc_create_capture_link (krad_ipc_client_t *client, krad_link_video_source_t video_source, char *spec);
 
 void krad_ipc_create_transmit_link (krad_ipc_client_t *client, krad_link_av_mode_t av_mode, char *host, int port,
 									char *mount, char *password, char *codecs,
 									int video_width, int video_height, int video_bitrate, int audio_bitrate);
+/* ladder is "1920x1080:4500,1280x720:2500,640x360:800", largest first, kbit/s */
+void krad_ipc_create_simulcast_link (krad_ipc_client_t *client, krad_link_av_mode_t av_mode, char *host, int port,
+									 char *mount, char *password, char *codecs,
+									 int video_width, int video_height, int video_bitrate, int audio_bitrate,
+									 char *ladder);
 
 void krad_ipc_list_links (krad_ipc_client_t *client);
 void krad_ipc_destroy_link (krad_ipc_client_t *client, int number);
@@ -11,6 +11,7 @@ krad_ipc_server_t *krad_ipc_server_init (char *sysname) {
 	}
 	
 	krad_ipc_server->shutdown = KRAD_IPC_STARTING;
+	pthread_mutex_init (&krad_ipc_server->subscriber_lock, NULL);
 	
 	if ((krad_ipc_server->clients = calloc (KRAD_IPC_SERVER_MAX_CLIENTS, sizeof (krad_ipc_server_client_t))) == NULL) {
 		krad_ipc_server_destroy (krad_ipc_server);
@@ -556,8 +557,35 @@ void krad_ipc_server_mixer_broadcast2 ( krad_ipc_server_t *krad_ipc_server, uint
 	}
 }
 
+void krad_ipc_server_set_subscriber ( krad_ipc_server_t *krad_ipc_server, void *subscriber_pointer,
+									  void (*control_callback)(void *, char *, char *, float),
+									  void (*tag_callback)(void *, char *, char *, char *)) {
+
+	/* once this returns a subscriber being cleared is not in a callback */
+	pthread_mutex_lock (&krad_ipc_server->subscriber_lock);
+
+	if (subscriber_pointer == NULL) {
+		krad_ipc_server->subscriber_control_callback = NULL;
+		krad_ipc_server->subscriber_tag_callback = NULL;
+		krad_ipc_server->subscriber_pointer = NULL;
+	} else {
+		krad_ipc_server->subscriber_pointer = subscriber_pointer;
+		krad_ipc_server->subscriber_control_callback = control_callback;
+		krad_ipc_server->subscriber_tag_callback = tag_callback;
+	}
+
+	pthread_mutex_unlock (&krad_ipc_server->subscriber_lock);
+
+}
+
 void krad_ipc_server_mixer_broadcast ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint32_t ebml_subid, char *portname, char *controlname, float floatval) {
 
+	krad_ipc_server_mixer_broadcast_skip (krad_ipc_server, ebml_id, ebml_subid, portname, controlname, floatval, krad_ipc_server->current_client);
+
+}
+
+void krad_ipc_server_mixer_broadcast_skip ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint32_t ebml_subid, char *portname, char *controlname, float floatval, krad_ipc_server_client_t *skip_client) {
+
 	int c;
 
 	uint64_t element;
@@ -566,8 +594,15 @@ void krad_ipc_server_mixer_broadcast ( krad_ipc_server_t *krad_ipc_server, uint3
 	element = 0;
 	subelement = 0;
 
+	pthread_mutex_lock (&krad_ipc_server->subscriber_lock);
+	if (krad_ipc_server->subscriber_control_callback != NULL) {
+		krad_ipc_server->subscriber_control_callback (krad_ipc_server->subscriber_pointer, portname, controlname, floatval);
+	}
+	pthread_mutex_unlock (&krad_ipc_server->subscriber_lock);
+
 	for (c = 0; c < KRAD_IPC_SERVER_MAX_CLIENTS; c++) {
-		if ((krad_ipc_server->clients[c].confirmed == 1) && (krad_ipc_server->current_client != &krad_ipc_server->clients[c])) {
+		if ((krad_ipc_server->clients[c].confirmed == 1) && (skip_client != &krad_ipc_server->clients[c])) {
+			pthread_mutex_lock (&krad_ipc_server->clients[c].client_lock);
 			krad_ebml_start_element (krad_ipc_server->clients[c].krad_ebml2, ebml_id, &element);	
 			krad_ebml_start_element (krad_ipc_server->clients[c].krad_ebml2, ebml_subid, &subelement);	
 			krad_ebml_write_string (krad_ipc_server->clients[c].krad_ebml2, EBML_ID_KRAD_MIXER_PORTGROUP_NAME, portname);
@@ -576,6 +611,7 @@ void krad_ipc_server_mixer_broadcast ( krad_ipc_server_t *krad_ipc_server, uint3
 			krad_ebml_finish_element (krad_ipc_server->clients[c].krad_ebml2, subelement);
 			krad_ebml_finish_element (krad_ipc_server->clients[c].krad_ebml2, element);
 			krad_ebml_write_sync (krad_ipc_server->clients[c].krad_ebml2);
+			pthread_mutex_unlock (&krad_ipc_server->clients[c].client_lock);
 		}
 	}
 }
@@ -590,6 +626,12 @@ void krad_ipc_server_broadcast_tag ( krad_ipc_server_t *krad_ipc_server, char *i
 	element = 0;
 	subelement = 0;
 
+	pthread_mutex_lock (&krad_ipc_server->subscriber_lock);
+	if (krad_ipc_server->subscriber_tag_callback != NULL) {
+		krad_ipc_server->subscriber_tag_callback (krad_ipc_server->subscriber_pointer, item, name, value);
+	}
+	pthread_mutex_unlock (&krad_ipc_server->subscriber_lock);
+
 	for (c = 0; c < KRAD_IPC_SERVER_MAX_CLIENTS; c++) {
 		//if ((krad_ipc_server->clients[c].confirmed == 1) && (krad_ipc_server->current_client != &krad_ipc_server->clients[c])) {
 		if (krad_ipc_server->clients[c].confirmed == 1) {		
@@ -614,6 +656,8 @@ void *krad_ipc_server_run_thread (void *arg) {
 	krad_ipc_server_t *krad_ipc_server = (krad_ipc_server_t *)arg;
 	krad_ipc_server_client_t *client;
 	int ret, s;
+	int read_space;
+	uint64_t corruptions;
 	
 	krad_ipc_server->shutdown = KRAD_IPC_RUNNING;
 	
@@ -704,6 +748,8 @@ void *krad_ipc_server_run_thread (void *arg) {
 							}
 						
 							while (krad_ebml_io_buffer_read_space (&client->krad_ebml->io_adapter)) {
+								read_space = krad_ebml_io_buffer_read_space (&client->krad_ebml->io_adapter);
+								corruptions = client->krad_ebml->corruptions;
 								client->krad_ipc_server->current_client = client; /* single thread has a few perks */
 								pthread_mutex_lock (&client->client_lock);
 								//resp = client->krad_ipc_server->handler (client->output_buffer, &client->command_response_len, client->krad_ipc_server->pointer);
@@ -711,6 +757,15 @@ void *krad_ipc_server_run_thread (void *arg) {
 								//printk ("Krad IPC Server: CMD Response %d %d bytes\n", resp, client->command_response_len);
 								krad_ebml_write_sync (krad_ipc_server->current_client->krad_ebml2);
 								pthread_mutex_unlock (&client->client_lock);
+								/* a command that made no sense, or that nothing could be
+								   read from, costs that client its connection, not the
+								   whole station */
+								if ((client->krad_ebml->corruptions != corruptions) ||
+									(krad_ebml_io_buffer_read_space (&client->krad_ebml->io_adapter) == read_space)) {
+									printke ("Krad IPC Server: Malformed command from client, disconnecting it");
+									krad_ipc_disconnect_client (client);
+									break;
+								}
 							}
 						
 						}
@@ -841,6 +896,7 @@ void krad_ipc_server_destroy (krad_ipc_server_t *krad_ipc_server) {
 	
 	
 	free (krad_ipc_server->clients);
+	pthread_mutex_destroy (&krad_ipc_server->subscriber_lock);
 	free (krad_ipc_server);
 	
 }
@@ -78,6 +78,13 @@ struct krad_ipc_server_St {
 
 	int (*handler)(void *, int *, void *);
 	void *pointer;
+
+	/* in-process subscriber to broadcasts, ie. the websocket server,
+	   held while it is set, cleared or called */
+	pthread_mutex_t subscriber_lock;
+	void *subscriber_pointer;
+	void (*subscriber_control_callback)(void *, char *, char *, float);
+	void (*subscriber_tag_callback)(void *, char *, char *, char *);
 	
 };
 
@@ -108,6 +115,9 @@ struct krad_ipc_server_client_St {
 
 
 void krad_ipc_server_broadcast_tag ( krad_ipc_server_t *krad_ipc_server, char *item, char *name, char *value);
+void krad_ipc_server_set_subscriber ( krad_ipc_server_t *krad_ipc_server, void *subscriber_pointer,
+									  void (*control_callback)(void *, char *, char *, float),
+									  void (*tag_callback)(void *, char *, char *, char *));
 
 void krad_ipc_server_respond_string ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, char *string);
 
@@ -138,6 +148,7 @@ void krad_ipc_server_broadcast_portgroup_created ( krad_ipc_server_t *krad_ipc_s
 void krad_ipc_server_mixer_broadcast2 ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint32_t ebml_subid, char *portname, uint32_t ebml_subid2, char *string);
 void krad_ipc_server_simple_broadcast ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint32_t ebml_subid, uint32_t ebml_subid2, char *string);
 void krad_ipc_server_mixer_broadcast ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint32_t ebml_subid, char *portname, char *controlname, float floatval);
+void krad_ipc_server_mixer_broadcast_skip ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint32_t ebml_subid, char *portname, char *controlname, float floatval, krad_ipc_server_client_t *skip_client);
 void krad_ipc_server_respond_number ( krad_ipc_server_t *krad_ipc_server, uint32_t ebml_id, uint64_t number);
 int krad_ipc_server_read_command (krad_ipc_server_t *krad_ipc_server, uint32_t *ebml_id_ptr, uint64_t *ebml_data_size_ptr);
 uint64_t krad_ipc_server_read_number (krad_ipc_server_t *krad_ipc_server, uint64_t data_size);
@@ -0,0 +1,263 @@
+#include "krad_encode_pool.h"
+
+/* called with the lock held */
+
+static void krad_encode_pool_enqueue (krad_encode_pool_t *krad_encode_pool, krad_encode_job_t *krad_encode_job) {
+
+	krad_encode_job->next = NULL;
+	krad_encode_job->queued = 1;
+
+	if (krad_encode_pool->tail != NULL) {
+		krad_encode_pool->tail->next = krad_encode_job;
+	} else {
+		krad_encode_pool->head = krad_encode_job;
+	}
+	krad_encode_pool->tail = krad_encode_job;
+
+	sem_post (&krad_encode_pool->wake);
+
+}
+
+/* called with the lock held */
+
+static void krad_encode_pool_post (krad_encode_pool_t *krad_encode_pool, krad_encode_job_t *krad_encode_job) {
+
+	if (krad_encode_job->running) {
+		krad_encode_job->posted_while_running = 1;
+	} else {
+		if (!krad_encode_job->queued) {
+			krad_encode_pool_enqueue (krad_encode_pool, krad_encode_job);
+		}
+	}
+
+}
+
+/* called with the lock held */
+
+static void krad_encode_pool_take_pending (krad_encode_pool_t *krad_encode_pool) {
+
+	krad_encode_job_t *krad_encode_job;
+
+	if (!__sync_bool_compare_and_swap (&krad_encode_pool->pending, 1, 0)) {
+		return;
+	}
+
+	for (krad_encode_job = krad_encode_pool->jobs; krad_encode_job != NULL; krad_encode_job = krad_encode_job->next_job) {
+		if (__sync_bool_compare_and_swap (&krad_encode_job->pending, 1, 0)) {
+			krad_encode_pool_post (krad_encode_pool, krad_encode_job);
+		}
+	}
+
+}
+
+static void *krad_encode_pool_worker (void *arg) {
+
+	krad_encode_pool_t *krad_encode_pool = (krad_encode_pool_t *)arg;
+
+	krad_encode_job_t *krad_encode_job;
+	struct timespec start;
+	struct timespec end;
+
+	prctl (PR_SET_NAME, (unsigned long) "krad_encode", 0, 0, 0);
+
+	pthread_mutex_lock (&krad_encode_pool->lock);
+
+	while (krad_encode_pool->run) {
+
+		krad_encode_pool_take_pending (krad_encode_pool);
+
+		if (krad_encode_pool->head == NULL) {
+			pthread_mutex_unlock (&krad_encode_pool->lock);
+			while ((sem_wait (&krad_encode_pool->wake) != 0) && (errno == EINTR)) {
+				continue;
+			}
+			pthread_mutex_lock (&krad_encode_pool->lock);
+			continue;
+		}
+
+		krad_encode_job = krad_encode_pool->head;
+		krad_encode_pool->head = krad_encode_job->next;
+		if (krad_encode_pool->head == NULL) {
+			krad_encode_pool->tail = NULL;
+		}
+
+		krad_encode_job->queued = 0;
+		krad_encode_job->running = 1;
+
+		pthread_mutex_unlock (&krad_encode_pool->lock);
+
+		clock_gettime (CLOCK_THREAD_CPUTIME_ID, &start);
+		krad_encode_job->run (krad_encode_job->user);
+		clock_gettime (CLOCK_THREAD_CPUTIME_ID, &end);
+
+		pthread_mutex_lock (&krad_encode_pool->lock);
+
+		krad_encode_job->cpu_us += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+		krad_encode_job->runs++;
+		krad_encode_job->running = 0;
+
+		if (krad_encode_job->posted_while_running) {
+			krad_encode_job->posted_while_running = 0;
+			krad_encode_pool_enqueue (krad_encode_pool, krad_encode_job);
+		}
+
+		pthread_cond_broadcast (&krad_encode_pool->done_cond);
+	}
+
+	pthread_mutex_unlock (&krad_encode_pool->lock);
+
+	return NULL;
+
+}
+
+void krad_encode_job_post (krad_encode_job_t *krad_encode_job) {
+
+	krad_encode_pool_t *krad_encode_pool;
+
+	krad_encode_pool = krad_encode_job->krad_encode_pool;
+
+	/* if the lock is busy the post is left pending and a worker woken,
+	   it takes the post up once it has the lock */
+	if (pthread_mutex_trylock (&krad_encode_pool->lock) != 0) {
+		__sync_fetch_and_or (&krad_encode_job->pending, 1);
+		__sync_fetch_and_or (&krad_encode_pool->pending, 1);
+		sem_post (&krad_encode_pool->wake);
+		return;
+	}
+
+	krad_encode_pool_post (krad_encode_pool, krad_encode_job);
+	krad_encode_pool_take_pending (krad_encode_pool);
+
+	pthread_mutex_unlock (&krad_encode_pool->lock);
+
+}
+
+uint64_t krad_encode_job_cpu_us (krad_encode_job_t *krad_encode_job) {
+
+	uint64_t cpu_us;
+
+	pthread_mutex_lock (&krad_encode_job->krad_encode_pool->lock);
+	cpu_us = krad_encode_job->cpu_us;
+	pthread_mutex_unlock (&krad_encode_job->krad_encode_pool->lock);
+
+	return cpu_us;
+
+}
+
+krad_encode_job_t *krad_encode_pool_add_job (krad_encode_pool_t *krad_encode_pool, char *name,
+											 void (*run)(void *user), void *user) {
+
+	krad_encode_job_t *krad_encode_job;
+
+	krad_encode_job = calloc (1, sizeof(krad_encode_job_t));
+
+	krad_encode_job->krad_encode_pool = krad_encode_pool;
+	strncpy (krad_encode_job->name, name, sizeof(krad_encode_job->name) - 1);
+	krad_encode_job->run = run;
+	krad_encode_job->user = user;
+
+	pthread_mutex_lock (&krad_encode_pool->lock);
+	krad_encode_job->next_job = krad_encode_pool->jobs;
+	krad_encode_pool->jobs = krad_encode_job;
+	pthread_mutex_unlock (&krad_encode_pool->lock);
+
+	return krad_encode_job;
+
+}
+
+void krad_encode_pool_remove_job (krad_encode_pool_t *krad_encode_pool, krad_encode_job_t *krad_encode_job) {
+
+	krad_encode_job_t **link;
+
+	pthread_mutex_lock (&krad_encode_pool->lock);
+
+	while (krad_encode_job->running) {
+		pthread_cond_wait (&krad_encode_pool->done_cond, &krad_encode_pool->lock);
+	}
+
+	link = &krad_encode_pool->jobs;
+	while (*link != krad_encode_job) {
+		link = &(*link)->next_job;
+	}
+	*link = krad_encode_job->next_job;
+
+	if (krad_encode_job->queued) {
+		krad_encode_pool->tail = NULL;
+		link = &krad_encode_pool->head;
+		while (*link != NULL) {
+			if (*link == krad_encode_job) {
+				*link = krad_encode_job->next;
+			} else {
+				krad_encode_pool->tail = *link;
+				link = &(*link)->next;
+			}
+		}
+	}
+
+	pthread_mutex_unlock (&krad_encode_pool->lock);
+
+	printk ("Krad Encode Pool: %s used %"PRIu64"ms of cpu over %"PRIu64" runs",
+			krad_encode_job->name, krad_encode_job->cpu_us / 1000, krad_encode_job->runs);
+
+	free (krad_encode_job);
+
+}
+
+void krad_encode_pool_destroy (krad_encode_pool_t *krad_encode_pool) {
+
+	int w;
+
+	pthread_mutex_lock (&krad_encode_pool->lock);
+	krad_encode_pool->run = 0;
+	pthread_mutex_unlock (&krad_encode_pool->lock);
+
+	for (w = 0; w < krad_encode_pool->worker_count; w++) {
+		sem_post (&krad_encode_pool->wake);
+	}
+
+	for (w = 0; w < krad_encode_pool->worker_count; w++) {
+		pthread_join (krad_encode_pool->workers[w], NULL);
+	}
+
+	pthread_cond_destroy (&krad_encode_pool->done_cond);
+	sem_destroy (&krad_encode_pool->wake);
+	pthread_mutex_destroy (&krad_encode_pool->lock);
+	free (krad_encode_pool);
+
+}
+
+krad_encode_pool_t *krad_encode_pool_create (int workers) {
+
+	krad_encode_pool_t *krad_encode_pool;
+	int w;
+
+	if (workers <= 0) {
+		workers = sysconf (_SC_NPROCESSORS_ONLN);
+	}
+
+	if (workers < 1) {
+		workers = 1;
+	}
+
+	if (workers > KRAD_ENCODE_POOL_MAX_WORKERS) {
+		workers = KRAD_ENCODE_POOL_MAX_WORKERS;
+	}
+
+	krad_encode_pool = calloc (1, sizeof(krad_encode_pool_t));
+
+	krad_encode_pool->worker_count = workers;
+	krad_encode_pool->run = 1;
+
+	pthread_mutex_init (&krad_encode_pool->lock, NULL);
+	sem_init (&krad_encode_pool->wake, 0, 0);
+	pthread_cond_init (&krad_encode_pool->done_cond, NULL);
+
+	for (w = 0; w < krad_encode_pool->worker_count; w++) {
+		pthread_create (&krad_encode_pool->workers[w], NULL, krad_encode_pool_worker, (void *)krad_encode_pool);
+	}
+
+	printk ("Krad Encode Pool: %d workers", krad_encode_pool->worker_count);
+
+	return krad_encode_pool;
+
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/prctl.h>
+
+#include "krad_system.h"
+
+#ifndef KRAD_ENCODE_POOL_H
+#define KRAD_ENCODE_POOL_H
+
+#define KRAD_ENCODE_POOL_MAX_WORKERS 16
+
+typedef struct krad_encode_pool_St krad_encode_pool_t;
+typedef struct krad_encode_job_St krad_encode_job_t;
+
+/* A job is one encoder, run whenever it is posted on whichever worker is
+   free. A job is never run by two workers at once, posting it while it
+   runs has it run again straight after. Posting never waits on the pool
+   lock, so the mixer can post from its realtime thread, a post that finds
+   the lock busy is left pending and a worker is woken to take it up. */
+
+struct krad_encode_job_St {
+
+	krad_encode_pool_t *krad_encode_pool;
+	char name[64];
+
+	void (*run)(void *user);
+	void *user;
+
+	int queued;
+	int running;
+	int posted_while_running;
+	/* posted while the lock was busy, taken up by the next post or
+	   worker to get the lock */
+	int pending;
+
+	/* cpu time its runs have taken on the workers */
+	uint64_t cpu_us;
+	uint64_t runs;
+
+	krad_encode_job_t *next;
+	krad_encode_job_t *next_job;
+
+};
+
+struct krad_encode_pool_St {
+
+	pthread_t workers[KRAD_ENCODE_POOL_MAX_WORKERS];
+	int worker_count;
+
+	/* posted jobs, run in the order they were posted */
+	krad_encode_job_t *head;
+	krad_encode_job_t *tail;
+	/* every job, and whether any of them has a post pending */
+	krad_encode_job_t *jobs;
+	int pending;
+
+	int run;
+	pthread_mutex_t lock;
+	/* workers sleep on this rather than a condition so a post can wake
+	   one without the lock, every enqueue and pending post counts up */
+	sem_t wake;
+	pthread_cond_t done_cond;
+
+};
+
+/* workers 0 is one per core */
+krad_encode_pool_t *krad_encode_pool_create (int workers);
+void krad_encode_pool_destroy (krad_encode_pool_t *krad_encode_pool);
+
+krad_encode_job_t *krad_encode_pool_add_job (krad_encode_pool_t *krad_encode_pool, char *name,
+											 void (*run)(void *user), void *user);
+/* waits for the job to finish running if it is */
+void krad_encode_pool_remove_job (krad_encode_pool_t *krad_encode_pool, krad_encode_job_t *krad_encode_job);
+
+void krad_encode_job_post (krad_encode_job_t *krad_encode_job);
+uint64_t krad_encode_job_cpu_us (krad_encode_job_t *krad_encode_job);
+
+#endif
@@ -9,6 +9,126 @@ static void krad_linker_listen_create_client (krad_linker_t *krad_linker, int sd
 static void *krad_linker_listen_client_thread (void *arg);
 
 
+static void krad_link_v4l2_buffer_release (void *pointer, int index) {
+
+	krad_v4l2_t *krad_v4l2 = (krad_v4l2_t *)pointer;
+
+	kradv4l2_buffer_done (krad_v4l2, index);
+}
+
+/* frames come back from the mjpeg decoder threads in capture order */
+
+static void krad_link_mjpeg_decoded (void *pointer, krad_v4l2_mjpeg_job_t *job) {
+
+	krad_link_t *krad_link = (krad_link_t *)pointer;
+	krad_frame_t *krad_frame;
+	int b;
+	
+	krad_frame = job->user;
+
+	for (b = 0; b < krad_link->krad_v4l2->n_buffers; b++) {
+		if (krad_link->krad_v4l2->buffers[b].start == job->mjpeg) {
+			kradv4l2_buffer_done (krad_link->krad_v4l2, b);
+			break;
+		}
+	}
+
+	if (!job->failed) {
+		if (krad_link->mjpeg_decode_yuv) {
+			if (job->yuv_subsampling == TJSAMP_420) {
+				krad_frame->format = PIX_FMT_YUVJ420P;
+			} else if (job->yuv_subsampling == TJSAMP_444) {
+				krad_frame->format = PIX_FMT_YUVJ444P;
+			} else {
+				krad_frame->format = PIX_FMT_YUVJ422P;
+			}
+			for (b = 0; b < 4; b++) {
+				krad_frame->yuv_pixels[b] = job->yuv_pixels[b];
+				krad_frame->yuv_strides[b] = job->yuv_strides[b];
+			}
+			krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
+		} else {
+			krad_compositor_port_push_rgba_frame (krad_link->krad_compositor_port, krad_frame);
+		}
+	}
+
+	krad_framepool_unref_frame (krad_frame);
+}
+
+/* how many captured buffers may wait for the YUYV conversion, the driver
+   always keeps one to capture into and the converter may hold another,
+   past this frames are requeued and dropped */
+
+static int krad_link_captured_buffers_max (krad_link_t *krad_link) {
+
+	if (krad_link->krad_v4l2->n_buffers > 3) {
+		return krad_link->krad_v4l2->n_buffers - 2;
+	}
+
+	return 1;
+}
+
+/* YUYV conversion happens here so the capture thread only ever dequeues
+   buffers and never waits on it */
+
+void *video_capture_decoding_thread (void *arg) {
+
+	prctl (PR_SET_NAME, (unsigned long) "kradlink_vidcapdec", 0, 0, 0);
+
+	krad_link_t *krad_link = (krad_link_t *)arg;
+
+	krad_link_captured_buffer_t captured_buffer;
+	krad_frame_t *krad_frame;
+	unsigned char *captured_frame;
+
+	printk ("Video capture decoding thread started");
+
+	while (1) {
+
+		if (krad_ringbuffer_read_space (krad_link->captured_video_ringbuffer) < sizeof (krad_link_captured_buffer_t)) {
+			if (krad_link->capture_decoding != 1) {
+				break;
+			}
+			usleep (2000);
+			continue;
+		}
+
+		krad_ringbuffer_read (krad_link->captured_video_ringbuffer, (char *)&captured_buffer,
+							  sizeof (krad_link_captured_buffer_t));
+
+		captured_frame = krad_link->krad_v4l2->buffers[captured_buffer.index].start;
+
+		krad_frame = krad_framepool_getframe (krad_link->krad_framepool);
+
+		if (krad_frame == NULL) {
+			kradv4l2_buffer_done (krad_link->krad_v4l2, captured_buffer.index);
+			continue;
+		}
+
+		krad_frame->format = PIX_FMT_YUYV422;
+
+		krad_frame->yuv_pixels[0] = captured_frame;
+		krad_frame->yuv_pixels[1] = NULL;
+		krad_frame->yuv_pixels[2] = NULL;
+
+		krad_frame->yuv_strides[0] = krad_link->capture_width + (krad_link->capture_width/2) * 2;
+		krad_frame->yuv_strides[1] = 0;
+		krad_frame->yuv_strides[2] = 0;
+		krad_frame->yuv_strides[3] = 0;
+
+		krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
+
+		kradv4l2_buffer_done (krad_link->krad_v4l2, captured_buffer.index);
+
+		krad_framepool_unref_frame (krad_frame);
+	}
+
+	printk ("Video capture decoding thread exited");
+
+	return NULL;
+
+}
+
 void *video_capture_thread (void *arg) {
 
 	prctl (PR_SET_NAME, (unsigned long) "kradlink_vidcap", 0, 0, 0);
@@ -17,18 +137,19 @@ void *video_capture_thread (void *arg) {
 
 	void *captured_frame = NULL;
 	krad_frame_t *krad_frame;
+	krad_link_captured_buffer_t captured_buffer;
+	int passthru;
+	int patience;
 	
 	printk ("Video capture thread started");
 	
-	krad_link->krad_framepool = krad_framepool_create ( krad_link->capture_width,
-														krad_link->capture_height,
-														DEFAULT_CAPTURE_BUFFER_FRAMES);
+	passthru = ((krad_link->mjpeg_mode == 1) && (krad_link->mjpeg_passthru == 1));
 	
 	krad_link->krad_v4l2 = kradv4l2_create ();
 
 	krad_link->krad_v4l2->mjpeg_mode = krad_link->mjpeg_mode;
 
-	if ((krad_link->mjpeg_mode == 1) && (krad_link->mjpeg_passthru == 1)) {
+	if (passthru) {
 		krad_link->krad_compositor_port = 
 		krad_compositor_mjpeg_port_create (krad_link->krad_radio->krad_compositor, "V4L2MJPEGIn", INPUT);
 	} else {
@@ -39,6 +160,35 @@ void *video_capture_thread (void *arg) {
 
 	kradv4l2_open (krad_link->krad_v4l2, krad_link->device, krad_link->capture_width, 
 				   krad_link->capture_height, krad_link->capture_fps);
+
+	if (passthru) {
+		/* the compositor gets frames pointing right at the v4l2 buffers,
+		   which are requeued when the last user is done with them */
+		krad_link->krad_framepool = krad_framepool_create_wrapped ( krad_link->capture_width,
+																	krad_link->capture_height,
+																	krad_link->krad_v4l2->n_buffers);
+	} else if (krad_link->mjpeg_mode == 1) {
+		krad_link->krad_framepool = krad_framepool_create ( krad_link->capture_width,
+															krad_link->capture_height,
+															DEFAULT_CAPTURE_BUFFER_FRAMES);
+
+		krad_link->krad_mjpeg_decoder = kradv4l2_mjpeg_decoder_create (krad_link->capture_width,
+																	   krad_link->capture_height,
+																	   krad_link->mjpeg_decode_threads,
+																	   krad_link->mjpeg_decode_yuv,
+																	   krad_link_mjpeg_decoded,
+																	   krad_link);
+	} else {
+		krad_link->krad_framepool = krad_framepool_create ( krad_link->capture_width,
+															krad_link->capture_height,
+															DEFAULT_CAPTURE_BUFFER_FRAMES);
+
+		krad_link->captured_video_ringbuffer =
+			krad_ringbuffer_create (krad_link_captured_buffers_max (krad_link) * sizeof (krad_link_captured_buffer_t) + 1);
+
+		krad_link->capture_decoding = 1;
+		pthread_create (&krad_link->video_capture_decoding_thread, NULL, video_capture_decoding_thread, (void *)krad_link);
+	}
 	
 	kradv4l2_start_capturing (krad_link->krad_v4l2);
 
@@ -46,62 +196,103 @@ void *video_capture_thread (void *arg) {
 
 	while (krad_link->capturing == 1) {
 
+		if ((passthru) && (krad_framepool_frames_in_use (krad_link->krad_framepool) >= krad_link->krad_v4l2->n_buffers - 1)) {
+			/* everything is held downstream, waiting in select would time out */
+			usleep (2000);
+			continue;
+		}
+
 		captured_frame = kradv4l2_read_frame_wait_adv (krad_link->krad_v4l2);
 		
-		krad_frame = krad_framepool_getframe (krad_link->krad_framepool);
-		
-		if ((krad_link->mjpeg_mode == 1) && (krad_link->mjpeg_passthru == 0)) {
-			kradv4l2_mjpeg_to_rgb (krad_link->krad_v4l2, (unsigned char *)krad_frame->pixels,
-								   captured_frame, krad_link->krad_v4l2->jpeg_size);
+		if (captured_frame == NULL) {
+			continue;
 		}
-
-		if ((krad_link->mjpeg_mode == 1) && (krad_link->mjpeg_passthru == 1)) {
-			memcpy (krad_frame->pixels, captured_frame, krad_link->krad_v4l2->jpeg_size);
-			krad_frame->mjpeg_size = krad_link->krad_v4l2->jpeg_size;			
-			kradv4l2_frame_done (krad_link->krad_v4l2);
-			krad_compositor_port_push_frame (krad_link->krad_compositor_port, krad_frame);			
+		
+		if (passthru) {
+		
+			krad_frame = krad_framepool_getframe (krad_link->krad_framepool);
 			
-		} else {			
-			if ((krad_link->mjpeg_mode == 1) && (krad_link->mjpeg_passthru == 0)) {
+			if (krad_frame == NULL) {
 				kradv4l2_frame_done (krad_link->krad_v4l2);
-				krad_compositor_port_push_rgba_frame (krad_link->krad_compositor_port, krad_frame);
-			} else {
+				continue;
+			}
+		
+			krad_frame->pixels = captured_frame;
+			krad_frame->mjpeg_size = krad_link->krad_v4l2->jpeg_size;
+			krad_frame->release_pointer = krad_link->krad_v4l2;
+			krad_frame->release_id = krad_link->krad_v4l2->buf.index;
+			krad_frame->release_callback = krad_link_v4l2_buffer_release;
 			
-				krad_frame->format = PIX_FMT_YUYV422;
-
-				krad_frame->yuv_pixels[0] = captured_frame;
-				krad_frame->yuv_pixels[1] = NULL;
-				krad_frame->yuv_pixels[2] = NULL;
-
-				krad_frame->yuv_strides[0] = krad_link->capture_width + (krad_link->capture_width/2) * 2;
-				krad_frame->yuv_strides[1] = 0;
-				krad_frame->yuv_strides[2] = 0;
-				krad_frame->yuv_strides[3] = 0;
-
-				krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
-				
-				kradv4l2_frame_done (krad_link->krad_v4l2);				
-				
-			}	
+			krad_compositor_port_push_frame (krad_link->krad_compositor_port, krad_frame);
+			krad_framepool_unref_frame (krad_frame);
+			krad_compositor_mjpeg_process (krad_link->krad_radio->krad_compositor);
 			
-		}
-
-		krad_framepool_unref_frame (krad_frame);
+		} else if (krad_link->mjpeg_mode == 1) {
+		
+			krad_frame = krad_framepool_getframe (krad_link->krad_framepool);
+			
+			if (krad_frame == NULL) {
+				kradv4l2_frame_done (krad_link->krad_v4l2);
+				continue;
+			}
+			
+			if (kradv4l2_mjpeg_decoder_submit (krad_link->krad_mjpeg_decoder, captured_frame,
+											   krad_link->krad_v4l2->jpeg_size,
+											   (unsigned char *)krad_frame->pixels, krad_frame) < 0) {
+				krad_framepool_unref_frame (krad_frame);
+				kradv4l2_frame_done (krad_link->krad_v4l2);
+			}
 		
-		if ((krad_link->mjpeg_mode == 1) && (krad_link->mjpeg_passthru == 1)) {
-			krad_compositor_mjpeg_process (krad_link->krad_radio->krad_compositor);
 		} else {
-			//krad_compositor_process (krad_link->krad_radio->krad_compositor);
+		
+			captured_buffer.index = krad_link->krad_v4l2->buf.index;
+			captured_buffer.size = krad_link->krad_v4l2->jpeg_size;
+			
+			if (krad_ringbuffer_read_space (krad_link->captured_video_ringbuffer) / sizeof (krad_link_captured_buffer_t) <
+				krad_link_captured_buffers_max (krad_link)) {
+				krad_ringbuffer_write (krad_link->captured_video_ringbuffer, (char *)&captured_buffer,
+									   sizeof (krad_link_captured_buffer_t));
+			} else {
+				kradv4l2_frame_done (krad_link->krad_v4l2);
+			}
 		}
-	
+	}
+
+	if (krad_link->krad_mjpeg_decoder != NULL) {
+		kradv4l2_mjpeg_decoder_destroy (krad_link->krad_mjpeg_decoder);
+		krad_link->krad_mjpeg_decoder = NULL;
+	}
+
+	if (krad_link->captured_video_ringbuffer != NULL) {
+		krad_link->capture_decoding = 2;
+		pthread_join (krad_link->video_capture_decoding_thread, NULL);
+		krad_ringbuffer_free (krad_link->captured_video_ringbuffer);
+		krad_link->captured_video_ringbuffer = NULL;
 	}
 
 	kradv4l2_stop_capturing (krad_link->krad_v4l2);
-	kradv4l2_close(krad_link->krad_v4l2);
-	kradv4l2_destroy(krad_link->krad_v4l2);
 
 	krad_compositor_port_destroy (krad_link->krad_radio->krad_compositor, krad_link->krad_compositor_port);
 
+	if (passthru) {
+		/* frames still out point into the mmap'd buffers, the buffers
+		   must outlive them, if they don't come back they stay mapped */
+		patience = 0;
+		while (krad_framepool_frames_in_use (krad_link->krad_framepool) > 0) {
+			if (patience * 10 >= KRAD_LINK_PASSTHRU_CLOSE_WAIT_MS) {
+				printke ("Video capture: gave up waiting on %d wrapped frames, leaving their buffers mapped",
+						 krad_framepool_frames_in_use (krad_link->krad_framepool));
+				krad_link->krad_v4l2->keep_mapped = 1;
+				break;
+			}
+			usleep (10000);
+			patience++;
+		}
+	}
+
+	kradv4l2_close(krad_link->krad_v4l2);
+	kradv4l2_destroy(krad_link->krad_v4l2);
+
 	krad_link->capture_audio = 2;
 	krad_link->encoding = 2;
 
@@ -292,6 +483,131 @@ void *test_screen_generator_thread (void *arg) {
 	
 }
 
+void *synth_generator_thread (void *arg) {
+
+	prctl (PR_SET_NAME, (unsigned long) "kradlink_synth", 0, 0, 0);
+
+	krad_link_t *krad_link = (krad_link_t *)arg;
+	
+	printk ("synth generator thread begins");
+	
+	krad_synth_t *krad_synth;
+	krad_frame_t *krad_frame;
+	krad_ticker_t *krad_ticker;
+	float *samples[KRAD_MIXER_MAX_CHANNELS];
+	uint8_t *yuv_pixels[4];
+	int yuv_strides[4];
+	int audio_frames;
+	int sample_rate;
+	int c;
+
+	krad_synth = krad_link->krad_synth;
+	sample_rate = krad_link->krad_radio->krad_mixer->sample_rate;
+
+	if (krad_synth->pattern == KRAD_SYNTH_YUV_FILE) {
+		/* sws converts straight into the frame at compositor size */
+		krad_link->krad_framepool = krad_framepool_create ( krad_link->krad_radio->krad_compositor->width,
+															krad_link->krad_radio->krad_compositor->height,
+															DEFAULT_CAPTURE_BUFFER_FRAMES);
+	} else {
+		krad_link->krad_framepool = krad_framepool_create ( krad_synth->width,
+															krad_synth->height,
+															DEFAULT_CAPTURE_BUFFER_FRAMES);
+	}
+
+	krad_synth_set_sample_rate (krad_synth, sample_rate);
+
+	for (c = 0; c < krad_link->channels; c++) {
+		samples[c] = malloc (sample_rate * sizeof(float));
+	}
+
+	krad_link->krad_mixer_portgroup = krad_mixer_portgroup_create (krad_link->krad_radio->krad_mixer, "SynthIn", INPUT, krad_link->channels,
+														  krad_link->krad_radio->krad_mixer->master_mix, KRAD_LINK, krad_link, 0);	
+
+	krad_link->krad_compositor_port = krad_compositor_port_create (krad_link->krad_radio->krad_compositor,
+																   "SynthIn",
+																   INPUT,
+																   krad_synth->width, krad_synth->height);
+
+	krad_ticker = krad_ticker_create (krad_synth->fps_numerator, krad_synth->fps_denominator);
+
+	krad_ticker_start (krad_ticker);
+
+	while (krad_link->capturing == 1) {
+
+		/* unpaced or freewheeling we can outrun the compositor,
+		   wait for it rather than overflowing the port */
+		if (krad_ringbuffer_write_space (krad_link->krad_compositor_port->frame_ring) < sizeof(krad_frame_t *)) {
+			usleep (2000);
+			continue;
+		}
+
+		krad_frame = krad_framepool_getframe (krad_link->krad_framepool);
+
+		if (krad_frame == NULL) {
+			usleep (2000);
+			continue;
+		}
+
+		if (krad_synth->pattern == KRAD_SYNTH_YUV_FILE) {
+			if (krad_synth_read_yuv (krad_synth, yuv_pixels, yuv_strides) < 0) {
+				krad_framepool_unref_frame (krad_frame);
+				break;
+			}
+			for (c = 0; c < 4; c++) {
+				krad_frame->yuv_pixels[c] = yuv_pixels[c];
+				krad_frame->yuv_strides[c] = yuv_strides[c];
+			}
+			krad_frame->format = PIX_FMT_YUV420P;
+			krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
+		} else {
+			krad_synth_render (krad_synth, krad_frame->pixels, krad_synth->width);
+			krad_compositor_port_push_rgba_frame (krad_link->krad_compositor_port, krad_frame);
+		}
+
+		krad_framepool_unref_frame (krad_frame);
+
+		audio_frames = krad_synth_audio_frames_for_video_frame (krad_synth);
+
+		if (audio_frames > sample_rate) {
+			audio_frames = sample_rate;
+		}
+
+		if (audio_frames > 0) {
+			krad_synth_read_audio (krad_synth, samples, krad_link->channels, audio_frames);
+			for (c = 0; c < krad_link->channels; c++) {
+				if (krad_ringbuffer_write_space (krad_link->audio_capture_ringbuffer[c]) >= audio_frames * 4) {
+					krad_ringbuffer_write (krad_link->audio_capture_ringbuffer[c], (char *)samples[c], audio_frames * 4);
+				}
+			}
+		}
+
+		krad_synth_next_frame (krad_synth);
+
+		if (krad_synth->realtime) {
+			krad_ticker_wait (krad_ticker);
+		}
+	}
+
+	krad_ticker_destroy (krad_ticker);
+
+	krad_mixer_portgroup_destroy (krad_link->krad_radio->krad_mixer, krad_link->krad_mixer_portgroup);
+
+	krad_compositor_port_destroy (krad_link->krad_radio->krad_compositor, krad_link->krad_compositor_port);
+
+	for (c = 0; c < krad_link->channels; c++) {
+		free (samples[c]);
+	}
+
+	printk ("synth generator thread exited after %"PRIu64" frames", krad_synth->frame_num);
+
+	krad_link->krad_synth = NULL;
+	krad_synth_destroy (krad_synth);
+
+	return NULL;
+	
+}
+
 void *x11_capture_thread (void *arg) {
 
 	prctl (PR_SET_NAME, (unsigned long) "kradlink_x11cap", 0, 0, 0);
@@ -338,57 +654,559 @@ void *x11_capture_thread (void *arg) {
 }
 
 
-void *video_encoding_thread (void *arg) {
+/* simulcast: the ladder arrives as "1920x1080:4500,1280x720:2500,640x360:800",
+   largest first, bitrates in kbit/s. The first entry is this link. */
 
-	prctl (PR_SET_NAME, (unsigned long) "kradlink_videnc", 0, 0, 0);
+static int krad_link_parse_simulcast (krad_link_t *krad_link, char *ladder) {
 
-	krad_link_t *krad_link = (krad_link_t *)arg;
+	char *entry;
+	char *saveptr;
+	char copy[512];
+	int width;
+	int height;
+	int bitrate;
+	int r;
 
-	printk ("Video encoding thread started");
-	
-	krad_frame_t *krad_frame;
-	void *video_packet;
-	int keyframe;
-	int packet_size;
-	char keyframe_char[1];
-	unsigned char *planes[3];
-	int strides[3];
+	r = 0;
+	strncpy (copy, ladder, sizeof(copy) - 1);
+	copy[sizeof(copy) - 1] = '\0';
 
-	keyframe = 0;
-	krad_frame = NULL;
-	
-	/* CODEC SETUP */
+	for (entry = strtok_r (copy, ",", &saveptr); entry != NULL; entry = strtok_r (NULL, ",", &saveptr)) {
 
-	if (krad_link->video_codec == VP8) {
+		if (r == KRAD_LINK_MAX_RENDITIONS) {
+			printke ("Krad Link: simulcast ladder has more than %d renditions", KRAD_LINK_MAX_RENDITIONS);
+			break;
+		}
 
-		krad_link->krad_vpx_encoder = krad_vpx_encoder_create (krad_link->encoding_width,
-															   krad_link->encoding_height,
-															   krad_link->encoding_fps_numerator,
-															   krad_link->encoding_fps_denominator,															   
-															   krad_link->vp8_bitrate);
+		if ((sscanf (entry, "%dx%d:%d", &width, &height, &bitrate) != 3) ||
+			(width < 16) || (height < 16) || (bitrate < 1)) {
+			printke ("Krad Link: bad simulcast rendition %s", entry);
+			return 0;
+		}
 
-		if (krad_link->operation_mode == TRANSMIT) {
-			krad_link->krad_vpx_encoder->cfg.kf_max_dist = 90;
+		if ((r > 0) && ((width > krad_link->rendition_width[r - 1]) || (height > krad_link->rendition_height[r - 1]))) {
+			printke ("Krad Link: simulcast renditions must go from largest to smallest");
+			return 0;
 		}
 
-		krad_vpx_encoder_config_set (krad_link->krad_vpx_encoder, &krad_link->krad_vpx_encoder->cfg);
+		krad_link->rendition_width[r] = width & ~1;
+		krad_link->rendition_height[r] = height & ~1;
+		krad_link->rendition_bitrate[r] = bitrate;
+		r++;
+	}
 
-		krad_vpx_encoder_quality_set (krad_link->krad_vpx_encoder, (((1000 / ((krad_link->encoding_fps_numerator / krad_link->encoding_fps_denominator)) / 3) * 2) * 1000));
+	if (r > 0) {
+		krad_link->encoding_width = krad_link->rendition_width[0];
+		krad_link->encoding_height = krad_link->rendition_height[0];
+		krad_link->vp8_bitrate = krad_link->rendition_bitrate[0];
+	}
 
-		printk ("Video encoding quality set to %ld", krad_link->krad_vpx_encoder->quality);
+	krad_link->renditions = r;
 	
-	}
+	return r;
+
+}
+
+/* "/live.webm" becomes "/live_360p.webm" */
+
+static void krad_link_rendition_mount (char *mount, char *base, int height, int size) {
+
+	char *ext;
+	int len;
+
+	ext = strrchr (base, '.');
 	
-	if (krad_link->video_codec == THEORA) {
-		krad_link->krad_theora_encoder = krad_theora_encoder_create (krad_link->encoding_width, 
-																	 krad_link->encoding_height,
-																	 krad_link->encoding_fps_numerator,
-																	 krad_link->encoding_fps_denominator,
-																	 DEFAULT_THEORA_QUALITY);
+	if ((ext == NULL) || (strchr (ext, '/') != NULL)) {
+		snprintf (mount, size, "%s_%dp", base, height);
+	} else {
+		len = ext - base;
+		snprintf (mount, size, "%.*s_%dp%s", len, base, height, ext);
 	}
-	
-	if (krad_link->video_codec == DIRAC) {
-		krad_link->krad_dirac = krad_dirac_encoder_create (krad_link->encoding_width, 
+
+}
+
+/* a child link shares its parent's codecs and destination, it only ever
+   runs an output thread and, for renditions, a video encoder */
+
+static krad_link_t *krad_link_child_create (krad_link_t *krad_link) {
+
+	krad_link_t *child;
+	
+	child = calloc (1, sizeof(krad_link_t));
+
+	child->krad_radio = krad_link->krad_radio;
+	child->krad_linker = krad_link->krad_linker;
+
+	child->operation_mode = krad_link->operation_mode;
+	child->transport_mode = krad_link->transport_mode;
+	child->av_mode = krad_link->av_mode;
+	child->audio_codec = krad_link->audio_codec;
+	child->video_codec = krad_link->video_codec;
+	child->video_source = krad_link->video_source;
+
+	strcpy (child->host, krad_link->host);
+	child->port = krad_link->port;
+	strcpy (child->mount, krad_link->mount);
+	strcpy (child->password, krad_link->password);
+	strcpy (child->output, krad_link->output);
+
+	child->capture_fps = krad_link->capture_fps;
+	child->encoding_fps_numerator = krad_link->encoding_fps_numerator;
+	child->encoding_fps_denominator = krad_link->encoding_fps_denominator;
+	child->encoding_width = krad_link->encoding_width;
+	child->encoding_height = krad_link->encoding_height;
+	child->vp8_bitrate = krad_link->vp8_bitrate;
+
+	child->udp_fec_group = krad_link->udp_fec_group;
+	child->udp_pace_kbps = krad_link->udp_pace_kbps;
+	child->udp_pace_max_delay_ms = krad_link->udp_pace_max_delay_ms;
+	child->udp_pace_txtime = krad_link->udp_pace_txtime;
+	child->max_interleave_ms = krad_link->max_interleave_ms;
+	child->live_cluster_ms = krad_link->live_cluster_ms;
+	child->live_cluster_bytes = krad_link->live_cluster_bytes;
+	child->live_flush_ms = krad_link->live_flush_ms;
+
+	child->encoded_audio_ringbuffer = krad_ringbuffer_create (2000000);
+	child->encoded_video_ringbuffer = krad_ringbuffer_create (6000000);
+
+	return child;
+
+}
+
+static void krad_link_child_destroy (krad_link_t *child) {
+
+	krad_ringbuffer_free (child->encoded_audio_ringbuffer);
+	krad_ringbuffer_free (child->encoded_video_ringbuffer);
+	free (child);
+
+}
+
+static krad_link_t *krad_link_rendition_create (krad_link_t *krad_link, int r) {
+
+	krad_link_t *rendition;
+	
+	rendition = krad_link_child_create (krad_link);
+
+	rendition->rendition_parent = krad_link;
+	snprintf (rendition->sysname, sizeof(rendition->sysname), "%s_%dp", krad_link->sysname, krad_link->rendition_height[r]);
+	krad_link_rendition_mount (rendition->mount, krad_link->mount, krad_link->rendition_height[r], sizeof(rendition->mount));
+
+	rendition->encoding_width = krad_link->rendition_width[r];
+	rendition->encoding_height = krad_link->rendition_height[r];
+	rendition->vp8_bitrate = krad_link->rendition_bitrate[r];
+
+	printk ("Krad Link: simulcast rendition %dx%d at %dk on %s",
+			rendition->encoding_width, rendition->encoding_height, rendition->vp8_bitrate, rendition->mount);
+
+	return rendition;
+
+}
+
+static void krad_link_children_set_encoding (krad_link_t *krad_link, int encoding) {
+
+	int r;
+
+	for (r = 1; r < krad_link->renditions; r++) {
+		krad_link->rendition[r]->encoding = encoding;
+	}
+	
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (r = 0; r < KRAD_LINK_MAX_OUTPUTS; r++) {
+		if (krad_link->fanout[r] != NULL) {
+			krad_link->fanout[r]->encoding = encoding;
+		}
+	}
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+}
+
+/* frame number to ms on the encoding clock, worked out from the count each
+   time rather than added up so non integer frame rates don't drift */
+
+static int64_t krad_link_video_timecode (krad_link_t *krad_link, int64_t frame) {
+	return frame * 1000 * krad_link->encoding_fps_denominator / krad_link->encoding_fps_numerator;
+}
+
+/* A full queue means that output is stuck, so the packet is dropped rather
+   than holding up the encoder, and video then waits for a keyframe so the
+   output picks back up cleanly.
+
+   Queued video is size(4) keyframe(1) timecode(8) data,
+   queued audio is size(4) frames(4) timecode(8) data. */
+
+static void krad_link_queue_video (krad_link_t *krad_link, unsigned char *packet, int size, int keyframe,
+								   int64_t timecode) {
+
+	char keyframe_char[1];
+
+	if (krad_link->output_failed) {
+		return;
+	}
+
+	if ((krad_link->video_queue_needs_keyframe) && (!keyframe)) {
+		krad_link->packets_dropped++;
+		return;
+	}
+	
+	if (krad_ringbuffer_write_space (krad_link->encoded_video_ringbuffer) < size + 13) {
+		if (krad_link->video_queue_needs_keyframe == 0) {
+			printke ("Krad Link: %s output is behind, dropping video until the next keyframe", krad_link->sysname);
+		}
+		krad_link->video_queue_needs_keyframe = 1;
+		krad_link->packets_dropped++;
+		return;
+	}
+
+	krad_link->video_queue_needs_keyframe = 0;
+	keyframe_char[0] = keyframe;
+
+	krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)&size, 4);
+	krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, keyframe_char, 1);
+	krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)&timecode, 8);
+	krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)packet, size);
+
+}
+
+static void krad_link_queue_audio (krad_link_t *krad_link, unsigned char *packet, int size, int frames,
+								   int64_t timecode) {
+
+	if (krad_link->output_failed) {
+		return;
+	}
+
+	if (krad_ringbuffer_write_space (krad_link->encoded_audio_ringbuffer) < size + 16) {
+		krad_link->packets_dropped++;
+		return;
+	}
+
+	krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&size, 4);
+	krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&frames, 4);
+	krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&timecode, 8);
+	krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)packet, size);
+
+}
+
+static void krad_link_write_encoded_video (krad_link_t *krad_link, unsigned char *packet, int size, int keyframe,
+										   int64_t timecode) {
+
+	int o;
+
+	krad_link_queue_video (krad_link, packet, size, keyframe, timecode);
+
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (o = 0; o < KRAD_LINK_MAX_OUTPUTS; o++) {
+		if (krad_link->fanout[o] != NULL) {
+			krad_link_queue_video (krad_link->fanout[o], packet, size, keyframe, timecode);
+		}
+	}
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+}
+
+/* every rendition and output gets the same encoded audio, so it is only encoded once,
+   the timecode is where the packet starts in the frames encoded so far */
+
+static void krad_link_write_encoded_audio (krad_link_t *krad_link, unsigned char *buffer, int bytes, int frames) {
+
+	int r;
+	int64_t timecode;
+
+	timecode = krad_link->audio_frames_encoded * 1000 / krad_link->krad_radio->krad_mixer->sample_rate;
+	krad_link->audio_frames_encoded += frames;
+
+	krad_link_queue_audio (krad_link, buffer, bytes, frames, timecode);
+
+	for (r = 1; r < krad_link->renditions; r++) {
+		krad_link_queue_audio (krad_link->rendition[r], buffer, bytes, frames, timecode);
+	}
+	
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (r = 0; r < KRAD_LINK_MAX_OUTPUTS; r++) {
+		if (krad_link->fanout[r] != NULL) {
+			krad_link_queue_audio (krad_link->fanout[r], buffer, bytes, frames, timecode);
+		}
+	}
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+}
+
+static void krad_link_child_audio_ready (krad_link_t *krad_link, krad_link_t *child) {
+
+	child->channels = krad_link->channels;
+	child->krad_vorbis = krad_link->krad_vorbis;
+	child->krad_flac = krad_link->krad_flac;
+	child->krad_opus = krad_link->krad_opus;
+	child->audio_encoder_ready = 1;
+
+}
+
+static void krad_link_children_audio_ready (krad_link_t *krad_link) {
+
+	int r;
+
+	for (r = 1; r < krad_link->renditions; r++) {
+		krad_link_child_audio_ready (krad_link, krad_link->rendition[r]);
+	}
+	
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (r = 0; r < KRAD_LINK_MAX_OUTPUTS; r++) {
+		if (krad_link->fanout[r] != NULL) {
+			krad_link_child_audio_ready (krad_link, krad_link->fanout[r]);
+		}
+	}
+	krad_link->audio_encoder_ready = 1;
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+}
+
+void *rendition_encoding_thread (void *arg) {
+
+	krad_link_t *rendition = (krad_link_t *)arg;
+	krad_link_t *krad_link = rendition->rendition_parent;
+
+	void *video_packet;
+	int keyframe;
+	int packet_size;
+	int frame;
+	
+	prctl (PR_SET_NAME, (unsigned long) "kradlink_simenc", 0, 0, 0);
+
+	frame = 0;
+
+	while (1) {
+
+		pthread_mutex_lock (&krad_link->rendition_lock);
+		while ((frame == krad_link->rendition_frame) && (krad_link->rendition_stop == 0)) {
+			pthread_cond_wait (&krad_link->rendition_cond, &krad_link->rendition_lock);
+		}
+		if (frame == krad_link->rendition_frame) {
+			pthread_mutex_unlock (&krad_link->rendition_lock);
+			break;
+		}
+		frame = krad_link->rendition_frame;
+		pthread_mutex_unlock (&krad_link->rendition_lock);
+
+		krad_vpx_encoder_adapt (rendition->krad_vpx_encoder, krad_link->rendition_frames_queued);
+
+		packet_size = krad_vpx_encoder_write (rendition->krad_vpx_encoder, (unsigned char **)&video_packet, &keyframe);
+
+		if (packet_size) {
+			krad_link_queue_video (rendition, video_packet, packet_size, keyframe,
+								   krad_link_video_timecode (rendition, rendition->krad_vpx_encoder->pts));
+		}
+
+		pthread_mutex_lock (&krad_link->rendition_lock);
+		krad_link->rendition_pending--;
+		pthread_cond_broadcast (&krad_link->rendition_cond);
+		pthread_mutex_unlock (&krad_link->rendition_lock);
+	}
+
+	krad_vpx_encoder_finish (rendition->krad_vpx_encoder);
+	do {
+		packet_size = krad_vpx_encoder_write (rendition->krad_vpx_encoder, (unsigned char **)&video_packet, &keyframe);
+		if (packet_size) {
+			krad_link_queue_video (rendition, video_packet, packet_size, keyframe,
+								   krad_link_video_timecode (rendition, rendition->krad_vpx_encoder->pts));
+		}
+	} while (packet_size);
+
+	krad_vpx_encoder_destroy (rendition->krad_vpx_encoder);
+	rendition->krad_vpx_encoder = NULL;
+
+	return NULL;
+
+}
+
+/* Encoders are made here rather than in their threads so the cascade has
+   somewhere to scale into from the first frame. They share the cores
+   between them and keyframes are driven from the top so every rendition
+   switches on the same frame. */
+
+static void krad_link_renditions_start (krad_link_t *krad_link) {
+
+	int r;
+	int threads;
+	krad_link_t *rendition;
+	
+	threads = krad_link->krad_vpx_encoder->threads_created / krad_link->renditions;
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	krad_link->krad_vpx_encoder->cfg.kf_mode = VPX_KF_DISABLED;
+	krad_vpx_encoder_threads_set (krad_link->krad_vpx_encoder, threads);
+
+	pthread_mutex_init (&krad_link->rendition_lock, NULL);
+	pthread_cond_init (&krad_link->rendition_cond, NULL);
+	krad_link->rendition_frame = 0;
+	krad_link->rendition_pending = 0;
+	krad_link->rendition_stop = 0;
+
+	for (r = 1; r < krad_link->renditions; r++) {
+	
+		rendition = krad_link->rendition[r];
+	
+		rendition->krad_vpx_encoder = krad_vpx_encoder_create (rendition->encoding_width,
+															   rendition->encoding_height,
+															   rendition->encoding_fps_numerator,
+															   rendition->encoding_fps_denominator,
+															   rendition->vp8_bitrate);
+
+		rendition->krad_vpx_encoder->cfg.kf_mode = VPX_KF_DISABLED;
+		krad_vpx_encoder_rate_control_set (rendition->krad_vpx_encoder, VPX_CBR, KRAD_VPX_DEFAULT_BUFFER_MS);
+		krad_vpx_encoder_threads_set (rendition->krad_vpx_encoder, threads);
+		krad_vpx_encoder_config_set (rendition->krad_vpx_encoder, &rendition->krad_vpx_encoder->cfg);
+		rendition->krad_vpx_encoder->update_config = 0;
+
+		krad_link->rendition_scaler[r] = sws_getContext (krad_link->rendition_width[r - 1],
+														 krad_link->rendition_height[r - 1],
+														 PIX_FMT_YUV420P,
+														 krad_link->rendition_width[r],
+														 krad_link->rendition_height[r],
+														 PIX_FMT_YUV420P,
+														 SWS_BILINEAR,
+														 NULL, NULL, NULL);
+
+		if (krad_link->rendition_scaler[r] == NULL) {
+			failfast ("Krad Link: could not make simulcast scaler for %dx%d",
+					  krad_link->rendition_width[r], krad_link->rendition_height[r]);
+		}
+
+		pthread_create (&rendition->rendition_encoding_thread, NULL, rendition_encoding_thread, (void *)rendition);
+	}
+
+}
+
+/* scale down the cascade from the frame just pulled into the top encoder,
+   then let the rendition encoders go while this thread does the top one */
+
+static void krad_link_renditions_encode (krad_link_t *krad_link, int frames_queued, uint64_t frame_num) {
+
+	int r;
+	krad_vpx_encoder_t *above;
+	krad_vpx_encoder_t *encoder;
+
+	if ((frame_num % KRAD_LINK_SIMULCAST_KEYFRAME_INTERVAL) == 0) {
+		krad_vpx_encoder_want_keyframe (krad_link->krad_vpx_encoder);
+	}
+
+	for (r = 1; r < krad_link->renditions; r++) {
+	
+		if (r == 1) {
+			above = krad_link->krad_vpx_encoder;
+		} else {
+			above = krad_link->rendition[r - 1]->krad_vpx_encoder;
+		}
+		encoder = krad_link->rendition[r]->krad_vpx_encoder;
+
+		sws_scale (krad_link->rendition_scaler[r], (const uint8_t * const*)above->image->planes, above->image->stride,
+				   0, krad_link->rendition_height[r - 1], encoder->image->planes, encoder->image->stride);
+		
+		if (krad_link->krad_vpx_encoder->flags & VPX_EFLAG_FORCE_KF) {
+			krad_vpx_encoder_want_keyframe (encoder);
+		}
+	}
+
+	pthread_mutex_lock (&krad_link->rendition_lock);
+	krad_link->rendition_frames_queued = frames_queued;
+	krad_link->rendition_pending = krad_link->renditions - 1;
+	krad_link->rendition_frame++;
+	pthread_cond_broadcast (&krad_link->rendition_cond);
+	pthread_mutex_unlock (&krad_link->rendition_lock);
+
+}
+
+static void krad_link_renditions_wait (krad_link_t *krad_link) {
+
+	pthread_mutex_lock (&krad_link->rendition_lock);
+	while (krad_link->rendition_pending > 0) {
+		pthread_cond_wait (&krad_link->rendition_cond, &krad_link->rendition_lock);
+	}
+	pthread_mutex_unlock (&krad_link->rendition_lock);
+
+}
+
+static void krad_link_renditions_stop (krad_link_t *krad_link) {
+
+	int r;
+
+	pthread_mutex_lock (&krad_link->rendition_lock);
+	krad_link->rendition_stop = 1;
+	pthread_cond_broadcast (&krad_link->rendition_cond);
+	pthread_mutex_unlock (&krad_link->rendition_lock);
+
+	for (r = 1; r < krad_link->renditions; r++) {
+		pthread_join (krad_link->rendition[r]->rendition_encoding_thread, NULL);
+		sws_freeContext (krad_link->rendition_scaler[r]);
+		krad_link->rendition_scaler[r] = NULL;
+	}
+
+	pthread_cond_destroy (&krad_link->rendition_cond);
+	pthread_mutex_destroy (&krad_link->rendition_lock);
+
+}
+
+void *video_encoding_thread (void *arg) {
+
+	prctl (PR_SET_NAME, (unsigned long) "kradlink_videnc", 0, 0, 0);
+
+	krad_link_t *krad_link = (krad_link_t *)arg;
+
+	printk ("Video encoding thread started");
+	
+	krad_frame_t *krad_frame;
+	void *video_packet;
+	int keyframe;
+	int packet_size;
+	unsigned char *planes[3];
+	int strides[3];
+	int r;
+	time_t speed_reported;
+	uint64_t frames_encoded;
+	int64_t timecode;
+
+	keyframe = 0;
+	timecode = 0;
+	krad_frame = NULL;
+	speed_reported = time (NULL);
+	frames_encoded = 0;
+	
+	/* CODEC SETUP */
+
+	if (krad_link->video_codec == VP8) {
+
+		krad_link->krad_vpx_encoder = krad_vpx_encoder_create (krad_link->encoding_width,
+															   krad_link->encoding_height,
+															   krad_link->encoding_fps_numerator,
+															   krad_link->encoding_fps_denominator,															   
+															   krad_link->vp8_bitrate);
+
+		if (krad_link->operation_mode == TRANSMIT) {
+			krad_link->krad_vpx_encoder->cfg.kf_max_dist = 90;
+			krad_vpx_encoder_rate_control_set (krad_link->krad_vpx_encoder, VPX_CBR, KRAD_VPX_DEFAULT_BUFFER_MS);
+		}
+
+		krad_vpx_encoder_config_set (krad_link->krad_vpx_encoder, &krad_link->krad_vpx_encoder->cfg);
+		krad_link->krad_vpx_encoder->update_config = 0;
+
+		if (krad_link->renditions > 1) {
+			krad_link_renditions_start (krad_link);
+		}
+
+		krad_vpx_encoder_print_speed (krad_link->krad_vpx_encoder);
+	
+	}
+	
+	if (krad_link->video_codec == THEORA) {
+		krad_link->krad_theora_encoder = krad_theora_encoder_create (krad_link->encoding_width, 
+																	 krad_link->encoding_height,
+																	 krad_link->encoding_fps_numerator,
+																	 krad_link->encoding_fps_denominator,
+																	 DEFAULT_THEORA_QUALITY);
+	}
+	
+	if (krad_link->video_codec == DIRAC) {
+		krad_link->krad_dirac = krad_dirac_encoder_create (krad_link->encoding_width, 
 														   krad_link->encoding_height,
 														   krad_link->encoding_fps_numerator,
 														   krad_link->encoding_fps_denominator,
@@ -442,28 +1260,31 @@ void *video_encoding_thread (void *arg) {
 		
 			if (krad_link->video_codec == VP8) {
 		
-				if (krad_vpx_encoder_quality_get(krad_link->krad_vpx_encoder) > 1) {	
-					if (krad_compositor_port_frames_avail (krad_link->krad_compositor_port) > 25) {
-						krad_vpx_encoder_quality_set (krad_link->krad_vpx_encoder, 1);
-						printk ("Alert! Reduced VP8 quality due to frames avail > 25");
-					}
+				if (krad_link->renditions > 1) {
+					krad_link_renditions_encode (krad_link,
+												 krad_compositor_port_frames_avail (krad_link->krad_compositor_port),
+												 frames_encoded);
 				}
-				if (krad_vpx_encoder_quality_get(krad_link->krad_vpx_encoder) == 1) {
-					if (krad_compositor_port_frames_avail(krad_link->krad_compositor_port) < 1) {
-						krad_vpx_encoder_quality_set (krad_link->krad_vpx_encoder,
-												  ((((1000 / (krad_link->encoding_fps_numerator / krad_link->encoding_fps_denominator)) / 3) * 2) * 1000));
-						printk ("Alert! Increased VP8 quality");
-					}				
-				}			
+
+				krad_vpx_encoder_adapt (krad_link->krad_vpx_encoder,
+										krad_compositor_port_frames_avail (krad_link->krad_compositor_port));
+
 				packet_size = krad_vpx_encoder_write (krad_link->krad_vpx_encoder,
 									(unsigned char **)&video_packet,
 													  &keyframe);
+				
+				if (krad_link->renditions > 1) {
+					krad_link_renditions_wait (krad_link);
+				}
+				
+				timecode = krad_link_video_timecode (krad_link, krad_link->krad_vpx_encoder->pts);
 			}
 		
 			if (krad_link->video_codec == THEORA) {
 				packet_size = krad_theora_encoder_write (krad_link->krad_theora_encoder,
 									   (unsigned char **)&video_packet,
 									   					 &keyframe);
+				timecode = krad_link_video_timecode (krad_link, frames_encoded);
 			}
 		
 			if (krad_link->video_codec == DIRAC) {
@@ -471,21 +1292,27 @@ void *video_encoding_thread (void *arg) {
 									   (unsigned char **)&video_packet);
 									   
 				keyframe = 1;
+				timecode = krad_link_video_timecode (krad_link, frames_encoded);
 			}			
+			
+			frames_encoded++;
 		
 			if ((packet_size) || (krad_link->video_codec == THEORA)) {
 			
 				//FIXME un needed memcpy
-			
-				keyframe_char[0] = keyframe;
-
-				krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)&packet_size, 4);
-				krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, keyframe_char, 1);
-				krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)video_packet, packet_size);
+				krad_link_write_encoded_video (krad_link, video_packet, packet_size, keyframe, timecode);
 
 			}
 			
 			krad_framepool_unref_frame (krad_frame);
+			
+			if ((krad_link->video_codec == VP8) && (time (NULL) - speed_reported >= KRAD_LINK_VP8_REPORT_SECONDS)) {
+				krad_vpx_encoder_print_speed (krad_link->krad_vpx_encoder);
+				for (r = 1; r < krad_link->renditions; r++) {
+					krad_vpx_encoder_print_speed (krad_link->rendition[r]->krad_vpx_encoder);
+				}
+				speed_reported = time (NULL);
+			}
 	
 		} else {
 			// FIXME signal
@@ -498,6 +1325,9 @@ void *video_encoding_thread (void *arg) {
 	krad_compositor_port_destroy (krad_link->krad_radio->krad_compositor, krad_link->krad_compositor_port);
 		
 	if (krad_link->video_codec == VP8) {
+		if (krad_link->renditions > 1) {
+			krad_link_renditions_stop (krad_link);
+		}
 		krad_vpx_encoder_finish (krad_link->krad_vpx_encoder);
 		do {
 			packet_size = krad_vpx_encoder_write (krad_link->krad_vpx_encoder,
@@ -505,9 +1335,8 @@ void *video_encoding_thread (void *arg) {
 							   					  &keyframe);
 			if (packet_size) {
 				//FIXME goes with un needed memcpy above
-				krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)&packet_size, 4);
-				krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, keyframe_char, 1);
-				krad_ringbuffer_write (krad_link->encoded_video_ringbuffer, (char *)video_packet, packet_size);
+				krad_link_write_encoded_video (krad_link, video_packet, packet_size, keyframe,
+											   krad_link_video_timecode (krad_link, krad_link->krad_vpx_encoder->pts));
 			}
 							   					  
 		} while (packet_size);
@@ -528,236 +1357,419 @@ void *video_encoding_thread (void *arg) {
 	if ((krad_link->av_mode == VIDEO_ONLY) || (krad_link->audio_codec == NOCODEC)) {
 		krad_link->encoding = 4;
 	}
+	krad_link_children_set_encoding (krad_link, krad_link->encoding);
+	
+	printk ("Video encoding thread exited");
+	
+	return NULL;
+	
+}
+
+
+/* the only place a link goes from prebuffering to playing, its decoded
+   audio has to be prebuffer_ms deep first, a link without audio starts
+   straight away */
+
+static void krad_link_start_playing (krad_link_t *krad_link, krad_resample_ring_t *krad_resample_ring,
+									 uint32_t prebuffer_ms) {
+
+	if (krad_link->playing != 0) {
+		return;
+	}
+
+	if ((krad_resample_ring != NULL) && (krad_resample_ring_fill_ms (krad_resample_ring) < prebuffer_ms)) {
+		return;
+	}
+
+	/* the input thread can have finished (3) in the meantime, that sticks */
+	__sync_bool_compare_and_swap (&krad_link->playing, 0, 1);
+}
+
+void krad_link_audio_samples_callback (int frames, void *userdata, float **samples) {
+
+	krad_link_t *krad_link = (krad_link_t *)userdata;
+	
+	if ((krad_link->operation_mode == RECEIVE) || (krad_link->operation_mode == PLAYBACK)) {
+		/* after a seek this plays again once it has prebuffered from there */
+		if (krad_link->audio_flush) {
+			krad_ringbuffer_read_advance (krad_link->audio_output_ringbuffer[0],
+										  krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[0]));
+			krad_ringbuffer_read_advance (krad_link->audio_output_ringbuffer[1],
+										  krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[1]));
+			__sync_bool_compare_and_swap (&krad_link->playing, 1, 0);
+			krad_link->audio_flush = 0;
+		}
+		if ((krad_link->playing > 0) &&
+			(krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[0]) >= frames * 4) && 
+			(krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[1]) >= frames * 4)) {
+			krad_ringbuffer_read (krad_link->audio_output_ringbuffer[0], (char *)samples[0], frames * 4);
+			krad_ringbuffer_read (krad_link->audio_output_ringbuffer[1], (char *)samples[1], frames * 4);
+			krad_link->audio_frames_played += frames;
+			krad_link->audio_clock_running = 1;
+		} else {
+			memset(samples[0], 0, frames * 4);
+			memset(samples[1], 0, frames * 4);
+			
+			if ((krad_link->playing > 0) && (krad_link->playing < 3)) {
+				krad_link->audio_underruns++;
+			}
+			
+			if (krad_link->playing == 3) {
+				krad_link->destroy = 1;
+			}
+		}
+	}
+
+	if (krad_link->operation_mode == CAPTURE) {
+		krad_link->audio_frames_captured += frames;
+		krad_ringbuffer_read (krad_link->audio_capture_ringbuffer[0], (char *)samples[0], frames * 4);
+		krad_ringbuffer_read (krad_link->audio_capture_ringbuffer[1], (char *)samples[1], frames * 4);
+	}	
+	
+	if (krad_link->capture_audio == 2) {
+		krad_link->capture_audio = 3;
+	}
+}
+
+/* The mixer hands transmit and record links each period of the mix as a
+   shared block, they are queued by pointer for the encode job */
+
+void krad_link_audio_block_callback (krad_block_t *block, void *userdata) {
+
+	krad_link_t *krad_link = (krad_link_t *)userdata;
+
+	if (block != NULL) {
+		krad_link->audio_frames_captured += block->frames;
+		if (krad_ringbuffer_write_space (krad_link->audio_block_ringbuffer) >= sizeof(krad_block_t *)) {
+			krad_blockpool_ref_block (block);
+			krad_ringbuffer_write (krad_link->audio_block_ringbuffer, (char *)&block, sizeof(krad_block_t *));
+		}
+	}
+
+	krad_encode_job_post (krad_link->audio_encode_job);
+
+	if (krad_link->capture_audio == 2) {
+		krad_link->capture_audio = 3;
+	}
+
+}
+
+static void krad_link_audio_encode_frames (krad_link_t *krad_link, float **samples, int frames) {
+
+	int c;
+	int s;
+	int bytes;
+	int framecnt;
+	float *interleaved;
+	unsigned char *buffer;
+
+	buffer = krad_link->audio_encode_buffer;
+
+	if (krad_link->audio_codec == OPUS) {
+
+		krad_opus_encoder_write (krad_link->krad_opus, samples, frames);
+
+		bytes = krad_opus_encoder_read (krad_link->krad_opus, buffer, &framecnt);
+
+		while (bytes > 0) {
+			krad_link_write_encoded_audio (krad_link, buffer, bytes, framecnt);
+			bytes = krad_opus_encoder_read (krad_link->krad_opus, buffer, &framecnt);
+		}
+	}
+	
+	/* flac packets are timed as whole encoder frames, so it is given one
+	   at a time */
+	if (krad_link->audio_codec == FLAC) {
+
+		interleaved = krad_link->audio_encode_interleaved + (krad_link->audio_encode_pending * krad_link->channels);
+
+		for (s = 0; s < frames; s++) {
+			for (c = 0; c < krad_link->channels; c++) {
+				interleaved[s * krad_link->channels + c] = samples[c][s];
+			}
+		}
+
+		krad_link->audio_encode_pending += frames;
+
+		while (krad_link->audio_encode_pending >= KRAD_DEFAULT_FLAC_FRAME_SIZE) {
+
+			bytes = krad_flac_encode (krad_link->krad_flac, krad_link->audio_encode_interleaved,
+									  KRAD_DEFAULT_FLAC_FRAME_SIZE, buffer);
+
+			if (bytes > 0) {
+				krad_link_write_encoded_audio (krad_link, buffer, bytes, KRAD_DEFAULT_FLAC_FRAME_SIZE);
+			}
+
+			krad_link->audio_encode_pending -= KRAD_DEFAULT_FLAC_FRAME_SIZE;
+			memmove (krad_link->audio_encode_interleaved,
+					 krad_link->audio_encode_interleaved + (KRAD_DEFAULT_FLAC_FRAME_SIZE * krad_link->channels),
+					 krad_link->audio_encode_pending * krad_link->channels * 4);
+		}
+	}
 	
-	printk ("Video encoding thread exited");
+	if (krad_link->audio_codec == VORBIS) {
 	
-	return NULL;
+		unsigned char *vorbis_buffer;
+		float **float_buffer;
+
+		krad_vorbis_encoder_prepare (krad_link->krad_vorbis, frames, &float_buffer);
+					
+		for (c = 0; c < krad_link->channels; c++) {
+			memcpy (float_buffer[c], samples[c], frames * 4);
+		}			
 	
+		krad_vorbis_encoder_wrote (krad_link->krad_vorbis, frames);
+
+		bytes = krad_vorbis_encoder_read (krad_link->krad_vorbis, &framecnt, &vorbis_buffer);
+
+		while (bytes > 0) {
+			krad_link_write_encoded_audio (krad_link, vorbis_buffer, bytes, framecnt);
+			bytes = krad_vorbis_encoder_read (krad_link->krad_vorbis, &framecnt, &vorbis_buffer);
+		}
+	}
+
 }
 
+/* Audio encoding runs as a job on the linker's encode pool, posted each
+   time the mixer hands this link a block. A run encodes every block that
+   is waiting and returns. */
 
-void krad_link_audio_samples_callback (int frames, void *userdata, float **samples) {
+static void krad_link_audio_encode (void *arg) {
 
-	krad_link_t *krad_link = (krad_link_t *)userdata;
-	
-	int c;
-	
-	if ((krad_link->operation_mode == RECEIVE) || (krad_link->operation_mode == PLAYBACK)) {
-		if ((krad_link->playing > 0) && 
-			(krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[0]) >= frames * 4) && 
-			(krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[1]) >= frames * 4)) {
-			krad_ringbuffer_read (krad_link->audio_output_ringbuffer[0], (char *)samples[0], frames * 4);
-			krad_ringbuffer_read (krad_link->audio_output_ringbuffer[1], (char *)samples[1], frames * 4);
-		} else {
-			memset(samples[0], '0', frames * 4);
-			memset(samples[1], '0', frames * 4);
-			
-			if (krad_link->playing == 3) {
-				krad_link->destroy = 1;
+	krad_link_t *krad_link = (krad_link_t *)arg;
+
+	krad_block_t *block;
+	uint64_t missed;
+	int frames;
+
+	if (krad_link->audio_encoding_done) {
+		return;
+	}
+
+	while (krad_ringbuffer_read_space (krad_link->audio_block_ringbuffer) >= sizeof(krad_block_t *)) {
+
+		krad_ringbuffer_read (krad_link->audio_block_ringbuffer, (char *)&block, sizeof(krad_block_t *));
+
+		/* blocks that never made it here are made up with silence, so the
+		   encoded audio keeps to the mixer's clock */
+		if ((krad_link->audio_block_started) && (block->position > krad_link->audio_block_position)) {
+			missed = block->position - krad_link->audio_block_position;
+			krad_link->audio_frames_filled += missed;
+			if (time (NULL) - krad_link->audio_fill_reported >= KRAD_LINK_FILL_REPORT_SECONDS) {
+				printke ("Krad Link: %s missed %"PRIu64" frames of the mix, filled with silence",
+						 krad_link->sysname, krad_link->audio_frames_filled - krad_link->audio_frames_filled_reported);
+				krad_link->audio_frames_filled_reported = krad_link->audio_frames_filled;
+				krad_link->audio_fill_reported = time (NULL);
+			}
+			while (missed > 0) {
+				frames = KRAD_BLOCKPOOL_MAX_FRAMES;
+				if (missed < frames) {
+					frames = missed;
+				}
+				krad_link_audio_encode_frames (krad_link, krad_link->audio_encode_silence, frames);
+				missed -= frames;
 			}
 		}
+
+		krad_link_audio_encode_frames (krad_link, block->samples, block->frames);
+
+		krad_link->audio_block_position = block->position + block->frames;
+		krad_link->audio_block_started = 1;
+
+		krad_blockpool_unref_block (block);
 	}
 
-	if ((krad_link->operation_mode == TRANSMIT) || (krad_link->operation_mode == RECORD)) {
-		krad_link->audio_frames_captured += frames;
-		for (c = 0; c < krad_link->channels; c++ ) {
-			krad_ringbuffer_write (krad_link->audio_input_ringbuffer[c], (char *)samples[c], frames * 4);
+	/* the video side is done and all the audio there is has been encoded */
+	if (krad_link->encoding == 3) {
+
+		if (krad_link->krad_vorbis != NULL) {
+			krad_vorbis_encoder_destroy (krad_link->krad_vorbis);
+			krad_link->krad_vorbis = NULL;
+		}
+		
+		if (krad_link->krad_flac != NULL) {
+			krad_flac_encoder_destroy (krad_link->krad_flac);
+			krad_link->krad_flac = NULL;
+		}
+
+		if (krad_link->krad_opus != NULL) {
+			krad_opus_encoder_destroy (krad_link->krad_opus);
+			krad_link->krad_opus = NULL;
 		}
-	}
-	
-	if (krad_link->operation_mode == CAPTURE) {
-		krad_link->audio_frames_captured += frames;
-		krad_ringbuffer_read (krad_link->audio_capture_ringbuffer[0], (char *)samples[0], frames * 4);
-		krad_ringbuffer_read (krad_link->audio_capture_ringbuffer[1], (char *)samples[1], frames * 4);
-	}	
-	
-	if (krad_link->capture_audio == 2) {
-		krad_link->capture_audio = 3;
-	}
-}
 
-void *audio_encoding_thread (void *arg) {
+		krad_link->audio_encoding_done = 1;
+		krad_link->encoding = 4;
+		krad_link_children_set_encoding (krad_link, 4);
+	}
 
-	prctl (PR_SET_NAME, (unsigned long) "kradlink_audenc", 0, 0, 0);
+}
 
-	krad_link_t *krad_link = (krad_link_t *)arg;
+static void krad_link_audio_encode_start (krad_link_t *krad_link) {
 
 	int c;
-	int s;
-	int bytes;
-	int frames;
-	float *samples[KRAD_MIXER_MAX_CHANNELS];
-	float *interleaved_samples;
-	unsigned char *buffer;
-	int framecnt;
-	krad_mixer_portgroup_t *mixer_portgroup;
 
-	printk ("Audio encoding thread starting");
+	printk ("Audio encoding starting");
 	
 	krad_link->channels = 2;
+	krad_link->audio_encoding_done = 0;
 	
-	interleaved_samples = malloc (8192 * 4 * KRAD_MIXER_MAX_CHANNELS);
-	buffer = malloc (300000);
+	krad_link->audio_encode_interleaved = malloc ((KRAD_DEFAULT_FLAC_FRAME_SIZE + KRAD_BLOCKPOOL_MAX_FRAMES) * 4 * krad_link->channels);
+	krad_link->audio_encode_pending = 0;
+	krad_link->audio_encode_buffer = malloc (300000);
+	krad_link->audio_block_ringbuffer = krad_ringbuffer_create (KRAD_LINK_AUDIO_BLOCKS * sizeof(krad_block_t *));
+	krad_link->audio_block_started = 0;
+	krad_link->audio_frames_filled = 0;
+	krad_link->audio_frames_filled_reported = 0;
+	krad_link->audio_fill_reported = 0;
 	
 	for (c = 0; c < krad_link->channels; c++) {
-		samples[c] = malloc (8192 * 4);
+		krad_link->audio_encode_silence[c] = calloc (KRAD_BLOCKPOOL_MAX_FRAMES, sizeof(float));
 		krad_link->samples[c] = malloc (8192 * 4);
-		krad_link->audio_input_ringbuffer[c] = krad_ringbuffer_create (2000000);		
 	}
-	
-	mixer_portgroup = krad_mixer_portgroup_create (krad_link->krad_radio->krad_mixer, krad_link->sysname, 
-												   OUTPUT, krad_link->channels,
-												   krad_link->krad_radio->krad_mixer->master_mix,
-												   KRAD_LINK, krad_link, 0);		
 		
 	switch (krad_link->audio_codec) {
 		case VORBIS:
 			krad_link->krad_vorbis = krad_vorbis_encoder_create (krad_link->channels,
 																 krad_link->krad_radio->krad_mixer->sample_rate,
 																 krad_link->vorbis_quality);
-			framecnt = KRAD_DEFAULT_VORBIS_FRAME_SIZE;
 			break;
 		case FLAC:
 			krad_link->krad_flac = krad_flac_encoder_create (krad_link->channels,
 															 krad_link->krad_radio->krad_mixer->sample_rate,
 															 24);
-			framecnt = KRAD_DEFAULT_FLAC_FRAME_SIZE;
 			break;
 		case OPUS:
 			krad_link->krad_opus = krad_opus_encoder_create (krad_link->channels,
 															 krad_link->krad_radio->krad_mixer->sample_rate,
 															 KRAD_DEFAULT_OPUS_BITRATE,
 															 OPUS_APPLICATION_AUDIO);
-			framecnt = KRAD_MIN_OPUS_FRAME_SIZE;
 			break;
 		default:
 			failfast ("Krad Link Audio Encoder: Unknown Audio Codec");
 	}
 	
-	krad_link->audio_encoder_ready = 1;
-	
-	while (krad_link->encoding) {
+	krad_link_children_audio_ready (krad_link);
 
-		while (krad_ringbuffer_read_space(krad_link->audio_input_ringbuffer[krad_link->channels - 1]) >= framecnt * 4) {
-
-			if (krad_link->audio_codec == OPUS) {
-
-				for (c = 0; c < krad_link->channels; c++) {
-					krad_ringbuffer_read (krad_link->audio_input_ringbuffer[c], (char *)samples[c], (framecnt * 4) );
-					krad_opus_encoder_write (krad_link->krad_opus, c + 1, (char *)samples[c], framecnt * 4);
-				}
+	krad_link->audio_encode_job = krad_encode_pool_add_job (krad_link->krad_linker->krad_encode_pool,
+															krad_link->sysname, krad_link_audio_encode, krad_link);
 
-				bytes = krad_opus_encoder_read (krad_link->krad_opus, buffer, &framecnt);
-			}
-			
-			if (krad_link->audio_codec == FLAC) {
-				
-				for (c = 0; c < krad_link->channels; c++) {
-					krad_ringbuffer_read (krad_link->audio_input_ringbuffer[c], (char *)samples[c], (framecnt * 4) );
-				}
-			
-				for (s = 0; s < framecnt; s++) {
-					for (c = 0; c < krad_link->channels; c++) {
-						interleaved_samples[s * krad_link->channels + c] = samples[c][s];
-					}
-				}
-			
-				bytes = krad_flac_encode (krad_link->krad_flac, interleaved_samples, framecnt, buffer);
-			}
-			
-			if ((krad_link->audio_codec == FLAC) || (krad_link->audio_codec == OPUS)) {
-	
-				while (bytes > 0) {
-					
-					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&bytes, 4);
-					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&framecnt, 4);
-					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)buffer, bytes);
-					
-					bytes = 0;
-					
-					if (krad_link->audio_codec == OPUS) {
-						bytes = krad_opus_encoder_read (krad_link->krad_opus, buffer, &framecnt);
-					}
-				}
-			}
-			
-			if (krad_link->audio_codec == VORBIS) {
-			
-				unsigned char *vorbis_buffer;
-				float **float_buffer;
+	/* the mixer posts the job from here on */
+	krad_link->audio_encode_portgroup = krad_mixer_portgroup_create (krad_link->krad_radio->krad_mixer, krad_link->sysname, 
+																	 OUTPUT, krad_link->channels,
+																	 krad_link->krad_radio->krad_mixer->master_mix,
+																	 KRAD_LINK, krad_link, 0);
 
-				krad_vorbis_encoder_prepare (krad_link->krad_vorbis, framecnt, &float_buffer);
-							
-				for (c = 0; c < krad_link->channels; c++) {
-					krad_ringbuffer_read (krad_link->audio_input_ringbuffer[c], (char *)float_buffer[c], framecnt * 4);
-				}			
-			
-				krad_vorbis_encoder_wrote (krad_link->krad_vorbis, framecnt);
+}
 
-				bytes = krad_vorbis_encoder_read (krad_link->krad_vorbis, &frames, &vorbis_buffer);
+/* Once encoding has been set to 3, waits for the last of the audio to be
+   encoded, then takes the job off the pool */
 
-				while (bytes > 0) {
-				
-					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&bytes, 4);
-					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&frames, 4);
-					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)vorbis_buffer, bytes);
-					
-					bytes = krad_vorbis_encoder_read (krad_link->krad_vorbis, &frames, &vorbis_buffer);
-				}
-			}
-		}
+static void krad_link_audio_encode_stop (krad_link_t *krad_link) {
 
-		/* Wait for available audio to encode */
+	krad_block_t *block;
+	int c;
 
-		while (krad_ringbuffer_read_space (krad_link->audio_input_ringbuffer[krad_link->channels - 1]) < framecnt * 4) {
-			usleep (5000);
-			if (krad_link->encoding == 3) {
-				break;
-			}
-		}
-		
-		if ((krad_link->encoding == 3) && 
-			(krad_ringbuffer_read_space (krad_link->audio_input_ringbuffer[krad_link->channels - 1]) < framecnt * 4)) {
-				break;
-		}
+	while (!krad_link->audio_encoding_done) {
+		krad_encode_job_post (krad_link->audio_encode_job);
+		usleep (5000);
 	}
 
-	krad_mixer_portgroup_destroy (krad_link->krad_radio->krad_mixer, mixer_portgroup);
-	
-	
-	if (krad_link->krad_vorbis != NULL) {
-		krad_vorbis_encoder_destroy (krad_link->krad_vorbis);
-		krad_link->krad_vorbis = NULL;
-	}
-	
-	if (krad_link->krad_flac != NULL) {
-		krad_flac_encoder_destroy (krad_link->krad_flac);
-		krad_link->krad_flac = NULL;
-	}
+	krad_mixer_portgroup_destroy (krad_link->krad_radio->krad_mixer, krad_link->audio_encode_portgroup);
+	krad_link->audio_encode_portgroup = NULL;
 
-	if (krad_link->krad_opus != NULL) {
-		krad_opus_encoder_destroy (krad_link->krad_opus);
-		krad_link->krad_opus = NULL;
-	}
-	
-	krad_link->encoding = 4;
+	krad_encode_pool_remove_job (krad_link->krad_linker->krad_encode_pool, krad_link->audio_encode_job);
+	krad_link->audio_encode_job = NULL;
 	
 	while (krad_link->capture_audio != 3) {
 		usleep (5000);
 	}
 	
+	while (krad_ringbuffer_read_space (krad_link->audio_block_ringbuffer) >= sizeof(krad_block_t *)) {
+		krad_ringbuffer_read (krad_link->audio_block_ringbuffer, (char *)&block, sizeof(krad_block_t *));
+		krad_blockpool_unref_block (block);
+	}
+	krad_ringbuffer_free (krad_link->audio_block_ringbuffer);
+
+	if (krad_link->audio_frames_filled > 0) {
+		printk ("Krad Link: %s had %"PRIu64" frames of silence filled in for audio it missed",
+				krad_link->sysname, krad_link->audio_frames_filled);
+	}
+
 	for (c = 0; c < krad_link->channels; c++) {
 		free (krad_link->samples[c]);
-		free (samples[c]);
-		krad_ringbuffer_free (krad_link->audio_input_ringbuffer[c]);		
+		free (krad_link->audio_encode_silence[c]);
 	}	
 	
-	free (interleaved_samples);
-	free (buffer);
-	
-	printk ("Audio encoding thread exiting");	
+	free (krad_link->audio_encode_interleaved);
+	free (krad_link->audio_encode_buffer);
 	
-	return NULL;
+	printk ("Audio encoding done");	
+
+}
+
+static int64_t krad_link_now_ms () {
+
+	struct timespec now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+}
+
+/* Look at the packet at the head of an encoded queue without taking it,
+   only once all of it has been written */
+
+static int krad_link_peek_video (krad_link_t *krad_link, int *size, int *keyframe, int64_t *timecode) {
+
+	char header[13];
+
+	if (krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) < 13) {
+		return 0;
+	}
+
+	krad_ringbuffer_peek (krad_link->encoded_video_ringbuffer, header, 13);
+	memcpy (size, header, 4);
+	*keyframe = header[4];
+	memcpy (timecode, header + 5, 8);
+
+	return (krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) >= *size + 13);
+
+}
+
+static int krad_link_peek_audio (krad_link_t *krad_link, int *size, int *frames, int64_t *timecode) {
+
+	char header[16];
+
+	if (krad_ringbuffer_read_space (krad_link->encoded_audio_ringbuffer) < 16) {
+		return 0;
+	}
+
+	krad_ringbuffer_peek (krad_link->encoded_audio_ringbuffer, header, 16);
+	memcpy (size, header, 4);
+	memcpy (frames, header + 4, 4);
+	memcpy (timecode, header + 8, 8);
+
+	return (krad_ringbuffer_read_space (krad_link->encoded_audio_ringbuffer) >= *size + 16);
+
+}
+
+static int64_t krad_link_rebase_timecode (int64_t timecode, int64_t base) {
+
+	if (timecode < base) {
+		return 0;
+	}
+
+	return timecode - base;
+
+}
+
+static void krad_link_print_interleave (krad_link_t *krad_link, int64_t widest_offset_ms) {
+
+	printk ("Krad Link: %s A/V offset %"PRIi64"ms widest %"PRIi64"ms, %"PRIu64" packets muxed late after waiting %dms",
+			krad_link->sysname, krad_link->av_offset_ms, widest_offset_ms,
+			krad_link->packets_late, krad_link->max_interleave_ms);
+
 }
 
 void *stream_output_thread (void *arg) {
@@ -768,32 +1780,52 @@ void *stream_output_thread (void *arg) {
 
 	krad_transmission_t *krad_transmission;
 	unsigned char *packet;
-	int packet_size;
+	int video_size;
+	int audio_size;
 	int keyframe;
 	int frames;
-	char keyframe_char[1];
+	int video_ready;
+	int audio_ready;
+	int video_done;
+	int audio_done;
+	int mux_video;
+	int mux_audio;
+	int held_too_long;
 	int video_frames_muxed;
-	int audio_frames_muxed;
-	int audio_frames_per_video_frame;
+	int64_t video_timecode;
+	int64_t audio_timecode;
+	int64_t video_timecode_base;
+	int64_t video_muxed_timecode;
+	int64_t audio_muxed_timecode;
+	int64_t widest_offset_ms;
+	int64_t waiting_since;
+	int waiting_on_video;
+	int64_t timecode_base;
+	time_t offset_reported;
 	krad_frame_t *krad_frame;
+	krad_container_t *krad_container;
+	int live_output;
 
 	krad_transmission = NULL;
 	krad_frame = NULL;
-	audio_frames_per_video_frame = 0;
-	audio_frames_muxed = 0;
+	keyframe = 0;
+	frames = 0;
+	video_size = 0;
+	audio_size = 0;
 	video_frames_muxed = 0;
+	video_timecode = 0;
+	audio_timecode = 0;
+	video_timecode_base = 0;
+	video_muxed_timecode = -1;
+	audio_muxed_timecode = -1;
+	widest_offset_ms = 0;
+	waiting_since = 0;
+	waiting_on_video = 0;
+	timecode_base = -1;
+	offset_reported = time (NULL);
+	live_output = 0;
 
 	printk ("Output/Muxing thread starting");
-	
-	if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
-
-		if (krad_link->audio_codec == OPUS) {
-			audio_frames_per_video_frame = krad_link->krad_radio->krad_mixer->sample_rate / krad_link->capture_fps;
-		} else {
-			audio_frames_per_video_frame = krad_link->krad_radio->krad_mixer->sample_rate / krad_link->capture_fps;
-			//audio_frames_per_video_frame = 1602;
-		}
-	}
 
 	packet = malloc (2000000);
 	
@@ -814,7 +1846,14 @@ void *stream_output_thread (void *arg) {
 																	krad_link->port,
 																	krad_link->mount,
 																	krad_link->password);
-		}																	
+		}
+
+		live_output = 1;
+		krad_link->live_changed = 0;
+		krad_container_set_live (krad_link->krad_container,
+								 krad_link->live_cluster_ms,
+								 krad_link->live_cluster_bytes,
+								 krad_link->live_flush_ms);
 	} else {
 		printk ("Outputing to file: %s", krad_link->output);
 		krad_link->krad_container = krad_container_open_file (krad_link->output, KRAD_EBML_IO_WRITEONLY);
@@ -901,147 +1940,178 @@ void *stream_output_thread (void *arg) {
 		
 	while ( krad_link->encoding ) {
 
-		if (krad_link->encoding == 4) {
+		if (krad_container_failed (krad_link->krad_container)) {
+			printke ("Krad Link: %s lost its destination, the other outputs carry on", krad_link->sysname);
+			krad_link->output_failed = 1;
 			break;
 		}
 
-		if ((krad_link->av_mode != AUDIO_ONLY) && (krad_link->mjpeg_passthru == 0)) {
-			if ((krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) >= 4) && (krad_link->encoding < 3)) {
-
-				krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, (char *)&packet_size, 4);
-		
-				while ((krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) < packet_size + 1) &&
-					   (krad_link->encoding < 3)) {		
-
-					usleep(10000);
-				}
-			
-				if ((krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) < packet_size + 1) &&
-					(krad_link->encoding > 2)) {
-					
-					continue;
-				}
-			
-				krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, keyframe_char, 1);
-				krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, (char *)packet, packet_size);
-
-				keyframe = keyframe_char[0];
-	
-				krad_container_add_video (krad_link->krad_container, 
-										  krad_link->video_track,
-										  packet,
-										  packet_size,
-										  keyframe);
-
-				video_frames_muxed++;
-			}
+		if ((live_output) && (__sync_bool_compare_and_swap (&krad_link->live_changed, 1, 0))) {
+			krad_container_set_live (krad_link->krad_container,
+									 krad_link->live_cluster_ms,
+									 krad_link->live_cluster_bytes,
+									 krad_link->live_flush_ms);
 		}
-		
-		if (krad_link->mjpeg_passthru == 1) {
 
-			krad_frame = krad_compositor_port_pull_frame (krad_link->krad_compositor_port);
+		/* See what is at the head of each stream */
 
-			if (krad_frame != NULL) {
+		video_ready = 0;
+		audio_ready = 0;
 
-				if (video_frames_muxed % 4 == 0) {
-					keyframe = 1;
-				} else {
-					keyframe = 0;
+		if (krad_link->av_mode != AUDIO_ONLY) {
+			if (krad_link->mjpeg_passthru == 1) {
+				if ((krad_frame == NULL) && (krad_link->encoding < 3)) {
+					krad_frame = krad_compositor_port_pull_frame (krad_link->krad_compositor_port);
+					if (krad_frame != NULL) {
+						if (video_frames_muxed == 0) {
+							video_timecode_base = krad_frame->timecode;
+						}
+						video_timecode = krad_frame->timecode - video_timecode_base;
+						keyframe = (video_frames_muxed % 4 == 0);
+					}
 				}
-				
-				krad_container_add_video (krad_link->krad_container,
-										  krad_link->video_track, 
-						 (unsigned char *)krad_frame->pixels,
-										  krad_frame->mjpeg_size,
-										  keyframe);
-				
-				krad_framepool_unref_frame (krad_frame);
-				video_frames_muxed++;
+				video_ready = (krad_frame != NULL);
+			} else {
+				video_ready = krad_link_peek_video (krad_link, &video_size, &keyframe, &video_timecode);
 			}
-			
-			usleep(2000);
 		}
 		
 		if (krad_link->av_mode != VIDEO_ONLY) {
-		
-			while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) >= 4) && 
-				  ((krad_link->av_mode == AUDIO_ONLY) ||
-				  ((video_frames_muxed * audio_frames_per_video_frame) > audio_frames_muxed))) {
+			audio_ready = krad_link_peek_audio (krad_link, &audio_size, &frames, &audio_timecode);
+		}
 
-				krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)&packet_size, 4);
-		
-				while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < packet_size + 4) &&
-					   (krad_link->encoding != 4)) {
-							usleep (5000);
-				}
-			
-				if ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < packet_size + 4) &&
-					(krad_link->encoding == 4)) {
-					break;
-				}
-			
-				krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)&frames, 4);
-				krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)packet, packet_size);
+		/* Once the encoders are done there is nothing more to wait for */
+
+		video_done = (krad_link->av_mode == AUDIO_ONLY) || ((krad_link->encoding > 2) && (!video_ready));
+		audio_done = (krad_link->av_mode == VIDEO_ONLY) || ((krad_link->encoding == 4) && (!audio_ready));
+
+		if ((video_done) && (audio_done)) {
+			break;
+		}
 
-				krad_container_add_audio (krad_link->krad_container,
-										  krad_link->audio_track,
-										  packet,
-										  packet_size,
-										  frames);
+		/* The earliest head goes next. A head on its own goes once the other
+		   stream has muxed past it, or has finished, or it has been held for
+		   the max interleave delay, so a stalled stream can't hold up the output.
+		   Once a stream has stalled that long the other one keeps going on its
+		   own, the wait is only armed again when the stalled one produces. */
 
-				audio_frames_muxed += frames;
+		mux_video = 0;
+		mux_audio = 0;
 
-				//printk ("ebml muxed audio frames: %d", audio_frames_muxed);
+		if ((video_ready) && (audio_ready)) {
+			krad_link->av_offset_ms = video_timecode - audio_timecode;
+			if (llabs (krad_link->av_offset_ms) > llabs (widest_offset_ms)) {
+				widest_offset_ms = krad_link->av_offset_ms;
+			}
+			if (audio_timecode < video_timecode) {
+				mux_audio = 1;
+			} else {
+				mux_video = 1;
+			}
+			waiting_since = 0;
+		} else {
+			if ((video_ready) || (audio_ready)) {
+				if ((waiting_since == 0) || (waiting_on_video != !video_ready)) {
+					waiting_since = krad_link_now_ms ();
+					waiting_on_video = !video_ready;
+				}
+				held_too_long = (krad_link_now_ms () - waiting_since >= krad_link->max_interleave_ms);
+				if (video_ready) {
+					if ((audio_done) || (video_timecode <= audio_muxed_timecode) || (held_too_long)) {
+						mux_video = 1;
+					}
+				} else {
+					if ((video_done) || (audio_timecode <= video_muxed_timecode) || (held_too_long)) {
+						mux_audio = 1;
+					}
+				}
+				if (((mux_video) || (mux_audio)) && (held_too_long) && (!video_done) && (!audio_done)) {
+					krad_link->packets_late++;
+				}
 			}
+		}
 
-			if (krad_link->encoding == 4) {
-				break;
+		/* An output added part way through starts its own file at zero */
+
+		if ((timecode_base == -1) && ((mux_video) || (mux_audio))) {
+			if (mux_video) {
+				timecode_base = video_timecode;
+			} else {
+				timecode_base = audio_timecode;
 			}
 		}
+
+		if (mux_video) {
 		
-		if (krad_link->av_mode == AUDIO_ONLY) {
-		
-			if (krad_ringbuffer_read_space (krad_link->encoded_audio_ringbuffer) < 4) {
+			if (krad_link->mjpeg_passthru == 1) {
+				krad_container_add_video_timecode (krad_link->krad_container,
+												   krad_link->video_track, 
+								  (unsigned char *)krad_frame->pixels,
+												   krad_frame->mjpeg_size,
+												   keyframe,
+												   krad_link_rebase_timecode (video_timecode, timecode_base));
 				
-				if (krad_link->encoding == 4) {
-					break;
-				}
-
-				usleep (8000);
-			
+				krad_framepool_unref_frame (krad_frame);
+				krad_frame = NULL;
+			} else {
+				krad_ringbuffer_read_advance (krad_link->encoded_video_ringbuffer, 13);
+				krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, (char *)packet, video_size);
+
+				krad_container_add_video_timecode (krad_link->krad_container, 
+												   krad_link->video_track,
+												   packet,
+												   video_size,
+												   keyframe,
+												   krad_link_rebase_timecode (video_timecode, timecode_base));
 			}
+
+			video_muxed_timecode = video_timecode;
+			video_frames_muxed++;
 		}
 		
-		if ((krad_link->av_mode == VIDEO_ONLY) && (krad_link->mjpeg_passthru == 0)) {
-		
-			if (krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) < 4) {
-		
-				if (krad_link->encoding == 4) {
-					break;
-				}
+		if (mux_audio) {
 
-				usleep (8000);
-			}
-		}
+			krad_ringbuffer_read_advance (krad_link->encoded_audio_ringbuffer, 16);
+			krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)packet, audio_size);
 
-		if (krad_link->av_mode == AUDIO_AND_VIDEO) {
+			krad_container_add_audio_timecode (krad_link->krad_container,
+											   krad_link->audio_track,
+											   packet,
+											   audio_size,
+											   frames,
+											   krad_link_rebase_timecode (audio_timecode, timecode_base));
 
-			if (((krad_ringbuffer_read_space (krad_link->encoded_audio_ringbuffer) < 4) || 
-				((video_frames_muxed * audio_frames_per_video_frame) > audio_frames_muxed)) && 
-			     (krad_ringbuffer_read_space (krad_link->encoded_video_ringbuffer) < 4)) {
-		
-				if (krad_link->encoding == 4) {
-					break;
-				}
+			audio_muxed_timecode = audio_timecode;
+		}
+		
+		if ((krad_link->av_mode == AUDIO_AND_VIDEO) &&
+			(time (NULL) - offset_reported >= KRAD_LINK_INTERLEAVE_REPORT_SECONDS)) {
+			krad_link_print_interleave (krad_link, widest_offset_ms);
+			widest_offset_ms = 0;
+			offset_reported = time (NULL);
+		}
 
-				usleep (8000);
-			}
+		if ((!mux_video) && (!mux_audio)) {
+			usleep (2000);
 		}
 		
 		//krad_ebml_write_tag (krad_link->krad_ebml, "test tag 1", "monkey 123");
 	}
 
-	krad_container_destroy (krad_link->krad_container);
+	if (krad_link->av_mode == AUDIO_AND_VIDEO) {
+		krad_link_print_interleave (krad_link, widest_offset_ms);
+	}
+
+	if (krad_frame != NULL) {
+		krad_framepool_unref_frame (krad_frame);
+	}
+
+	pthread_mutex_lock (&krad_link->container_lock);
+	krad_container = krad_link->krad_container;
+	krad_link->krad_container = NULL;
+	pthread_mutex_unlock (&krad_link->container_lock);
+
+	krad_container_destroy (krad_container);
 	
 	free (packet);
 	
@@ -1060,6 +2130,15 @@ void *stream_output_thread (void *arg) {
 }
 
 
+static void krad_link_udp_output_setup (krad_link_t *krad_link, int spread_ms) {
+
+	krad_slicer_set_fec_group (krad_link->krad_slicer, krad_link->udp_fec_group);
+	krad_slicer_set_pacing (krad_link->krad_slicer, krad_link->udp_pace_kbps, spread_ms,
+							krad_link->udp_pace_max_delay_ms);
+	krad_slicer_set_txtime (krad_link->krad_slicer, krad_link->udp_pace_txtime);
+
+}
+
 void *udp_output_thread(void *arg) {
 
 	prctl (PR_SET_NAME, (unsigned long) "kradlink_udpout", 0, 0, 0);
@@ -1072,15 +2151,26 @@ void *udp_output_thread(void *arg) {
 	int count;
 	int packet_size;
 	int frames;
+	int spread_ms;
+	int wait_us;
 	uint64_t frames_big;
+	time_t stats_reported;
 	
 	frames_big = 0;
 	count = 0;
+	spread_ms = 0;
+	stats_reported = time (NULL);
 	
 	buffer = malloc(250000);
 	
 	krad_link->krad_slicer = krad_slicer_create ();
 	
+	if ((krad_link->av_mode != AUDIO_ONLY) && (krad_link->encoding_fps_numerator > 0)) {
+		spread_ms = (1000 * krad_link->encoding_fps_denominator) / krad_link->encoding_fps_numerator;
+	}
+	
+	krad_link_udp_output_setup (krad_link, spread_ms);
+	
 	if (krad_link->audio_codec == OPUS) {	
 	
 		while ( krad_link->encoding ) {
@@ -1089,15 +2179,17 @@ void *udp_output_thread(void *arg) {
 
 				krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)&packet_size, 4);
 		
-				while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < packet_size + 4) && (krad_link->encoding != 4)) {
+				while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < packet_size + 12) && (krad_link->encoding != 4)) {
 					usleep(4000);
 				}
 			
-				if ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < packet_size + 4) && (krad_link->encoding == 4)) {
+				if ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < packet_size + 12) && (krad_link->encoding == 4)) {
 					break;
 				}
 			
 				krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)&frames, 4);
+				// the slicer carries its own frame count, the timecode is for muxing
+				krad_ringbuffer_read_advance(krad_link->encoded_audio_ringbuffer, 8);
 				frames_big = frames;
 				memcpy (buffer, &frames_big, 8);
 				krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)buffer + 8, packet_size);
@@ -1109,11 +2201,30 @@ void *udp_output_thread(void *arg) {
 				if (krad_link->encoding == 4) {
 					break;
 				}
-				usleep(4000);
+				// wake up for the pacer if it has something due sooner
+				wait_us = krad_slicer_service (krad_link->krad_slicer);
+				if ((wait_us < 0) || (wait_us > 4000)) {
+					wait_us = 4000;
+				}
+				usleep (wait_us + 1);
+			}
+			
+			if (__sync_bool_compare_and_swap (&krad_link->udp_changed, 1, 0)) {
+				krad_link_udp_output_setup (krad_link, spread_ms);
+			}
+			
+			krad_slicer_service (krad_link->krad_slicer);
+			krad_slicer_service_nacks (krad_link->krad_slicer);
+			
+			if (time (NULL) - stats_reported >= KRAD_LINK_UDP_REPORT_SECONDS) {
+				krad_slicer_print_stats (krad_link->krad_slicer);
+				stats_reported = time (NULL);
 			}
 		}
 	}
 	
+	krad_slicer_drain (krad_link->krad_slicer);
+	krad_slicer_print_stats (krad_link->krad_slicer);
 	krad_slicer_destroy (krad_link->krad_slicer);
 	
 	free (buffer);
@@ -1144,6 +2255,263 @@ void krad_link_run (krad_link_t *krad_link) {
 	pthread_detach (krad_link->main_thread);
 }
 
+/* Decode pipeline */
+
+static void krad_link_decode_wake (krad_link_t *krad_link) {
+
+	pthread_mutex_lock (&krad_link->decode_lock);
+	pthread_cond_broadcast (&krad_link->decode_cond);
+	pthread_mutex_unlock (&krad_link->decode_lock);
+
+}
+
+/* called with decode_lock held */
+
+static void krad_link_decode_timedwait (krad_link_t *krad_link) {
+
+	struct timespec deadline;
+
+	/* a link being destroyed is noticed in time even if nobody wakes us */
+	clock_gettime (CLOCK_REALTIME, &deadline);
+	deadline.tv_nsec += KRAD_LINK_DECODE_WAIT_MS * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_cond_timedwait (&krad_link->decode_cond, &krad_link->decode_lock, &deadline);
+
+}
+
+static void krad_link_decode_wait (krad_link_t *krad_link, krad_ringbuffer_t *ringbuffer, size_t bytes, int write) {
+
+	pthread_mutex_lock (&krad_link->decode_lock);
+
+	while (!krad_link->destroy) {
+
+		if ((write) && (krad_ringbuffer_write_space (ringbuffer) >= bytes)) {
+			break;
+		}
+
+		if ((!write) && (krad_ringbuffer_read_space (ringbuffer) >= bytes)) {
+			break;
+		}
+
+		krad_link_decode_timedwait (krad_link);
+	}
+
+	pthread_mutex_unlock (&krad_link->decode_lock);
+
+}
+
+static uint64_t krad_link_audio_clock_ms (krad_link_t *krad_link) {
+
+	return (krad_link->audio_frames_played * 1000) / krad_link->krad_radio->krad_mixer->sample_rate;
+
+}
+
+/* Returns 1 if the audio clock is already too far past a decoded frame
+   for it to be worth converting and showing. Until there is an audio
+   clock the compositor paces frames by timecode. */
+
+static int krad_link_video_frame_late (krad_link_t *krad_link, uint64_t timecode, int *start_waited_ms) {
+
+	/* the audio is usually just behind the first frames */
+	while ((!krad_link->audio_clock_running) && (krad_link->av_mode == AUDIO_AND_VIDEO) &&
+		   (*start_waited_ms < KRAD_LINK_AV_START_WAIT_MS) && (!krad_link->destroy)) {
+		usleep (10000);
+		*start_waited_ms += 10;
+	}
+
+	if (!krad_link->audio_clock_running) {
+		return 0;
+	}
+
+	krad_link->krad_compositor_port->source_paced = 1;
+
+	return ((int64_t)timecode - (int64_t)krad_link_audio_clock_ms (krad_link) < -KRAD_LINK_VIDEO_LATE_MS);
+
+}
+
+/* Decoded audio waiting to be played, at the mixer's rate */
+
+static uint64_t krad_link_audio_queued_ms (krad_link_t *krad_link) {
+
+	if ((krad_link->av_mode != AUDIO_AND_VIDEO) || (krad_link->audio_output_ringbuffer[0] == NULL)) {
+		return 0;
+	}
+
+	return (krad_ringbuffer_read_space (krad_link->audio_output_ringbuffer[0]) / 4 * 1000) /
+		   krad_link->krad_radio->krad_mixer->sample_rate;
+
+}
+
+/* Holds a frame until the audio clock gets to it, but no longer than
+   its duration and a bit. If the audio clock has stopped, the mixer
+   has stalled or the link is prebuffering after a seek, frames go by
+   their own timecodes instead, each a frame duration after the last. */
+
+static void krad_link_video_frame_wait (krad_link_t *krad_link, uint64_t timecode, int frame_ms,
+										int64_t shown_ms, uint64_t *clock_ms, int64_t *clock_moved_ms) {
+
+	int64_t ahead;
+	int64_t start_ms;
+	int64_t now_ms;
+	uint64_t clock;
+
+	if (!krad_link->audio_clock_running) {
+		return;
+	}
+
+	start_ms = krad_link_now_ms ();
+	now_ms = start_ms;
+
+	while ((!krad_link->convert_flush) && (!krad_link->destroy)) {
+
+		clock = krad_link_audio_clock_ms (krad_link);
+		if (clock != *clock_ms) {
+			*clock_ms = clock;
+			*clock_moved_ms = now_ms;
+		}
+
+		ahead = (int64_t)timecode - (int64_t)clock;
+
+		if ((ahead <= 0) || (now_ms - start_ms >= frame_ms + KRAD_LINK_VIDEO_LATE_MS)) {
+			break;
+		}
+
+		if ((now_ms - *clock_moved_ms >= KRAD_LINK_VIDEO_LATE_MS) && (now_ms - shown_ms >= frame_ms)) {
+			break;
+		}
+
+		if (ahead > 10) {
+			usleep (10000);
+		} else {
+			usleep (ahead * 1000);
+		}
+
+		now_ms = krad_link_now_ms ();
+	}
+
+}
+
+static int krad_link_video_plane_rows (krad_link_t *krad_link, krad_frame_t *krad_frame, int plane) {
+
+	int rows;
+
+	rows = krad_link->krad_compositor_port->source_height;
+
+	if ((plane > 0) && (krad_frame->format == PIX_FMT_YUV420P)) {
+		rows = (rows + 1) / 2;
+	}
+
+	return rows;
+
+}
+
+/* Copies a decoded picture out of the decoder, which reuses its buffers on
+   the next decode, and queues it for video_converting_thread, waiting for
+   room if the converter is behind. */
+
+static void krad_link_video_convert_queue (krad_link_t *krad_link, krad_frame_t *krad_frame) {
+
+	unsigned char *yuv;
+	int slot;
+	int size;
+	int stride;
+	int rows;
+	int p;
+	int r;
+
+	pthread_mutex_lock (&krad_link->decode_lock);
+	while ((krad_link->convert_queued == KRAD_LINK_CONVERT_FRAMES) && (!krad_link->destroy)) {
+		krad_link_decode_timedwait (krad_link);
+	}
+	pthread_mutex_unlock (&krad_link->decode_lock);
+
+	if (krad_link->destroy) {
+		return;
+	}
+
+	slot = krad_link->convert_write;
+
+	size = 0;
+	for (p = 0; p < 3; p++) {
+		size += abs (krad_frame->yuv_strides[p]) * krad_link_video_plane_rows (krad_link, krad_frame, p);
+	}
+
+	if (krad_link->convert_yuv_size[slot] < size) {
+		free (krad_link->convert_yuv[slot]);
+		krad_link->convert_yuv[slot] = malloc (size);
+		krad_link->convert_yuv_size[slot] = size;
+	}
+
+	/* theora pictures are stored bottom up, so strides can be negative */
+	yuv = krad_link->convert_yuv[slot];
+	for (p = 0; p < 3; p++) {
+		stride = abs (krad_frame->yuv_strides[p]);
+		rows = krad_link_video_plane_rows (krad_link, krad_frame, p);
+		for (r = 0; r < rows; r++) {
+			memcpy (yuv + (r * stride), krad_frame->yuv_pixels[p] + (r * krad_frame->yuv_strides[p]), stride);
+		}
+		krad_frame->yuv_pixels[p] = yuv;
+		krad_frame->yuv_strides[p] = stride;
+		yuv += stride * rows;
+	}
+
+	krad_framepool_ref_frame (krad_frame);
+	krad_link->convert_frame[slot] = krad_frame;
+	krad_link->convert_write = (slot + 1) % KRAD_LINK_CONVERT_FRAMES;
+
+	pthread_mutex_lock (&krad_link->decode_lock);
+	krad_link->convert_queued++;
+	pthread_cond_broadcast (&krad_link->decode_cond);
+	pthread_mutex_unlock (&krad_link->decode_lock);
+
+}
+
+/* Frames still queued when the demuxer seeks are from before it, the
+   converter drops them, including one it is holding for the clock */
+
+static void krad_link_video_convert_flush (krad_link_t *krad_link) {
+
+	pthread_mutex_lock (&krad_link->decode_lock);
+	krad_link->convert_flush = krad_link->convert_queued;
+	pthread_cond_broadcast (&krad_link->decode_cond);
+	pthread_mutex_unlock (&krad_link->decode_lock);
+
+}
+
+/* Before the port is given a new picture size, frames queued at the old
+   one have to be through the converter */
+
+static void krad_link_video_convert_drain (krad_link_t *krad_link) {
+
+	pthread_mutex_lock (&krad_link->decode_lock);
+	while ((krad_link->convert_queued > 0) && (!krad_link->destroy)) {
+		krad_link_decode_timedwait (krad_link);
+	}
+	pthread_mutex_unlock (&krad_link->decode_lock);
+
+}
+
+static void krad_link_video_decode_timed (krad_link_t *krad_link, struct timespec *start) {
+
+	struct timespec end;
+	int decode_us;
+
+	clock_gettime (CLOCK_MONOTONIC, &end);
+
+	decode_us = (end.tv_sec - start->tv_sec) * 1000000 + (end.tv_nsec - start->tv_nsec) / 1000;
+
+	if (krad_link->video_decode_us == 0) {
+		krad_link->video_decode_us = decode_us;
+	} else {
+		krad_link->video_decode_us += (decode_us - krad_link->video_decode_us) / 8;
+	}
+
+}
+
 void *stream_input_thread (void *arg) {
 
 	prctl (PR_SET_NAME, (unsigned long) "kradlink_stmin", 0, 0, 0);
@@ -1153,12 +2521,14 @@ void *stream_input_thread (void *arg) {
 	printk ("Input/Demuxing thread starting");
 
 	unsigned char *buffer;
+	unsigned char *packet;
 	unsigned char *header_buffer;
 	int codec_bytes;
 	int video_packets;
 	int audio_packets;
 	int current_track;
 	krad_codec_t track_codecs[10];
+	int resend_headers[10];
 	krad_codec_t nocodec;	
 	int packet_size;
 	uint64_t packet_timecode;
@@ -1166,8 +2536,16 @@ void *stream_input_thread (void *arg) {
 	int h;
 	int total_header_size;
 	int writeheaders;
+	uint64_t corruptions;
+	uint64_t corrupt_bytes;
+	uint64_t reported_corruptions;
+	int64_t seeked;
+	int empty_reads;
+	krad_container_t *krad_container;
 	
 	nocodec = NOCODEC;
+	empty_reads = 0;
+	reported_corruptions = 0;
 	packet_size = 0;
 	codec_bytes = 0;	
 	header_size = 0;
@@ -1177,13 +2555,31 @@ void *stream_input_thread (void *arg) {
 	audio_packets = 0;
 	current_track = -1;
 	
+	for (h = 0; h < 10; h++) {
+		track_codecs[h] = NOCODEC;
+		resend_headers[h] = 0;
+	}
+	
 	header_buffer = malloc (4096 * 512);
 	buffer = malloc (4096 * 512);
 	
 	if (krad_link->host[0] != '\0') {
 		krad_link->krad_container = krad_container_open_stream (krad_link->host, krad_link->port, krad_link->mount, NULL);
 	} else {
-		krad_link->krad_container = krad_container_open_file (krad_link->input, KRAD_IO_READONLY);
+		if (krad_playlist_is_playlist (krad_link->input)) {
+			krad_link->krad_playlist = krad_playlist_open (krad_link->input, 1);
+			if (krad_link->krad_playlist != NULL) {
+				krad_link->krad_container = krad_playlist_next (krad_link->krad_playlist);
+			}
+			if (krad_link->krad_container == NULL) {
+				krad_link->playing = 3;
+				krad_link->destroy = 1;
+			} else {
+				printk ("Krad Link: %s playing %s", krad_link->input, krad_playlist_current (krad_link->krad_playlist));
+			}
+		} else {
+			krad_link->krad_container = krad_container_open_file (krad_link->input, KRAD_IO_READONLY);
+		}
 	}
 	
 	while (!krad_link->destroy) {
@@ -1192,14 +2588,80 @@ void *stream_input_thread (void *arg) {
 		total_header_size = 0;
 		header_size = 0;
 
-		packet_size = krad_container_read_packet ( krad_link->krad_container, &current_track, &packet_timecode, buffer);
+		if (krad_link->seek_pending) {
+			krad_link->seek_pending = 0;
+			seeked = krad_container_seek (krad_link->krad_container, krad_link->seek_ms);
+			if (seeked < 0) {
+				printke ("Krad Link: could not seek %s to %"PRIu64"ms", krad_link->input, krad_link->seek_ms);
+			} else {
+				printk ("Krad Link: %s playing from %"PRId64"ms", krad_link->input, seeked);
+				/* each track's next packet goes after its headers again, the
+				   decoders know by them where the seek starts */
+				__sync_fetch_and_add (&krad_link->seeks, 1);
+				for (h = 0; h < 10; h++) {
+					resend_headers[h] = (track_codecs[h] != NOCODEC);
+				}
+			}
+		}
+
+		packet_size = krad_container_read_packet_in_place (krad_link->krad_container, &current_track,
+														   &packet_timecode, buffer, &packet);
 		//printk ("packet track %d timecode: %zu size %d", current_track, packet_timecode, packet_size);
+		if ((krad_link->krad_playlist != NULL) && (packet_size <= 0) && (packet_timecode == 0) &&
+			(((video_packets + audio_packets) > 20) || (++empty_reads > KRAD_LINK_PLAYLIST_EMPTY_READS))) {
+
+			/* the next item was opened while this one played, the decoders
+			   see new codec headers and carry on into the same mixer
+			   portgroup and compositor port, a list where nothing plays
+			   gives out a NULL once it has been all the way round */
+			krad_playlist_item_done (krad_link->krad_playlist, (video_packets + audio_packets) > 0);
+			pthread_mutex_lock (&krad_link->container_lock);
+			krad_container = krad_link->krad_container;
+			krad_link->krad_container = NULL;
+			pthread_mutex_unlock (&krad_link->container_lock);
+			krad_container_destroy (krad_container);
+			krad_container = krad_playlist_next (krad_link->krad_playlist);
+			if (krad_container == NULL) {
+				break;
+			}
+			pthread_mutex_lock (&krad_link->container_lock);
+			krad_link->krad_container = krad_container;
+			pthread_mutex_unlock (&krad_link->container_lock);
+			printk ("Krad Link: %s playing %s", krad_link->input, krad_playlist_current (krad_link->krad_playlist));
+			for (h = 0; h < 10; h++) {
+				track_codecs[h] = NOCODEC;
+				resend_headers[h] = 0;
+			}
+			reported_corruptions = 0;
+			video_packets = 0;
+			audio_packets = 0;
+			empty_reads = 0;
+			continue;
+		}
+
 		if ((packet_size <= 0) && (packet_timecode == 0) && ((video_packets + audio_packets) > 20))  {
 			//printk ("stream input thread packet size was: %d", packet_size);
 			break;
 		}
 		
-		if (krad_container_track_changed (krad_link->krad_container, current_track)) {
+		if (packet_size > 0) {
+			empty_reads = 0;
+		}
+		
+		/* the demuxer skips past corrupt input, so a bad patch of a
+		   relayed stream is a glitch here rather than the end of it */
+		corruptions = krad_container_corruptions (krad_link->krad_container, &corrupt_bytes);
+		if (corruptions != reported_corruptions) {
+			printke ("Krad Link: input has had %"PRIu64" corrupt patches, %"PRIu64" bytes skipped",
+					 corruptions, corrupt_bytes);
+			reported_corruptions = corruptions;
+		}
+		
+		krad_link->buffered_ms = krad_container_buffered_ms (krad_link->krad_container);
+		
+		if ((krad_container_track_changed (krad_link->krad_container, current_track)) ||
+			((packet_size > 0) && (resend_headers[current_track]))) {
+			resend_headers[current_track] = 0;
 			printk ("track %d changed! status is %d header count is %d", current_track, krad_container_track_active(krad_link->krad_container, current_track), krad_container_track_header_count(krad_link->krad_container, current_track));
 			
 			track_codecs[current_track] = krad_container_track_codec (krad_link->krad_container, current_track);
@@ -1222,9 +2684,7 @@ void *stream_input_thread (void *arg) {
 
 			video_packets++;
 
-			while ((krad_ringbuffer_write_space(krad_link->encoded_video_ringbuffer) < packet_size + 4 + total_header_size + 4 + 4 + 8) && (!krad_link->destroy)) {
-				usleep(10000);
-			}
+			krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, packet_size + 4 + total_header_size + 4 + 4 + 8, 1);
 			
 			if (writeheaders == 1) {
 				krad_ringbuffer_write(krad_link->encoded_video_ringbuffer, (char *)&nocodec, 4);
@@ -1241,8 +2701,9 @@ void *stream_input_thread (void *arg) {
 			}
 			krad_ringbuffer_write(krad_link->encoded_video_ringbuffer, (char *)&packet_timecode, 8);
 			krad_ringbuffer_write(krad_link->encoded_video_ringbuffer, (char *)&packet_size, 4);
-			krad_ringbuffer_write(krad_link->encoded_video_ringbuffer, (char *)buffer, packet_size);
+			krad_ringbuffer_write(krad_link->encoded_video_ringbuffer, (char *)packet, packet_size);
 			codec_bytes += packet_size;
+			krad_link_decode_wake (krad_link);
 		}
 		
 		if ((track_codecs[current_track] == VORBIS) || (track_codecs[current_track] == OPUS) || (track_codecs[current_track] == FLAC)) {
@@ -1251,9 +2712,7 @@ void *stream_input_thread (void *arg) {
 
 			if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
 			
-				while ((krad_ringbuffer_write_space (krad_link->encoded_audio_ringbuffer) < packet_size + 4 + total_header_size + 4 + 4) && (!krad_link->destroy)) {
-					usleep(10000);
-				}
+				krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, packet_size + 4 + total_header_size + 4 + 4, 1);
 				
 				if (writeheaders == 1) {
 					krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&nocodec, 4);
@@ -1270,8 +2729,9 @@ void *stream_input_thread (void *arg) {
 				}
 				
 				krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)&packet_size, 4);
-				krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)buffer, packet_size);
+				krad_ringbuffer_write (krad_link->encoded_audio_ringbuffer, (char *)packet, packet_size);
 				codec_bytes += packet_size;
+				krad_link_decode_wake (krad_link);
 			}
 			
 		}
@@ -1284,7 +2744,19 @@ void *stream_input_thread (void *arg) {
 	printk ("");
 	printk ("Input/Demuxing thread exiting");
 	
-	krad_container_destroy (krad_link->krad_container);
+	pthread_mutex_lock (&krad_link->container_lock);
+	krad_container = krad_link->krad_container;
+	krad_link->krad_container = NULL;
+	pthread_mutex_unlock (&krad_link->container_lock);
+
+	if (krad_container != NULL) {
+		krad_container_destroy (krad_container);
+	}
+	
+	if (krad_link->krad_playlist != NULL) {
+		krad_playlist_destroy (krad_link->krad_playlist);
+		krad_link->krad_playlist = NULL;
+	}
 	
 	free (buffer);
 	free (header_buffer);
@@ -1302,8 +2774,6 @@ void *udp_input_thread(void *arg) {
 
 	int sd;
 	int ret;
-	int rsize;
-	unsigned char *buffer;
 	unsigned char *packet_buffer;
 	struct sockaddr_in local_address;
 	struct sockaddr_in remote_address;
@@ -1311,16 +2781,20 @@ void *udp_input_thread(void *arg) {
 	int nocodec;
 	int opus_codec;
 	int packets;
+	int nack_size;
+	unsigned char nack[KRAD_UDP_HEADER_SIZE];
+	time_t stats_reported;
 	
 	packets = 0;
-	rsize = sizeof(remote_address);
+	stats_reported = time (NULL);
+	memset (&remote_address, 0, sizeof(remote_address));
 	opus_codec = OPUS;
 	nocodec = NOCODEC;
-	buffer = calloc (1, 2000);
 	packet_buffer = calloc (1, 500000);
 	sd = socket (AF_INET, SOCK_DGRAM, 0);
 
 	krad_link->krad_rebuilder = krad_rebuilder_create ();
+	krad_rebuilder_set_latency (krad_link->krad_rebuilder, krad_link->udp_latency_ms);
 
 	memset((char *) &local_address, 0, sizeof(local_address));
 	local_address.sin_family = AF_INET;
@@ -1331,12 +2805,14 @@ void *udp_input_thread(void *arg) {
 		failfast ("UDP Input bind error");
 	}
 	
+	krad_rebuilder_set_gro (krad_link->krad_rebuilder, sd);
+	
 	//kludge to get header
 	krad_opus_t *opus_temp;
 	unsigned char opus_header[256];
 	int opus_header_size;
 	
-	opus_temp = krad_opus_encoder_create (krad_link->krad_radio->krad_mixer->sample_rate, 2, 110000, 
+	opus_temp = krad_opus_encoder_create (2, krad_link->krad_radio->krad_mixer->sample_rate, 110000, 
 										 OPUS_APPLICATION_AUDIO);
 										 
 	opus_header_size = opus_temp->header_data_size;
@@ -1349,13 +2825,15 @@ void *udp_input_thread(void *arg) {
 	krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)&opus_codec, 4);
 	krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)&opus_header_size, 4);
 	krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)opus_header, opus_header_size);
+	krad_link_decode_wake (krad_link);
 
 	while (!krad_link->destroy) {
 	
 		sockets[0].fd = sd;
 		sockets[0].events = POLLIN;
 
-		ret = poll (sockets, 1, 250);	
+		// short, the jitter buffer has to let go of gaps on time
+		ret = poll (sockets, 1, 5);
 	
 		if (ret < 0) {
 			printk ("Krad Link UDP Poll Failure");
@@ -1365,46 +2843,53 @@ void *udp_input_thread(void *arg) {
 	
 		if (ret > 0) {
 		
-			ret = recvfrom (sd, buffer, 2000, 0, (struct sockaddr *)&remote_address, (socklen_t *)&rsize);
+			ret = krad_rebuilder_recv (krad_link->krad_rebuilder, sd, &remote_address);
 		
 			if (ret == -1) {
 				printk ("Krad Link UDP Recv Failure");
 				krad_link->destroy = 1;
 				continue;
 			}
-		
-			//printk ("Received packet from %s:%d", 
-			//		inet_ntoa(remote_address.sin_addr), ntohs(remote_address.sin_port));
+		}
 
+		if (__sync_bool_compare_and_swap (&krad_link->udp_changed, 1, 0)) {
+			krad_rebuilder_set_latency (krad_link->krad_rebuilder, krad_link->udp_latency_ms);
+		}
 
-			krad_rebuilder_write (krad_link->krad_rebuilder, buffer, ret);
+		while ((nack_size = krad_rebuilder_get_nack (krad_link->krad_rebuilder, nack)) > 0) {
+			if (remote_address.sin_port == 0) {
+				continue;
+			}
+			sendto (sd, nack, nack_size, 0, (struct sockaddr *)&remote_address, sizeof(remote_address));
+		}
 
-			ret = krad_rebuilder_read_packet (krad_link->krad_rebuilder, packet_buffer, 1);
-		
-			if (ret != 0) {
-				//printk ("read a packet with %d bytes", ret);
+		while ((ret = krad_rebuilder_read_packet (krad_link->krad_rebuilder, packet_buffer, 1)) > 0) {
 
-				if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
+			//printk ("read a packet with %d bytes", ret);
+
+			if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
+		
+				krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, ret + 4 + 4, 1);
 			
-					while ((krad_ringbuffer_write_space(krad_link->encoded_audio_ringbuffer) < ret + 4 + 4) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
-				
-					if (packets > 0) {
-						krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)&opus_codec, 4);
-					}
-					krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)&ret, 4);
-					krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)packet_buffer, ret);
-					packets++;
+				if (packets > 0) {
+					krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)&opus_codec, 4);
 				}
-
+				krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)&ret, 4);
+				krad_ringbuffer_write(krad_link->encoded_audio_ringbuffer, (char *)packet_buffer, ret);
+				krad_link_decode_wake (krad_link);
+				packets++;
 			}
 		}
+		
+		if (time (NULL) - stats_reported >= KRAD_LINK_UDP_REPORT_SECONDS) {
+			krad_rebuilder_print_stats (krad_link->krad_rebuilder, 1);
+			stats_reported = time (NULL);
+		}
 	}
 
+	krad_rebuilder_print_stats (krad_link->krad_rebuilder, 1);
 	krad_rebuilder_destroy (krad_link->krad_rebuilder);
 	close (sd);
-	free (buffer);
 	free (packet_buffer);
 	printk ("UDP Input thread exiting");
 	
@@ -1412,6 +2897,101 @@ void *udp_input_thread(void *arg) {
 
 }
 
+/* Converts and composites what video_decoding_thread decodes, so scaling
+   one frame overlaps decoding the next */
+
+void *video_converting_thread (void *arg) {
+
+	prctl (PR_SET_NAME, (unsigned long) "kradlink_vidcnv", 0, 0, 0);
+
+	krad_link_t *krad_link = (krad_link_t *)arg;
+
+	printk ("Video converting thread starting");
+
+	krad_frame_t *krad_frame;
+	int start_waited_ms;
+	int reported_dropped;
+	time_t sync_reported;
+	uint64_t last_timecode;
+	int frame_ms;
+	int64_t shown_ms;
+	uint64_t clock_ms;
+	int64_t clock_moved_ms;
+
+	start_waited_ms = 0;
+	reported_dropped = 0;
+	sync_reported = time (NULL);
+	last_timecode = 0;
+	shown_ms = krad_link_now_ms ();
+	clock_ms = 0;
+	clock_moved_ms = shown_ms;
+
+	while (!krad_link->destroy) {
+
+		pthread_mutex_lock (&krad_link->decode_lock);
+		while ((krad_link->convert_queued == 0) && (!krad_link->destroy)) {
+			krad_link_decode_timedwait (krad_link);
+		}
+		pthread_mutex_unlock (&krad_link->decode_lock);
+
+		if (krad_link->destroy) {
+			break;
+		}
+
+		krad_frame = krad_link->convert_frame[krad_link->convert_read];
+
+		/* going by the gap to the frame before, across a jump it is a guess */
+		frame_ms = krad_frame->timecode - last_timecode;
+		if ((krad_frame->timecode <= last_timecode) || (frame_ms > KRAD_LINK_DECODE_WAIT_MS)) {
+			frame_ms = KRAD_LINK_DECODE_WAIT_MS;
+		}
+		last_timecode = krad_frame->timecode;
+
+		/* a late frame was still decoded for the ones after it to refer to,
+		   it just isn't converted and composited */
+		if (krad_link->convert_flush == 0) {
+			if (krad_link_video_frame_late (krad_link, krad_frame->timecode, &start_waited_ms)) {
+				krad_link->video_frames_dropped++;
+			} else {
+				krad_compositor_port_convert_yuv_frame (krad_link->krad_compositor_port, krad_frame);
+				krad_link_video_frame_wait (krad_link, krad_frame->timecode, frame_ms, shown_ms,
+											&clock_ms, &clock_moved_ms);
+				if (krad_link->convert_flush == 0) {
+					krad_compositor_port_push_frame (krad_link->krad_compositor_port, krad_frame);
+					shown_ms = krad_link_now_ms ();
+				}
+			}
+		}
+
+		if ((krad_link->video_frames_dropped != reported_dropped) &&
+			(time (NULL) - sync_reported >= KRAD_LINK_SYNC_REPORT_SECONDS)) {
+			sync_reported = time (NULL);
+			reported_dropped = krad_link->video_frames_dropped;
+			printk ("Krad Link: %s has dropped %d late video frames, video at %"PRIu64"ms audio clock at %"PRIu64"ms",
+					krad_link->sysname, krad_link->video_frames_dropped, krad_frame->timecode,
+					krad_link_audio_clock_ms (krad_link));
+		}
+
+		krad_framepool_unref_frame (krad_frame);
+		krad_link->convert_frame[krad_link->convert_read] = NULL;
+		krad_link->convert_read = (krad_link->convert_read + 1) % KRAD_LINK_CONVERT_FRAMES;
+
+		pthread_mutex_lock (&krad_link->decode_lock);
+		/* frames leave in order, so the ones from before a seek go first */
+		if (krad_link->convert_flush > 0) {
+			krad_link->convert_flush--;
+		}
+		krad_link->convert_queued--;
+		pthread_cond_broadcast (&krad_link->decode_cond);
+		pthread_mutex_unlock (&krad_link->decode_lock);
+	}
+
+	printk ("Video converting thread exiting");
+
+	return NULL;
+
+}
+
 void *video_decoding_thread (void *arg) {
 
 	prctl (PR_SET_NAME, (unsigned long) "kradlink_viddec", 0, 0, 0);
@@ -1427,15 +3007,28 @@ void *video_decoding_thread (void *arg) {
 	int header_len[3];
 	uint64_t timecode;
 	uint64_t timecode2;
+	uint64_t last_timecode;
+	int64_t timecode_base;
+	int new_headers;
+	int decoded;
+	struct timespec decode_start;
 	krad_frame_t *krad_frame;
 	int port_updated;
+	int seeks;
+	int seeks_seen;
+	int seeked;
 	
 	for (h = 0; h < 3; h++) {
 		header[h] = malloc(100000);
 		header_len[h] = 0;
 	}
 
+	last_timecode = 0;
+	timecode_base = 0;
+	new_headers = 0;
 	port_updated = 0;
+	seeks_seen = 0;
+	seeked = 0;
 	bytes = 0;
 	buffer = malloc(3000000);
 	
@@ -1451,16 +3044,36 @@ void *video_decoding_thread (void *arg) {
 																   INPUT,
 																   krad_link->composite_width,
 																   krad_link->composite_height);
+
+	pthread_create (&krad_link->video_converting_thread, NULL, video_converting_thread, (void *)krad_link);
 	
 	
 	while (!krad_link->destroy) {
 
 
-		while ((krad_ringbuffer_read_space(krad_link->encoded_video_ringbuffer) < 4) && (!krad_link->destroy)) {
-			usleep(10000);
-		}
+		krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, 4, 0);
 		
 		krad_ringbuffer_read(krad_link->encoded_video_ringbuffer, (char *)&krad_link->video_codec, 4);
+
+		/* after a seek, packets and frames from before it are dropped up
+		   to the headers the demuxer sent from where it seeked to */
+		seeks = krad_link->seeks;
+		if (seeks_seen != seeks) {
+			krad_link_video_convert_flush (krad_link);
+			if (krad_link->video_codec == NOCODEC) {
+				seeks_seen = seeks;
+				seeked = 1;
+			} else if (krad_link->video_codec == krad_link->last_video_codec) {
+				krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, 12, 0);
+				krad_ringbuffer_read_advance (krad_link->encoded_video_ringbuffer, 8);
+				krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, (char *)&bytes, 4);
+				krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, bytes, 0);
+				krad_ringbuffer_read_advance (krad_link->encoded_video_ringbuffer, bytes);
+				krad_link_decode_wake (krad_link);
+				continue;
+			}
+		}
+
 		if ((krad_link->last_video_codec != krad_link->video_codec) || (krad_link->video_codec == NOCODEC)) {
 			printk ("video codec is %d", krad_link->video_codec);
 			if (krad_link->last_video_codec != NOCODEC)	{
@@ -1480,6 +3093,7 @@ void *video_decoding_thread (void *arg) {
 	
 			if (krad_link->video_codec == NOCODEC) {
 				krad_link->last_video_codec = krad_link->video_codec;
+				new_headers = 1;
 				continue;
 			}
 	
@@ -1492,15 +3106,11 @@ void *video_decoding_thread (void *arg) {
 				
 				for (h = 0; h < 3; h++) {
 
-					while ((krad_ringbuffer_read_space(krad_link->encoded_video_ringbuffer) < 4) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, 4, 0);
 	
 					krad_ringbuffer_read(krad_link->encoded_video_ringbuffer, (char *)&header_len[h], 4);
 		
-					while ((krad_ringbuffer_read_space(krad_link->encoded_video_ringbuffer) < header_len[h]) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, header_len[h], 0);
 		
 					krad_ringbuffer_read(krad_link->encoded_video_ringbuffer, (char *)header[h], header_len[h]);
 				}
@@ -1508,6 +3118,7 @@ void *video_decoding_thread (void *arg) {
 				printk ("Theora Header byte sizes: %d %d %d", header_len[0], header_len[1], header_len[2]);
 				krad_link->krad_theora_decoder = krad_theora_decoder_create(header[0], header_len[0], header[1], header_len[1], header[2], header_len[2]);
 
+				krad_link_video_convert_drain (krad_link);
 				krad_compositor_port_set_io_params (krad_link->krad_compositor_port,
 													krad_link->krad_theora_decoder->width,
 													krad_link->krad_theora_decoder->height);
@@ -1522,19 +3133,16 @@ void *video_decoding_thread (void *arg) {
 
 		krad_link->last_video_codec = krad_link->video_codec;
 	
-		while ((krad_ringbuffer_read_space(krad_link->encoded_video_ringbuffer) < 12) && (!krad_link->destroy)) {
-			usleep(10000);
-		}
+		krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, 12, 0);
 	
 		krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, (char *)&timecode, 8);
 	
 		krad_ringbuffer_read(krad_link->encoded_video_ringbuffer, (char *)&bytes, 4);
 		
-		while ((krad_ringbuffer_read_space(krad_link->encoded_video_ringbuffer) < bytes) && (!krad_link->destroy)) {
-			usleep(10000);
-		}
+		krad_link_decode_wait (krad_link, krad_link->encoded_video_ringbuffer, bytes, 0);
 		
 		krad_ringbuffer_read (krad_link->encoded_video_ringbuffer, (char *)buffer, bytes);
+		krad_link_decode_wake (krad_link);
 		
 		krad_frame = krad_framepool_getframe (krad_link->krad_framepool);
 		while ((krad_frame == NULL) && (!krad_link->destroy)) {
@@ -1546,13 +3154,18 @@ void *video_decoding_thread (void *arg) {
 			break;
 		}		
 		
-		if ((krad_link->playing == 0) && (krad_link->krad_compositor_port->start_timecode != 1)) {
-			krad_link->playing = 1;
+		if ((krad_link->av_mode == VIDEO_ONLY) && (krad_link->krad_compositor_port->start_timecode != 1)) {
+			/* with audio, the audio decoder starts the link once it has prebuffered */
+			krad_link_start_playing (krad_link, NULL, 0);
 		}
 		
+		decoded = 0;
+		clock_gettime (CLOCK_MONOTONIC, &decode_start);
+		
 		if (krad_link->video_codec == THEORA) {
 		
 			krad_theora_decoder_decode (krad_link->krad_theora_decoder, buffer, bytes);		
+			krad_link_video_decode_timed (krad_link, &decode_start);
 			krad_theora_decoder_timecode (krad_link->krad_theora_decoder, &timecode2);			
 			//printk ("timecode1: %zu timecode2: %zu", timecode, timecode2);
 			timecode = timecode2;
@@ -1567,17 +3180,18 @@ void *video_decoding_thread (void *arg) {
 			krad_frame->yuv_strides[1] = krad_link->krad_theora_decoder->ycbcr[1].stride;
 			krad_frame->yuv_strides[2] = krad_link->krad_theora_decoder->ycbcr[2].stride;
 
-			krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
-
+			decoded = 1;
 		}
 			
 		if (krad_link->video_codec == VP8) {
 
 			krad_vpx_decoder_decode (krad_link->krad_vpx_decoder, buffer, bytes);
+			krad_link_video_decode_timed (krad_link, &decode_start);
 				
 			if (krad_link->krad_vpx_decoder->img != NULL) {
 				
 				if (port_updated == 0) {
+					krad_link_video_convert_drain (krad_link);
 					krad_compositor_port_set_io_params (krad_link->krad_compositor_port,
 														krad_link->krad_vpx_decoder->width,
 														krad_link->krad_vpx_decoder->height);
@@ -1595,8 +3209,7 @@ void *video_decoding_thread (void *arg) {
 				krad_frame->yuv_strides[1] = krad_link->krad_vpx_decoder->img->stride[1];
 				krad_frame->yuv_strides[2] = krad_link->krad_vpx_decoder->img->stride[2];
 				
-				krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
-
+				decoded = 1;
 			}
 		}
 			
@@ -1604,10 +3217,12 @@ void *video_decoding_thread (void *arg) {
 		if (krad_link->video_codec == DIRAC) {
 
 			krad_dirac_decode (krad_link->krad_dirac, buffer, bytes);
+			krad_link_video_decode_timed (krad_link, &decode_start);
 
 			if (krad_link->krad_dirac->frame != NULL) {
 				
 				if (port_updated == 0) {
+					krad_link_video_convert_drain (krad_link);
 					krad_compositor_port_set_io_params (krad_link->krad_compositor_port,
 														krad_link->krad_dirac->frame->width,
 														krad_link->krad_dirac->frame->height);
@@ -1633,18 +3248,59 @@ void *video_decoding_thread (void *arg) {
 				krad_frame->yuv_strides[1] = krad_link->krad_dirac->frame->components[1].stride;
 				krad_frame->yuv_strides[2] = krad_link->krad_dirac->frame->components[2].stride;
 				
-				krad_compositor_port_push_yuv_frame (krad_link->krad_compositor_port, krad_frame);
-				
+				decoded = 1;
 			}
 		}
 		
-		krad_frame->timecode = timecode;
+		/* played from partway in, seeked or onto the next item of a list,
+		   which all come with new headers, or a jump in a live stream,
+		   the compositor paces frames by timecode so they carry on from
+		   the last one it had */
+		if ((new_headers) || (timecode + KRAD_LINK_SEEK_GAP_MS < last_timecode) ||
+			(timecode > last_timecode + KRAD_LINK_SEEK_GAP_MS)) {
+			if (krad_link->audio_clock_running) {
+				/* with audio the frame lines up with where the clock will be
+				   when the audio from here plays, a seek empties what is
+				   queued ahead of that */
+				if (seeked) {
+					timecode_base = timecode - krad_link_audio_clock_ms (krad_link);
+				} else {
+					timecode_base = timecode - (krad_link_audio_clock_ms (krad_link) +
+												krad_link_audio_queued_ms (krad_link));
+				}
+			} else {
+				timecode_base = timecode - (last_timecode - timecode_base);
+			}
+			new_headers = 0;
+			seeked = 0;
+		}
+		last_timecode = timecode;
+
+		krad_frame->timecode = timecode - timecode_base;
 		//printk ("frame timecode: %zu", krad_frame->timecode);
 
+		if (decoded) {
+			krad_link_video_convert_queue (krad_link, krad_frame);
+		}
+
 		krad_framepool_unref_frame (krad_frame);		
 		
 	}
 
+	pthread_join (krad_link->video_converting_thread, NULL);
+
+	for (h = 0; h < KRAD_LINK_CONVERT_FRAMES; h++) {
+		if (krad_link->convert_frame[h] != NULL) {
+			krad_framepool_unref_frame (krad_link->convert_frame[h]);
+			krad_link->convert_frame[h] = NULL;
+		}
+		free (krad_link->convert_yuv[h]);
+		krad_link->convert_yuv[h] = NULL;
+		krad_link->convert_yuv_size[h] = 0;
+	}
+	krad_link->convert_queued = 0;
+	krad_link->convert_flush = 0;
+
 	krad_compositor_port_destroy (krad_link->krad_radio->krad_compositor, krad_link->krad_compositor_port);
 
 	free (buffer);
@@ -1657,6 +3313,19 @@ void *video_decoding_thread (void *arg) {
 
 }
 
+/* The mixer thread reads the decoded audio, so it is the one to empty
+   it, see krad_link_audio_samples_callback */
+
+static void krad_link_audio_flush (krad_link_t *krad_link) {
+
+	krad_link->audio_flush = 1;
+
+	while ((krad_link->audio_flush) && (!krad_link->destroy)) {
+		usleep (KRAD_LINK_DECODE_WAIT_MS * 1000);
+	}
+
+}
+
 void *audio_decoding_thread(void *arg) {
 
 	prctl (PR_SET_NAME, (unsigned long) "kradlink_auddec", 0, 0, 0);
@@ -1680,6 +3349,13 @@ void *audio_decoding_thread(void *arg) {
 	
 	krad_resample_ring_t *krad_resample_ring[KRAD_MIXER_MAX_CHANNELS];
 	
+	int track_drift;
+	double drift_adjust;
+	time_t drift_reported;
+	uint32_t prebuffer_ms;
+	int seeks;
+	int seeks_seen;
+	
 	/* SET UP */
 	
 	krad_link->channels = 2;
@@ -1698,6 +3374,21 @@ void *audio_decoding_thread(void *arg) {
 		samples[c] = malloc(4 * 8192);
 		krad_link->samples[c] = malloc(4 * 8192);
 	}
+
+	/* a file plays at our pace, a remote sender plays at theirs */
+	track_drift = 0;
+	drift_reported = time (NULL);
+	prebuffer_ms = KRAD_LINK_AUDIO_AHEAD_MS;
+	seeks_seen = 0;
+	
+	if ((krad_link->operation_mode == RECEIVE) && (krad_link->audio_target_latency_ms > 0)) {
+		track_drift = 1;
+		/* prebuffer to the target so the loop starts out settled */
+		prebuffer_ms = krad_link->audio_target_latency_ms;
+		for (c = 0; c < krad_link->channels; c++) {
+			krad_resample_ring_set_target_latency (krad_resample_ring[c], krad_link->audio_target_latency_ms);
+		}
+	}
 	
 	buffer = malloc(2000000);
 	audio = calloc(1, 8192 * 4 * 4);
@@ -1714,11 +3405,28 @@ void *audio_decoding_thread(void *arg) {
 
 		/* THE FOLLOWING IS WHERE WE ENSURE WE ARE ON THE RIGHT CODEC AND READ HEADERS IF NEED BE */
 
-		while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < 4) && (!krad_link->destroy)) {
-			usleep(5000);
-		}
+		krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, 4, 0);
 		
 		krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)&krad_link->audio_codec, 4);
+
+		/* after a seek, packets from before it are dropped up to the
+		   headers the demuxer sent from where it seeked to, and so is
+		   what was decoded from them but not yet played */
+		seeks = krad_link->seeks;
+		if (seeks_seen != seeks) {
+			if (krad_link->audio_codec == NOCODEC) {
+				krad_link_audio_flush (krad_link);
+				seeks_seen = seeks;
+			} else if (krad_link->audio_codec == krad_link->last_audio_codec) {
+				krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, 4, 0);
+				krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)&bytes, 4);
+				krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, bytes, 0);
+				krad_ringbuffer_read_advance (krad_link->encoded_audio_ringbuffer, bytes);
+				krad_link_decode_wake (krad_link);
+				continue;
+			}
+		}
+
 		if ((krad_link->last_audio_codec != krad_link->audio_codec) || (krad_link->audio_codec == NOCODEC)) {
 			printk ("audio codec is %d", krad_link->audio_codec);
 			if (krad_link->last_audio_codec != NOCODEC)	{
@@ -1745,15 +3453,11 @@ void *audio_decoding_thread(void *arg) {
 				krad_link->krad_flac = krad_flac_decoder_create();
 				for (h = 0; h < 1; h++) {
 
-					while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < 4) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, 4, 0);
 	
 					krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)&header_len[h], 4);
 		
-					while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < header_len[h]) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, header_len[h], 0);
 		
 					krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)header[h], header_len[h]);
 				}
@@ -1767,15 +3471,11 @@ void *audio_decoding_thread(void *arg) {
 				
 				for (h = 0; h < 3; h++) {
 
-					while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < 4) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, 4, 0);
 	
 					krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)&header_len[h], 4);
 		
-					while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < header_len[h]) && (!krad_link->destroy)) {
-						usleep(10000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, header_len[h], 0);
 		
 					krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)header[h], header_len[h]);
 				}
@@ -1794,15 +3494,11 @@ void *audio_decoding_thread(void *arg) {
 			
 				for (h = 0; h < 1; h++) {
 
-					while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < 4) && (!krad_link->destroy)) {
-						usleep(5000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, 4, 0);
 	
 					krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)&header_len[h], 4);
 		
-					while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < header_len[h]) && (!krad_link->destroy)) {
-						usleep(5000);
-					}
+					krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, header_len[h], 0);
 		
 					krad_ringbuffer_read(krad_link->encoded_audio_ringbuffer, (char *)header[h], header_len[h]);
 				}
@@ -1819,17 +3515,14 @@ void *audio_decoding_thread(void *arg) {
 
 		krad_link->last_audio_codec = krad_link->audio_codec;
 	
-		while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < 4) && (!krad_link->destroy)) {
-			usleep(4000);
-		}
+		krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, 4, 0);
 	
 		krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)&bytes, 4);
 		
-		while ((krad_ringbuffer_read_space(krad_link->encoded_audio_ringbuffer) < bytes) && (!krad_link->destroy)) {
-			usleep(1000);
-		}
+		krad_link_decode_wait (krad_link, krad_link->encoded_audio_ringbuffer, bytes, 0);
 		
 		krad_ringbuffer_read (krad_link->encoded_audio_ringbuffer, (char *)buffer, bytes);
+		krad_link_decode_wake (krad_link);
 		
 		/* DECODING HAPPENS HERE */
 		
@@ -1846,10 +3539,7 @@ void *audio_decoding_thread(void *arg) {
 				
 					while ((krad_resample_ring_write_space (krad_resample_ring[0]) < len) && (!krad_link->destroy)) {
 						//printk ("wait!");
-						//FIXME
-						if (krad_link->playing == 0) {
-							krad_link->playing = 1;
-						}
+						krad_link_start_playing (krad_link, krad_resample_ring[0], prebuffer_ms);
 						usleep(25000);
 					}
 				
@@ -1909,6 +3599,41 @@ void *audio_decoding_thread(void *arg) {
 				}
 			}
 		}
+		
+		/* DECODE AHEAD */
+		
+		/* a file or an unpaced sender is only decoded so far ahead of the
+		   mixer, which keeps it in step with its video and quick to seek */
+		if (!track_drift) {
+			while ((krad_resample_ring_fill_ms (krad_resample_ring[0]) >= KRAD_LINK_AUDIO_AHEAD_MS) &&
+				   (!krad_link->destroy)) {
+				krad_link_start_playing (krad_link, krad_resample_ring[0], prebuffer_ms);
+				usleep (KRAD_LINK_AUDIO_AHEAD_MS * 1000 / 10);
+			}
+		}
+		
+		/* CLOCK DRIFT */
+		
+		if (track_drift) {
+			if (krad_link->playing == 0) {
+				krad_link_start_playing (krad_link, krad_resample_ring[0], prebuffer_ms);
+			} else {
+				drift_adjust = krad_resample_ring_track_drift (krad_resample_ring[0]);
+				for (c = 0; c < krad_link->channels; c++) {
+					krad_resample_ring_set_drift_adjust (krad_resample_ring[c], drift_adjust);
+				}
+				
+				krad_link->audio_fill_ms = krad_resample_ring_fill_ms (krad_resample_ring[0]);
+				krad_link->audio_drift_ppm = drift_adjust * 1000000.0;
+				
+				if (time (NULL) - drift_reported >= KRAD_LINK_DRIFT_REPORT_SECONDS) {
+					drift_reported = time (NULL);
+					printk ("Krad Link: %s audio fill %dms target %dms ratio trim %+.1fppm underruns %d",
+							krad_link->sysname, krad_link->audio_fill_ms, krad_link->audio_target_latency_ms,
+							krad_link->audio_drift_ppm, krad_link->audio_underruns);
+				}
+			}
+		}
 	}
 	
 	/* ITS ALL OVER */
@@ -2089,10 +3814,12 @@ void krad_link_destroy (krad_link_t *krad_link) {
 	printk ("Link shutting down");
 	
 	krad_link->destroy = 1;	
+	krad_link_decode_wake (krad_link);
 	
 	if (krad_link->capturing) {
 		krad_link->capturing = 0;
-		if ((krad_link->video_source == V4L2) || (krad_link->video_source == X11)) {
+		if ((krad_link->video_source == V4L2) || (krad_link->video_source == X11) ||
+			(krad_link->video_source == SYNTH) || (krad_link->video_source == YUVFILE)) {
 			pthread_join (krad_link->video_capture_thread, NULL);
 		}
 		if (krad_link->video_source == DECKLINK) {
@@ -2112,8 +3839,9 @@ void krad_link_destroy (krad_link_t *krad_link) {
 			krad_link->encoding = 3;
 		}
 	
-		if (krad_link->audio_codec != NOCODEC) {
-			pthread_join (krad_link->audio_encoding_thread, NULL);
+		/* a link torn down before its encoder started has nothing to stop */
+		if ((krad_link->audio_codec != NOCODEC) && (krad_link->audio_encode_job != NULL)) {
+			krad_link_audio_encode_stop (krad_link);
 		}
 	}
 	
@@ -2121,6 +3849,18 @@ void krad_link_destroy (krad_link_t *krad_link) {
 	     (krad_link->operation_mode == RECORD)) {
 			pthread_join (krad_link->stream_output_thread, NULL);
 	}
+	
+	for (c = 1; c < krad_link->renditions; c++) {
+		pthread_join (krad_link->rendition[c]->stream_output_thread, NULL);
+		krad_link_child_destroy (krad_link->rendition[c]);
+		krad_link->rendition[c] = NULL;
+	}
+	
+	for (c = 0; c < KRAD_LINK_MAX_OUTPUTS; c++) {
+		if (krad_link->fanout[c] != NULL) {
+			krad_link_remove_output (krad_link, c);
+		}
+	}
 
 	if ((krad_link->operation_mode == TRANSMIT) && (krad_link->transport_mode == UDP)) {
 		pthread_join (krad_link->udp_output_thread, NULL);
@@ -2171,11 +3911,243 @@ void krad_link_destroy (krad_link_t *krad_link) {
 	
 	krad_tags_destroy (krad_link->krad_tags);	
 	
+	pthread_mutex_destroy (&krad_link->fanout_lock);
+	pthread_mutex_destroy (&krad_link->container_lock);
+	pthread_cond_destroy (&krad_link->decode_cond);
+	pthread_mutex_destroy (&krad_link->decode_lock);
+	
 	printk ("Krad Link Closed Clean");
 	
 	free (krad_link);
 }
 
+int krad_link_add_output (krad_link_t *krad_link, char *destination) {
+
+	krad_link_t *output;
+	int o;
+
+	if ((krad_link->operation_mode != TRANSMIT) && (krad_link->operation_mode != RECORD)) {
+		printke ("Krad Link: %s isn't encoding, can't add an output", krad_link->sysname);
+		return -1;
+	}
+	
+	output = krad_link_child_create (krad_link);
+	output->fanout_parent = krad_link;
+	output->host[0] = '\0';
+	output->mount[0] = '\0';
+	output->password[0] = '\0';
+
+	if (strncmp (destination, "udp://", 6) == 0) {
+		output->operation_mode = TRANSMIT;
+		output->transport_mode = UDP;
+		if (sscanf (destination + 6, "%511[^:]:%d", output->host, &output->port) != 2) {
+			output->host[0] = '\0';
+		}
+	} else if (strncmp (destination, "transmitter:", 12) == 0) {
+		output->operation_mode = TRANSMIT;
+		output->transport_mode = TCP;
+		strcpy (output->host, "transmitter");
+		strncpy (output->mount, destination + 12, sizeof(output->mount) - 1);
+	} else if (strncmp (destination, "icecast://", 10) == 0) {
+		output->operation_mode = TRANSMIT;
+		output->transport_mode = TCP;
+		if (sscanf (destination + 10, "%511[^@]@%511[^:]:%d%511s",
+					output->password, output->host, &output->port, output->mount) != 4) {
+			output->host[0] = '\0';
+		}
+	} else {
+		output->operation_mode = RECORD;
+		output->transport_mode = FILESYSTEM;
+		strncpy (output->output, destination, sizeof(output->output) - 1);
+	}
+	
+	if ((output->operation_mode == TRANSMIT) && (output->host[0] == '\0')) {
+		printke ("Krad Link: can't make sense of output %s", destination);
+		krad_link_child_destroy (output);
+		return -1;
+	}
+
+	/* it joins part way through, so it waits for a keyframe */
+	output->video_queue_needs_keyframe = 1;
+	output->encoding = 1;
+	output->krad_theora_encoder = krad_link->krad_theora_encoder;
+
+	pthread_mutex_lock (&krad_link->fanout_lock);
+
+	for (o = 0; o < KRAD_LINK_MAX_OUTPUTS; o++) {
+		if (krad_link->fanout[o] == NULL) {
+			break;
+		}
+	}
+
+	if (o == KRAD_LINK_MAX_OUTPUTS) {
+		pthread_mutex_unlock (&krad_link->fanout_lock);
+		printke ("Krad Link: %s already has %d outputs", krad_link->sysname, KRAD_LINK_MAX_OUTPUTS);
+		krad_link_child_destroy (output);
+		return -1;
+	}
+
+	snprintf (output->sysname, sizeof(output->sysname), "%s_out%d", krad_link->sysname, o);
+
+	if (krad_link->audio_encoder_ready) {
+		krad_link_child_audio_ready (krad_link, output);
+	}
+
+	if (output->transport_mode == UDP) {
+		pthread_create (&output->udp_output_thread, NULL, udp_output_thread, (void *)output);
+	} else {
+		pthread_create (&output->stream_output_thread, NULL, stream_output_thread, (void *)output);
+	}
+
+	krad_link->fanout[o] = output;
+	
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+	if ((krad_link->video_codec == VP8) && (krad_link->krad_vpx_encoder != NULL)) {
+		krad_vpx_encoder_want_keyframe (krad_link->krad_vpx_encoder);
+	}
+
+	printk ("Krad Link: %s output %d to %s", krad_link->sysname, o, destination);
+
+	return o;
+
+}
+
+void krad_link_seek (krad_link_t *krad_link, uint64_t ms) {
+
+	if ((krad_link->operation_mode != PLAYBACK) || (krad_link->transport_mode != FILESYSTEM)) {
+		printke ("Krad Link: %s is not playing a file, can't seek", krad_link->sysname);
+		return;
+	}
+
+	krad_link->seek_ms = ms;
+	krad_link->seek_pending = 1;
+
+	printk ("Krad Link: %s seeking to %"PRIu64"ms", krad_link->sysname, ms);
+
+}
+
+void krad_link_set_max_interleave (krad_link_t *krad_link, int ms) {
+
+	int r;
+
+	krad_link->max_interleave_ms = ms;
+
+	for (r = 1; r < krad_link->renditions; r++) {
+		krad_link->rendition[r]->max_interleave_ms = ms;
+	}
+
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (r = 0; r < KRAD_LINK_MAX_OUTPUTS; r++) {
+		if (krad_link->fanout[r] != NULL) {
+			krad_link->fanout[r]->max_interleave_ms = ms;
+		}
+	}
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+	printk ("Krad Link: %s max interleave delay now %dms", krad_link->sysname, ms);
+
+}
+
+/* the output thread owns the container, it picks these up before its next packet */
+
+static void krad_link_apply_live (krad_link_t *krad_link, int cluster_ms, int cluster_bytes, int flush_ms) {
+
+	krad_link->live_cluster_ms = cluster_ms;
+	krad_link->live_cluster_bytes = cluster_bytes;
+	krad_link->live_flush_ms = flush_ms;
+
+	__sync_bool_compare_and_swap (&krad_link->live_changed, 0, 1);
+
+}
+
+void krad_link_set_live (krad_link_t *krad_link, int cluster_ms, int cluster_bytes, int flush_ms) {
+
+	int r;
+
+	krad_link_apply_live (krad_link, cluster_ms, cluster_bytes, flush_ms);
+
+	for (r = 1; r < krad_link->renditions; r++) {
+		krad_link_apply_live (krad_link->rendition[r], cluster_ms, cluster_bytes, flush_ms);
+	}
+
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (r = 0; r < KRAD_LINK_MAX_OUTPUTS; r++) {
+		if (krad_link->fanout[r] != NULL) {
+			krad_link_apply_live (krad_link->fanout[r], cluster_ms, cluster_bytes, flush_ms);
+		}
+	}
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+	printk ("Krad Link: %s live clusters now %dms or %d bytes, flushing every %dms",
+			krad_link->sysname, cluster_ms, cluster_bytes, flush_ms);
+
+}
+
+/* the udp thread owns the slicer or rebuilder, it picks these up on its next pass */
+
+static void krad_link_apply_udp (krad_link_t *krad_link, int pace_kbps, int pace_txtime, int fec_group, int latency_ms) {
+
+	krad_link->udp_pace_kbps = pace_kbps;
+	krad_link->udp_pace_txtime = pace_txtime;
+	krad_link->udp_fec_group = fec_group;
+	krad_link->udp_latency_ms = latency_ms;
+
+	__sync_bool_compare_and_swap (&krad_link->udp_changed, 0, 1);
+
+}
+
+void krad_link_set_udp (krad_link_t *krad_link, int pace_kbps, int pace_txtime, int fec_group, int latency_ms) {
+
+	int r;
+
+	krad_link_apply_udp (krad_link, pace_kbps, pace_txtime, fec_group, latency_ms);
+
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	for (r = 0; r < KRAD_LINK_MAX_OUTPUTS; r++) {
+		if (krad_link->fanout[r] != NULL) {
+			krad_link_apply_udp (krad_link->fanout[r], pace_kbps, pace_txtime, fec_group, latency_ms);
+		}
+	}
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+
+	printk ("Krad Link: %s udp pacing now %dkbps%s, fec group %d, latency %dms",
+			krad_link->sysname, pace_kbps, pace_txtime ? " with txtime" : "", fec_group, latency_ms);
+
+}
+
+void krad_link_remove_output (krad_link_t *krad_link, int number) {
+
+	krad_link_t *output;
+
+	if ((number < 0) || (number >= KRAD_LINK_MAX_OUTPUTS)) {
+		return;
+	}
+
+	pthread_mutex_lock (&krad_link->fanout_lock);
+	output = krad_link->fanout[number];
+	krad_link->fanout[number] = NULL;
+	pthread_mutex_unlock (&krad_link->fanout_lock);
+	
+	if (output == NULL) {
+		return;
+	}
+	
+	output->encoding = 4;
+	
+	if (output->transport_mode == UDP) {
+		pthread_join (output->udp_output_thread, NULL);
+	} else {
+		pthread_join (output->stream_output_thread, NULL);
+	}
+	
+	printk ("Krad Link: %s output %d removed, %"PRIu64" packets dropped%s", krad_link->sysname, number,
+			output->packets_dropped, output->output_failed ? ", destination failed" : "");
+	
+	krad_link_child_destroy (output);
+
+}
+
 krad_link_t *krad_link_create (int linknum) {
 
 	krad_link_t *krad_link;
@@ -2194,6 +4166,16 @@ krad_link_t *krad_link_create (int linknum) {
 	krad_link->encoding_height = -1;
 	
 	krad_link->vp8_bitrate = DEFAULT_VPX_BITRATE;
+
+	krad_link->mjpeg_decode_threads = KRAD_V4L2_MJPEG_DEFAULT_THREADS;
+	krad_link->audio_target_latency_ms = KRAD_LINK_DEFAULT_AUDIO_TARGET_LATENCY_MS;
+	krad_link->udp_latency_ms = KRAD_LINK_DEFAULT_UDP_LATENCY_MS;
+	krad_link->udp_fec_group = KRAD_LINK_DEFAULT_UDP_FEC_GROUP;
+	krad_link->udp_pace_max_delay_ms = KRAD_UDP_DEFAULT_PACE_MAX_DELAY_MS;
+	krad_link->max_interleave_ms = KRAD_LINK_DEFAULT_MAX_INTERLEAVE_MS;
+	krad_link->live_cluster_ms = KRAD_EBML_LIVE_DEFAULT_MAX_CLUSTER_MS;
+	krad_link->live_cluster_bytes = KRAD_EBML_LIVE_DEFAULT_MAX_CLUSTER_BYTES;
+	krad_link->live_flush_ms = KRAD_EBML_LIVE_DEFAULT_FLUSH_MS;
 	
 	strncpy(krad_link->device, DEFAULT_V4L2_DEVICE, sizeof(krad_link->device));
 	strncpy(krad_link->alsa_capture_device, DEFAULT_ALSA_CAPTURE_DEVICE, sizeof(krad_link->alsa_capture_device));
@@ -2209,6 +4191,11 @@ krad_link_t *krad_link_create (int linknum) {
 
 	sprintf (krad_link->sysname, "link%d", linknum);
 	krad_link->krad_tags = krad_tags_create (krad_link->sysname);
+	
+	pthread_mutex_init (&krad_link->fanout_lock, NULL);
+	pthread_mutex_init (&krad_link->container_lock, NULL);
+	pthread_mutex_init (&krad_link->decode_lock, NULL);
+	pthread_cond_init (&krad_link->decode_cond, NULL);
 
 	return krad_link;
 }
@@ -2284,6 +4271,18 @@ void krad_link_activate (krad_link_t *krad_link) {
 			krad_link->capturing = 1;
 			pthread_create(&krad_link->video_capture_thread, NULL, info_screen_generator_thread, (void *)krad_link);
 		}			
+		
+		if ((krad_link->video_source == SYNTH) || (krad_link->video_source == YUVFILE)) {
+
+			krad_link->krad_synth = krad_synth_create (krad_link->input);
+
+			if (krad_link->krad_synth != NULL) {
+				krad_link->capturing = 1;
+				pthread_create(&krad_link->video_capture_thread, NULL, synth_generator_thread, (void *)krad_link);
+			} else {
+				printke ("Krad Link: could not start synth source %s", krad_link->input);
+			}
+		}
 
 	}
 	
@@ -2309,13 +4308,26 @@ void krad_link_activate (krad_link_t *krad_link) {
 
 		krad_link->encoding = 1;
 
+		if (krad_link->renditions > 1) {
+			if ((krad_link->operation_mode != TRANSMIT) || (krad_link->transport_mode != TCP) ||
+				(krad_link->video_codec != VP8) || (krad_link->av_mode == AUDIO_ONLY) ||
+				(krad_link->mjpeg_passthru == 1)) {
+				printke ("Krad Link: simulcast needs a tcp transmit link with vp8 video");
+				krad_link->renditions = 0;
+			} else {
+				for (c = 1; c < krad_link->renditions; c++) {
+					krad_link->rendition[c] = krad_link_rendition_create (krad_link, c);
+					krad_link->rendition[c]->encoding = 1;
+				}
+			}
+		}
 		
 		if ((krad_link->mjpeg_passthru == 0) && ((krad_link->av_mode == VIDEO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO))) {
 			pthread_create (&krad_link->video_encoding_thread, NULL, video_encoding_thread, (void *)krad_link);
 		}
 	
 		if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
-			pthread_create (&krad_link->audio_encoding_thread, NULL, audio_encoding_thread, (void *)krad_link);
+			krad_link_audio_encode_start (krad_link);
 		}
 	
 		if ((krad_link->operation_mode == TRANSMIT) && (krad_link->transport_mode == UDP)) {
@@ -2323,7 +4335,48 @@ void krad_link_activate (krad_link_t *krad_link) {
 		} else {
 			pthread_create (&krad_link->stream_output_thread, NULL, stream_output_thread, (void *)krad_link);	
 		}
+		
+		for (c = 1; c < krad_link->renditions; c++) {
+			pthread_create (&krad_link->rendition[c]->stream_output_thread, NULL, stream_output_thread,
+							(void *)krad_link->rendition[c]);
+		}
+
+	}
+}
+
+/* v4l2 capture options, space separated: mjpeg, passthru, yuv, threads=N */
+
+static void krad_link_v4l2_options (krad_link_t *krad_link, char *options) {
+
+	char *option;
+	char *saveptr;
+
+	for (option = strtok_r (options, " ,", &saveptr); option != NULL; option = strtok_r (NULL, " ,", &saveptr)) {
+		if (strcmp (option, "mjpeg") == 0) {
+			krad_link->mjpeg_mode = 1;
+		} else if (strcmp (option, "passthru") == 0) {
+			krad_link->mjpeg_mode = 1;
+			krad_link->mjpeg_passthru = 1;
+		} else if (strcmp (option, "yuv") == 0) {
+			krad_link->mjpeg_mode = 1;
+			krad_link->mjpeg_decode_yuv = 1;
+		} else if (strncmp (option, "threads=", 8) == 0) {
+			krad_link->mjpeg_mode = 1;
+			krad_link->mjpeg_decode_threads = atoi (option + 8);
+			if (krad_link->mjpeg_decode_threads < 1) {
+				krad_link->mjpeg_decode_threads = 1;
+			}
+			if (krad_link->mjpeg_decode_threads > KRAD_V4L2_MJPEG_MAX_THREADS) {
+				krad_link->mjpeg_decode_threads = KRAD_V4L2_MJPEG_MAX_THREADS;
+			}
+		} else {
+			printke ("Krad Link: unknown v4l2 option %s", option);
+		}
+	}
 
+	if (krad_link->mjpeg_mode == 1) {
+		printk ("Krad Link: v4l2 mjpeg capture%s, %d decode threads%s", krad_link->mjpeg_passthru ? " passthru" : "",
+				krad_link->mjpeg_decode_threads, krad_link->mjpeg_decode_yuv ? " to yuv" : "");
 	}
 }
 
@@ -2333,6 +4386,9 @@ void krad_linker_ebml_to_link ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 	uint64_t ebml_data_size;
 
 	char string[512];
+	/* what is left to read once the link element is done with, for
+	   elements that are only there sometimes */
+	int link_end;
 	
 	memset (string, '\0', 512);
 
@@ -2346,6 +4402,8 @@ void krad_linker_ebml_to_link ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 	} else {
 		//printk ("tag size %zu", ebml_data_size);
 	}
+
+	link_end = krad_ebml_io_buffer_read_space (&krad_ipc_server->current_client->krad_ebml->io_adapter) - ebml_data_size;
 	
 	krad_ebml_read_element (krad_ipc_server->current_client->krad_ebml, &ebml_id, &ebml_data_size);
 	
@@ -2411,6 +4469,15 @@ void krad_linker_ebml_to_link ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 			}
 
 			krad_ebml_read_string (krad_ipc_server->current_client->krad_ebml, krad_link->input, ebml_data_size);
+
+			krad_ebml_read_element (krad_ipc_server->current_client->krad_ebml, &ebml_id, &ebml_data_size);
+
+			if (ebml_id != EBML_ID_KRAD_LINK_LINK_SEEK_MS) {
+				printk ("hrm wtf3");
+			} else {
+				krad_link->seek_ms = krad_ebml_read_number (krad_ipc_server->current_client->krad_ebml, ebml_data_size);
+				krad_link->seek_pending = (krad_link->seek_ms > 0);
+			}
 		}
 		
 		if (krad_link->transport_mode == TCP) {
@@ -2470,6 +4537,34 @@ void krad_linker_ebml_to_link ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 			(krad_link->video_source == TEST) || (krad_link->video_source == INFO)) {
 			krad_link->av_mode = VIDEO_ONLY;
 		}
+
+		/* capture options are only sent when there are some */
+		if ((krad_link->video_source == V4L2) &&
+			(krad_ebml_io_buffer_read_space (&krad_ipc_server->current_client->krad_ebml->io_adapter) > link_end)) {
+
+			krad_ebml_read_element (krad_ipc_server->current_client->krad_ebml, &ebml_id, &ebml_data_size);
+
+			if (ebml_id != EBML_ID_KRAD_LINK_LINK_FILENAME) {
+				printk ("hrm wtf v4l2");
+			}
+
+			krad_ebml_read_string (krad_ipc_server->current_client->krad_ebml, string, ebml_data_size);
+
+			krad_link_v4l2_options (krad_link, string);
+		}
+		
+		if ((krad_link->video_source == SYNTH) || (krad_link->video_source == YUVFILE)) {
+
+			krad_link->av_mode = AUDIO_AND_VIDEO;
+
+			krad_ebml_read_element (krad_ipc_server->current_client->krad_ebml, &ebml_id, &ebml_data_size);
+
+			if (ebml_id != EBML_ID_KRAD_LINK_LINK_FILENAME) {
+				printk ("hrm wtf synth");
+			}
+
+			krad_ebml_read_string (krad_ipc_server->current_client->krad_ebml, krad_link->input, ebml_data_size);
+		}
 	
 	}
 	
@@ -2605,6 +4700,17 @@ void krad_linker_ebml_to_link ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 
 		krad_ebml_read_string (krad_ipc_server->current_client->krad_ebml, krad_link->password, ebml_data_size);
 
+		krad_ebml_read_element (krad_ipc_server->current_client->krad_ebml, &ebml_id, &ebml_data_size);	
+
+		if (ebml_id != EBML_ID_KRAD_LINK_LINK_SIMULCAST) {
+			printk ("hrm wtf2s");
+		} else {
+			krad_ebml_read_string (krad_ipc_server->current_client->krad_ebml, string, ebml_data_size);
+			if ((string[0] != '\0') && (krad_link->video_codec == VP8)) {
+				krad_link_parse_simulcast (krad_link, string);
+			}
+		}
+
 		if (strstr(krad_link->mount, "flac") != NULL) {
 			krad_link->audio_codec = FLAC;
 		}
@@ -2694,6 +4800,8 @@ void krad_linker_link_to_ebml ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 		if ((krad_link->transport_mode == UDP) || (krad_link->transport_mode == TCP)) {
 			krad_ebml_write_int32 (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_PORT, krad_link->port);
 		}
+
+		krad_ebml_write_int32 (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_VIDEO_DECODE_US, krad_link->video_decode_us);
 	}	
 	
 	if (krad_link->operation_mode == CAPTURE) {
@@ -2708,6 +4816,7 @@ void krad_linker_link_to_ebml ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 		if (krad_link->transport_mode == FILESYSTEM) {
 	
 			krad_ebml_write_string (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_FILENAME, krad_link->input);
+			krad_ebml_write_int32 (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_BUFFERED_MS, krad_link->buffered_ms);
 		}
 		
 		if (krad_link->transport_mode == TCP) {
@@ -2716,7 +4825,8 @@ void krad_linker_link_to_ebml ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 			krad_ebml_write_int32 (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_PORT, krad_link->port);
 			krad_ebml_write_string (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_MOUNT, krad_link->mount);
 		}
-		
+
+		krad_ebml_write_int32 (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_VIDEO_DECODE_US, krad_link->video_decode_us);
 	}
 	
 	if ((krad_link->operation_mode == TRANSMIT) || (krad_link->operation_mode == RECORD)) {
@@ -2762,6 +4872,11 @@ void krad_linker_link_to_ebml ( krad_ipc_server_t *krad_ipc_server, krad_link_t
 
 		}
 
+		if ((krad_link->av_mode == AUDIO_ONLY) || (krad_link->av_mode == AUDIO_AND_VIDEO)) {
+			krad_ebml_write_int32 (krad_ipc_server->current_client->krad_ebml2, EBML_ID_KRAD_LINK_LINK_AUDIO_ENCODE_CPU_MS,
+								   (krad_link->audio_encode_job != NULL) ? krad_encode_job_cpu_us (krad_link->audio_encode_job) / 1000 : 0);
+		}
+
 	}
 	
 	krad_ebml_finish_element (krad_ipc_server->current_client->krad_ebml2, link);
@@ -2780,7 +4895,7 @@ int krad_linker_handler ( krad_linker_t *krad_linker, krad_ipc_server_t *krad_ip
 	uint64_t element;
 	uint64_t response;
 	
-	char string[128];	
+	char string[512];	
 	
 	uint64_t bigint;
 	uint8_t tinyint;
@@ -2859,6 +4974,91 @@ int krad_linker_handler ( krad_linker_t *krad_linker, krad_ipc_server_t *krad_ip
 
 					krad_ebml_read_element (krad_ipc->current_client->krad_ebml, &ebml_id, &ebml_data_size);	
 
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_ADD_OUTPUT) {
+						krad_ebml_read_string (krad_ipc->current_client->krad_ebml, string, ebml_data_size);
+						krad_link_add_output (krad_linker->krad_link[k], string);
+					}
+					
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_REMOVE_OUTPUT) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						krad_link_remove_output (krad_linker->krad_link[k], bigint);
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_SEEK_MS) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						krad_link_seek (krad_linker->krad_link[k], bigint);
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_MAX_INTERLEAVE) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if ((bigint > 0) && (bigint <= 10000)) {
+							krad_link_set_max_interleave (krad_linker->krad_link[k], bigint);
+						}
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_LIVE_CLUSTER_MS) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if ((bigint > 0) && (bigint <= KRAD_EBML_MAX_BLOCK_TIMECODE)) {
+							krad_link_set_live (krad_linker->krad_link[k], bigint,
+												krad_linker->krad_link[k]->live_cluster_bytes,
+												krad_linker->krad_link[k]->live_flush_ms);
+						}
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_LIVE_CLUSTER_BYTES) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if ((bigint >= 4096) && (bigint <= KRADEBML_WRITE_BUFFER_SIZE)) {
+							krad_link_set_live (krad_linker->krad_link[k], krad_linker->krad_link[k]->live_cluster_ms,
+												bigint, krad_linker->krad_link[k]->live_flush_ms);
+						}
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_LIVE_FLUSH_MS) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if (bigint <= 10000) {
+							krad_link_set_live (krad_linker->krad_link[k], krad_linker->krad_link[k]->live_cluster_ms,
+												krad_linker->krad_link[k]->live_cluster_bytes, bigint);
+						}
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_UDP_PACE_KBPS) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if (bigint <= 1000000) {
+							krad_link_set_udp (krad_linker->krad_link[k], bigint,
+											   krad_linker->krad_link[k]->udp_pace_txtime,
+											   krad_linker->krad_link[k]->udp_fec_group,
+											   krad_linker->krad_link[k]->udp_latency_ms);
+						}
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_UDP_PACE_TXTIME) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						krad_link_set_udp (krad_linker->krad_link[k], krad_linker->krad_link[k]->udp_pace_kbps,
+										   bigint != 0,
+										   krad_linker->krad_link[k]->udp_fec_group,
+										   krad_linker->krad_link[k]->udp_latency_ms);
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_UDP_FEC_GROUP) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if (bigint <= KRAD_UDP_MAX_FEC_GROUP) {
+							krad_link_set_udp (krad_linker->krad_link[k], krad_linker->krad_link[k]->udp_pace_kbps,
+											   krad_linker->krad_link[k]->udp_pace_txtime,
+											   bigint,
+											   krad_linker->krad_link[k]->udp_latency_ms);
+						}
+					}
+
+					if (ebml_id == EBML_ID_KRAD_LINK_LINK_UDP_LATENCY_MS) {
+						bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+						if (bigint <= 10000) {
+							krad_link_set_udp (krad_linker->krad_link[k], krad_linker->krad_link[k]->udp_pace_kbps,
+											   krad_linker->krad_link[k]->udp_pace_txtime,
+											   krad_linker->krad_link[k]->udp_fec_group,
+											   bigint);
+						}
+					}
+
 					if (krad_linker->krad_link[k]->audio_codec == OPUS) {
 
 						/*
@@ -2917,7 +5117,12 @@ int krad_linker_handler ( krad_linker_t *krad_linker, krad_ipc_server_t *krad_ip
 						if (ebml_id == EBML_ID_KRAD_LINK_LINK_OGG_MAX_PACKETS_PER_PAGE) {
 							bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
 							if ((bigint > 0) && (bigint < 200)) {					
-								krad_ogg_set_max_packets_per_page (krad_linker->krad_link[k]->krad_container->krad_ogg, bigint);
+								pthread_mutex_lock (&krad_linker->krad_link[k]->container_lock);
+								if ((krad_linker->krad_link[k]->krad_container != NULL) &&
+									(krad_linker->krad_link[k]->krad_container->container_type == OGG)) {
+									krad_ogg_set_max_packets_per_page (krad_linker->krad_link[k]->krad_container->krad_ogg, bigint);
+								}
+								pthread_mutex_unlock (&krad_linker->krad_link[k]->container_lock);
 							}
 						}
 				
@@ -2938,6 +5143,39 @@ int krad_linker_handler ( krad_linker_t *krad_linker, krad_ipc_server_t *krad_ip
 								krad_vpx_encoder_want_keyframe (krad_linker->krad_link[k]->krad_vpx_encoder);
 							}
 						}
+						if (ebml_id == EBML_ID_KRAD_LINK_LINK_VP8_THREADS) {
+							bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+							krad_vpx_encoder_threads_set (krad_linker->krad_link[k]->krad_vpx_encoder, bigint);
+						}
+						if (ebml_id == EBML_ID_KRAD_LINK_LINK_VP8_SPEED) {
+							bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+							// anything past cpu-used 16 hands speed back to the encoder
+							if (bigint > 16) {
+								krad_vpx_encoder_speed_set (krad_linker->krad_link[k]->krad_vpx_encoder, KRAD_VPX_SPEED_AUTO);
+							} else {
+								krad_vpx_encoder_speed_set (krad_linker->krad_link[k]->krad_vpx_encoder, bigint);
+							}
+						}
+						if (ebml_id == EBML_ID_KRAD_LINK_LINK_VP8_DEADLINE) {
+							bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+							if (bigint == KRAD_LINK_VP8_DEADLINE_AUTO) {
+								krad_vpx_encoder_quality_set (krad_linker->krad_link[k]->krad_vpx_encoder, KRAD_VPX_DEADLINE_AUTO);
+							} else {
+								krad_vpx_encoder_quality_set (krad_linker->krad_link[k]->krad_vpx_encoder, bigint);
+							}
+						}
+						if (ebml_id == EBML_ID_KRAD_LINK_LINK_VP8_RATE_CONTROL) {
+							krad_ebml_read_string (krad_ipc->current_client->krad_ebml, string, ebml_data_size);
+							krad_vpx_encoder_rate_control_set (krad_linker->krad_link[k]->krad_vpx_encoder,
+															   krad_vpx_encoder_string_to_rate_control (string), 0);
+						}
+						if (ebml_id == EBML_ID_KRAD_LINK_LINK_VP8_BUFFER) {
+							bigint = krad_ebml_read_number (krad_ipc->current_client->krad_ebml, ebml_data_size);
+							if ((bigint > 0) && (bigint < 60000)) {
+								krad_vpx_encoder_rate_control_set (krad_linker->krad_link[k]->krad_vpx_encoder,
+																   krad_linker->krad_link[k]->krad_vpx_encoder->rate_control, bigint);
+							}
+						}
 					}
 
 
@@ -3302,6 +5540,7 @@ krad_linker_t *krad_linker_create (krad_radio_t *krad_radio) {
 	pthread_mutex_init (&krad_linker->change_lock, NULL);	
 
 	krad_linker->krad_transmitter = krad_transmitter_create ();
+	krad_linker->krad_encode_pool = krad_encode_pool_create (0);
 
 	return krad_linker;
 
@@ -3322,6 +5561,7 @@ void krad_linker_destroy (krad_linker_t *krad_linker) {
 	}
 	pthread_mutex_unlock (&krad_linker->change_lock);		
 	pthread_mutex_destroy (&krad_linker->change_lock);
+	krad_encode_pool_destroy (krad_linker->krad_encode_pool);
 	free (krad_linker);
 
 }
@@ -1,6 +1,7 @@
 typedef struct krad_link_St krad_link_t;
 typedef struct krad_linker_St krad_linker_t;
 typedef struct krad_linker_listen_client_St krad_linker_listen_client_t;
+typedef struct krad_link_captured_buffer_St krad_link_captured_buffer_t;
 
 #include "krad_radio.h"
 
@@ -11,6 +12,36 @@ typedef struct krad_linker_listen_client_St krad_linker_listen_client_t;
 #define DEFAULT_VPX_BITRATE 92 * 8
 #define DEFAULT_DIRAC_BITRATE 15000000
 #define DEFAULT_THEORA_QUALITY 42
+#define KRAD_LINK_DEFAULT_AUDIO_TARGET_LATENCY_MS 250
+#define KRAD_LINK_DRIFT_REPORT_SECONDS 30
+#define KRAD_LINK_DEFAULT_UDP_LATENCY_MS 60
+#define KRAD_LINK_DEFAULT_UDP_FEC_GROUP 5
+#define KRAD_LINK_UDP_REPORT_SECONDS 30
+#define KRAD_LINK_VP8_REPORT_SECONDS 30
+#define KRAD_LINK_MAX_RENDITIONS 4
+#define KRAD_LINK_SIMULCAST_KEYFRAME_INTERVAL 90
+#define KRAD_LINK_MAX_OUTPUTS 8
+#define KRAD_LINK_DEFAULT_MAX_INTERLEAVE_MS 250
+#define KRAD_LINK_INTERLEAVE_REPORT_SECONDS 30
+#define KRAD_LINK_FILL_REPORT_SECONDS 5
+/* a jump in file timecodes bigger than this is taken as a seek */
+#define KRAD_LINK_SEEK_GAP_MS 5000
+/* a list item that never gives up a packet is skipped after this many reads */
+#define KRAD_LINK_PLAYLIST_EMPTY_READS 100
+/* decoding: files have this much audio decoded ahead of the mixer, video
+   frames later than this against the audio clock are dropped, and video
+   waits this long at the start for the audio clock before going it alone */
+#define KRAD_LINK_AUDIO_AHEAD_MS 500
+#define KRAD_LINK_VIDEO_LATE_MS 80
+#define KRAD_LINK_AV_START_WAIT_MS 1000
+#define KRAD_LINK_DECODE_WAIT_MS 100
+/* how long capture teardown waits for passthru frames to come back */
+#define KRAD_LINK_PASSTHRU_CLOSE_WAIT_MS 5000
+#define KRAD_LINK_SYNC_REPORT_SECONDS 30
+/* decoded video frames waiting to be converted for the compositor */
+#define KRAD_LINK_CONVERT_FRAMES 2
+/* blocks of the mix a transmit or record link can have waiting to encode */
+#define KRAD_LINK_AUDIO_BLOCKS 256
 #define DEFAULT_CAPTURE_BUFFER_FRAMES 50
 #define DEFAULT_DECODING_BUFFER_FRAMES 50
 #define DEFAULT_VORBIS_QUALITY 0.4
@@ -50,7 +81,10 @@ struct krad_linker_St {
 	pthread_t listening_thread;
 	
 	/* linker transmitter */	
-	krad_transmitter_t *krad_transmitter;	
+	krad_transmitter_t *krad_transmitter;
+
+	/* runs the audio encoders of all the links */
+	krad_encode_pool_t *krad_encode_pool;	
 	
 };
 
@@ -75,6 +109,13 @@ struct krad_linker_listen_client_St {
 
 };
 
+/* a dequeued v4l2 buffer on its way from the capture thread to the decoder */
+
+struct krad_link_captured_buffer_St {
+	int index;
+	unsigned int size;
+};
+
 struct krad_link_St {
 
 	krad_radio_t *krad_radio;
@@ -106,6 +147,8 @@ struct krad_link_St {
 //	krad_ogg_t *krad_ogg;
 	krad_ebml_t *krad_ebml;
 	krad_container_t *krad_container;
+	/* set when the file being played is a list of files */
+	krad_playlist_t *krad_playlist;
 	krad_v4l2_t *krad_v4l2;
 	
 	krad_link_operation_mode_t operation_mode;
@@ -148,11 +191,54 @@ struct krad_link_St {
 
 	int mjpeg_mode;
 	int mjpeg_passthru;	
+	int mjpeg_decode_threads;
+	int mjpeg_decode_yuv;
+	krad_v4l2_mjpeg_decoder_t *krad_mjpeg_decoder;
+
+	krad_synth_t *krad_synth;
+
+	/* receive links track the remote clock, see krad_resample_ring */
+	int audio_target_latency_ms;
+	int audio_fill_ms;
+	float audio_drift_ppm;
+	int audio_underruns;
 
 	int capture_buffer_frames;
 	int decoding_buffer_frames;
 	
 	int playing;
+	/* Decode pipeline: the demuxer wakes the decoders when it queues a
+	   packet and they wake it when they take one. The mixer taking this
+	   link's audio is the clock its video frames are shown against. */
+	pthread_mutex_t decode_lock;
+	pthread_cond_t decode_cond;
+	uint64_t audio_frames_played;
+	int audio_clock_running;
+	int video_frames_dropped;
+	/* Decoded pictures are copied out of the decoder into these and
+	   converted for the compositor on video_converting_thread */
+	krad_frame_t *convert_frame[KRAD_LINK_CONVERT_FRAMES];
+	unsigned char *convert_yuv[KRAD_LINK_CONVERT_FRAMES];
+	int convert_yuv_size[KRAD_LINK_CONVERT_FRAMES];
+	int convert_write;
+	int convert_read;
+	int convert_queued;
+	/* how many of the queued frames are from before a seek, they are
+	   dropped rather than shown */
+	int convert_flush;
+	/* running average of decoding one video frame */
+	int video_decode_us;
+	/* how far a file being played is read in ahead of its demuxer */
+	int buffered_ms;
+	/* where in the file to play from, picked up by the demuxer */
+	uint64_t seek_ms;
+	int seek_pending;
+	/* bumped by the demuxer for each seek it makes, the decoders drop
+	   what they have from before it until the headers sent after it */
+	int seeks;
+	/* set by the audio decoder for the mixer thread to empty the
+	   decoded audio rings */
+	int audio_flush;
 	
 	int encoding;
 	int capturing;
@@ -160,16 +246,32 @@ struct krad_link_St {
 	
 	float vorbis_quality;
 	krad_ringbuffer_t *audio_capture_ringbuffer[KRAD_MIXER_MAX_CHANNELS];	
-	krad_ringbuffer_t *audio_input_ringbuffer[KRAD_MIXER_MAX_CHANNELS];
 	krad_ringbuffer_t *audio_output_ringbuffer[KRAD_MIXER_MAX_CHANNELS];
 	float *samples[KRAD_MIXER_MAX_CHANNELS];
 
 	int audio_encoder_ready;
 	int audio_frames_captured;
 
+	/* audio is encoded by a job on the linker's encode pool, the mixer
+	   posts it each time it hands over a block of the mix */
+	krad_encode_job_t *audio_encode_job;
+	krad_mixer_portgroup_t *audio_encode_portgroup;
+	krad_ringbuffer_t *audio_block_ringbuffer;
+	uint64_t audio_block_position;
+	int audio_block_started;
+	uint64_t audio_frames_filled;
+	uint64_t audio_frames_filled_reported;
+	time_t audio_fill_reported;
+	float *audio_encode_silence[KRAD_MIXER_MAX_CHANNELS];
+	float *audio_encode_interleaved;
+	int audio_encode_pending;
+	unsigned char *audio_encode_buffer;
+	int audio_encoding_done;
+
 	krad_ringbuffer_t *decoded_audio_ringbuffer;
 	krad_ringbuffer_t *encoded_audio_ringbuffer;
 	krad_ringbuffer_t *encoded_video_ringbuffer;
+	krad_ringbuffer_t *captured_video_ringbuffer;
 	
 	int video_track;
 	int audio_track;
@@ -178,9 +280,11 @@ struct krad_link_St {
 
 	pthread_t main_thread;
 	pthread_t video_capture_thread;
+	pthread_t video_capture_decoding_thread;
+	int capture_decoding;
 	pthread_t video_encoding_thread;
-	pthread_t audio_encoding_thread;
 	pthread_t video_decoding_thread;
+	pthread_t video_converting_thread;
 	pthread_t audio_decoding_thread;
 	pthread_t stream_output_thread;
 	pthread_t stream_input_thread;
@@ -192,6 +296,63 @@ struct krad_link_St {
 	
 	krad_rebuilder_t *krad_rebuilder;
 	krad_slicer_t *krad_slicer;
+	int udp_latency_ms;
+	int udp_fec_group;
+	/* 0 for no ceiling, video is still spread over the frame interval */
+	int udp_pace_kbps;
+	int udp_pace_max_delay_ms;
+	int udp_pace_txtime;
+	/* set when the above change, the udp thread applies them */
+	int udp_changed;
+
+	/* Simulcast: a transmit link can carry a ladder of VP8 renditions.
+	   Rendition 0 is this link at its own encoding size, the rest are
+	   child links that get their picture scaled down from the rendition
+	   above, their own encoder thread and stream output, and a copy of
+	   this link's encoded audio. */
+	int renditions;
+	int rendition_width[KRAD_LINK_MAX_RENDITIONS];
+	int rendition_height[KRAD_LINK_MAX_RENDITIONS];
+	int rendition_bitrate[KRAD_LINK_MAX_RENDITIONS];
+	krad_link_t *rendition[KRAD_LINK_MAX_RENDITIONS];
+	struct SwsContext *rendition_scaler[KRAD_LINK_MAX_RENDITIONS];
+	pthread_mutex_t rendition_lock;
+	pthread_cond_t rendition_cond;
+	int rendition_frame;
+	int rendition_pending;
+	int rendition_frames_queued;
+	int rendition_stop;
+	krad_link_t *rendition_parent;
+	pthread_t rendition_encoding_thread;
+
+	/* Output fanout: more destinations for the packets this link already
+	   encodes. Each one is a child link running only a stream or udp
+	   output thread on its own packet queues, so a stuck or dead
+	   destination drops its own packets and nobody else's. */
+	krad_link_t *fanout[KRAD_LINK_MAX_OUTPUTS];
+	pthread_mutex_t fanout_lock;
+	krad_link_t *fanout_parent;
+	int output_failed;
+	int video_queue_needs_keyframe;
+	uint64_t packets_dropped;
+
+	/* Encoded packets carry a timecode in ms and the stream output
+	   interleaves on it, holding the earlier stream back for at most
+	   max_interleave_ms while the other one catches up. */
+	uint64_t audio_frames_encoded;
+	int max_interleave_ms;
+	int64_t av_offset_ms;
+	uint64_t packets_late;
+
+	/* webm clustering and flushing for stream outputs, live_changed
+	   has the output thread apply new ones before its next packet */
+	int live_cluster_ms;
+	int live_cluster_bytes;
+	int live_flush_ms;
+	int live_changed;
+
+	/* held while krad_container is swapped or destroyed */
+	pthread_mutex_t container_lock;
 
 };
 
@@ -209,8 +370,20 @@ void krad_linker_destroy (krad_linker_t *krad_linker);
 int krad_linker_handler ( krad_linker_t *krad_linker, krad_ipc_server_t *krad_ipc );
 void krad_link_shutdown();
 void krad_link_audio_samples_callback (int frames, void *userdata, float **samples);
+void krad_link_audio_block_callback (krad_block_t *block, void *userdata);
 void krad_link_destroy (krad_link_t *krad_link);
 krad_link_t *krad_link_create (int linknum);
+/* destination is a file path, udp://host:port, transmitter:/mount
+   or icecast://password@host:port/mount, returns the output number */
+int krad_link_add_output (krad_link_t *krad_link, char *destination);
+void krad_link_remove_output (krad_link_t *krad_link, int number);
+/* how long the stream output holds one stream back waiting for the other */
+void krad_link_set_max_interleave (krad_link_t *krad_link, int ms);
+/* cluster limits and flush interval for webm stream outputs */
+void krad_link_set_live (krad_link_t *krad_link, int cluster_ms, int cluster_bytes, int flush_ms);
+void krad_link_set_udp (krad_link_t *krad_link, int pace_kbps, int pace_txtime, int fec_group, int latency_ms);
+/* file playback carries on from the last keyframe at or before ms */
+void krad_link_seek (krad_link_t *krad_link, uint64_t ms);
 void krad_link_run (krad_link_t *krad_link);
 
 #endif
@@ -248,6 +248,14 @@ krad_link_video_source_t krad_link_string_to_video_source (char *string) {
 		return V4L2;
 	}	
 
+	if (strcmp(string, "synth") == 0) {
+		return SYNTH;
+	}
+
+	if ((strcmp(string, "file") == 0) || (strcmp(string, "yuvfile") == 0)) {
+		return YUVFILE;
+	}
+
 	return NOVIDEO;
 
 }
@@ -265,6 +273,10 @@ char *krad_link_video_source_to_string (krad_link_video_source_t video_source) {
 			return "decklink";
 		case X11:
 			return "X11";
+		case SYNTH:
+			return "synth";
+		case YUVFILE:
+			return "yuvfile";
 		case NOVIDEO:
 			return "novideo";
 		default:
@@ -7,6 +7,9 @@ typedef struct krad_link_rep_St krad_link_rep_t;
 #ifndef KRAD_LINK_COMMON_H
 #define KRAD_LINK_COMMON_H
 
+/* the vp8 deadline a link update sends to hand it back to the encoder */
+#define KRAD_LINK_VP8_DEADLINE_AUTO 0
+
 #ifndef KRAD_CODEC_T
 typedef enum {
 	VORBIS = 6666,
@@ -55,6 +58,8 @@ typedef enum {
 	V4L2,
 	DECKLINK,
 	X11,
+	SYNTH,
+	YUVFILE,
 	NOVIDEO,
 } krad_link_video_source_t;
 
@@ -86,6 +91,9 @@ struct krad_link_rep_St {
 	krad_link_video_source_t video_source;
 
 	char filename[512];
+	int buffered_ms;
+	int video_decode_us;
+	int audio_encode_cpu_ms;
 	char host[512];
 	int port;
 	char mount[512];
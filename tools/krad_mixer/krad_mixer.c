@@ -330,13 +330,48 @@ void portgroup_copy_samples (krad_mixer_portgroup_t *dest_portgroup, krad_mixer_
 			}
 			break;
 		case KRAD_LINK:
-			if (dest_portgroup->direction == OUTPUT) {
-				krad_link_audio_samples_callback (nframes, dest_portgroup->io_ptr, src_portgroup->samples);
-			}
 			break;
 	}
 }
 
+/* One copy of part of a mixbus for all the link outputs on it, NULL if
+   there are no blocks free, the links make up for the missing frames
+   themselves. offset and nframes are within this period, nframes is at
+   most KRAD_BLOCKPOOL_MAX_FRAMES. */
+
+static krad_block_t *krad_mixer_mixbus_block (krad_mixer_t *krad_mixer, krad_mixer_portgroup_t *mixbus,
+											  uint32_t offset, uint32_t nframes) {
+
+	krad_blockpool_t *krad_blockpool;
+	krad_block_t *block;
+	int c;
+
+	krad_blockpool = krad_mixer->krad_blockpool;
+
+	if (krad_blockpool == NULL) {
+		return NULL;
+	}
+
+	/* pairs with the one made publishing the pool */
+	__sync_synchronize ();
+
+	block = krad_blockpool_getblock (krad_blockpool);
+
+	if (block == NULL) {
+		return NULL;
+	}
+
+	for (c = 0; c < block->channels; c++) {
+		memcpy (block->samples[c], mixbus->samples[c] + offset, nframes * 4);
+	}
+
+	block->frames = nframes;
+	block->position = krad_mixer->frames_mixed + offset;
+
+	return block;
+
+}
+
 void portgroup_hardlimit (krad_mixer_portgroup_t *portgroup, uint32_t nframes) {
 
 	int c;
@@ -352,6 +387,10 @@ int krad_mixer_process (uint32_t nframes, krad_mixer_t *krad_mixer) {
 
 	krad_mixer_portgroup_t *portgroup = NULL;
 	krad_mixer_portgroup_t *mixbus = NULL;
+	krad_mixer_portgroup_t *block_mixbus = NULL;
+	krad_block_t *block = NULL;
+	uint32_t offset;
+	uint32_t block_frames;
 	
 	if (krad_mixer->push_tone != NULL) {
 		krad_tone_add_preset (krad_mixer->tone_port->io_ptr, krad_mixer->push_tone);
@@ -402,8 +441,40 @@ int krad_mixer_process (uint32_t nframes, krad_mixer_t *krad_mixer) {
 		portgroup = krad_mixer->portgroup[p];
 		if ((portgroup != NULL) && (portgroup->active) && (portgroup->direction == OUTPUT)) {
 			portgroup_hardlimit ( portgroup->mixbus, nframes );
-			portgroup_copy_samples ( portgroup, portgroup->mixbus, nframes );
+			if (portgroup->io_type != KRAD_LINK) {
+				portgroup_copy_samples ( portgroup, portgroup->mixbus, nframes );
+			}
+		}
+	}
+
+	// hand link outputs their mix, a period longer than a block goes as several
+	for (offset = 0; offset < nframes; offset += block_frames) {
+
+		block_frames = nframes - offset;
+		if (block_frames > KRAD_BLOCKPOOL_MAX_FRAMES) {
+			block_frames = KRAD_BLOCKPOOL_MAX_FRAMES;
+		}
+
+		for (p = 0; p < KRAD_MIXER_MAX_PORTGROUPS; p++) {
+			portgroup = krad_mixer->portgroup[p];
+			if ((portgroup != NULL) && (portgroup->active) && (portgroup->direction == OUTPUT) &&
+				(portgroup->io_type == KRAD_LINK)) {
+				if ((block_mixbus != portgroup->mixbus) || (block == NULL)) {
+					if (block != NULL) {
+						krad_blockpool_unref_block (block);
+					}
+					block = krad_mixer_mixbus_block (krad_mixer, portgroup->mixbus, offset, block_frames);
+					block_mixbus = portgroup->mixbus;
+				}
+				krad_link_audio_block_callback (block, portgroup->io_ptr);
+			}
+		}
+
+		if (block != NULL) {
+			krad_blockpool_unref_block (block);
+			block = NULL;
 		}
+		block_mixbus = NULL;
 	}
 	
 	krad_mixer_portgroup_compute_peaks (krad_mixer->master_mix, nframes);
@@ -418,6 +489,8 @@ int krad_mixer_process (uint32_t nframes, krad_mixer_t *krad_mixer) {
 		}
 	}
 
+	krad_mixer->frames_mixed += nframes;
+
 	return 0;      
 
 }
@@ -458,10 +531,13 @@ krad_mixer_portgroup_t *krad_mixer_portgroup_create (krad_mixer_t *krad_mixer, c
 	
 	portgroup = NULL;
 
+	pthread_mutex_lock (&krad_mixer->portgroup_lock);
+
 	/* prevent dupe names */
 	for (p = 0; p < KRAD_MIXER_MAX_PORTGROUPS; p++) {
 		if (krad_mixer->portgroup[p]->active != 0) {
 			if (strcmp(sysname, krad_mixer->portgroup[p]->sysname) == 0) {
+				pthread_mutex_unlock (&krad_mixer->portgroup_lock);
 				return NULL;
 			}
 		}
@@ -475,9 +551,17 @@ krad_mixer_portgroup_t *krad_mixer_portgroup_create (krad_mixer_t *krad_mixer, c
 	}
 	
 	if (portgroup == NULL) {
+		pthread_mutex_unlock (&krad_mixer->portgroup_lock);
 		return NULL;
 	}
 
+	if ((io_type == KRAD_LINK) && (direction == OUTPUT) && (krad_mixer->krad_blockpool == NULL)) {
+		/* the mixer thread can see the pool as soon as it is set, the
+		   compare and swap is a full barrier so its blocks are made first */
+		__sync_bool_compare_and_swap (&krad_mixer->krad_blockpool, NULL,
+									  krad_blockpool_create (channels, KRAD_MIXER_BLOCKPOOL_BLOCKS));
+	}
+
 	portgroup->krad_mixer = krad_mixer;
 
 	strcpy (portgroup->sysname, sysname);
@@ -545,6 +629,8 @@ krad_mixer_portgroup_t *krad_mixer_portgroup_create (krad_mixer_t *krad_mixer, c
 
 	portgroup->active = 1;
 
+	pthread_mutex_unlock (&krad_mixer->portgroup_lock);
+
 	return portgroup;
 
 }
@@ -558,6 +644,8 @@ void krad_mixer_portgroup_destroy (krad_mixer_t *krad_mixer, krad_mixer_portgrou
 		return;
 	}
 
+	pthread_mutex_lock (&krad_mixer->portgroup_lock);
+
 	portgroup->active = 2;
 
 	while (portgroup->active != 0) {
@@ -607,6 +695,8 @@ void krad_mixer_portgroup_destroy (krad_mixer_t *krad_mixer, krad_mixer_portgrou
 	if (portgroup->io_type != KRAD_LINK) {
 		krad_tags_destroy (portgroup->krad_tags);	
 	}	
+
+	pthread_mutex_unlock (&krad_mixer->portgroup_lock);
 	
 }
 
@@ -724,6 +814,23 @@ int krad_mixer_set_portgroup_control (krad_mixer_t *krad_mixer, char *sysname, c
 	return 0;
 }
 
+/* the mixer thread takes the tone and clears push_tone, a tone pushed
+   before it has is dropped */
+
+void krad_mixer_push_tone (krad_mixer_t *krad_mixer, char *tone) {
+
+	pthread_mutex_lock (&krad_mixer->portgroup_lock);
+
+	if (krad_mixer->push_tone == NULL) {
+		snprintf (krad_mixer->push_tone_value, sizeof (krad_mixer->push_tone_value), "%s", tone);
+		__sync_synchronize ();
+		krad_mixer->push_tone = krad_mixer->push_tone_value;
+	}
+
+	pthread_mutex_unlock (&krad_mixer->portgroup_lock);
+
+}
+
 void krad_mixer_bind_portgroup_xmms2 (krad_mixer_t *krad_mixer, char *portgroupname, char *ipc_path) {
 
 	krad_mixer_portgroup_t *portgroup;
@@ -816,9 +923,15 @@ void krad_mixer_destroy (krad_mixer_t *krad_mixer) {
 	
 	free ( krad_mixer->crossfade_group );
 
+	if (krad_mixer->krad_blockpool != NULL) {
+		krad_blockpool_destroy (krad_mixer->krad_blockpool);
+	}
+
 	for (p = 0; p < KRAD_MIXER_MAX_PORTGROUPS; p++) {
 		free ( krad_mixer->portgroup[p] );
 	}
+
+	pthread_mutex_destroy (&krad_mixer->portgroup_lock);
 	
 	free ( krad_mixer->name );
 
@@ -891,6 +1004,8 @@ krad_mixer_t *krad_mixer_create (char *name) {
 	for (p = 0; p < KRAD_MIXER_MAX_PORTGROUPS; p++) {
 		krad_mixer->portgroup[p] = calloc (1, sizeof (krad_mixer_portgroup_t));
 	}
+
+	pthread_mutex_init (&krad_mixer->portgroup_lock, NULL);
 	
 	krad_mixer->krad_audio = krad_audio_create (krad_mixer);
 	
@@ -1035,12 +1150,8 @@ int krad_mixer_handler ( krad_mixer_t *krad_mixer, krad_ipc_server_t *krad_ipc )
 			} else {
 				//printf("tag name size %zu\n", ebml_data_size);
 			}
-			if (krad_mixer->push_tone == NULL) {
-				krad_ebml_read_string (krad_ipc->current_client->krad_ebml, krad_mixer->push_tone_value, ebml_data_size);
-				krad_mixer->push_tone = krad_mixer->push_tone_value;
-			} else {
-				krad_ebml_read_string (krad_ipc->current_client->krad_ebml, string, ebml_data_size);
-			}
+			krad_ebml_read_string (krad_ipc->current_client->krad_ebml, string, ebml_data_size);
+			krad_mixer_push_tone (krad_mixer, string);
 			break;
 			
 		case EBML_ID_KRAD_MIXER_CMD_BIND_PORTGROUP_XMMS2:
@@ -1093,6 +1204,8 @@ int krad_mixer_handler ( krad_mixer_t *krad_mixer, krad_ipc_server_t *krad_ipc )
 			krad_ipc_server_response_start ( krad_ipc, EBML_ID_KRAD_MIXER_MSG, &response);
 			krad_ipc_server_response_list_start ( krad_ipc, EBML_ID_KRAD_MIXER_PORTGROUP_LIST, &element);
 			
+			pthread_mutex_lock (&krad_mixer->portgroup_lock);
+
 			for (p = 0; p < KRAD_MIXER_MAX_PORTGROUPS; p++) {
 				portgroup = krad_mixer->portgroup[p];
 				if ((portgroup != NULL) && (portgroup->active) && (portgroup->direction == INPUT)) {
@@ -1110,6 +1223,8 @@ int krad_mixer_handler ( krad_mixer_t *krad_mixer, krad_ipc_server_t *krad_ipc )
 											  				 portgroup->io_type, portgroup->volume[0],  portgroup->mixbus->sysname, crossfade_name, crossfade_value );
 				}
 			}
+
+			pthread_mutex_unlock (&krad_mixer->portgroup_lock);
 			
 			krad_ipc_server_response_list_finish ( krad_ipc, element );
 			krad_ipc_server_response_finish ( krad_ipc, response );
@@ -7,6 +7,8 @@ typedef struct krad_mixer_crossfade_group_St krad_mixer_crossfade_group_t;
 #define KRAD_MIXER_MAX_CHANNELS 8
 #define KRAD_MIXER_DEFAULT_SAMPLE_RATE 48000
 #define KRAD_MIXER_DEFAULT_TICKER_PERIOD 512
+/* periods of the mix that can be out with link outputs at once */
+#define KRAD_MIXER_BLOCKPOOL_BLOCKS 512
 
 #include "krad_radio.h"
 
@@ -104,6 +106,16 @@ struct krad_mixer_St {
 	krad_mixer_portgroup_t *portgroup[KRAD_MIXER_MAX_PORTGROUPS];
 	krad_mixer_crossfade_group_t *crossfade_group;
 
+	/* held off the mixer thread while portgroups are created, destroyed
+	   or walked, and while a tone is pushed */
+	pthread_mutex_t portgroup_lock;
+
+	/* link outputs are handed each period of their mix as shared blocks,
+	   the pool is made when the first of them is created and published
+	   with a barrier, the mixer thread may already be running */
+	krad_blockpool_t *krad_blockpool;
+	uint64_t frames_mixed;
+
 	krad_ipc_server_t *krad_ipc;
 
 };
@@ -131,6 +143,8 @@ void krad_mixer_destroy (krad_mixer_t *krad_mixer);
 void krad_mixer_set_ipc (krad_mixer_t *krad_mixer, krad_ipc_server_t *krad_ipc);
 
 int krad_mixer_handler ( krad_mixer_t *krad_mixer, krad_ipc_server_t *krad_ipc );
+int krad_mixer_set_portgroup_control (krad_mixer_t *krad_mixer, char *sysname, char *control, float value);
+void krad_mixer_push_tone (krad_mixer_t *krad_mixer, char *tone);
 
 krad_mixer_portgroup_t *krad_mixer_portgroup_create (krad_mixer_t *krad_mixer, char *sysname, int direction, int channels, 
 													 krad_mixer_mixbus_t *mixbus, krad_mixer_portgroup_io_t io_type, void *io_ptr, krad_audio_api_t api);
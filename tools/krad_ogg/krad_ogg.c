@@ -198,84 +198,144 @@ krad_codec_t krad_ogg_get_codec (ogg_packet *packet) {
 }
 
 
-int krad_ogg_read_packet (krad_ogg_t *krad_ogg, int *track, uint64_t *timecode, unsigned char *buffer) {
+/* Pulls the header packets of any track that is still short of them */
+
+static void krad_ogg_read_headers (krad_ogg_t *krad_ogg) {
 
 	int t;
 	int ret;
 	ogg_packet packet;
-	
-	while (1) {
-	
-		for (t = 0; t < KRAD_OGG_MAX_TRACKS; t++) {
-			if ((krad_ogg->tracks[t].serial != KRAD_OGG_NO_SERIAL) && (krad_ogg->tracks[t].ready == 0)) {
-				while (krad_ogg->tracks[t].ready == 0) {
-					ret = ogg_stream_packetout(&krad_ogg->tracks[t].stream_state, &packet);
+
+	for (t = 0; t < KRAD_OGG_MAX_TRACKS; t++) {
+		if ((krad_ogg->tracks[t].serial != KRAD_OGG_NO_SERIAL) && (krad_ogg->tracks[t].ready == 0)) {
+			while (krad_ogg->tracks[t].ready == 0) {
+				ret = ogg_stream_packetout(&krad_ogg->tracks[t].stream_state, &packet);
+				
+				if (krad_ogg->tracks[t].codec == SKELETON) {
+					// just toss the skeleton
+					while (ogg_stream_packetout(&krad_ogg->tracks[t].stream_state, &packet));
 					
-					if (krad_ogg->tracks[t].codec == SKELETON) {
-						// just toss the skeleton
-						while (ogg_stream_packetout(&krad_ogg->tracks[t].stream_state, &packet));
+					ret = 0;
+				}
+				
+				if (ret == 1) {
+				
+					krad_ogg->tracks[t].header_len[krad_ogg->tracks[t].header_count] = packet.bytes;
+				
+					krad_ogg->tracks[t].header[krad_ogg->tracks[t].header_count] = malloc(packet.bytes);
+					memcpy (krad_ogg->tracks[t].header[krad_ogg->tracks[t].header_count],
+							packet.packet,
+							packet.bytes);
+				
+					if (krad_ogg->tracks[t].header_count == 0) {
+				
+						krad_ogg->tracks[t].codec = krad_ogg_get_codec(&packet);
+						if (krad_ogg->tracks[t].codec == VORBIS) {
+							krad_ogg->tracks[t].sample_rate = krad_ogg_vorbis_sample_rate(&packet);
+						}
 						
-						ret = 0;
-					}
-					
-					if (ret == 1) {
-					
-						krad_ogg->tracks[t].header_len[krad_ogg->tracks[t].header_count] = packet.bytes;
-					
-						krad_ogg->tracks[t].header[krad_ogg->tracks[t].header_count] = malloc(packet.bytes);
-						memcpy (krad_ogg->tracks[t].header[krad_ogg->tracks[t].header_count],
-								packet.packet,
-								packet.bytes);
-					
-						if (krad_ogg->tracks[t].header_count == 0) {
-					
-							krad_ogg->tracks[t].codec = krad_ogg_get_codec(&packet);
-							if (krad_ogg->tracks[t].codec == VORBIS) {
-								krad_ogg->tracks[t].sample_rate = krad_ogg_vorbis_sample_rate(&packet);
-							}
-							
-							if (krad_ogg->tracks[t].codec == THEORA) {
-								krad_ogg->tracks[t].frame_rate = krad_ogg_theora_frame_rate(&packet);
-								krad_ogg->tracks[t].keyframe_shift = krad_ogg_theora_keyframe_shift (&packet);
-							}
-							
+						if (krad_ogg->tracks[t].codec == THEORA) {
+							krad_ogg->tracks[t].frame_rate = krad_ogg_theora_frame_rate(&packet);
+							krad_ogg->tracks[t].keyframe_shift = krad_ogg_theora_keyframe_shift (&packet);
 						}
+						
+					}
 
-						krad_ogg->tracks[t].header_count++;
-						if ((krad_ogg->tracks[t].header_count == 3) &&
-							((krad_ogg->tracks[t].codec == VORBIS) || (krad_ogg->tracks[t].codec == THEORA))) {
-							
-							krad_ogg->tracks[t].ready = 1;
+					krad_ogg->tracks[t].header_count++;
+					if ((krad_ogg->tracks[t].header_count == 3) &&
+						((krad_ogg->tracks[t].codec == VORBIS) || (krad_ogg->tracks[t].codec == THEORA))) {
+						
+						krad_ogg->tracks[t].ready = 1;
+					}
+					if ((krad_ogg->tracks[t].header_count == 2) &&
+						((krad_ogg->tracks[t].codec == OPUS) || (krad_ogg->tracks[t].codec == FLAC))) {
+						
+						krad_ogg->tracks[t].header_count = 1;
+						
+						if (krad_ogg->tracks[t].codec == OPUS) {
+							krad_ogg->tracks[t].sample_rate = 48000;
 						}
-						if ((krad_ogg->tracks[t].header_count == 2) &&
-							((krad_ogg->tracks[t].codec == OPUS) || (krad_ogg->tracks[t].codec == FLAC))) {
-							
-							krad_ogg->tracks[t].header_count = 1;
-							
-							if (krad_ogg->tracks[t].codec == FLAC) {
-								// remove oggflac extra stuff
-								memmove (krad_ogg->tracks[t].header[0],
-										 krad_ogg->tracks[t].header[0] + 9,
-										 krad_ogg->tracks[t].header_len[0] - 9);
-								krad_ogg->tracks[t].header_len[0] -= 9;
-								if (krad_ogg->tracks[t].header_len[0] != 42) {
-									printkd ("ruh oh! our oggflac expectations where not met, problem likely!");
-								}
+						
+						if (krad_ogg->tracks[t].codec == FLAC) {
+							// remove oggflac extra stuff
+							memmove (krad_ogg->tracks[t].header[0],
+									 krad_ogg->tracks[t].header[0] + 9,
+									 krad_ogg->tracks[t].header_len[0] - 9);
+							krad_ogg->tracks[t].header_len[0] -= 9;
+							if (krad_ogg->tracks[t].header_len[0] != 42) {
+								printkd ("ruh oh! our oggflac expectations where not met, problem likely!");
+							} else {
+								/* 20 bits into streaminfo, after fLaC and the block header */
+								krad_ogg->tracks[t].sample_rate = (krad_ogg->tracks[t].header[0][18] << 12) |
+																  (krad_ogg->tracks[t].header[0][19] << 4) |
+																  (krad_ogg->tracks[t].header[0][20] >> 4);
 							}
-							
-							
-							krad_ogg->tracks[t].ready = 1;
 						}
-					} else {
-						break;
+						
+						
+						krad_ogg->tracks[t].ready = 1;
 					}
+				} else {
+					break;
 				}
 			}
 		}
+	}
+
+
+}
+
+/* a data packet with the intra frame bit clear */
+
+static int krad_ogg_theora_keyframe (ogg_packet *packet) {
+	return ((packet->bytes > 0) && (!(packet->packet[0] & 0x80)) && (!(packet->packet[0] & 0x40)));
+}
+
+/* The ms at the end of a packet or page from its granulepos */
+
+static uint64_t krad_ogg_granule_to_ms (krad_ogg_track_t *track, ogg_int64_t granulepos) {
+
+	ogg_int64_t iframe;
+	ogg_int64_t pframe;
+
+	if (track->codec == THEORA) {
+		iframe = granulepos >> track->keyframe_shift;
+		pframe = granulepos - (iframe << track->keyframe_shift);
+		/* kludged, we use the default shift of 6 and assume a 3.2.1+ bitstream */
+		return ((iframe + pframe - 1) / track->frame_rate) * 1000.0;
+	}
+
+	if (track->sample_rate > 0) {
+		return (granulepos / track->sample_rate) * 1000.0;
+	}
+
+	return 0;
+
+}
+
+int krad_ogg_read_packet (krad_ogg_t *krad_ogg, int *track, uint64_t *timecode, unsigned char *buffer) {
+
+	int t;
+	int ret;
+	ogg_packet packet;
+	
+	while (1) {
 	
+		krad_ogg_read_headers (krad_ogg);
+		
 		for (t = 0; t < KRAD_OGG_MAX_TRACKS; t++) {
 			if ((krad_ogg->tracks[t].serial != KRAD_OGG_NO_SERIAL) && (krad_ogg->tracks[t].ready == 1)) {
 				ret = ogg_stream_packetout(&krad_ogg->tracks[t].stream_state, &packet);
+				while ((ret == 1) && (krad_ogg->tracks[t].seek_keyframe) && (!krad_ogg_theora_keyframe (&packet))) {
+					ret = ogg_stream_packetout(&krad_ogg->tracks[t].stream_state, &packet);
+				}
+				if (ret == 1) {
+					krad_ogg->tracks[t].seek_keyframe = 0;
+				}
+				if (ret == -1) {
+					krad_ogg->corruptions++;
+					printke ("Krad Ogg: lost packets on track %d, %"PRIu64" corruptions so far", t, krad_ogg->corruptions);
+				}
 				//if ((ret == 1) && (packet.bytes > 0)) {
 				if (ret == 1) {
 					memcpy(buffer, packet.packet, packet.bytes);
@@ -294,20 +354,8 @@ int krad_ogg_read_packet (krad_ogg_t *krad_ogg, int *track, uint64_t *timecode,
 						}
 					}
 					if (packet.granulepos != -1) {
-						if (krad_ogg->tracks[t].codec == VORBIS) {
-							krad_ogg->tracks[t].last_granulepos =
-								(packet.granulepos / krad_ogg->tracks[t].sample_rate) * 1000.0;
-						}
-						
-						if (krad_ogg->tracks[t].codec == THEORA) {
-							ogg_int64_t iframe;
-							ogg_int64_t pframe;
-							iframe = packet.granulepos >> krad_ogg->tracks[t].keyframe_shift;
-							pframe = packet.granulepos - (iframe << krad_ogg->tracks[t].keyframe_shift);
-							/* kludged, we use the default shift of 6 and assume a 3.2.1+ bitstream */
-							krad_ogg->tracks[t].last_granulepos =
-								((iframe + pframe - 1) / krad_ogg->tracks[t].frame_rate) * 1000.0;
-						}
+						krad_ogg->tracks[t].last_granulepos = krad_ogg_granule_to_ms (&krad_ogg->tracks[t],
+																					   packet.granulepos);
 					}
 					*timecode = krad_ogg->tracks[t].last_granulepos;
 					return packet.bytes;
@@ -316,7 +364,7 @@ int krad_ogg_read_packet (krad_ogg_t *krad_ogg, int *track, uint64_t *timecode,
 		}
 	
 	
-		ret = krad_io_read(krad_ogg->krad_io, krad_ogg->input_buffer, 4096);
+		ret = krad_io_read(krad_ogg->krad_io, krad_ogg->input_buffer, krad_ogg->input_buffer_size);
 		
 		if (ret > 0) {
 			krad_ogg_write (krad_ogg, krad_ogg->input_buffer, ret);
@@ -336,8 +384,19 @@ void krad_ogg_process (krad_ogg_t *krad_ogg) {
 	ogg_page page;
 	int serial;
 	int t;
+	int ret;
 	
-	while (ogg_sync_pageout(&krad_ogg->sync_state, &page) == 1) {
+	/* pageseek rather than pageout so we hear about the bytes skipped
+	   looking for the next capture pattern after corruption */
+	while ((ret = ogg_sync_pageseek(&krad_ogg->sync_state, &page)) != 0) {
+		
+		if (ret < 0) {
+			krad_ogg->corruptions++;
+			krad_ogg->corrupt_bytes += -ret;
+			printke ("Krad Ogg: skipped %d bytes of corrupt input to the next page, %"PRIu64" corruptions so far",
+					 -ret, krad_ogg->corruptions);
+			continue;
+		}
 		
 		serial = ogg_page_serialno(&page);
 		
@@ -348,6 +407,12 @@ void krad_ogg_process (krad_ogg_t *krad_ogg) {
 					break;
 				}
 			}
+			
+			if (t == KRAD_OGG_MAX_TRACKS) {
+				krad_ogg->corruptions++;
+				printke ("Krad Ogg: no room for another track, dropping serial %d", serial);
+				continue;
+			}
 
 			krad_ogg->tracks[t].serial = serial;
 			ogg_stream_init(&krad_ogg->tracks[t].stream_state, serial);
@@ -388,6 +453,240 @@ int krad_ogg_write (krad_ogg_t *krad_ogg, unsigned char *buffer, int length) {
 	return length;
 }
 
+/* Seeking */
+
+static int krad_ogg_headers_ready (krad_ogg_t *krad_ogg) {
+
+	int t;
+	int tracks;
+
+	tracks = 0;
+
+	for (t = 0; t < KRAD_OGG_MAX_TRACKS; t++) {
+		if (krad_ogg->tracks[t].serial != KRAD_OGG_NO_SERIAL) {
+			if ((!krad_ogg->tracks[t].ready) && (krad_ogg->tracks[t].codec != SKELETON) &&
+				(!((krad_ogg->tracks[t].header_count > 0) && (krad_ogg->tracks[t].codec == NOCODEC)))) {
+				return 0;
+			}
+			tracks++;
+		}
+	}
+
+	return tracks > 0;
+
+}
+
+/* The granulepos of the first page from offset on that ends a packet,
+   of serial or of any track for KRAD_OGG_NO_SERIAL, and where the page
+   starts and ends. -1 if there isn't one starting before end. */
+
+static ogg_int64_t krad_ogg_seek_probe (krad_ogg_t *krad_ogg, int serial, int64_t offset, int64_t end,
+										int64_t *page_start, int64_t *page_end) {
+
+	ogg_sync_state sync_state;
+	ogg_page page;
+	ogg_int64_t granulepos;
+	int64_t position;
+	char *input;
+	int ret;
+
+	granulepos = -1;
+	position = offset;
+
+	if (krad_io_seek (krad_ogg->krad_io, offset, SEEK_SET) != offset) {
+		return -1;
+	}
+
+	ogg_sync_init (&sync_state);
+
+	while (position < end) {
+
+		ret = ogg_sync_pageseek (&sync_state, &page);
+
+		if (ret < 0) {
+			position += -ret;
+			continue;
+		}
+
+		if (ret == 0) {
+			input = ogg_sync_buffer (&sync_state, KRAD_OGG_SEEK_CHUNK_SIZE);
+			ret = krad_io_read (krad_ogg->krad_io, input, KRAD_OGG_SEEK_CHUNK_SIZE);
+			if (ret <= 0) {
+				break;
+			}
+			ogg_sync_wrote (&sync_state, ret);
+			continue;
+		}
+
+		if (((serial == KRAD_OGG_NO_SERIAL) || (ogg_page_serialno (&page) == serial)) &&
+			(ogg_page_granulepos (&page) != -1)) {
+			granulepos = ogg_page_granulepos (&page);
+			*page_start = position;
+			*page_end = position + ret;
+			break;
+		}
+
+		position += ret;
+	}
+
+	ogg_sync_clear (&sync_state);
+
+	return granulepos;
+
+}
+
+/* Just past the header pages, they all have a granulepos of 0 and come
+   before any data */
+
+static int64_t krad_ogg_seek_data_start (krad_ogg_t *krad_ogg, int64_t end) {
+
+	ogg_int64_t granulepos;
+	int64_t data_start;
+	int64_t page_start;
+	int64_t page_end;
+
+	data_start = 0;
+
+	while (1) {
+		granulepos = krad_ogg_seek_probe (krad_ogg, KRAD_OGG_NO_SERIAL, data_start, end, &page_start, &page_end);
+		if (granulepos != 0) {
+			break;
+		}
+		data_start = page_end;
+	}
+
+	return data_start;
+
+}
+
+/* Where to read from for the page of track t holding ms: just past the
+   last of its pages that ends before ms, within a chunk. *low_ms gets
+   the time at the end of that page. */
+
+static int64_t krad_ogg_seek_bisect (krad_ogg_t *krad_ogg, int t, uint64_t ms, int64_t low, int64_t high,
+									 uint64_t *low_ms) {
+
+	ogg_int64_t granulepos;
+	int64_t mid;
+	int64_t page_start;
+	int64_t page_end;
+	uint64_t page_ms;
+
+	*low_ms = 0;
+
+	while (high - low > KRAD_OGG_SEEK_CHUNK_SIZE) {
+
+		mid = low + (high - low) / 2;
+
+		granulepos = krad_ogg_seek_probe (krad_ogg, krad_ogg->tracks[t].serial, mid, high, &page_start, &page_end);
+
+		if (granulepos == -1) {
+			high = mid;
+			continue;
+		}
+
+		page_ms = krad_ogg_granule_to_ms (&krad_ogg->tracks[t], granulepos);
+
+		if (page_ms >= ms) {
+			high = mid;
+		} else {
+			low = page_end;
+			*low_ms = page_ms;
+		}
+	}
+
+	return low;
+
+}
+
+int64_t krad_ogg_seek_timecode (krad_ogg_t *krad_ogg, uint64_t timecode) {
+
+	struct stat file_stat;
+	ogg_int64_t granulepos;
+	ogg_int64_t iframe;
+	int64_t data_start;
+	int64_t position;
+	int64_t page_start;
+	int64_t page_end;
+	uint64_t ms;
+	uint64_t keyframe_low_ms;
+	int ret;
+	int t;
+	int r;
+
+	if ((krad_ogg->krad_io == NULL) || (krad_ogg->krad_io->mode != KRAD_IO_READONLY) ||
+		(!krad_ogg->krad_io->seekable) || (fstat (krad_ogg->krad_io->ptr, &file_stat) != 0) ||
+		(!S_ISREG (file_stat.st_mode))) {
+		printke ("Krad Ogg: can't seek this input");
+		return -1;
+	}
+
+	/* the headers have to be in before the pages they are in get skipped */
+	while (1) {
+		krad_ogg_read_headers (krad_ogg);
+		if (krad_ogg_headers_ready (krad_ogg)) {
+			break;
+		}
+		ret = krad_io_read (krad_ogg->krad_io, krad_ogg->input_buffer, krad_ogg->input_buffer_size);
+		if (ret <= 0) {
+			printke ("Krad Ogg: input ended before the headers, can't seek");
+			return -1;
+		}
+		krad_ogg_write (krad_ogg, krad_ogg->input_buffer, ret);
+	}
+
+	/* video is what has to land on a keyframe, otherwise any audio track */
+	r = -1;
+	for (t = 0; t < KRAD_OGG_MAX_TRACKS; t++) {
+		if ((krad_ogg->tracks[t].serial == KRAD_OGG_NO_SERIAL) || (!krad_ogg->tracks[t].ready)) {
+			continue;
+		}
+		if ((krad_ogg->tracks[t].codec == THEORA) && (krad_ogg->tracks[t].frame_rate > 0)) {
+			r = t;
+			break;
+		}
+		if ((r == -1) && (krad_ogg->tracks[t].sample_rate > 0)) {
+			r = t;
+		}
+	}
+
+	if (r == -1) {
+		printke ("Krad Ogg: no track to seek by");
+		return -1;
+	}
+
+	data_start = krad_ogg_seek_data_start (krad_ogg, file_stat.st_size);
+
+	position = krad_ogg_seek_bisect (krad_ogg, r, timecode, data_start, file_stat.st_size, &ms);
+
+	if (krad_ogg->tracks[r].codec == THEORA) {
+		/* the page holding timecode knows the keyframe it goes back to */
+		granulepos = krad_ogg_seek_probe (krad_ogg, krad_ogg->tracks[r].serial, position, file_stat.st_size,
+										  &page_start, &page_end);
+		if (granulepos > 0) {
+			iframe = granulepos >> krad_ogg->tracks[r].keyframe_shift;
+			ms = krad_ogg_granule_to_ms (&krad_ogg->tracks[r], iframe << krad_ogg->tracks[r].keyframe_shift);
+			position = krad_ogg_seek_bisect (krad_ogg, r, ms, data_start, position, &keyframe_low_ms);
+		}
+	}
+
+	ogg_sync_reset (&krad_ogg->sync_state);
+
+	for (t = 0; t < KRAD_OGG_MAX_TRACKS; t++) {
+		if (krad_ogg->tracks[t].serial != KRAD_OGG_NO_SERIAL) {
+			ogg_stream_reset (&krad_ogg->tracks[t].stream_state);
+			krad_ogg->tracks[t].last_granulepos = ms;
+			krad_ogg->tracks[t].seek_keyframe = (krad_ogg->tracks[t].codec == THEORA);
+		}
+	}
+
+	krad_io_seek (krad_ogg->krad_io, position, SEEK_SET);
+
+	return ms;
+
+}
+
+
 
 
 void krad_ogg_destroy(krad_ogg_t *krad_ogg) {
@@ -429,7 +728,8 @@ krad_ogg_t *krad_ogg_create() {
 		krad_ogg->tracks[t].last_serial = KRAD_OGG_NO_SERIAL;
 	}
 
-	krad_ogg->input_buffer = calloc(1, 4096);
+	krad_ogg->input_buffer_size = KRAD_OGG_INPUT_BUFFER_SIZE;
+	krad_ogg->input_buffer = calloc(1, krad_ogg->input_buffer_size);
 
 	ogg_sync_init (&krad_ogg->sync_state);
 
@@ -445,6 +745,12 @@ krad_ogg_t *krad_ogg_open_file (char *filename, krad_io_mode_t mode) {
 	
 	krad_ogg->krad_io = krad_io_open_file (filename, mode);
 	
+	if (mode == KRAD_IO_READONLY) {
+		free (krad_ogg->input_buffer);
+		krad_ogg->input_buffer_size = KRAD_OGG_FILE_INPUT_BUFFER_SIZE;
+		krad_ogg->input_buffer = calloc(1, krad_ogg->input_buffer_size);
+	}
+	
 	return krad_ogg;
 
 }
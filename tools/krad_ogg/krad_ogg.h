@@ -45,6 +45,13 @@ typedef struct krad_ogg_track_St krad_ogg_track_t;
 
 #define KRAD_OGG_NO_SERIAL -420
 
+/* streams are read a little at a time to keep latency down, files in
+   bigger pieces so playing one is fewer syscalls */
+#define KRAD_OGG_INPUT_BUFFER_SIZE 4096
+#define KRAD_OGG_FILE_INPUT_BUFFER_SIZE 256 * 1024
+/* seeking reads pages this much at a time and bisects down to this */
+#define KRAD_OGG_SEEK_CHUNK_SIZE 64 * 1024
+
 #ifndef KRAD_CODEC_T
 typedef enum {
 	VORBIS = 6666,
@@ -102,6 +109,9 @@ struct krad_ogg_track_St {
 	ogg_int64_t frames;
 	ogg_int64_t frames_since_keyframe;
 	
+	/* after a seek video packets are dropped up to a keyframe */
+	int seek_keyframe;
+	
 };
 
 struct krad_ogg_St {
@@ -112,8 +122,13 @@ struct krad_ogg_St {
 	krad_io_t *krad_io;
 	krad_transmission_t *krad_transmission;
 	unsigned char *input_buffer;
+	int input_buffer_size;
 
 	int output_aux_headers;
+	
+	/* pages skipped over and packets lost reading corrupt input */
+	uint64_t corruptions;
+	uint64_t corrupt_bytes;
 };
 
 
@@ -127,6 +142,9 @@ int krad_ogg_track_changed (krad_ogg_t *krad_ogg, int track);
 int krad_ogg_read_packet (krad_ogg_t *krad_ogg, int *track, uint64_t *timecode, unsigned char *buffer);
 int krad_ogg_write (krad_ogg_t *krad_ogg, unsigned char *buffer, int length);
 void krad_ogg_process (krad_ogg_t *krad_ogg);
+/* carries on reading a file from the last video keyframe, or audio page,
+   at or before timecode, returns the timecode from there or -1 */
+int64_t krad_ogg_seek_timecode (krad_ogg_t *krad_ogg, uint64_t timecode);
 krad_ogg_t *krad_ogg_open_file (char *filename, krad_io_mode_t mode);
 krad_ogg_t *krad_ogg_open_stream (char *host, int port, char *mount, char *password);
 krad_ogg_t *krad_ogg_open_transmission (krad_transmission_t *krad_transmission);
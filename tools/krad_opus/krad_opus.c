@@ -2,20 +2,54 @@
 
 /* Encoding */
 
+static void krad_opus_interleave (float *interleaved, float **samples, int channels, int frames) {
+
+	int s, c;
+
+	s = 0;
+
+	if (channels == 2) {
+#ifdef __SSE__
+		__m128 left;
+		__m128 right;
+
+		for (; s + 4 <= frames; s += 4) {
+			left = _mm_loadu_ps (samples[0] + s);
+			right = _mm_loadu_ps (samples[1] + s);
+			_mm_storeu_ps (interleaved + (s * 2), _mm_unpacklo_ps (left, right));
+			_mm_storeu_ps (interleaved + (s * 2) + 4, _mm_unpackhi_ps (left, right));
+		}
+#endif
+		for (; s < frames; s++) {
+			interleaved[s * 2] = samples[0][s];
+			interleaved[s * 2 + 1] = samples[1][s];
+		}
+		return;
+	}
+
+	for (s = 0; s < frames; s++) {
+		for (c = 0; c < channels; c++) {
+			interleaved[s * channels + c] = samples[c][s];
+		}
+	}
+
+}
+
 void krad_opus_encoder_destroy (krad_opus_t *krad_opus) {
 	
 	int c;
 	
-	for (c = 0; c < krad_opus->channels; c++) {
-		krad_ringbuffer_free ( krad_opus->ringbuf[c] );
-		krad_ringbuffer_free ( krad_opus->resampled_ringbuf[c] );
-		free (krad_opus->resampled_samples[c]);
-		free (krad_opus->samples[c]);
-		free (krad_opus->read_samples[c]);
-		src_delete (krad_opus->src_resampler[c]);
+	if (krad_opus->resample) {
+		for (c = 0; c < krad_opus->channels; c++) {
+			krad_ringbuffer_free ( krad_opus->ringbuf[c] );
+			krad_ringbuffer_free ( krad_opus->resampled_ringbuf[c] );
+			free (krad_opus->resampled_samples[c]);
+			free (krad_opus->samples[c]);
+			src_delete (krad_opus->src_resampler[c]);
+		}
 	}
 	
-	
+	free (krad_opus->pending);
 	free (krad_opus->opustags_header);
 	free (krad_opus->opus_header);
 	opus_multistream_encoder_destroy (krad_opus->encoder);
@@ -46,17 +80,23 @@ krad_opus_t *krad_opus_encoder_create (int channels, int input_sample_rate, int
 	krad_opus->new_signal = krad_opus->signal;
 	krad_opus->new_bandwidth = krad_opus->bandwidth;
 	
-	for (c = 0; c < krad_opus->channels; c++) {
-		krad_opus->ringbuf[c] = krad_ringbuffer_create (RINGBUFFER_SIZE);
-		krad_opus->resampled_ringbuf[c] = krad_ringbuffer_create (RINGBUFFER_SIZE);
-		krad_opus->samples[c] = malloc(16 * 8192);
-		krad_opus->resampled_samples[c] = malloc(16 * 8192);
-		krad_opus->src_resampler[c] = src_new (KRAD_OPUS_SRC_QUALITY, 1, &krad_opus->src_error[c]);
-		if (krad_opus->src_resampler[c] == NULL) {
-			failfast ("Krad Opus Encoder: src resampler error: %s", src_strerror (krad_opus->src_error[c]));
+	krad_opus->resample = (input_sample_rate != 48000);
+
+	if (krad_opus->resample) {
+		for (c = 0; c < krad_opus->channels; c++) {
+			krad_opus->ringbuf[c] = krad_ringbuffer_create (RINGBUFFER_SIZE);
+			krad_opus->resampled_ringbuf[c] = krad_ringbuffer_create (RINGBUFFER_SIZE);
+			krad_opus->samples[c] = malloc(16 * 8192);
+			krad_opus->resampled_samples[c] = malloc(16 * 8192);
+			krad_opus->src_resampler[c] = src_new (KRAD_OPUS_SRC_QUALITY, 1, &krad_opus->src_error[c]);
+			if (krad_opus->src_resampler[c] == NULL) {
+				failfast ("Krad Opus Encoder: src resampler error: %s", src_strerror (krad_opus->src_error[c]));
+			}
+			
+			krad_opus->src_data[c].src_ratio = 48000.0 / krad_opus->input_sample_rate;
 		}
-		
-		krad_opus->src_data[c].src_ratio = 48000.0 / krad_opus->input_sample_rate;
+	} else {
+		krad_opus->pending = malloc (KRAD_OPUS_PENDING_FRAMES * krad_opus->channels * 4);
 	}
 
 	if (krad_opus->channels < 3) {
@@ -195,8 +235,29 @@ krad_opus_t *krad_opus_encoder_create (int channels, int input_sample_rate, int
 
 }
 
-int krad_opus_encoder_write (krad_opus_t *krad_opus, int channel, char *buffer, int buffer_length) {
-	return krad_ringbuffer_write (krad_opus->ringbuf[channel - 1], buffer, buffer_length );
+int krad_opus_encoder_write (krad_opus_t *krad_opus, float **samples, int frames) {
+
+	int c;
+
+	if (krad_opus->resample) {
+		for (c = 0; c < krad_opus->channels; c++) {
+			krad_ringbuffer_write (krad_opus->ringbuf[c], (char *)samples[c], frames * 4);
+		}
+		return frames;
+	}
+
+	if (krad_opus->pending_frames + frames > KRAD_OPUS_PENDING_FRAMES) {
+		printke ("Krad Opus Encoder: %d frames written without being read, dropping some",
+				 krad_opus->pending_frames + frames);
+		frames = KRAD_OPUS_PENDING_FRAMES - krad_opus->pending_frames;
+	}
+
+	krad_opus_interleave (krad_opus->pending + (krad_opus->pending_frames * krad_opus->channels),
+						  samples, krad_opus->channels, frames);
+
+	krad_opus->pending_frames += frames;
+
+	return frames;
 }
 
 int krad_opus_get_bitrate (krad_opus_t *krad_opus) { 
@@ -244,9 +305,10 @@ int krad_opus_encoder_read (krad_opus_t *krad_opus, unsigned char *buffer, int *
 	int ready;
 	int bytes;
 	int resp;
-	int s, c;
+	int c;
+	float *pcm;
 
-	while (krad_ringbuffer_read_space (krad_opus->ringbuf[krad_opus->channels - 1]) >= 512 * 4 ) {
+	while ((krad_opus->resample) && (krad_ringbuffer_read_space (krad_opus->ringbuf[krad_opus->channels - 1]) >= 512 * 4)) {
 		   
 		for (c = 0; c < krad_opus->channels; c++) {
 
@@ -314,28 +376,38 @@ int krad_opus_encoder_read (krad_opus_t *krad_opus, unsigned char *buffer, int *
 		
 	ready = 1;
 	
-	for (c = 0; c < krad_opus->channels; c++) {
-		if (krad_ringbuffer_read_space (krad_opus->resampled_ringbuf[c]) < krad_opus->frame_size * 4) {
+	if (krad_opus->resample) {
+		for (c = 0; c < krad_opus->channels; c++) {
+			if (krad_ringbuffer_read_space (krad_opus->resampled_ringbuf[c]) < krad_opus->frame_size * 4) {
+				ready = 0;
+			}
+		}
+	} else {
+		if (krad_opus->pending_frames < krad_opus->frame_size) {
 			ready = 0;
 		}
 	}
 
 	if (ready == 1) {
 
-		for (c = 0; c < krad_opus->channels; c++) {
-			krad_opus->ret = krad_ringbuffer_read (krad_opus->resampled_ringbuf[c],
-										  (char *)krad_opus->resampled_samples[c],
-										          (krad_opus->frame_size * 4) );
-		}
+		if (krad_opus->resample) {
 
-		for (s = 0; s < krad_opus->frame_size; s++) {
 			for (c = 0; c < krad_opus->channels; c++) {
-				krad_opus->interleaved_resampled_samples[s * krad_opus->channels + c] = krad_opus->resampled_samples[c][s];
+				krad_opus->ret = krad_ringbuffer_read (krad_opus->resampled_ringbuf[c],
+											  (char *)krad_opus->resampled_samples[c],
+											          (krad_opus->frame_size * 4) );
 			}
+
+			krad_opus_interleave (krad_opus->interleaved_resampled_samples, krad_opus->resampled_samples,
+								  krad_opus->channels, krad_opus->frame_size);
+
+			pcm = krad_opus->interleaved_resampled_samples;
+		} else {
+			pcm = krad_opus->pending;
 		}
 
 		bytes = opus_multistream_encode_float (krad_opus->encoder,
-											   krad_opus->interleaved_resampled_samples,
+											   pcm,
 											   krad_opus->frame_size,
 											   buffer,
 											   500000);
@@ -344,6 +416,14 @@ int krad_opus_encoder_read (krad_opus_t *krad_opus, unsigned char *buffer, int *
 			failfast ("Krad Opus Encoding failed: %s.", opus_strerror (bytes));
 		}
 
+		/* move what was not encoded, which can be more than a frame,
+		   to the front of pending */
+		if (!krad_opus->resample) {
+			krad_opus->pending_frames -= krad_opus->frame_size;
+			memmove (krad_opus->pending, krad_opus->pending + (krad_opus->frame_size * krad_opus->channels),
+					 krad_opus->pending_frames * krad_opus->channels * 4);
+		}
+
 		*nframes = krad_opus->frame_size;
 
 		return bytes;
@@ -10,12 +10,16 @@
 #include <opus.h>
 #include <opus_multistream.h>
 #include <ogg/ogg.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include "krad_radio_version.h"
 #include "krad_system.h"
 #include "opus_header.h"
 #include "krad_ring.h"
 #include "krad_codec_header.h"
+#include "krad_blockpool.h"
 
 // where did this come from?
 #define OPUS_MAX_FRAME_BYTES 61295
@@ -24,6 +28,8 @@
 #define DEFAULT_OPUS_FRAME_SIZE 960
 #define KRAD_MIN_OPUS_FRAME_SIZE 120
 #define MAX_OPUS_FRAME_SIZE 2880
+/* room for a frame being filled plus a write of a whole mixer block landing on it */
+#define KRAD_OPUS_PENDING_FRAMES (MAX_OPUS_FRAME_SIZE + KRAD_BLOCKPOOL_MAX_FRAMES)
 #ifndef RINGBUFFER_SIZE
 #define RINGBUFFER_SIZE 2000000
 #endif
@@ -53,6 +59,13 @@ struct krad_opus_St {
 	krad_ringbuffer_t *resampled_ringbuf[MAX_CHANNELS];
 
 	krad_ringbuffer_t *ringbuf[MAX_CHANNELS];
+
+	/* Encoding at 48000 there is nothing to resample, input is interleaved
+	   straight into pending and frames are encoded from there */
+	int resample;
+	float *pending;
+	int pending_frames;
+
 	int ret;
 	int channels;
 	
@@ -106,7 +119,8 @@ void krad_opus_set_signal (krad_opus_t *krad_opus, int signal);
 void krad_opus_set_bandwidth (krad_opus_t *krad_opus, int bandwidth);
 
 int krad_opus_encoder_read (krad_opus_t *krad_opus, unsigned char *buffer, int *nframes);
-int krad_opus_encoder_write (krad_opus_t *krad_opus, int channel, char *buffer, int buffer_length);
+/* planar float input, one buffer per channel */
+int krad_opus_encoder_write (krad_opus_t *krad_opus, float **samples, int frames);
 void krad_opus_encoder_destroy (krad_opus_t *krad_opus);
 krad_opus_t *krad_opus_encoder_create (int channels, int input_sample_rate, int bitrate, int application);
 
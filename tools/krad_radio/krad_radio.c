@@ -371,7 +371,7 @@ static int krad_radio_handler ( void *output, int *output_len, void *ptr ) {
 			}		
 		
 			krad_radio_station->krad_http = krad_http_server_create ( numbers[0], numbers[1] );
-			krad_radio_station->krad_websocket = krad_websocket_server_create ( krad_radio_station->sysname, numbers[1] );
+			krad_radio_station->krad_websocket = krad_websocket_server_create ( krad_radio_station, krad_radio_station->sysname, numbers[1] );
 		
 			return 0;
 		
@@ -452,7 +452,23 @@ static int krad_radio_handler ( void *output, int *output_len, void *ptr ) {
 				krad_radio_set_dir ( krad_radio_station, tag_value_actual );
 			}
 			
-			return 0;			
+			return 0;
+
+		case EBML_ID_KRAD_RADIO_CMD_SET_FREEWHEEL:
+			
+			krad_ebml_read_element ( krad_radio_station->krad_ipc->current_client->krad_ebml, &ebml_id, &ebml_data_size);	
+
+			if (ebml_id != EBML_ID_KRAD_RADIO_FREEWHEEL) {
+				printke ("hrm wtf7");
+			}
+			
+			numbers[0] = krad_ebml_read_number ( krad_radio_station->krad_ipc->current_client->krad_ebml, ebml_data_size);
+			
+			krad_ticker_set_freewheel (numbers[0]);
+			
+			printk ("Krad Radio: freewheel %s", numbers[0] ? "on" : "off");
+			
+			return 0;
 			
 		default:
 			printke ("Krad Radio Command Unknown! %u", command);
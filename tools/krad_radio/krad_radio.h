@@ -22,6 +22,7 @@ typedef struct krad_radio_St krad_radio_t;
 #include "krad_system.h"
 #include "krad_xmms2.h"
 #include "krad_ticker.h"
+#include "krad_synth.h"
 #include "krad_tags.h"
 #include "krad_ipc_server.h"
 #include "krad_radio_ipc.h"
@@ -29,6 +30,7 @@ typedef struct krad_radio_St krad_radio_t;
 #include "krad_osc.h"
 #include "krad_ring.h"
 #include "krad_resample_ring.h"
+#include "krad_blockpool.h"
 #include "krad_tone.h"
 #include "krad_audio.h"
 #include "krad_jack.h"
@@ -51,12 +53,14 @@ typedef struct krad_radio_St krad_radio_t;
 #include "krad_vorbis.h"
 #include "krad_flac.h"
 #include "krad_container.h"
+#include "krad_playlist.h"
 #include "krad_framepool.h"
 #include "krad_decklink.h"
 #include "krad_sprite.h"
 #include "krad_text.h"
 #include "krad_compositor.h"
 #include "krad_link_common.h"
+#include "krad_encode_pool.h"
 #include "krad_link.h"
 
 extern int verbose;
@@ -24,8 +24,10 @@
 #define EBML_ID_KRAD_RADIO_CMD_UPTIME 0xA6
 #define EBML_ID_KRAD_RADIO_CMD_INFO 0xA5
 #define EBML_ID_KRAD_RADIO_CMD_SET_DIR 0x6264
+#define EBML_ID_KRAD_RADIO_CMD_SET_FREEWHEEL 0x6265
 
 #define EBML_ID_KRAD_RADIO_DIR 0x7D7B
+#define EBML_ID_KRAD_RADIO_FREEWHEEL 0x7D7C
 #define EBML_ID_KRAD_RADIO_UPTIME 0xFB
 #define EBML_ID_KRAD_RADIO_INFO 0xFD
 
@@ -204,6 +206,26 @@
 
 #define EBML_ID_KRAD_LINK_LINK_VP8_FORCE_KEYFRAME 0x6933
 #define EBML_ID_KRAD_LINK_LINK_VP8_BITRATE 0x6922
+#define EBML_ID_KRAD_LINK_LINK_VP8_THREADS 0x6934
+#define EBML_ID_KRAD_LINK_LINK_VP8_SPEED 0x6935
+#define EBML_ID_KRAD_LINK_LINK_VP8_DEADLINE 0x6936
+#define EBML_ID_KRAD_LINK_LINK_VP8_RATE_CONTROL 0x6937
+#define EBML_ID_KRAD_LINK_LINK_VP8_BUFFER 0x6938
+#define EBML_ID_KRAD_LINK_LINK_SIMULCAST 0x6939
+#define EBML_ID_KRAD_LINK_LINK_ADD_OUTPUT 0x693A
+#define EBML_ID_KRAD_LINK_LINK_REMOVE_OUTPUT 0x693B
+#define EBML_ID_KRAD_LINK_LINK_MAX_INTERLEAVE 0x693C
+#define EBML_ID_KRAD_LINK_LINK_LIVE_CLUSTER_MS 0x693D
+#define EBML_ID_KRAD_LINK_LINK_LIVE_CLUSTER_BYTES 0x693E
+#define EBML_ID_KRAD_LINK_LINK_LIVE_FLUSH_MS 0x693F
+#define EBML_ID_KRAD_LINK_LINK_BUFFERED_MS 0x6940
+#define EBML_ID_KRAD_LINK_LINK_SEEK_MS 0x6941
+#define EBML_ID_KRAD_LINK_LINK_VIDEO_DECODE_US 0x6942
+#define EBML_ID_KRAD_LINK_LINK_AUDIO_ENCODE_CPU_MS 0x6943
+#define EBML_ID_KRAD_LINK_LINK_UDP_PACE_KBPS 0x6945
+#define EBML_ID_KRAD_LINK_LINK_UDP_PACE_TXTIME 0x6946
+#define EBML_ID_KRAD_LINK_LINK_UDP_FEC_GROUP 0x6947
+#define EBML_ID_KRAD_LINK_LINK_UDP_LATENCY_MS 0x6948
 #define EBML_ID_KRAD_LINK_LINK_VIDEO_WIDTH 0x54B0
 #define EBML_ID_KRAD_LINK_LINK_VIDEO_HEIGHT 0x54BA
 
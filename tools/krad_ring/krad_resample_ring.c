@@ -14,6 +14,8 @@ uint32_t krad_resample_ring_read (krad_resample_ring_t *krad_resample_ring, unsi
 }
 
 uint32_t krad_resample_ring_write (krad_resample_ring_t *krad_resample_ring, unsigned char *src, uint32_t cnt) {
+
+	krad_resample_ring->frames_in += cnt / 4;
 			
 	if (krad_resample_ring->inbuffer_pos) {
 		memcpy (krad_resample_ring->inbuffer + krad_resample_ring->inbuffer_pos, src, cnt);
@@ -71,14 +73,105 @@ void krad_resample_ring_set_input_sample_rate (krad_resample_ring_t *krad_resamp
 
 	krad_resample_ring->input_sample_rate = input_sample_rate;
 	
-	krad_resample_ring->src_data.src_ratio = 
-		(float)krad_resample_ring->output_sample_rate / (float)krad_resample_ring->input_sample_rate;
+	krad_resample_ring->nominal_ratio = 
+		(double)krad_resample_ring->output_sample_rate / (double)krad_resample_ring->input_sample_rate;
+
+	krad_resample_ring->drift_integral = 0.0;
+	krad_resample_ring->drift_adjust = 0.0;
+	krad_resample_ring->frames_in_tracked = krad_resample_ring->frames_in;
+
+	krad_resample_ring->src_data.src_ratio = krad_resample_ring->nominal_ratio;
 	
 	printk ("krad_resample_ring src resampler ratio is: %f", krad_resample_ring->src_data.src_ratio);	
 	
 
 }
 
+void krad_resample_ring_set_target_latency (krad_resample_ring_t *krad_resample_ring, int ms) {
+
+	krad_resample_ring->target_fill = ((uint64_t)ms * krad_resample_ring->output_sample_rate) / 1000;
+	krad_resample_ring->fill_average = krad_resample_ring->target_fill;
+	krad_resample_ring->drift_integral = 0.0;
+	krad_resample_ring->frames_in_tracked = krad_resample_ring->frames_in;
+
+	krad_resample_ring_set_drift_adjust (krad_resample_ring, 0.0);
+
+}
+
+uint32_t krad_resample_ring_fill_ms (krad_resample_ring_t *krad_resample_ring) {
+	return ((uint64_t)(krad_resample_ring_read_space (krad_resample_ring) / 4) * 1000) /
+		   krad_resample_ring->output_sample_rate;
+}
+
+double krad_resample_ring_track_drift (krad_resample_ring_t *krad_resample_ring) {
+
+	double dt;
+	double error;
+	double adjust;
+	double integral_limit;
+	uint32_t fill;
+
+	if (krad_resample_ring->target_fill == 0) {
+		return 0.0;
+	}
+
+	dt = (double)(krad_resample_ring->frames_in - krad_resample_ring->frames_in_tracked) /
+		 krad_resample_ring->input_sample_rate;
+
+	if (dt <= 0.0) {
+		return krad_resample_ring->drift_adjust;
+	}
+
+	krad_resample_ring->frames_in_tracked = krad_resample_ring->frames_in;
+
+	if (dt > KRAD_RESAMPLE_RING_DRIFT_FILTER_SECONDS) {
+		dt = KRAD_RESAMPLE_RING_DRIFT_FILTER_SECONDS;
+	}
+
+	/* packets land in bursts, smooth the fill before steering on it */
+	fill = krad_resample_ring_read_space (krad_resample_ring) / 4;
+
+	krad_resample_ring->fill_average += (fill - krad_resample_ring->fill_average) *
+										(dt / KRAD_RESAMPLE_RING_DRIFT_FILTER_SECONDS);
+
+	/* seconds of latency above the target */
+	error = (krad_resample_ring->fill_average - krad_resample_ring->target_fill) /
+			krad_resample_ring->output_sample_rate;
+
+	integral_limit = KRAD_RESAMPLE_RING_DRIFT_MAX_ADJUST / KRAD_RESAMPLE_RING_DRIFT_KI;
+
+	krad_resample_ring->drift_integral += error * dt;
+
+	if (krad_resample_ring->drift_integral > integral_limit) {
+		krad_resample_ring->drift_integral = integral_limit;
+	}
+	if (krad_resample_ring->drift_integral < -integral_limit) {
+		krad_resample_ring->drift_integral = -integral_limit;
+	}
+
+	/* too full means we play slower than they send, make fewer samples */
+	adjust = -((KRAD_RESAMPLE_RING_DRIFT_KP * error) + (KRAD_RESAMPLE_RING_DRIFT_KI * krad_resample_ring->drift_integral));
+
+	if (adjust > KRAD_RESAMPLE_RING_DRIFT_MAX_ADJUST) {
+		adjust = KRAD_RESAMPLE_RING_DRIFT_MAX_ADJUST;
+	}
+	if (adjust < -KRAD_RESAMPLE_RING_DRIFT_MAX_ADJUST) {
+		adjust = -KRAD_RESAMPLE_RING_DRIFT_MAX_ADJUST;
+	}
+
+	return adjust;
+
+}
+
+void krad_resample_ring_set_drift_adjust (krad_resample_ring_t *krad_resample_ring, double adjust) {
+
+	krad_resample_ring->drift_adjust = adjust;
+
+	/* src_process ramps to a new ratio across the next block, no clicks */
+	krad_resample_ring->src_data.src_ratio = krad_resample_ring->nominal_ratio * (1.0 + adjust);
+
+}
+
 krad_resample_ring_t *krad_resample_ring_create (uint32_t size, int input_sample_rate, int output_sample_rate) {
 
 	krad_resample_ring_t *krad_resample_ring = calloc (1, sizeof(krad_resample_ring_t));
@@ -13,6 +13,16 @@
 
 #define KRAD_RESAMPLE_RING_SRC_QUALITY SRC_SINC_MEDIUM_QUALITY
 
+/* Drift tracking, a PI loop on the (smoothed) fill level trims the src ratio
+   so a remote clock running fast or slow against ours settles at the target
+   latency instead of slowly overflowing or running dry. Kp is in ratio per
+   second of latency error, Ki per second squared; critically damped-ish with
+   a ~20 second time constant, slow enough to be inaudible. */
+#define KRAD_RESAMPLE_RING_DRIFT_FILTER_SECONDS 1.0
+#define KRAD_RESAMPLE_RING_DRIFT_KP 0.05
+#define KRAD_RESAMPLE_RING_DRIFT_KI 0.00125
+#define KRAD_RESAMPLE_RING_DRIFT_MAX_ADJUST 0.005
+
 typedef struct krad_resample_ring_St krad_resample_ring_t;
 
 struct krad_resample_ring_St {
@@ -32,6 +42,15 @@ struct krad_resample_ring_St {
 	unsigned char *outbuffer;
 	unsigned char *inbuffer;
 	int inbuffer_pos;
+
+	double nominal_ratio;
+
+	uint32_t target_fill;
+	double fill_average;
+	double drift_integral;
+	double drift_adjust;
+	uint64_t frames_in;
+	uint64_t frames_in_tracked;
 };
 
 
@@ -41,6 +60,16 @@ krad_resample_ring_t *krad_resample_ring_create (uint32_t size, int input_sample
 
 void krad_resample_ring_set_input_sample_rate (krad_resample_ring_t *krad_resample_ring, int input_sample_rate);
 
+/* 0 turns drift tracking off and puts the ratio back to nominal */
+void krad_resample_ring_set_target_latency (krad_resample_ring_t *krad_resample_ring, int ms);
+uint32_t krad_resample_ring_fill_ms (krad_resample_ring_t *krad_resample_ring);
+
+/* Runs the drift loop over everything written since the last call and
+   returns the ratio adjustment, apply it to every channel with
+   set_drift_adjust so they stay sample aligned */
+double krad_resample_ring_track_drift (krad_resample_ring_t *krad_resample_ring);
+void krad_resample_ring_set_drift_adjust (krad_resample_ring_t *krad_resample_ring, double adjust);
+
 uint32_t krad_resample_ring_read_space (krad_resample_ring_t *krad_resample_ring);
 uint32_t krad_resample_ring_write_space (krad_resample_ring_t *krad_resample_ring);
 
@@ -0,0 +1,514 @@
+#include "krad_synth.h"
+
+static uint32_t krad_synth_xorshift (krad_synth_t *krad_synth) {
+
+	uint32_t x;
+
+	x = krad_synth->noise_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	krad_synth->noise_state = x;
+
+	return x;
+
+}
+
+static uint32_t read_le32 (unsigned char *buf) {
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint16_t read_le16 (unsigned char *buf) {
+	return buf[0] | (buf[1] << 8);
+}
+
+krad_synth_pattern_t krad_synth_string_to_pattern (char *string) {
+
+	if (strcmp(string, "bars") == 0) {
+		return KRAD_SYNTH_BARS;
+	}
+
+	if (strcmp(string, "gradient") == 0) {
+		return KRAD_SYNTH_GRADIENT;
+	}
+
+	if (strcmp(string, "noise") == 0) {
+		return KRAD_SYNTH_NOISE;
+	}
+
+	return KRAD_SYNTH_YUV_FILE;
+
+}
+
+char *krad_synth_pattern_to_string (krad_synth_pattern_t pattern) {
+
+	switch (pattern) {
+		case KRAD_SYNTH_BARS:
+			return "bars";
+		case KRAD_SYNTH_GRADIENT:
+			return "gradient";
+		case KRAD_SYNTH_NOISE:
+			return "noise";
+		case KRAD_SYNTH_YUV_FILE:
+			return "yuvfile";
+		default:
+			return "Unknown";
+	}
+}
+
+static int krad_synth_open_wav (krad_synth_t *krad_synth) {
+
+	unsigned char header[44];
+	uint32_t chunk_size;
+	int format;
+	int bits;
+
+	format = 0;
+	bits = 0;
+
+	krad_synth->wav_file = fopen (krad_synth->wav_filename, "rb");
+
+	if (krad_synth->wav_file == NULL) {
+		printke ("Krad Synth: could not open %s", krad_synth->wav_filename);
+		return -1;
+	}
+
+	if ((fread (header, 1, 12, krad_synth->wav_file) != 12) ||
+		(memcmp (header, "RIFF", 4) != 0) || (memcmp (header + 8, "WAVE", 4) != 0)) {
+		printke ("Krad Synth: %s is not a wav file", krad_synth->wav_filename);
+		return -1;
+	}
+
+	while (fread (header, 1, 8, krad_synth->wav_file) == 8) {
+
+		chunk_size = read_le32 (header + 4);
+
+		if (memcmp (header, "fmt ", 4) == 0) {
+			if ((chunk_size < 16) || (fread (header + 8, 1, 16, krad_synth->wav_file) != 16)) {
+				break;
+			}
+			format = read_le16 (header + 8);
+			krad_synth->wav_channels = read_le16 (header + 10);
+			krad_synth->wav_sample_rate = read_le32 (header + 12);
+			bits = read_le16 (header + 22);
+			fseek (krad_synth->wav_file, chunk_size - 16 + (chunk_size & 1), SEEK_CUR);
+			continue;
+		}
+
+		if (memcmp (header, "data", 4) == 0) {
+			krad_synth->wav_data_start = ftell (krad_synth->wav_file);
+			krad_synth->wav_data_size = chunk_size;
+			break;
+		}
+
+		fseek (krad_synth->wav_file, chunk_size + (chunk_size & 1), SEEK_CUR);
+	}
+
+	if ((format != 1) || (bits != 16) || (krad_synth->wav_channels < 1) ||
+		(krad_synth->wav_data_size < krad_synth->wav_channels * 2)) {
+		printke ("Krad Synth: %s needs to be 16 bit pcm", krad_synth->wav_filename);
+		return -1;
+	}
+
+	krad_synth->wav_buffer_frames = 4096;
+	krad_synth->wav_buffer = malloc (krad_synth->wav_buffer_frames * krad_synth->wav_channels * 2);
+
+	printk ("Krad Synth: wav %s %d channels %dhz %d bytes",
+			krad_synth->wav_filename, krad_synth->wav_channels,
+			krad_synth->wav_sample_rate, krad_synth->wav_data_size);
+
+	return 0;
+
+}
+
+static int krad_synth_open_yuv (krad_synth_t *krad_synth) {
+
+	krad_synth->yuv_file = fopen (krad_synth->filename, "rb");
+
+	if (krad_synth->yuv_file == NULL) {
+		printke ("Krad Synth: could not open %s", krad_synth->filename);
+		return -1;
+	}
+
+	krad_synth->yuv_frame_size = (krad_synth->width * krad_synth->height) +
+								 (((krad_synth->width + 1) / 2) * ((krad_synth->height + 1) / 2) * 2);
+
+	krad_synth->yuv_buffer = malloc (krad_synth->yuv_frame_size);
+
+	if (krad_synth->yuv_buffer == NULL) {
+		failfast ("Krad Synth: Out of memory");
+	}
+
+	return 0;
+
+}
+
+static void krad_synth_parse_spec (krad_synth_t *krad_synth, char *spec) {
+
+	char buffer[1024];
+	char *token;
+	char *saveptr;
+	int num;
+	int den;
+	int first;
+
+	first = 1;
+
+	strncpy (buffer, spec, sizeof(buffer) - 1);
+	buffer[sizeof(buffer) - 1] = '\0';
+
+	for (token = strtok_r (buffer, " ", &saveptr); token != NULL; token = strtok_r (NULL, " ", &saveptr)) {
+
+		if (first) {
+			first = 0;
+			krad_synth->pattern = krad_synth_string_to_pattern (token);
+			if (krad_synth->pattern == KRAD_SYNTH_YUV_FILE) {
+				strncpy (krad_synth->filename, token, sizeof(krad_synth->filename) - 1);
+			}
+			continue;
+		}
+
+		if (strcmp(token, "fast") == 0) {
+			krad_synth->realtime = 0;
+			continue;
+		}
+
+		if ((strlen(token) > 4) && (strcmp(token + strlen(token) - 4, ".wav") == 0)) {
+			strncpy (krad_synth->wav_filename, token, sizeof(krad_synth->wav_filename) - 1);
+			continue;
+		}
+
+		if (sscanf (token, "%dx%d", &num, &den) == 2) {
+			if ((num > 1) && (den > 1)) {
+				krad_synth->width = num & ~1;
+				krad_synth->height = den & ~1;
+			}
+			continue;
+		}
+
+		den = 1;
+
+		if (sscanf (token, "%d/%d", &num, &den) >= 1) {
+			if ((num > 0) && (den > 0)) {
+				krad_synth->fps_numerator = num;
+				krad_synth->fps_denominator = den;
+			}
+			continue;
+		}
+
+		printke ("Krad Synth: ignoring %s", token);
+	}
+}
+
+krad_synth_t *krad_synth_create (char *spec) {
+
+	krad_synth_t *krad_synth;
+
+	krad_synth = calloc (1, sizeof (krad_synth_t));
+
+	if (krad_synth == NULL) {
+		failfast ("Krad Synth: Out of memory");
+	}
+
+	krad_synth->pattern = KRAD_SYNTH_BARS;
+	krad_synth->width = KRAD_SYNTH_DEFAULT_WIDTH;
+	krad_synth->height = KRAD_SYNTH_DEFAULT_HEIGHT;
+	krad_synth->fps_numerator = KRAD_SYNTH_DEFAULT_FPS;
+	krad_synth->fps_denominator = 1;
+	krad_synth->realtime = 1;
+	krad_synth->sample_rate = 48000;
+	krad_synth->noise_state = 2463534242;
+
+	if ((spec != NULL) && (strlen(spec))) {
+		krad_synth_parse_spec (krad_synth, spec);
+	}
+
+	if (krad_synth->pattern == KRAD_SYNTH_YUV_FILE) {
+		if (krad_synth_open_yuv (krad_synth) < 0) {
+			krad_synth_destroy (krad_synth);
+			return NULL;
+		}
+	}
+
+	if (strlen(krad_synth->wav_filename)) {
+		if (krad_synth_open_wav (krad_synth) < 0) {
+			if (krad_synth->wav_file != NULL) {
+				fclose (krad_synth->wav_file);
+				krad_synth->wav_file = NULL;
+			}
+		}
+	}
+
+	printk ("Krad Synth: %s %dx%d %d/%d fps%s",
+			krad_synth->pattern == KRAD_SYNTH_YUV_FILE ? krad_synth->filename : krad_synth_pattern_to_string (krad_synth->pattern),
+			krad_synth->width, krad_synth->height,
+			krad_synth->fps_numerator, krad_synth->fps_denominator,
+			krad_synth->realtime ? "" : " unpaced");
+
+	return krad_synth;
+
+}
+
+void krad_synth_destroy (krad_synth_t *krad_synth) {
+
+	if (krad_synth->yuv_file != NULL) {
+		fclose (krad_synth->yuv_file);
+	}
+
+	if (krad_synth->yuv_buffer != NULL) {
+		free (krad_synth->yuv_buffer);
+	}
+
+	if (krad_synth->wav_file != NULL) {
+		fclose (krad_synth->wav_file);
+	}
+
+	if (krad_synth->wav_buffer != NULL) {
+		free (krad_synth->wav_buffer);
+	}
+
+	if (krad_synth->yuv_loops) {
+		printk ("Krad Synth: %s looped %d times", krad_synth->filename, krad_synth->yuv_loops);
+	}
+
+	free (krad_synth);
+
+}
+
+void krad_synth_next_frame (krad_synth_t *krad_synth) {
+	krad_synth->frame_num++;
+}
+
+void krad_synth_set_sample_rate (krad_synth_t *krad_synth, int sample_rate) {
+
+	krad_synth->sample_rate = sample_rate;
+
+	if ((krad_synth->wav_file != NULL) && (krad_synth->wav_sample_rate != sample_rate)) {
+		printke ("Krad Synth: %s is %dhz, playing it at %dhz",
+				 krad_synth->wav_filename, krad_synth->wav_sample_rate, sample_rate);
+	}
+}
+
+int krad_synth_audio_frames_for_video_frame (krad_synth_t *krad_synth) {
+
+	uint64_t due;
+
+	due = ((krad_synth->frame_num + 1) * krad_synth->sample_rate * krad_synth->fps_denominator) / krad_synth->fps_numerator;
+
+	if (due <= krad_synth->audio_frames) {
+		return 0;
+	}
+
+	return due - krad_synth->audio_frames;
+
+}
+
+static void krad_synth_render_bars (krad_synth_t *krad_synth, int *pixels, int stride) {
+
+	static const int bars[8] = { 0xFFC0C0C0, 0xFFC0C000, 0xFF00C0C0, 0xFF00C000,
+								 0xFFC000C0, 0xFFC00000, 0xFF0000C0, 0xFF000000 };
+	int x;
+	int y;
+	int offset;
+	int split;
+	int *row;
+
+	offset = (krad_synth->frame_num * 4) % krad_synth->width;
+	split = (krad_synth->height * 2) / 3;
+
+	for (y = 0; y < split; y++) {
+		row = pixels + (y * stride);
+		for (x = 0; x < krad_synth->width; x++) {
+			row[x] = bars[(((x + offset) % krad_synth->width) * 7) / krad_synth->width];
+		}
+	}
+
+	for (; y < krad_synth->height; y++) {
+		row = pixels + (y * stride);
+		for (x = 0; x < krad_synth->width; x++) {
+			row[x] = 0xFF000000 | (((x * 255) / krad_synth->width) * 0x010101);
+		}
+	}
+
+	/* a block that sweeps down so motion search has something to follow */
+	for (y = 0; y < krad_synth->height / 8; y++) {
+		row = pixels + ((((krad_synth->frame_num * 2) + y) % krad_synth->height) * stride);
+		for (x = 0; x < krad_synth->width / 8; x++) {
+			row[x + (krad_synth->width / 2)] = 0xFFFFFFFF;
+		}
+	}
+}
+
+static void krad_synth_render_gradient (krad_synth_t *krad_synth, int *pixels, int stride) {
+
+	int x;
+	int y;
+	int *row;
+	int shift;
+
+	shift = krad_synth->frame_num * 3;
+
+	for (y = 0; y < krad_synth->height; y++) {
+		row = pixels + (y * stride);
+		for (x = 0; x < krad_synth->width; x++) {
+			row[x] = 0xFF000000 |
+					 (((x + shift) & 0xFF) << 16) |
+					 (((y + shift) & 0xFF) << 8) |
+					 ((x + y) & 0xFF);
+		}
+	}
+}
+
+static void krad_synth_render_noise (krad_synth_t *krad_synth, int *pixels, int stride) {
+
+	int x;
+	int y;
+	int *row;
+
+	for (y = 0; y < krad_synth->height; y++) {
+		row = pixels + (y * stride);
+		for (x = 0; x < krad_synth->width; x++) {
+			row[x] = 0xFF000000 | (krad_synth_xorshift (krad_synth) & 0x00FFFFFF);
+		}
+	}
+}
+
+void krad_synth_render (krad_synth_t *krad_synth, int *pixels, int stride) {
+
+	switch (krad_synth->pattern) {
+		case KRAD_SYNTH_BARS:
+			krad_synth_render_bars (krad_synth, pixels, stride);
+			break;
+		case KRAD_SYNTH_GRADIENT:
+			krad_synth_render_gradient (krad_synth, pixels, stride);
+			break;
+		case KRAD_SYNTH_NOISE:
+			krad_synth_render_noise (krad_synth, pixels, stride);
+			break;
+		default:
+			break;
+	}
+}
+
+int krad_synth_read_yuv (krad_synth_t *krad_synth, uint8_t *yuv_pixels[4], int yuv_strides[4]) {
+
+	int chroma_width;
+	int chroma_height;
+
+	if (krad_synth->yuv_file == NULL) {
+		return -1;
+	}
+
+	if (fread (krad_synth->yuv_buffer, 1, krad_synth->yuv_frame_size, krad_synth->yuv_file) != krad_synth->yuv_frame_size) {
+		rewind (krad_synth->yuv_file);
+		krad_synth->yuv_loops++;
+		if (fread (krad_synth->yuv_buffer, 1, krad_synth->yuv_frame_size, krad_synth->yuv_file) != krad_synth->yuv_frame_size) {
+			printke ("Krad Synth: %s is shorter than one %dx%d frame",
+					 krad_synth->filename, krad_synth->width, krad_synth->height);
+			return -1;
+		}
+	}
+
+	chroma_width = (krad_synth->width + 1) / 2;
+	chroma_height = (krad_synth->height + 1) / 2;
+
+	yuv_pixels[0] = krad_synth->yuv_buffer;
+	yuv_pixels[1] = yuv_pixels[0] + (krad_synth->width * krad_synth->height);
+	yuv_pixels[2] = yuv_pixels[1] + (chroma_width * chroma_height);
+	yuv_pixels[3] = NULL;
+
+	yuv_strides[0] = krad_synth->width;
+	yuv_strides[1] = chroma_width;
+	yuv_strides[2] = chroma_width;
+	yuv_strides[3] = 0;
+
+	return 0;
+
+}
+
+static void krad_synth_read_wav (krad_synth_t *krad_synth, float **samples, int channels, int frames) {
+
+	int c;
+	int s;
+	int wc;
+	int pos;
+	int chunk;
+	int frame_bytes;
+	int got;
+
+	pos = 0;
+	frame_bytes = krad_synth->wav_channels * 2;
+
+	while (pos < frames) {
+
+		chunk = frames - pos;
+
+		if (chunk > krad_synth->wav_buffer_frames) {
+			chunk = krad_synth->wav_buffer_frames;
+		}
+
+		if (chunk > (krad_synth->wav_data_size - krad_synth->wav_data_pos) / frame_bytes) {
+			chunk = (krad_synth->wav_data_size - krad_synth->wav_data_pos) / frame_bytes;
+		}
+
+		got = 0;
+
+		if (chunk > 0) {
+			got = fread (krad_synth->wav_buffer, frame_bytes, chunk, krad_synth->wav_file);
+		}
+
+		if (got <= 0) {
+			fseek (krad_synth->wav_file, krad_synth->wav_data_start, SEEK_SET);
+			krad_synth->wav_data_pos = 0;
+			continue;
+		}
+
+		krad_synth->wav_data_pos += got * frame_bytes;
+
+		for (c = 0; c < channels; c++) {
+			wc = c < krad_synth->wav_channels ? c : krad_synth->wav_channels - 1;
+			for (s = 0; s < got; s++) {
+				samples[c][pos + s] = (int16_t)read_le16 ((unsigned char *)&krad_synth->wav_buffer[s * krad_synth->wav_channels + wc]) / 32768.0f;
+			}
+		}
+
+		pos += got;
+	}
+}
+
+void krad_synth_read_audio (krad_synth_t *krad_synth, float **samples, int channels, int frames) {
+
+	int c;
+	int s;
+	float delta;
+
+	krad_synth->audio_frames += frames;
+
+	if (krad_synth->wav_file != NULL) {
+		krad_synth_read_wav (krad_synth, samples, channels, frames);
+		return;
+	}
+
+	if (krad_synth->pattern == KRAD_SYNTH_NOISE) {
+		for (c = 0; c < channels; c++) {
+			for (s = 0; s < frames; s++) {
+				samples[c][s] = ((int32_t)krad_synth_xorshift (krad_synth) / 2147483648.0f) * KRAD_SYNTH_TONE_LEVEL;
+			}
+		}
+		return;
+	}
+
+	delta = (2.0f * M_PI * KRAD_SYNTH_TONE_FREQUENCY) / krad_synth->sample_rate;
+
+	for (s = 0; s < frames; s++) {
+		samples[0][s] = sinf (krad_synth->tone_angle) * KRAD_SYNTH_TONE_LEVEL;
+		krad_synth->tone_angle += delta;
+		if (krad_synth->tone_angle > 2.0f * M_PI) {
+			krad_synth->tone_angle -= 2.0f * M_PI;
+		}
+	}
+
+	for (c = 1; c < channels; c++) {
+		memcpy (samples[c], samples[0], frames * sizeof(float));
+	}
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "krad_system.h"
+
+typedef struct krad_synth_St krad_synth_t;
+
+#ifndef KRAD_SYNTH_H
+#define KRAD_SYNTH_H
+
+/* Deterministic stand ins for capture hardware, so encode and
+   transmit paths can be load tested without a camera or a soundcard.
+
+   Spec strings look like:
+     bars 1280x720 30
+     noise 1920x1080 60/1 fast
+     /tmp/clip.yuv 1280x720 30000/1001 /tmp/clip.wav
+
+   The first word is a pattern (bars, gradient, noise) or the path to a
+   raw I420 file, followed by an optional size, an optional frame rate,
+   "fast" to run without pacing and an optional 16 bit PCM wav path. */
+
+#define KRAD_SYNTH_DEFAULT_WIDTH 1280
+#define KRAD_SYNTH_DEFAULT_HEIGHT 720
+#define KRAD_SYNTH_DEFAULT_FPS 30
+#define KRAD_SYNTH_TONE_FREQUENCY 440.0f
+#define KRAD_SYNTH_TONE_LEVEL 0.25f
+
+typedef enum {
+	KRAD_SYNTH_BARS,
+	KRAD_SYNTH_GRADIENT,
+	KRAD_SYNTH_NOISE,
+	KRAD_SYNTH_YUV_FILE,
+} krad_synth_pattern_t;
+
+struct krad_synth_St {
+
+	krad_synth_pattern_t pattern;
+
+	int width;
+	int height;
+	int fps_numerator;
+	int fps_denominator;
+
+	/* 0 means generate as fast as the consumers will take it */
+	int realtime;
+
+	uint64_t frame_num;
+	uint32_t noise_state;
+
+	char filename[512];
+	FILE *yuv_file;
+	uint8_t *yuv_buffer;
+	int yuv_frame_size;
+	int yuv_loops;
+
+	char wav_filename[512];
+	FILE *wav_file;
+	int wav_channels;
+	int wav_sample_rate;
+	long wav_data_start;
+	int wav_data_size;
+	int wav_data_pos;
+	int16_t *wav_buffer;
+	int wav_buffer_frames;
+
+	int sample_rate;
+	float tone_angle;
+	uint64_t audio_frames;
+
+};
+
+krad_synth_pattern_t krad_synth_string_to_pattern (char *string);
+char *krad_synth_pattern_to_string (krad_synth_pattern_t pattern);
+
+void krad_synth_set_sample_rate (krad_synth_t *krad_synth, int sample_rate);
+
+/* audio frames owed to keep the audio caught up with the current video frame */
+int krad_synth_audio_frames_for_video_frame (krad_synth_t *krad_synth);
+
+/* argb into pixels for the pattern modes */
+void krad_synth_render (krad_synth_t *krad_synth, int *pixels, int stride);
+
+/* points yuv_pixels into the next frame of the file, loops at the end */
+int krad_synth_read_yuv (krad_synth_t *krad_synth, uint8_t *yuv_pixels[4], int yuv_strides[4]);
+
+/* fills channels of non interleaved float audio, wav if we have one */
+void krad_synth_read_audio (krad_synth_t *krad_synth, float **samples, int channels, int frames);
+
+void krad_synth_next_frame (krad_synth_t *krad_synth);
+
+void krad_synth_destroy (krad_synth_t *krad_synth);
+krad_synth_t *krad_synth_create (char *spec);
+
+#endif
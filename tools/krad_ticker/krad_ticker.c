@@ -1,5 +1,7 @@
 #include "krad_ticker.h"
 
+static int krad_ticker_freewheel;
+
 static inline uint64_t ts_to_nsec (struct timespec ts) {
 	return (ts.tv_sec * 1000000000LL) + ts.tv_nsec;
 }
@@ -47,10 +49,30 @@ void krad_ticker_start (krad_ticker_t *krad_ticker) {
 	clock_gettime (CLOCK_MONOTONIC, &krad_ticker->start_time);
 }
 
+void krad_ticker_set_freewheel (int freewheel) {
+	__sync_lock_test_and_set (&krad_ticker_freewheel, freewheel ? 1 : 0);
+}
+
+int krad_ticker_get_freewheel () {
+	return __sync_fetch_and_add (&krad_ticker_freewheel, 0);
+}
+
 void krad_ticker_wait (krad_ticker_t *krad_ticker) {
 
     krad_ticker->total_periods++;
 
+	if (krad_ticker_get_freewheel ()) {
+		krad_ticker->freewheeling = 1;
+		return;
+	}
+
+	if (krad_ticker->freewheeling) {
+		/* we ran ahead of the wall clock, pick up again from now */
+		krad_ticker->freewheeling = 0;
+		krad_ticker_start (krad_ticker);
+		return;
+	}
+
 	krad_ticker->wakeup_time = add_ts (krad_ticker->start_time,
 									   krad_ticker->wait_time_nanosecs * krad_ticker->total_periods);
 
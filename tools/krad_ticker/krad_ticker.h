@@ -14,6 +14,8 @@ struct krad_ticker_St {
     
 	uint64_t wait_time_nanosecs;    
 	uint64_t total_periods;
+	
+	int freewheeling;
 
 };
 
@@ -24,3 +26,8 @@ krad_ticker_t *krad_ticker_create (int numerator, int denominator);
 void krad_ticker_start (krad_ticker_t *krad_ticker);
 void krad_ticker_wait (krad_ticker_t *krad_ticker);
 
+/* Process wide, when set every ticker stops sleeping and just counts
+   periods, so a headless station runs as fast as the cpu allows */
+void krad_ticker_set_freewheel (int freewheel);
+int krad_ticker_get_freewheel ();
+
@@ -1,12 +1,64 @@
+#define _GNU_SOURCE
 #include "krad_udp.h"
 
 
+uint64_t krad_udp_now_ms () {
+
+	struct timespec now;
+	
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+}
+
+static uint64_t krad_udp_now_ns () {
+
+	struct timespec now;
+	
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+}
+
+static void krad_udp_write_header (unsigned char *data, krad_udp_packet_type_t type, int track, uint32_t seq,
+								   int start, int total, uint32_t index) {
+
+	uint32_t ms;
+	
+	ms = krad_udp_now_ms ();
+
+	memcpy (data, "KQN", 3);
+	data[3] = type;
+	memcpy (data + 4, &track, 4);
+	memcpy (data + 8, &seq, 4);
+	memcpy (data + 12, &start, 4);
+	memcpy (data + 16, &total, 4);
+	memcpy (data + 20, &index, 4);
+	memcpy (data + 24, &ms, 4);
+
+}
+
+static void krad_udp_read_header (unsigned char *data, int *track, uint32_t *seq, int *start,
+								  int *total, uint32_t *index, uint32_t *ms) {
+
+	memcpy (track, data + 4, 4);
+	memcpy (seq, data + 8, 4);
+	memcpy (start, data + 12, 4);
+	memcpy (total, data + 16, 4);
+	memcpy (index, data + 20, 4);
+	memcpy (ms, data + 24, 4);
+
+}
+
 krad_slicer_t *krad_slicer_create () {
 
 	krad_slicer_t *krad_slicer = calloc(1, sizeof(krad_slicer_t));
 
-	krad_slicer->data = calloc(1, 2048);
-	strcpy ((char *)krad_slicer->data, "KQN");
+	krad_slicer->msgs = calloc (KRAD_UDP_BATCH, sizeof(struct mmsghdr));
+	krad_slicer->fec_out = calloc (KRAD_UDP_PACE_QUEUE, sizeof(krad_udp_datagram_t));
+	krad_slicer->gso = 1;
 
 	krad_slicer->sd = socket (AF_INET, SOCK_DGRAM, 0);
 
@@ -15,41 +67,525 @@ krad_slicer_t *krad_slicer_create () {
 }
 
 void krad_slicer_destroy (krad_slicer_t *krad_slicer) {
+
+	int t;
 	
 	close (krad_slicer->sd);
 	
-	free (krad_slicer->data);
+	for (t = 0; t < KRAD_UDP_MAX_TRACKS; t++) {
+		if (krad_slicer->tracks[t].history != NULL) {
+			free (krad_slicer->tracks[t].history);
+		}
+	}
+	
+	free (krad_slicer->msgs);
+	free (krad_slicer->fec_out);
 	free (krad_slicer);
 }
 
-void krad_slicer_sendto (krad_slicer_t *krad_slicer, unsigned char *data, int size, int track, char *ip, int port) {
+void krad_slicer_set_fec_group (krad_slicer_t *krad_slicer, int group_size) {
+
+	int t;
+
+	if (group_size < 2) {
+		group_size = 0;
+	}
+	
+	if (group_size > KRAD_UDP_MAX_FEC_GROUP) {
+		group_size = KRAD_UDP_MAX_FEC_GROUP;
+	}
+	
+	krad_slicer->fec_group = group_size;
+	
+	for (t = 0; t < KRAD_UDP_MAX_TRACKS; t++) {
+		krad_slicer->tracks[t].fec_count = 0;
+	}
+
+}
+
+void krad_slicer_set_gso (krad_slicer_t *krad_slicer, int gso) {
+	krad_slicer->gso = gso;
+}
+
+void krad_slicer_set_pacing (krad_slicer_t *krad_slicer, int kbps, int spread_ms, int max_delay_ms) {
+
+	if (kbps < 0) {
+		kbps = 0;
+	}
+	
+	if (spread_ms < 0) {
+		spread_ms = 0;
+	}
+	
+	if (max_delay_ms < 1) {
+		max_delay_ms = KRAD_UDP_DEFAULT_PACE_MAX_DELAY_MS;
+	}
+
+	krad_slicer->pace_bytes_per_second = (uint64_t)kbps * 1000 / 8;
+	krad_slicer->pace_spread_ms = spread_ms;
+	krad_slicer->pace_max_delay_ms = max_delay_ms;
+	krad_slicer->pace_next_ns = 0;
+
+}
+
+int krad_slicer_set_txtime (krad_slicer_t *krad_slicer, int txtime) {
+
+	struct sock_txtime sock_txtime;
+	
+	if (!txtime) {
+		krad_slicer->txtime = 0;
+		return 0;
+	}
+	
+	memset (&sock_txtime, 0, sizeof(sock_txtime));
+	sock_txtime.clockid = CLOCK_MONOTONIC;
+	
+	if (setsockopt (krad_slicer->sd, SOL_SOCKET, SO_TXTIME, &sock_txtime, sizeof(sock_txtime)) != 0) {
+		printk ("Krad UDP: no SO_TXTIME on this socket (%s), pacing by sleeping", strerror(errno));
+		krad_slicer->txtime = 0;
+		return -1;
+	}
+	
+	krad_slicer->txtime = 1;
+	
+	return 0;
+
+}
+
+/* bytes per second a slice of size goes out at, 0 for as fast as we can.
+   Spreading aims to have the slice out spread_ms after it was handed to
+   us, so whatever is already queued eats into that, down to a quarter. */
+static uint64_t krad_slicer_pace_rate (krad_slicer_t *krad_slicer, int size, uint64_t queued_ns) {
 
+	uint64_t rate;
+	uint64_t spread_ns;
+	
+	rate = 0;
+
+	if ((krad_slicer->pace_spread_ms) && (size > KRAD_UDP_MAX_PAYOAD_SIZE)) {
+		spread_ns = (uint64_t)krad_slicer->pace_spread_ms * 1000000;
+		if (queued_ns > spread_ns * 3 / 4) {
+			spread_ns = spread_ns / 4;
+		} else {
+			spread_ns -= queued_ns;
+		}
+		rate = (uint64_t)size * 1000000000 / spread_ns;
+	}
+	
+	if ((krad_slicer->pace_bytes_per_second) && ((rate == 0) || (krad_slicer->pace_bytes_per_second < rate))) {
+		rate = krad_slicer->pace_bytes_per_second;
+	}
+	
+	return rate;
+
+}
+
+/* when the next bytes may leave, an idle bucket fills up to a small burst */
+static uint64_t krad_slicer_pace_departure (krad_slicer_t *krad_slicer, uint64_t now, uint64_t rate) {
+
+	uint64_t burst_ns;
+	
+	burst_ns = (uint64_t)KRAD_UDP_PACE_BURST_BYTES * 1000000000 / rate;
+
+	if (krad_slicer->pace_next_ns + burst_ns < now) {
+		krad_slicer->pace_next_ns = now - burst_ns;
+	}
+	
+	return krad_slicer->pace_next_ns;
+
+}
+
+static void krad_slicer_send_error (krad_slicer_t *krad_slicer, int count) {
+
+	krad_slicer->send_errors += count;
+	
+	if ((krad_slicer->send_errors == count) || ((krad_slicer->send_errors % 1000) < count)) {
+		printke ("Krad UDP: send error %"PRIu64" times, last: %s", krad_slicer->send_errors, strerror(errno));
+	}
+
+}
+
+static void krad_slicer_sendmmsg (krad_slicer_t *krad_slicer, int first, int count, uint64_t *departures) {
+
+	int d;
+	int ret;
+	int sent;
+	struct cmsghdr *cmsg;
+	
+	for (d = 0; d < count; d++) {
+		krad_slicer->iovs[d].iov_base = krad_slicer->pending[first + d];
+		krad_slicer->iovs[d].iov_len = krad_slicer->pending_length[first + d];
+		memset (&krad_slicer->msgs[d], 0, sizeof(struct mmsghdr));
+		krad_slicer->msgs[d].msg_hdr.msg_name = &krad_slicer->remote_client;
+		krad_slicer->msgs[d].msg_hdr.msg_namelen = sizeof(krad_slicer->remote_client);
+		krad_slicer->msgs[d].msg_hdr.msg_iov = &krad_slicer->iovs[d];
+		krad_slicer->msgs[d].msg_hdr.msg_iovlen = 1;
+		if (departures != NULL) {
+			memset (krad_slicer->control[d], 0, sizeof(krad_slicer->control[d]));
+			krad_slicer->msgs[d].msg_hdr.msg_control = krad_slicer->control[d];
+			krad_slicer->msgs[d].msg_hdr.msg_controllen = sizeof(krad_slicer->control[d]);
+			cmsg = CMSG_FIRSTHDR (&krad_slicer->msgs[d].msg_hdr);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_TXTIME;
+			cmsg->cmsg_len = CMSG_LEN (sizeof(uint64_t));
+			memcpy (CMSG_DATA (cmsg), &departures[d], sizeof(uint64_t));
+		}
+	}
+	
+	sent = 0;
+	
+	while (sent < count) {
+	
+		ret = sendmmsg (krad_slicer->sd, krad_slicer->msgs + sent, count - sent, 0);
+		krad_slicer->syscalls++;
+		
+		if (ret < 1) {
+			krad_slicer_send_error (krad_slicer, count - sent);
+			return;
+		}
+		
+		sent += ret;
+		krad_slicer->sent += ret;
+	}
+}
+
+/* one sendmsg for a run of datagrams, the kernel cuts it back up every
+   KRAD_UDP_MAX_DATAGRAM_SIZE bytes, only the last may be shorter */
+static int krad_slicer_send_gso (krad_slicer_t *krad_slicer, int first, int count) {
+
+	int d;
 	int ret;
+	uint16_t segment_size;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(sizeof(uint16_t))];
+
+	for (d = 0; d < count; d++) {
+		krad_slicer->iovs[d].iov_base = krad_slicer->pending[first + d];
+		krad_slicer->iovs[d].iov_len = krad_slicer->pending_length[first + d];
+	}
+	
+	memset (&msg, 0, sizeof(msg));
+	memset (control, 0, sizeof(control));
+	msg.msg_name = &krad_slicer->remote_client;
+	msg.msg_namelen = sizeof(krad_slicer->remote_client);
+	msg.msg_iov = krad_slicer->iovs;
+	msg.msg_iovlen = count;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	
+	segment_size = KRAD_UDP_MAX_DATAGRAM_SIZE;
+	cmsg = CMSG_FIRSTHDR (&msg);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN (sizeof(uint16_t));
+	memcpy (CMSG_DATA (cmsg), &segment_size, sizeof(uint16_t));
+	
+	ret = sendmsg (krad_slicer->sd, &msg, 0);
+	krad_slicer->syscalls++;
+	
+	if (ret < 0) {
+		if ((errno == EINVAL) || (errno == EIO) || (errno == ENOPROTOOPT) || (errno == EOPNOTSUPP)) {
+			printk ("Krad UDP: kernel won't segment for us (%s), sending datagrams one by one", strerror(errno));
+			krad_slicer->gso = 0;
+			return -1;
+		}
+		krad_slicer_send_error (krad_slicer, count);
+		return 0;
+	}
+	
+	krad_slicer->sent += count;
+	
+	return 0;
+}
+
+static void krad_slicer_flush (krad_slicer_t *krad_slicer) {
+
+	int d;
+	int run;
+	int singles;
+	
+	d = 0;
+	singles = 0;
+	
+	while (d < krad_slicer->pending_count) {
+	
+		run = 0;
+		
+		if (krad_slicer->gso) {
+			while ((d + run < krad_slicer->pending_count) && (run < KRAD_UDP_GSO_SEGMENTS) &&
+				   (krad_slicer->pending_gso[d + run])) {
+				run++;
+				if (krad_slicer->pending_length[d + run - 1] != KRAD_UDP_MAX_DATAGRAM_SIZE) {
+					break;
+				}
+			}
+		}
+		
+		if (run < 2) {
+			singles++;
+			d++;
+			continue;
+		}
+		
+		// keep the order on the wire
+		if (singles) {
+			krad_slicer_sendmmsg (krad_slicer, d - singles, singles, NULL);
+			singles = 0;
+		}
+		
+		if (krad_slicer_send_gso (krad_slicer, d, run) < 0) {
+			singles += run;
+		}
+		
+		d += run;
+	}
+	
+	if (singles) {
+		krad_slicer_sendmmsg (krad_slicer, d - singles, singles, NULL);
+	}
+
+	krad_slicer->pending_count = 0;
+
+}
+
+static void krad_slicer_queue (krad_slicer_t *krad_slicer, unsigned char *data, int length, int gso) {
+
+	if (krad_slicer->pending_count == KRAD_UDP_BATCH) {
+		krad_slicer_flush (krad_slicer);
+	}
+	
+	krad_slicer->pending[krad_slicer->pending_count] = data;
+	krad_slicer->pending_length[krad_slicer->pending_count] = length;
+	krad_slicer->pending_gso[krad_slicer->pending_count] = gso;
+	krad_slicer->pending_count++;
+
+}
+
+static void krad_slicer_pace_queue (krad_slicer_t *krad_slicer, unsigned char *data, int length, uint64_t rate) {
+
+	int slot;
+	
+	slot = (krad_slicer->pace_read + krad_slicer->pace_count) % KRAD_UDP_PACE_QUEUE;
+
+	krad_slicer->pace_data[slot] = data;
+	krad_slicer->pace_length[slot] = length;
+	krad_slicer->pace_datagram_rate[slot] = rate;
+	krad_slicer->pace_count++;
+	krad_slicer->pace_queued_ns += (uint64_t)length * 1000000000 / rate;
+
+}
+
+int krad_slicer_service (krad_slicer_t *krad_slicer) {
+
+	int d;
+	int length;
+	uint64_t now;
+	uint64_t rate;
+	uint64_t departure;
+	
+	while (krad_slicer->pace_count) {
+	
+		now = krad_udp_now_ns ();
+		d = 0;
+		
+		while ((krad_slicer->pace_count) && (d < KRAD_UDP_BATCH)) {
+		
+			length = krad_slicer->pace_length[krad_slicer->pace_read];
+			rate = krad_slicer->pace_datagram_rate[krad_slicer->pace_read];
+			departure = krad_slicer_pace_departure (krad_slicer, now, rate);
+			
+			// with txtime everything goes to the kernel stamped, otherwise only what is due
+			if ((!krad_slicer->txtime) && (departure > now)) {
+				break;
+			}
+			
+			krad_slicer->pending[d] = krad_slicer->pace_data[krad_slicer->pace_read];
+			krad_slicer->pending_length[d] = length;
+			krad_slicer->pending_departure[d] = departure;
+			d++;
+			
+			krad_slicer->pace_next_ns = departure + (uint64_t)length * 1000000000 / rate;
+			krad_slicer->pace_queued_ns -= (uint64_t)length * 1000000000 / rate;
+			krad_slicer->pace_read = (krad_slicer->pace_read + 1) % KRAD_UDP_PACE_QUEUE;
+			krad_slicer->pace_count--;
+		}
+		
+		if (d == 0) {
+			break;
+		}
+		
+		if (krad_slicer->txtime) {
+			krad_slicer_sendmmsg (krad_slicer, 0, d, krad_slicer->pending_departure);
+		} else {
+			krad_slicer_sendmmsg (krad_slicer, 0, d, NULL);
+		}
+	}
+	
+	if (krad_slicer->pace_count == 0) {
+		krad_slicer->pace_queued_ns = 0;
+		return -1;
+	}
+	
+	now = krad_udp_now_ns ();
+	
+	if (krad_slicer->pace_next_ns <= now) {
+		return 0;
+	}
+	
+	// the next datagram is not due yet, so the pacer is holding it back
+	krad_slicer->pace_waits++;
+	
+	return (krad_slicer->pace_next_ns - now) / 1000;
+
+}
+
+void krad_slicer_drain (krad_slicer_t *krad_slicer) {
+
+	int wait_us;
+
+	while ((wait_us = krad_slicer_service (krad_slicer)) >= 0) {
+		usleep (wait_us + 1);
+	}
+
+}
+
+static void krad_slicer_fec_add (krad_slicer_t *krad_slicer, krad_slicer_track_t *slicer_track,
+								 int track, unsigned char *data, int length, uint32_t index, uint64_t rate) {
+
+	int b;
+	krad_udp_datagram_t *fec;
+
+	if (slicer_track->fec_count == 0) {
+		memset (slicer_track->fec_parity, 0, sizeof(slicer_track->fec_parity));
+		slicer_track->fec_length_xor = 0;
+		slicer_track->fec_max_length = 0;
+		slicer_track->fec_first = index;
+	}
+	
+	for (b = 0; b < length; b++) {
+		slicer_track->fec_parity[b] ^= data[b];
+	}
+	
+	slicer_track->fec_length_xor ^= length;
+	
+	if (length > slicer_track->fec_max_length) {
+		slicer_track->fec_max_length = length;
+	}
+	
+	slicer_track->fec_count++;
+	
+	if (slicer_track->fec_count < krad_slicer->fec_group) {
+		return;
+	}
+	
+	if (krad_slicer->pending_count == KRAD_UDP_BATCH) {
+		krad_slicer_flush (krad_slicer);
+	}
+	
+	fec = &krad_slicer->fec_out[krad_slicer->fec_out_next];
+	krad_slicer->fec_out_next = (krad_slicer->fec_out_next + 1) % KRAD_UDP_PACE_QUEUE;
+	
+	// the FEC header carries first index|group size|xor of the datagram lengths
+	krad_udp_write_header (fec->data, KRAD_UDP_FEC, track, slicer_track->fec_first,
+						   slicer_track->fec_count, slicer_track->fec_length_xor, 0);
+	memcpy (fec->data + KRAD_UDP_HEADER_SIZE, slicer_track->fec_parity, slicer_track->fec_max_length);
+	fec->length = KRAD_UDP_HEADER_SIZE + slicer_track->fec_max_length;
+	
+	if (rate) {
+		krad_slicer_pace_queue (krad_slicer, fec->data, fec->length, rate);
+	} else {
+		krad_slicer_queue (krad_slicer, fec->data, fec->length, 0);
+	}
+	krad_slicer->fec_sent++;
+	
+	slicer_track->fec_count = 0;
+
+}
+
+int krad_slicer_sendto (krad_slicer_t *krad_slicer, unsigned char *data, int size, int track, char *ip, int port) {
+
 	int remaining;
 	int payload_size;
 	int packet_size;
 	int sent;
-	int packet;
-	struct sockaddr_in remote_client;
+	int datagrams;
+	uint64_t now;
+	uint64_t rate;
+	uint64_t backlog_ns;
+	krad_slicer_track_t *slicer_track;
+	krad_udp_datagram_t *datagram;
 		
-	ret = 0;
 	sent = 0;
 	payload_size = 0;
 	packet_size = 0;
-	packet = 0;
 	remaining = size;
 
-	memset((char *) &remote_client, 0, sizeof(remote_client));
-	remote_client.sin_port = htons(port);
-	remote_client.sin_family = AF_INET;
+	if ((track < 0) || (track >= KRAD_UDP_MAX_TRACKS) || (size < 1) || (size > KRAD_UDP_MAX_SLICE_SIZE)) {
+		printke ("Krad UDP: can't send %d bytes on track %d", size, track);
+		return -1;
+	}
+
+	if ((krad_slicer->port != port) || (strncmp (krad_slicer->ip, ip, sizeof(krad_slicer->ip)) != 0)) {
+
+		memset((char *) &krad_slicer->remote_client, 0, sizeof(krad_slicer->remote_client));
+		krad_slicer->remote_client.sin_port = htons(port);
+		krad_slicer->remote_client.sin_family = AF_INET;
 	
-	if (inet_pton(remote_client.sin_family, ip, &(remote_client.sin_addr)) != 1) {
-		failfast ("inet_pton() failed");
+		if (inet_pton(krad_slicer->remote_client.sin_family, ip, &(krad_slicer->remote_client.sin_addr)) != 1) {
+			printke ("Krad UDP: inet_pton() failed for %s", ip);
+			krad_slicer->port = 0;
+			return -1;
+		}
+		
+		strncpy (krad_slicer->ip, ip, sizeof(krad_slicer->ip) - 1);
+		krad_slicer->port = port;
+	}
+	
+	now = krad_udp_now_ns ();
+	backlog_ns = krad_slicer->pace_queued_ns;
+	if (krad_slicer->pace_next_ns > now) {
+		backlog_ns += krad_slicer->pace_next_ns - now;
 	}
 
-	while (remaining) {
+	rate = krad_slicer_pace_rate (krad_slicer, size, backlog_ns);
+	
+	if (rate) {
+	
+		backlog_ns += (uint64_t)size * 1000000000 / rate;
+		krad_slicer->backlog_ms = backlog_ns / 1000000;
+	
+		/* Dropping here rather than after queueing means the receiver
+		   never waits on a slice that is not coming, it only hears
+		   about the ones we could get out in time. */
+		datagrams = (size + KRAD_UDP_MAX_PAYOAD_SIZE - 1) / KRAD_UDP_MAX_PAYOAD_SIZE;
+		if (krad_slicer->fec_group) {
+			datagrams += datagrams / krad_slicer->fec_group + 1;
+		}
 		
-		packet++;
+		if ((krad_slicer->backlog_ms > krad_slicer->pace_max_delay_ms) ||
+			(krad_slicer->pace_count + datagrams > KRAD_UDP_PACE_QUEUE)) {
+			krad_slicer->paced_dropped++;
+			if ((krad_slicer->paced_dropped % 100) == 1) {
+				printk ("Krad UDP: pacer %dms behind, dropped %"PRIu64" slices so far",
+						krad_slicer->backlog_ms, krad_slicer->paced_dropped);
+			}
+			krad_slicer_service (krad_slicer);
+			return 0;
+		}
+		
+		if (krad_slicer->backlog_ms > krad_slicer->backlog_peak_ms) {
+			krad_slicer->backlog_peak_ms = krad_slicer->backlog_ms;
+		}
+	}
+	
+	slicer_track = &krad_slicer->tracks[track];
+	
+	if (slicer_track->history == NULL) {
+		slicer_track->history = calloc (KRAD_UDP_SEND_HISTORY, sizeof(krad_udp_datagram_t));
+	}
+
+	while (remaining) {
 	
 		if (remaining > KRAD_UDP_MAX_PAYOAD_SIZE) {
 			payload_size = KRAD_UDP_MAX_PAYOAD_SIZE;
@@ -60,48 +596,118 @@ void krad_slicer_sendto (krad_slicer_t *krad_slicer, unsigned char *data, int si
 		remaining -= payload_size;
 		packet_size = payload_size + KRAD_UDP_HEADER_SIZE;
 		
-		// header|track number|sequence number|start_byte|total_bytes
-		memcpy (krad_slicer->data + 3, &track, 4);
-		memcpy (krad_slicer->data + 7, &krad_slicer->track_seq[track], 4);
-		memcpy (krad_slicer->data + 11, &sent, 4);
-		memcpy (krad_slicer->data + 15, &size, 4);
-
-		memcpy (krad_slicer->data + 19, data + sent, payload_size);
+		/* The history slot is the only copy made, it is what gets sent and
+		   what NACKs are answered from. It stays put until the batch goes
+		   out since the history is deeper than a batch. */
+		
+		datagram = &slicer_track->history[slicer_track->index & (KRAD_UDP_SEND_HISTORY - 1)];
+		
+		krad_udp_write_header (datagram->data, KRAD_UDP_DATA, track, slicer_track->seq, sent, size, slicer_track->index);
+		memcpy (datagram->data + KRAD_UDP_HEADER_SIZE, data + sent, payload_size);
+		datagram->length = packet_size;
+		datagram->index = slicer_track->index;
 
-		//printk("track: %d slice: %d size: %d packet: %d range: %d - %d packet size: %d payload size: %d\n", 
-		//		track, krad_slicer->track_seq[track], size, packet, sent, sent + payload_size - 1, packet_size, payload_size);
+		//printk("track: %d slice: %u size: %d range: %d - %d packet size: %d payload size: %d\n", 
+		//		track, slicer_track->seq, size, sent, sent + payload_size - 1, packet_size, payload_size);
 		
-		ret = sendto(krad_slicer->sd, krad_slicer->data, packet_size, 0, 
-					 (struct sockaddr *) &remote_client, sizeof(remote_client));
+		if (rate) {
+			krad_slicer_pace_queue (krad_slicer, datagram->data, packet_size, rate);
+		} else {
+			krad_slicer_queue (krad_slicer, datagram->data, packet_size, 1);
+		}
 		
-		if (ret != packet_size) {
-			failfast ("udp sending error");
+		if (krad_slicer->fec_group) {
+			krad_slicer_fec_add (krad_slicer, slicer_track, track, datagram->data, packet_size,
+								 slicer_track->index, rate);
 		}
 		
+		slicer_track->index++;
 		sent += payload_size;
-	}	
+	}
+
+	if (rate) {
+		krad_slicer_service (krad_slicer);
+	} else {
+		krad_slicer_flush (krad_slicer);
+	}
+
+	slicer_track->seq++;
+	
+	return 0;
+
+}
+
+void krad_slicer_service_nacks (krad_slicer_t *krad_slicer) {
+
+	int ret;
+	int n;
+	int track;
+	int count;
+	int total;
+	uint32_t first;
+	uint32_t index;
+	uint32_t seq;
+	uint32_t ms;
+	unsigned char nack[KRAD_UDP_HEADER_SIZE + 16];
+	krad_udp_datagram_t *datagram;
 
-	krad_slicer->track_seq[track]++;
+	while (1) {
 
+		ret = recv (krad_slicer->sd, nack, sizeof(nack), MSG_DONTWAIT);
+	
+		if (ret < 0) {
+			break;
+		}
+		
+		if ((ret < KRAD_UDP_HEADER_SIZE) || (memcmp (nack, "KQN", 3) != 0) || (nack[3] != KRAD_UDP_NACK)) {
+			continue;
+		}
+		
+		// NACK carries first missing index|count
+		krad_udp_read_header (nack, &track, &first, &count, &total, &index, &ms);
+		
+		if ((track < 0) || (track >= KRAD_UDP_MAX_TRACKS) || (krad_slicer->tracks[track].history == NULL) ||
+			(count < 1) || (count > KRAD_UDP_MAX_NACK_RANGE)) {
+			continue;
+		}
+		
+		krad_slicer->nacks_received++;
+		
+		for (n = 0; n < count; n++) {
+			seq = first + n;
+			datagram = &krad_slicer->tracks[track].history[seq & (KRAD_UDP_SEND_HISTORY - 1)];
+			if ((datagram->length > 0) && (datagram->index == seq)) {
+				krad_slicer_queue (krad_slicer, datagram->data, datagram->length, 0);
+				krad_slicer->retransmitted++;
+			}
+		}
+	}
+	
+	// retransmits are few and late already, they skip the pacer
+	if (krad_slicer->pending_count) {
+		krad_slicer_flush (krad_slicer);
+	}
 }
 
+void krad_slicer_print_stats (krad_slicer_t *krad_slicer) {
 
+	printk ("Krad UDP: sent %"PRIu64" datagrams in %"PRIu64" syscalls fec %"PRIu64" nacks %"PRIu64" "
+			"retransmitted %"PRIu64" errors %"PRIu64" pacer backlog %dms peak %dms dropped %"PRIu64" waits %"PRIu64"",
+			krad_slicer->sent, krad_slicer->syscalls, krad_slicer->fec_sent, krad_slicer->nacks_received,
+			krad_slicer->retransmitted, krad_slicer->send_errors, krad_slicer->backlog_ms,
+			krad_slicer->backlog_peak_ms, krad_slicer->paced_dropped, krad_slicer->pace_waits);
+
+}
 
 
 krad_rebuilder_t *krad_rebuilder_create () {
 
 	krad_rebuilder_t *krad_rebuilder;
-	int s;
 	
 	krad_rebuilder = calloc(1, sizeof(krad_rebuilder_t));
 	
-	krad_rebuilder->slice_count = 10;
-	
-	krad_rebuilder->slices = calloc(krad_rebuilder->slice_count, sizeof(krad_slice_t));
-
-	for (s = 0; s < krad_rebuilder->slice_count; s++) {
-		krad_rebuilder->slices[s].data = malloc(500000);
-	}
+	krad_rebuilder->latency_ms = KRAD_UDP_DEFAULT_LATENCY_MS;
+	krad_rebuilder->nack = 1;
 
 	return krad_rebuilder;
 
@@ -109,112 +715,646 @@ krad_rebuilder_t *krad_rebuilder_create () {
 
 void krad_rebuilder_destroy (krad_rebuilder_t *krad_rebuilder) {
 
+	int t;
 	int s;
 	
-	for (s = 0; s < krad_rebuilder->slice_count; s++) {
-		free (krad_rebuilder->slices[s].data);
+	for (t = 0; t < KRAD_UDP_MAX_TRACKS; t++) {
+		for (s = 0; s < KRAD_UDP_SLICE_SLOTS; s++) {
+			if (krad_rebuilder->tracks[t].slices[s].data != NULL) {
+				free (krad_rebuilder->tracks[t].slices[s].data);
+			}
+		}
+		if (krad_rebuilder->tracks[t].history != NULL) {
+			free (krad_rebuilder->tracks[t].history);
+			free (krad_rebuilder->tracks[t].fec_history);
+		}
+	}
+
+	if (krad_rebuilder->recv_buffers != NULL) {
+		free (krad_rebuilder->recv_buffers);
+		free (krad_rebuilder->recv_msgs);
 	}
 
-	free (krad_rebuilder->slices);
 	free (krad_rebuilder);
 
 }
 
+void krad_rebuilder_set_latency (krad_rebuilder_t *krad_rebuilder, int latency_ms) {
+	if (latency_ms < 0) {
+		latency_ms = 0;
+	}
+	krad_rebuilder->latency_ms = latency_ms;
+}
 
+void krad_rebuilder_set_nack (krad_rebuilder_t *krad_rebuilder, int nack) {
+	krad_rebuilder->nack = nack;
+}
 
-void krad_rebuilder_write (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int length) {
+int krad_rebuilder_set_gro (krad_rebuilder_t *krad_rebuilder, int sd) {
+
+	int on;
+	
+	on = 1;
+	
+	if (krad_rebuilder->recv_buffers != NULL) {
+		// buffers are already sized for single datagrams
+		return -1;
+	}
+	
+	if (setsockopt (sd, SOL_UDP, UDP_GRO, &on, sizeof(on)) != 0) {
+		printk ("Krad UDP: no GRO on this kernel (%s)", strerror(errno));
+		return -1;
+	}
+	
+	krad_rebuilder->gro = 1;
+	
+	return 0;
+
+}
+
+static void krad_rebuilder_track_reset (krad_rebuilder_track_t *rebuilder_track) {
 
 	int s;
+	
+	for (s = 0; s < KRAD_UDP_SLICE_SLOTS; s++) {
+		rebuilder_track->slices[s].used = 0;
+	}
+	
+	memset (rebuilder_track->seen, 0, sizeof(rebuilder_track->seen));
+	
+	if (rebuilder_track->history != NULL) {
+		for (s = 0; s < KRAD_UDP_HISTORY; s++) {
+			rebuilder_track->history[s].length = 0;
+			rebuilder_track->fec_history[s].length = 0;
+		}
+	}
+	
+	rebuilder_track->started = 0;
+	rebuilder_track->have_index = 0;
+	rebuilder_track->have_transit = 0;
+
+}
+
+static int krad_rebuilder_seen (krad_rebuilder_track_t *rebuilder_track, uint32_t index) {
+
+	int slot;
+	
+	slot = index & (KRAD_UDP_INDEX_WINDOW - 1);
+	
+	return rebuilder_track->seen[slot] && (rebuilder_track->seen_index[slot] == index);
+
+}
+
+static void krad_rebuilder_queue_nack (krad_rebuilder_t *krad_rebuilder, int track, uint32_t first, int count) {
+
+	int next;
+	
+	next = (krad_rebuilder->nack_write + 1) % KRAD_UDP_NACK_QUEUE;
+	
+	if (next == krad_rebuilder->nack_read) {
+		// full, the oldest request is the least likely to still help
+		krad_rebuilder->nack_read = (krad_rebuilder->nack_read + 1) % KRAD_UDP_NACK_QUEUE;
+	}
+	
+	krad_rebuilder->nacks[krad_rebuilder->nack_write].track = track;
+	krad_rebuilder->nacks[krad_rebuilder->nack_write].first = first;
+	krad_rebuilder->nacks[krad_rebuilder->nack_write].count = count;
+	krad_rebuilder->nacks[krad_rebuilder->nack_write].queued_ms = krad_udp_now_ms ();
+	krad_rebuilder->nack_write = next;
+
+}
+
+static int krad_rebuilder_take_datagram (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int length,
+										 int recovered);
+
+static void krad_rebuilder_fec_recover (krad_rebuilder_t *krad_rebuilder, int track, uint32_t first) {
+
+	int b;
+	int g;
+	int group_size;
+	int missing;
+	int length_xor;
+	int parity_length;
+	int track_check;
+	uint32_t index;
+	uint32_t missing_index;
+	uint32_t seq;
+	uint32_t ms;
+	krad_rebuilder_track_t *rebuilder_track;
+	krad_udp_datagram_t *fec;
+	krad_udp_datagram_t *datagram;
+	unsigned char recovery[KRAD_UDP_MAX_DATAGRAM_SIZE];
+	
+	rebuilder_track = &krad_rebuilder->tracks[track];
+	fec = &rebuilder_track->fec_history[first & (KRAD_UDP_HISTORY - 1)];
+	
+	if ((fec->length == 0) || (fec->index != first)) {
+		return;
+	}
+	
+	krad_udp_read_header (fec->data, &track_check, &seq, &group_size, &length_xor, &index, &ms);
+	
+	missing = 0;
+	missing_index = 0;
+	
+	for (g = 0; g < group_size; g++) {
+		if (!krad_rebuilder_seen (rebuilder_track, first + g)) {
+			missing++;
+			missing_index = first + g;
+		}
+	}
+	
+	if (missing > 1) {
+		return;
+	}
+	
+	if (missing == 0) {
+		fec->length = 0;
+		return;
+	}
+	
+	parity_length = fec->length - KRAD_UDP_HEADER_SIZE;
+	memcpy (recovery, fec->data + KRAD_UDP_HEADER_SIZE, parity_length);
+	
+	for (g = 0; g < group_size; g++) {
+		index = first + g;
+		if (index == missing_index) {
+			continue;
+		}
+		datagram = &rebuilder_track->history[index & (KRAD_UDP_HISTORY - 1)];
+		if ((datagram->length == 0) || (datagram->index != index) || (datagram->length > parity_length)) {
+			return;
+		}
+		for (b = 0; b < datagram->length; b++) {
+			recovery[b] ^= datagram->data[b];
+		}
+		length_xor ^= datagram->length;
+	}
+	
+	fec->length = 0;
+	
+	if ((length_xor < KRAD_UDP_HEADER_SIZE) || (length_xor > parity_length)) {
+		return;
+	}
+	
+	if (krad_rebuilder_take_datagram (krad_rebuilder, recovery, length_xor, 1) == 0) {
+		rebuilder_track->recovered++;
+	}
+
+}
+
+static void krad_rebuilder_fec_check (krad_rebuilder_t *krad_rebuilder, int track, uint32_t index) {
+
+	int g;
+	uint32_t first;
+	krad_udp_datagram_t *fec;
+
+	// any FEC group we already hold that this datagram belongs to
+	for (g = 0; g < KRAD_UDP_MAX_FEC_GROUP; g++) {
+		first = index - g;
+		fec = &krad_rebuilder->tracks[track].fec_history[first & (KRAD_UDP_HISTORY - 1)];
+		if ((fec->length > 0) && (fec->index == first)) {
+			krad_rebuilder_fec_recover (krad_rebuilder, track, first);
+		}
+	}
+}
+
+static int krad_rebuilder_take_datagram (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int length,
+										 int recovered) {
+
 	int track;
-	int slice_num;
 	int slice_size;
 	int payload_size;
 	int payload_start;
+	int gap;
+	int slot;
+	int32_t distance;
+	int32_t transit;
+	int32_t transit_change;
+	uint32_t slice_num;
+	uint32_t index;
+	uint32_t ms;
+	uint32_t new_read_seq;
+	uint64_t now;
+	krad_rebuilder_track_t *rebuilder_track;
+	krad_slice_t *slice;
+	krad_udp_datagram_t *datagram;
 	
-	if (memcmp(data, "KQN", 3) != 0) {
-		failfast ("krad packet error!");
+	if ((memcmp (data, "KQN", 3) != 0) || (data[3] != KRAD_UDP_DATA)) {
+		krad_rebuilder->malformed++;
+		return -1;
 	}
-	
-	// header|track number|sequence number|start_byte|total_bytes
-	memcpy (&track, data + 3, 4);
-	memcpy (&slice_num, data + 7, 4);
-	memcpy (&payload_start, data + 11, 4);
-	memcpy (&slice_size, data + 15, 4);	
+
+	krad_udp_read_header (data, &track, &slice_num, &payload_start, &slice_size, &index, &ms);
 
 	payload_size = length - KRAD_UDP_HEADER_SIZE;
 	
-	//printf("packet size: %d track %d slice num %d slice size %d %s\n", length, track, slice_num, slice_size, data);
-
-	if (slice_num < krad_rebuilder->slice_position - 7) {
-		printk ("krad packet too damn old\n");
-		return;
+	if ((track < 0) || (track >= KRAD_UDP_MAX_TRACKS) || (slice_size < 1) || (slice_size > KRAD_UDP_MAX_SLICE_SIZE) ||
+		(payload_start < 0) || (payload_start > slice_size - payload_size)) {
+		krad_rebuilder->malformed++;
+		return -1;
 	}
 	
-	for (s = 0; s < krad_rebuilder->slice_count; s++) {
-		if (krad_rebuilder->slices[s].seq == slice_num) {
-			break;
+	//printf("packet size: %d track %d slice num %u slice size %d\n", length, track, slice_num, slice_size);
+	
+	rebuilder_track = &krad_rebuilder->tracks[track];
+	now = krad_udp_now_ms ();
+	
+	if (rebuilder_track->history == NULL) {
+		rebuilder_track->history = calloc (KRAD_UDP_HISTORY, sizeof(krad_udp_datagram_t));
+		rebuilder_track->fec_history = calloc (KRAD_UDP_HISTORY, sizeof(krad_udp_datagram_t));
+	}
+	
+	if ((rebuilder_track->have_index) && ((int32_t)(rebuilder_track->highest_index - index) > KRAD_UDP_INDEX_WINDOW * 4)) {
+		printk ("Krad UDP: track %d went back %u datagrams, sender restarted?", track, rebuilder_track->highest_index - index);
+		krad_rebuilder_track_reset (rebuilder_track);
+	}
+	
+	if (krad_rebuilder_seen (rebuilder_track, index)) {
+		rebuilder_track->duplicates++;
+		return 0;
+	}
+	
+	if ((rebuilder_track->have_index) && ((int32_t)(rebuilder_track->highest_index - index) >= KRAD_UDP_INDEX_WINDOW)) {
+		rebuilder_track->late++;
+		return 0;
+	}
+	
+	slot = index & (KRAD_UDP_INDEX_WINDOW - 1);
+	rebuilder_track->seen[slot] = 1;
+	rebuilder_track->seen_index[slot] = index;
+	
+	if (!rebuilder_track->have_index) {
+		rebuilder_track->highest_index = index;
+		rebuilder_track->have_index = 1;
+	} else {
+		if ((int32_t)(index - rebuilder_track->highest_index) > 0) {
+			gap = index - rebuilder_track->highest_index - 1;
+			if ((gap > 0) && (krad_rebuilder->nack)) {
+				if (gap > KRAD_UDP_MAX_NACK_RANGE) {
+					krad_rebuilder_queue_nack (krad_rebuilder, track, index - KRAD_UDP_MAX_NACK_RANGE, KRAD_UDP_MAX_NACK_RANGE);
+				} else {
+					krad_rebuilder_queue_nack (krad_rebuilder, track, rebuilder_track->highest_index + 1, gap);
+				}
+			}
+			rebuilder_track->highest_index = index;
+		}
+	}
+	
+	datagram = &rebuilder_track->history[index & (KRAD_UDP_HISTORY - 1)];
+	memcpy (datagram->data, data, length);
+	datagram->length = length;
+	datagram->index = index;
+	
+	if (!recovered) {
+		transit = (uint32_t)now - ms;
+		if (rebuilder_track->have_transit) {
+			transit_change = transit - rebuilder_track->last_transit;
+			if (transit_change < 0) {
+				transit_change = -transit_change;
+			}
+			rebuilder_track->jitter_ms += ((double)transit_change - rebuilder_track->jitter_ms) / 16.0;
 		}
+		rebuilder_track->last_transit = transit;
+		rebuilder_track->have_transit = 1;
 	}
 
+	rebuilder_track->received++;
 	
-	if ((s == krad_rebuilder->slice_count) || (slice_num == 0)) {
-		for (s = 0; s < krad_rebuilder->slice_count; s++) {
-			if ((krad_rebuilder->slices[s].seq == 0) || 
-			    (krad_rebuilder->slices[s].seq < krad_rebuilder->slice_position - (krad_rebuilder->slice_count - 2))) {
-			    krad_rebuilder->slices[s].size = slice_size;
-			    krad_rebuilder->slices[s].fill = 0;
-			    krad_rebuilder->slices[s].seq = slice_num;
-				break;
+	if (!rebuilder_track->started) {
+		rebuilder_track->read_seq = slice_num;
+		rebuilder_track->started = 1;
+	}
+	
+	distance = slice_num - rebuilder_track->read_seq;
+	
+	if (distance < 0) {
+		rebuilder_track->late++;
+		krad_rebuilder_fec_check (krad_rebuilder, track, index);
+		return 0;
+	}
+	
+	if (distance >= KRAD_UDP_SLICE_SLOTS) {
+		// so far ahead the slots wrap, whatever we were waiting on is gone
+		new_read_seq = slice_num - KRAD_UDP_SLICE_SLOTS + 1;
+		for (slot = 0; slot < KRAD_UDP_SLICE_SLOTS; slot++) {
+			if ((rebuilder_track->slices[slot].used) &&
+			    ((int32_t)(rebuilder_track->slices[slot].seq - new_read_seq) < 0)) {
+				rebuilder_track->slices[slot].used = 0;
 			}
 		}
+		rebuilder_track->lost += new_read_seq - rebuilder_track->read_seq;
+		rebuilder_track->read_seq = new_read_seq;
 	}
 	
-	if (slice_size != krad_rebuilder->slices[s].size) {
-		failfast("krad packet error2! %d", s);
+	slice = &rebuilder_track->slices[slice_num & (KRAD_UDP_SLICE_SLOTS - 1)];
+	
+	if ((!slice->used) || (slice->seq != slice_num)) {
+		if (slice->allocated < slice_size) {
+			free (slice->data);
+			slice->data = malloc (slice_size);
+			slice->allocated = slice_size;
+		}
+		slice->used = 1;
+		slice->seq = slice_num;
+		slice->size = slice_size;
+		slice->fill = 0;
+		slice->arrived_ms = now;
+	} else {
+		if (slice->size != slice_size) {
+			krad_rebuilder->malformed++;
+			return -1;
+		}
 	}
 	
-	memcpy (krad_rebuilder->slices[s].data + payload_start, data + KRAD_UDP_HEADER_SIZE, payload_size);
-	krad_rebuilder->slices[s].fill += payload_size;
-
+	memcpy (slice->data + payload_start, data + KRAD_UDP_HEADER_SIZE, payload_size);
+	slice->fill += payload_size;
+	
 	/*
-	if (krad_rebuilder->slices[s].fill == krad_rebuilder->slices[s].size) {
-		printkd("slice %d recieved %d bytes\n", krad_rebuilder->slices[s].seq, krad_rebuilder->slices[s].size);
+	if (slice->fill == slice->size) {
+		printkd("slice %u recieved %d bytes\n", slice->seq, slice->size);
 	}
 	*/
 
-	if (krad_rebuilder->slice_position < slice_num) {
-		krad_rebuilder->slice_position = slice_num;
-	}
+	krad_rebuilder_fec_check (krad_rebuilder, track, index);
+
+	return 0;
 }
 
+int krad_rebuilder_write (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int length) {
+
+	int track;
+	int group_size;
+	int length_xor;
+	uint32_t first;
+	uint32_t index;
+	uint32_t ms;
+	krad_rebuilder_track_t *rebuilder_track;
+	krad_udp_datagram_t *fec;
+	
+	if ((length < KRAD_UDP_HEADER_SIZE) || (length > KRAD_UDP_MAX_FEC_SIZE) ||
+		(memcmp (data, "KQN", 3) != 0)) {
+		krad_rebuilder->malformed++;
+		if ((krad_rebuilder->malformed == 1) || ((krad_rebuilder->malformed % 1000) == 0)) {
+			printke ("Krad UDP: dropped %"PRIu64" malformed packets", krad_rebuilder->malformed);
+		}
+		return -1;
+	}
+	
+	if (data[3] == KRAD_UDP_DATA) {
+		if (length > KRAD_UDP_MAX_DATAGRAM_SIZE) {
+			krad_rebuilder->malformed++;
+			return -1;
+		}
+		return krad_rebuilder_take_datagram (krad_rebuilder, data, length, 0);
+	}
+
+	if (data[3] == KRAD_UDP_FEC) {
+	
+		krad_udp_read_header (data, &track, &first, &group_size, &length_xor, &index, &ms);
+		
+		if ((track < 0) || (track >= KRAD_UDP_MAX_TRACKS) || (group_size < 2) ||
+			(group_size > KRAD_UDP_MAX_FEC_GROUP)) {
+			krad_rebuilder->malformed++;
+			return -1;
+		}
+		
+		rebuilder_track = &krad_rebuilder->tracks[track];
+		
+		if (rebuilder_track->history == NULL) {
+			// nothing to recover against yet
+			return 0;
+		}
+		
+		fec = &rebuilder_track->fec_history[first & (KRAD_UDP_HISTORY - 1)];
+		memcpy (fec->data, data, length);
+		fec->length = length;
+		fec->index = first;
+		
+		krad_rebuilder_fec_recover (krad_rebuilder, track, first);
+		
+		return 0;
+	}
+	
+	krad_rebuilder->malformed++;
+	return -1;
+
+}
 
 int krad_rebuilder_read_packet (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int track) {
 
 	int s;
+	int size;
+	uint64_t now;
+	uint64_t waiting_since;
+	krad_rebuilder_track_t *rebuilder_track;
+	krad_slice_t *slice;
 	
-	if (krad_rebuilder->slice_read_position < (krad_rebuilder->slice_position - 5)) {
-		printkd("fell behind and readjusted %d ", krad_rebuilder->slice_read_position);
-		krad_rebuilder->slice_read_position = krad_rebuilder->slice_position - 5;
-		printkd("%d\n", krad_rebuilder->slice_read_position);
+	if ((track < 0) || (track >= KRAD_UDP_MAX_TRACKS)) {
+		return 0;
 	}
-
-	for (s = 0; s < krad_rebuilder->slice_count; s++) {
-		if (krad_rebuilder->slices[s].seq == krad_rebuilder->slice_read_position) {
-			if (krad_rebuilder->slices[s].fill == krad_rebuilder->slices[s].size) {
-				break;
+	
+	rebuilder_track = &krad_rebuilder->tracks[track];
+	
+	if (!rebuilder_track->started) {
+		return 0;
+	}
+	
+	now = 0;
+	
+	while (1) {
+	
+		slice = &rebuilder_track->slices[rebuilder_track->read_seq & (KRAD_UDP_SLICE_SLOTS - 1)];
+		
+		if ((slice->used) && (slice->seq == rebuilder_track->read_seq) && (slice->fill >= slice->size)) {
+			size = slice->size;
+			memcpy (data, slice->data, size);
+			slice->used = 0;
+			rebuilder_track->read_seq++;
+			rebuilder_track->delivered++;
+			return size;
+		}
+		
+		/* Nothing to hand out yet. Once anything at or after the slice we
+		   want has sat in the buffer for the latency, give up on it. */
+		
+		waiting_since = 0;
+		
+		for (s = 0; s < KRAD_UDP_SLICE_SLOTS; s++) {
+			if ((rebuilder_track->slices[s].used) &&
+				((int32_t)(rebuilder_track->slices[s].seq - rebuilder_track->read_seq) >= 0)) {
+				if ((waiting_since == 0) || (rebuilder_track->slices[s].arrived_ms < waiting_since)) {
+					waiting_since = rebuilder_track->slices[s].arrived_ms;
+				}
 			}
 		}
+		
+		if (waiting_since == 0) {
+			return 0;
+		}
+		
+		if (now == 0) {
+			now = krad_udp_now_ms ();
+		}
+		
+		if (now < waiting_since + krad_rebuilder->latency_ms) {
+			return 0;
+		}
+		
+		if ((slice->used) && (slice->seq == rebuilder_track->read_seq)) {
+			slice->used = 0;
+		}
+		
+		rebuilder_track->lost++;
+		rebuilder_track->read_seq++;
 	}
+}
 
-	if (s == krad_rebuilder->slice_count) {
-		return 0;
+int krad_rebuilder_get_nack (krad_rebuilder_t *krad_rebuilder, unsigned char *data) {
+
+	int track;
+	uint32_t first;
+	int count;
+	krad_udp_nack_t *nack;
+	krad_rebuilder_track_t *rebuilder_track;
+
+	while (krad_rebuilder->nack_read != krad_rebuilder->nack_write) {
+	
+		nack = &krad_rebuilder->nacks[krad_rebuilder->nack_read];
+		
+		if (krad_udp_now_ms () < nack->queued_ms + KRAD_UDP_NACK_HOLDOFF_MS) {
+			return 0;
+		}
+	
+		track = nack->track;
+		first = nack->first;
+		count = nack->count;
+		krad_rebuilder->nack_read = (krad_rebuilder->nack_read + 1) % KRAD_UDP_NACK_QUEUE;
+		
+		rebuilder_track = &krad_rebuilder->tracks[track];
+		
+		// anything that turned up late or got rebuilt from FEC meanwhile
+		while ((count > 0) && (krad_rebuilder_seen (rebuilder_track, first))) {
+			first++;
+			count--;
+		}
+		
+		while ((count > 0) && (krad_rebuilder_seen (rebuilder_track, first + count - 1))) {
+			count--;
+		}
+		
+		if (count == 0) {
+			continue;
+		}
+		
+		krad_udp_write_header (data, KRAD_UDP_NACK, track, first, count, 0, 0);
+		krad_rebuilder->nacks_sent++;
+		
+		return KRAD_UDP_HEADER_SIZE;
 	}
+	
+	return 0;
+
+}
 
-	memcpy (data, krad_rebuilder->slices[s].data, krad_rebuilder->slices[s].size);
+void krad_rebuilder_print_stats (krad_rebuilder_t *krad_rebuilder, int track) {
 
-	krad_rebuilder->slice_read_position++;
+	krad_rebuilder_track_t *rebuilder_track;
+
+	if ((track < 0) || (track >= KRAD_UDP_MAX_TRACKS)) {
+		return;
+	}
+	
+	rebuilder_track = &krad_rebuilder->tracks[track];
 
-	return krad_rebuilder->slices[s].size;
+	printk ("Krad UDP: track %d received %"PRIu64" delivered %"PRIu64" lost %"PRIu64" late %"PRIu64" "
+			"duplicates %"PRIu64" recovered %"PRIu64" nacks %"PRIu64" malformed %"PRIu64" jitter %.1fms",
+			track, rebuilder_track->received, rebuilder_track->delivered, rebuilder_track->lost,
+			rebuilder_track->late, rebuilder_track->duplicates, rebuilder_track->recovered,
+			krad_rebuilder->nacks_sent, krad_rebuilder->malformed, rebuilder_track->jitter_ms);
 
 }
 
+int krad_rebuilder_recv (krad_rebuilder_t *krad_rebuilder, int sd, struct sockaddr_in *from) {
+
+	int m;
+	int ret;
+	int offset;
+	int length;
+	int segment_size;
+	int datagrams;
+	struct msghdr *msg;
+	struct cmsghdr *cmsg;
+	
+	if (krad_rebuilder->recv_buffers == NULL) {
+		if (krad_rebuilder->gro) {
+			krad_rebuilder->recv_buffer_size = KRAD_UDP_GRO_BUFFER_SIZE;
+		} else {
+			krad_rebuilder->recv_buffer_size = KRAD_UDP_RECV_BUFFER_SIZE;
+		}
+		krad_rebuilder->recv_buffers = malloc (KRAD_UDP_RECV_BATCH * krad_rebuilder->recv_buffer_size);
+		krad_rebuilder->recv_msgs = calloc (KRAD_UDP_RECV_BATCH, sizeof(struct mmsghdr));
+	}
+	
+	for (m = 0; m < KRAD_UDP_RECV_BATCH; m++) {
+		krad_rebuilder->recv_iovs[m].iov_base = krad_rebuilder->recv_buffers + m * krad_rebuilder->recv_buffer_size;
+		krad_rebuilder->recv_iovs[m].iov_len = krad_rebuilder->recv_buffer_size;
+		msg = &krad_rebuilder->recv_msgs[m].msg_hdr;
+		memset (msg, 0, sizeof(struct msghdr));
+		msg->msg_name = &krad_rebuilder->recv_addresses[m];
+		msg->msg_namelen = sizeof(struct sockaddr_in);
+		msg->msg_iov = &krad_rebuilder->recv_iovs[m];
+		msg->msg_iovlen = 1;
+		if (krad_rebuilder->gro) {
+			msg->msg_control = krad_rebuilder->recv_control[m];
+			msg->msg_controllen = sizeof(krad_rebuilder->recv_control[m]);
+		}
+	}
+	
+	ret = recvmmsg (sd, krad_rebuilder->recv_msgs, KRAD_UDP_RECV_BATCH, MSG_DONTWAIT, NULL);
+	krad_rebuilder->syscalls++;
+	
+	if (ret < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+			return 0;
+		}
+		return -1;
+	}
+	
+	datagrams = 0;
+	
+	for (m = 0; m < ret; m++) {
+	
+		msg = &krad_rebuilder->recv_msgs[m].msg_hdr;
+		length = krad_rebuilder->recv_msgs[m].msg_len;
+		segment_size = length;
+	
+		if (krad_rebuilder->gro) {
+			for (cmsg = CMSG_FIRSTHDR (msg); cmsg != NULL; cmsg = CMSG_NXTHDR (msg, cmsg)) {
+				if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+					memcpy (&segment_size, CMSG_DATA (cmsg), sizeof(int));
+				}
+			}
+			if (segment_size < 1) {
+				segment_size = length;
+			}
+		}
+		
+		// a coalesced read is back to back datagrams of segment_size, the last may be short
+		for (offset = 0; offset < length; offset += segment_size) {
+			if (length - offset < segment_size) {
+				krad_rebuilder_write (krad_rebuilder, (unsigned char *)krad_rebuilder->recv_iovs[m].iov_base + offset, length - offset);
+			} else {
+				krad_rebuilder_write (krad_rebuilder, (unsigned char *)krad_rebuilder->recv_iovs[m].iov_base + offset, segment_size);
+			}
+			datagrams++;
+		}
+		
+		if (from != NULL) {
+			memcpy (from, &krad_rebuilder->recv_addresses[m], sizeof(struct sockaddr_in));
+		}
+	}
+	
+	return datagrams;
+
+}
@@ -17,18 +17,84 @@
 #include <sys/socket.h>
 #include <ifaddrs.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/net_tstamp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <poll.h>
 
 #include "krad_system.h"
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+
 typedef struct krad_slice_St krad_slice_t;
+typedef struct krad_udp_datagram_St krad_udp_datagram_t;
+typedef struct krad_udp_nack_St krad_udp_nack_t;
+typedef struct krad_slicer_track_St krad_slicer_track_t;
 typedef struct krad_slicer_St krad_slicer_t;
+typedef struct krad_rebuilder_track_St krad_rebuilder_track_t;
 typedef struct krad_rebuilder_St krad_rebuilder_t;
 
+#ifndef KRAD_UDP_H
+#define KRAD_UDP_H
+
+/* Every datagram is:
+
+   "KQN"|type|track|slice seq|start byte|slice bytes|datagram index|send ms
+
+   A slice is one codec packet, split over as many datagrams as it takes.
+   The datagram index counts every data datagram sent on a track, it is
+   what FEC groups and NACKs refer to. */
+
 #define KRAD_UDP_MAX_PAYOAD_SIZE 1300
-#define KRAD_UDP_HEADER_SIZE 19
+#define KRAD_UDP_HEADER_SIZE 28
+#define KRAD_UDP_MAX_DATAGRAM_SIZE (KRAD_UDP_HEADER_SIZE + KRAD_UDP_MAX_PAYOAD_SIZE)
+/* parity covers whole data datagrams, so it is a header longer */
+#define KRAD_UDP_MAX_FEC_SIZE (KRAD_UDP_HEADER_SIZE + KRAD_UDP_MAX_DATAGRAM_SIZE)
+#define KRAD_UDP_MAX_SLICE_SIZE 500000
+#define KRAD_UDP_MAX_TRACKS 4
+
+/* slices in flight per track, power of two */
+#define KRAD_UDP_SLICE_SLOTS 64
+/* datagrams remembered per track for duplicate checks and NACKs, power of two */
+#define KRAD_UDP_INDEX_WINDOW 1024
+/* datagrams kept around for FEC recovery and retransmit, power of two */
+#define KRAD_UDP_HISTORY 256
+/* the sender's history also backs the pacer queue, so it is deeper */
+#define KRAD_UDP_SEND_HISTORY 512
+/* leaves the last 64 datagrams sent around to answer NACKs from */
+#define KRAD_UDP_PACE_QUEUE (KRAD_UDP_SEND_HISTORY - 64)
+#define KRAD_UDP_NACK_QUEUE 32
+#define KRAD_UDP_MAX_NACK_RANGE 64
+/* give reordered datagrams a moment to turn up before asking again */
+#define KRAD_UDP_NACK_HOLDOFF_MS 5
+#define KRAD_UDP_MAX_FEC_GROUP 32
+
+#define KRAD_UDP_DEFAULT_LATENCY_MS 60
+
+/* datagrams handed to the kernel per sendmmsg / taken per recvmmsg */
+#define KRAD_UDP_BATCH 64
+#define KRAD_UDP_RECV_BATCH 32
+/* full size datagrams per UDP_SEGMENT send, has to stay under 64KB */
+#define KRAD_UDP_GSO_SEGMENTS 44
+#define KRAD_UDP_GRO_BUFFER_SIZE 65536
+#define KRAD_UDP_RECV_BUFFER_SIZE 2048
+
+/* pacing: datagrams per sleep, and how far the bucket may fill while idle */
+#define KRAD_UDP_PACE_CHUNK 4
+#define KRAD_UDP_PACE_BURST_BYTES (KRAD_UDP_PACE_CHUNK * KRAD_UDP_MAX_DATAGRAM_SIZE)
+#define KRAD_UDP_DEFAULT_PACE_MAX_DELAY_MS 150
 
 typedef enum {
 	K_VP8 = 1,
@@ -36,44 +102,228 @@ typedef enum {
 	K_AUX,
 } krad_slice_track_type_t;
 
+typedef enum {
+	KRAD_UDP_DATA = 0,
+	KRAD_UDP_FEC,
+	KRAD_UDP_NACK,
+} krad_udp_packet_type_t;
+
+struct krad_udp_datagram_St {
+	uint32_t index;
+	int length;
+	unsigned char data[KRAD_UDP_MAX_FEC_SIZE];
+};
+
+struct krad_udp_nack_St {
+	int track;
+	uint32_t first;
+	int count;
+	uint64_t queued_ms;
+};
+
 struct krad_slice_St {
 	unsigned char *data;
+	int allocated;
 	int size;
 	int fill;
 	
-	int track;
+	int used;
+	uint32_t seq;
+	uint64_t arrived_ms;
+};
+
+struct krad_slicer_track_St {
+
 	uint32_t seq;
+	uint32_t index;
 	
+	krad_udp_datagram_t *history;
+
+	/* XOR of every datagram in the current group, padded to the longest */
+	unsigned char fec_parity[KRAD_UDP_MAX_DATAGRAM_SIZE];
+	int fec_length_xor;
+	int fec_max_length;
+	int fec_count;
+	uint32_t fec_first;
+
 };
 
 struct krad_slicer_St {
 
 	int sd;
 
-	unsigned char *data;
+	char ip[64];
+	int port;
+	struct sockaddr_in remote_client;
+
+	int fec_group;
+	int gso;
+
+	krad_slicer_track_t tracks[KRAD_UDP_MAX_TRACKS];
+
+	/* datagrams waiting for the next sendmmsg, they point into the
+	   track history or fec_out, nothing is copied again to send it */
+	unsigned char *pending[KRAD_UDP_BATCH];
+	int pending_length[KRAD_UDP_BATCH];
+	int pending_gso[KRAD_UDP_BATCH];
+	int pending_count;
+	
+	uint64_t pending_departure[KRAD_UDP_BATCH];
+	
+	/* ring, FEC datagrams wait here until sent, paced or not */
+	krad_udp_datagram_t *fec_out;
+	int fec_out_next;
+
+	/* allocated, mmsghdr needs _GNU_SOURCE and only krad_udp.c has it */
+	struct mmsghdr *msgs;
+	struct iovec iovs[KRAD_UDP_BATCH];
+	char control[KRAD_UDP_BATCH][CMSG_SPACE(sizeof(uint64_t))];
+
+	/* token bucket in front of the socket, see krad_slicer_set_pacing */
+	uint64_t pace_bytes_per_second;
+	int pace_spread_ms;
+	int pace_max_delay_ms;
+	uint64_t pace_next_ns;
+	int txtime;
 
-	int track_seq[3];
+	unsigned char *pace_data[KRAD_UDP_PACE_QUEUE];
+	int pace_length[KRAD_UDP_PACE_QUEUE];
+	uint64_t pace_datagram_rate[KRAD_UDP_PACE_QUEUE];
+	int pace_read;
+	int pace_count;
+	uint64_t pace_queued_ns;
+
+	uint64_t paced_dropped;
+	uint64_t pace_waits;
+	int backlog_ms;
+	int backlog_peak_ms;
+
+	uint64_t sent;
+	uint64_t syscalls;
+	uint64_t fec_sent;
+	uint64_t nacks_received;
+	uint64_t retransmitted;
+	uint64_t send_errors;
+
+};
+
+struct krad_rebuilder_track_St {
+
+	int started;
+	uint32_t read_seq;
+
+	krad_slice_t slices[KRAD_UDP_SLICE_SLOTS];
+
+	int have_index;
+	uint32_t highest_index;
+	uint32_t seen_index[KRAD_UDP_INDEX_WINDOW];
+	unsigned char seen[KRAD_UDP_INDEX_WINDOW];
+
+	krad_udp_datagram_t *history;
+	krad_udp_datagram_t *fec_history;
+
+	/* RFC 3550 style interarrival jitter, in ms */
+	int have_transit;
+	int64_t last_transit;
+	double jitter_ms;
+
+	uint64_t received;
+	uint64_t duplicates;
+	uint64_t late;
+	uint64_t lost;
+	uint64_t recovered;
+	uint64_t delivered;
 
 };
 
 struct krad_rebuilder_St {
 
-	krad_slice_t *slices;
-	
-	int slice_count;
-	int slice_position;
-	int slice_read_position;
+	int latency_ms;
+	int nack;
+
+	krad_rebuilder_track_t tracks[KRAD_UDP_MAX_TRACKS];
+
+	krad_udp_nack_t nacks[KRAD_UDP_NACK_QUEUE];
+	int nack_read;
+	int nack_write;
+
+	uint64_t malformed;
+	uint64_t nacks_sent;
+
+	int gro;
+	int recv_buffer_size;
+	unsigned char *recv_buffers;
+	struct mmsghdr *recv_msgs;
+	struct iovec recv_iovs[KRAD_UDP_RECV_BATCH];
+	struct sockaddr_in recv_addresses[KRAD_UDP_RECV_BATCH];
+	char recv_control[KRAD_UDP_RECV_BATCH][64];
+	uint64_t syscalls;
+
 };
 
+uint64_t krad_udp_now_ms ();
+
 krad_slicer_t *krad_slicer_create ();
 void krad_slicer_destroy (krad_slicer_t *krad_slicer);
 
-void krad_slicer_sendto (krad_slicer_t *krad_slicer, unsigned char *data, int size, int track, char *ip, int port);
+/* send one XOR parity datagram after every group_size data datagrams, 0 for none */
+void krad_slicer_set_fec_group (krad_slicer_t *krad_slicer, int group_size);
+
+/* let the kernel split runs of full size datagrams (UDP_SEGMENT), on by
+   default, it turns itself off if the kernel refuses */
+void krad_slicer_set_gso (krad_slicer_t *krad_slicer, int gso);
+
+int krad_slicer_sendto (krad_slicer_t *krad_slicer, unsigned char *data, int size, int track, char *ip, int port);
+
+/* Paces datagrams out instead of bursting them. kbps is a ceiling for
+   everything sent, spread_ms spreads each multi datagram slice over that
+   long (the frame interval, say). Either can be 0, both 0 turns pacing
+   off. Paced slices are queued by sendto and sent by krad_slicer_service,
+   a slice that would sit more than max_delay_ms in the queue is dropped
+   whole instead. With krad_slicer_set_txtime the kernel (fq qdisc) holds
+   each datagram back to its departure time and the queue empties at once. */
+void krad_slicer_set_pacing (krad_slicer_t *krad_slicer, int kbps, int spread_ms, int max_delay_ms);
+
+/* SO_TXTIME departure times instead of sleeping, returns 0 if the socket took it */
+int krad_slicer_set_txtime (krad_slicer_t *krad_slicer, int txtime);
+
+/* sends whatever the pacer has due, returns microseconds until more is due,
+   or -1 when the queue is empty */
+int krad_slicer_service (krad_slicer_t *krad_slicer);
+
+/* sleeps until the pacer queue is empty */
+void krad_slicer_drain (krad_slicer_t *krad_slicer);
 
+void krad_slicer_print_stats (krad_slicer_t *krad_slicer);
+
+/* answers any NACKs the receiver has sent back to us, never blocks */
+void krad_slicer_service_nacks (krad_slicer_t *krad_slicer);
 
 
 krad_rebuilder_t *krad_rebuilder_create ();
 void krad_rebuilder_destroy (krad_rebuilder_t *krad_rebuilder);
 
-void krad_rebuilder_write (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int length);
+/* how long a gap in a track is waited on before the missing slice is declared lost */
+void krad_rebuilder_set_latency (krad_rebuilder_t *krad_rebuilder, int latency_ms);
+void krad_rebuilder_set_nack (krad_rebuilder_t *krad_rebuilder, int nack);
+
+/* asks the kernel to coalesce datagrams (UDP_GRO) on sd, returns 0 if it will */
+int krad_rebuilder_set_gro (krad_rebuilder_t *krad_rebuilder, int sd);
+
+/* takes every datagram waiting on sd with recvmmsg, never blocks,
+   returns how many were written in, or -1 on a socket error.
+   from gets the address of the last sender if not NULL */
+int krad_rebuilder_recv (krad_rebuilder_t *krad_rebuilder, int sd, struct sockaddr_in *from);
+
+/* returns 0 if the datagram was taken, -1 if it was malformed and dropped */
+int krad_rebuilder_write (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int length);
+
+/* returns the size of the next slice for the track in order, 0 if there is none yet */
 int krad_rebuilder_read_packet (krad_rebuilder_t *krad_rebuilder, unsigned char *data, int track);
+
+/* builds the next NACK datagram to send back to the sender, returns its size or 0 */
+int krad_rebuilder_get_nack (krad_rebuilder_t *krad_rebuilder, unsigned char *data);
+
+void krad_rebuilder_print_stats (krad_rebuilder_t *krad_rebuilder, int track);
+
+#endif
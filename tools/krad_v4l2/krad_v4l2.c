@@ -7,6 +7,8 @@ krad_v4l2_t *kradv4l2_create() {
 
 	kradv4l2 = calloc(1, sizeof(krad_v4l2_t));
 
+	pthread_mutex_init (&kradv4l2->streaming_lock, NULL);
+
 	kradv4l2->jpeg_dec = tjInitDecompress();
 
 	kradv4l2->jpeg_buffer = calloc(1, 4200000);
@@ -19,6 +21,7 @@ void kradv4l2_destroy(krad_v4l2_t *kradv4l2) {
 
 	tjDestroy ( kradv4l2->jpeg_dec );
 	free ( kradv4l2->jpeg_buffer );
+	pthread_mutex_destroy (&kradv4l2->streaming_lock);
 	free ( kradv4l2 );
 
 }
@@ -28,6 +31,34 @@ void kradv4l2_frame_done (krad_v4l2_t *kradv4l2) {
 		errno_exit ("VIDIOC_QBUF");
 	}
 }
+
+/* Requeue a buffer by index, so more than one dequeued buffer can be out
+   at a time, ie. wrapped in frames or waiting to be decoded. Can be called
+   from any thread, after stop capturing the driver owns them all again. */
+
+void kradv4l2_buffer_done (krad_v4l2_t *kradv4l2, int index) {
+
+	struct v4l2_buffer buf;
+
+	pthread_mutex_lock (&kradv4l2->streaming_lock);
+
+	if (kradv4l2->streaming == 0) {
+		pthread_mutex_unlock (&kradv4l2->streaming_lock);
+		return;
+	}
+
+	CLEAR (buf);
+
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = index;
+
+	if (-1 == xioctl (kradv4l2->fd, VIDIOC_QBUF, &buf)) {
+		printke ("V4L2: VIDIOC_QBUF of buffer %d error %d, %s", index, errno, strerror (errno));
+	}
+
+	pthread_mutex_unlock (&kradv4l2->streaming_lock);
+}
 			
 char *kradv4l2_read_frame_adv (krad_v4l2_t *kradv4l2) {
 		
@@ -222,7 +253,10 @@ char *kradv4l2_read_frame_wait_adv (krad_v4l2_t *kradv4l2) {
 	}
 
     if (0 == r) {
-		failfast ("select timeout");
+		/* every buffer is held downstream or the device stalled, the caller
+		   tries again once some come back */
+		printke ("Krad V4L2: select timeout waiting on %s", kradv4l2->device);
+		return NULL;
     }
 
 	return kradv4l2_read_frame_adv (kradv4l2);
@@ -294,6 +328,10 @@ void kradv4l2_start_capturing (krad_v4l2_t *kradv4l2) {
 			errno_exit ("VIDIOC_STREAMON");
 		}
 		
+		pthread_mutex_lock (&kradv4l2->streaming_lock);
+		kradv4l2->streaming = 1;
+		pthread_mutex_unlock (&kradv4l2->streaming_lock);
+		
 		break;
 
 	case IO_METHOD_USERPTR:
@@ -338,11 +376,15 @@ void kradv4l2_stop_capturing (krad_v4l2_t *kradv4l2) {
 		
 		case IO_METHOD_USERPTR:
 		
+			pthread_mutex_lock (&kradv4l2->streaming_lock);
+			kradv4l2->streaming = 0;
+		
 			type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
 			if (-1 == xioctl (kradv4l2->fd, VIDIOC_STREAMOFF, &type)) {
 				errno_exit ("VIDIOC_STREAMOFF");
 			}
+			pthread_mutex_unlock (&kradv4l2->streaming_lock);
 
 			break;
 	}
@@ -358,6 +400,9 @@ void kradv4l2_uninit_device (krad_v4l2_t *kradv4l2) {
 			break;
 
 		case IO_METHOD_MMAP:
+			if (kradv4l2->keep_mapped) {
+				break;
+			}
 			for (i = 0; i < kradv4l2->n_buffers; ++i)
 				if (-1 == munmap (kradv4l2->buffers[i].start, kradv4l2->buffers[i].length))
 					errno_exit ("munmap");
@@ -411,7 +456,7 @@ void kradv4l2_init_mmap (krad_v4l2_t *kradv4l2) {
 		failfast ("Insufficient buffer memory on %s\n", kradv4l2->device);
 	}
 
-	failfast ("v4l2 says %d buffers", req.count);
+	printkd ("V4L2: %d buffers", req.count);
 
 	kradv4l2->buffers = calloc (req.count, sizeof (*kradv4l2->buffers));
 
@@ -892,3 +937,341 @@ int kradv4l2_mjpeg_to_jpeg (krad_v4l2_t *kradv4l2, unsigned char *jpeg_buffer, u
 	*/
 }
 
+
+
+/* Multithreaded MJPEG decoder */
+
+#define KRAD_V4L2_PAD(v, p) (((v) + (p) - 1) & (~((p) - 1)))
+
+static uint64_t kradv4l2_time_us () {
+
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* walk the markers up to the start of scan, v4l2 mjpeg leaves out the
+   huffman tables but recorded jpegs usually have them */
+
+static int kradv4l2_mjpeg_scan (unsigned char *buffer, unsigned int size, int *has_dht) {
+
+	unsigned int pos;
+	unsigned int len;
+	
+	*has_dht = 0;
+
+	if ((size < 4) || (buffer[0] != 0xFF) || (buffer[1] != 0xD8)) {
+		return 0;
+	}
+
+	pos = 2;
+
+	while (pos + 4 <= size) {
+		if (buffer[pos] != 0xFF) {
+			return 0;
+		}
+		if (buffer[pos + 1] == 0xDA) {
+			return 1;
+		}
+		if (buffer[pos + 1] == 0xC4) {
+			*has_dht = 1;
+		}
+		len = (buffer[pos + 2] << 8) | buffer[pos + 3];
+		pos += 2 + len;
+	}
+
+	return 0;
+}
+
+static void kradv4l2_mjpeg_decode_job (krad_v4l2_mjpeg_worker_t *worker, krad_v4l2_mjpeg_job_t *job) {
+
+	krad_v4l2_mjpeg_decoder_t *decoder;
+	unsigned char *jpeg;
+	unsigned long jpeg_size;
+	int has_dht;
+	int width;
+	int height;
+	int subsampling;
+	int chroma_width;
+	int chroma_height;
+	int plane_height;
+	int ret;
+
+	decoder = worker->decoder;
+
+	if (!kradv4l2_mjpeg_scan (job->mjpeg, job->mjpeg_size, &has_dht)) {
+		job->failed = 1;
+		return;
+	}
+	
+	if (has_dht) {
+		jpeg = job->mjpeg;
+		jpeg_size = job->mjpeg_size;
+	} else {
+		if (job->mjpeg_size + 1024 > KRAD_V4L2_JPEG_BUFFER_SIZE) {
+			job->failed = 1;
+			return;
+		}
+		jpeg_size = kradv4l2_mjpeg_to_jpeg (NULL, worker->jpeg_buffer, job->mjpeg, job->mjpeg_size);
+		jpeg = worker->jpeg_buffer;
+	}
+	
+	if (decoder->yuv == 0) {
+		ret = tjDecompress2 ( worker->jpeg_dec, jpeg, jpeg_size, job->argb, decoder->width, 
+							  decoder->width * 4, decoder->height, TJPF_BGRA, 0 );
+		if (ret != 0) {
+			printke ("JPEG decoding error: %s", tjGetErrorStr());
+			job->failed = 1;
+		}
+		return;
+	}
+
+	ret = tjDecompressHeader2 (worker->jpeg_dec, jpeg, jpeg_size, &width, &height, &subsampling);
+
+	if ((ret != 0) || (width != decoder->width) || (height != decoder->height) ||
+		((subsampling != TJSAMP_444) && (subsampling != TJSAMP_422) && (subsampling != TJSAMP_420))) {
+		printke ("JPEG header unusable for yuv decode: %dx%d subsampling %d", width, height, subsampling);
+		job->failed = 1;
+		return;
+	}
+
+	ret = tjDecompressToYUV (worker->jpeg_dec, jpeg, jpeg_size, job->yuv, 0);
+
+	if (ret != 0) {
+		printke ("JPEG decoding error: %s", tjGetErrorStr());
+		job->failed = 1;
+		return;
+	}
+
+	/* turbojpeg pads plane widths to 4 and 4:2:0 heights to 2 */
+
+	plane_height = height;
+	chroma_width = width;
+	chroma_height = height;
+
+	if (subsampling == TJSAMP_420) {
+		plane_height = KRAD_V4L2_PAD (height, 2);
+		chroma_height = plane_height / 2;
+	}
+
+	if (subsampling != TJSAMP_444) {
+		chroma_width = (width + 1) / 2;
+	}
+
+	job->yuv_subsampling = subsampling;
+	job->yuv_strides[0] = KRAD_V4L2_PAD (width, 4);
+	job->yuv_strides[1] = KRAD_V4L2_PAD (chroma_width, 4);
+	job->yuv_strides[2] = job->yuv_strides[1];
+	job->yuv_strides[3] = 0;
+	job->yuv_pixels[0] = job->yuv;
+	job->yuv_pixels[1] = job->yuv_pixels[0] + job->yuv_strides[0] * plane_height;
+	job->yuv_pixels[2] = job->yuv_pixels[1] + job->yuv_strides[1] * chroma_height;
+	job->yuv_pixels[3] = NULL;
+}
+
+/* must be called with the decoder lock held, whoever gets here first hands
+   over every finished frame at the head of the queue in order */
+
+static void kradv4l2_mjpeg_decoder_deliver (krad_v4l2_mjpeg_decoder_t *decoder) {
+
+	krad_v4l2_mjpeg_job_t *job;
+
+	if (decoder->delivering) {
+		return;
+	}
+	
+	decoder->delivering = 1;
+
+	while (decoder->delivered < decoder->submitted) {
+		job = &decoder->jobs[decoder->delivered % KRAD_V4L2_MJPEG_QUEUE_SIZE];
+		if (job->state != KRAD_V4L2_MJPEG_JOB_DONE) {
+			break;
+		}
+		pthread_mutex_unlock (&decoder->lock);
+		decoder->frame_callback (decoder->callback_pointer, job);
+		pthread_mutex_lock (&decoder->lock);
+		job->state = KRAD_V4L2_MJPEG_JOB_FREE;
+		decoder->delivered++;
+	}
+
+	decoder->delivering = 0;
+}
+
+static void *kradv4l2_mjpeg_decoder_thread (void *arg) {
+
+	krad_v4l2_mjpeg_worker_t *worker = (krad_v4l2_mjpeg_worker_t *)arg;
+	krad_v4l2_mjpeg_decoder_t *decoder;
+	krad_v4l2_mjpeg_job_t *job;
+	uint64_t start_time;
+
+	prctl (PR_SET_NAME, (unsigned long) "kradv4l2_mjpeg", 0, 0, 0);
+
+	decoder = worker->decoder;
+
+	pthread_mutex_lock (&decoder->lock);
+
+	while (1) {
+
+		while ((decoder->taken == decoder->submitted) && (!decoder->shutdown)) {
+			pthread_cond_wait (&decoder->work_cond, &decoder->lock);
+		}
+
+		if (decoder->taken == decoder->submitted) {
+			break;
+		}
+
+		job = &decoder->jobs[decoder->taken % KRAD_V4L2_MJPEG_QUEUE_SIZE];
+		decoder->taken++;
+		job->state = KRAD_V4L2_MJPEG_JOB_DECODING;
+		
+		pthread_mutex_unlock (&decoder->lock);
+		
+		start_time = kradv4l2_time_us ();
+		kradv4l2_mjpeg_decode_job (worker, job);
+		job->decode_time_us = kradv4l2_time_us () - start_time;
+
+		printkd ("MJPEG: frame %"PRIu64" decoded in %"PRIu64"us", job->sequence, job->decode_time_us);
+		
+		pthread_mutex_lock (&decoder->lock);
+
+		decoder->frames++;
+		decoder->decode_time_total_us += job->decode_time_us;
+		if (job->decode_time_us > decoder->decode_time_max_us) {
+			decoder->decode_time_max_us = job->decode_time_us;
+		}
+		if (job->failed) {
+			decoder->failures++;
+		}
+
+		job->state = KRAD_V4L2_MJPEG_JOB_DONE;
+		kradv4l2_mjpeg_decoder_deliver (decoder);
+	}
+
+	pthread_mutex_unlock (&decoder->lock);
+
+	return NULL;
+}
+
+/* returns -1 when every slot is busy, the caller should drop the frame */
+
+int kradv4l2_mjpeg_decoder_submit (krad_v4l2_mjpeg_decoder_t *decoder, unsigned char *mjpeg, unsigned int mjpeg_size,
+								   unsigned char *argb, void *user) {
+
+	krad_v4l2_mjpeg_job_t *job;
+
+	pthread_mutex_lock (&decoder->lock);
+
+	if (decoder->submitted - decoder->delivered >= KRAD_V4L2_MJPEG_QUEUE_SIZE) {
+		pthread_mutex_unlock (&decoder->lock);
+		return -1;
+	}
+
+	job = &decoder->jobs[decoder->submitted % KRAD_V4L2_MJPEG_QUEUE_SIZE];
+
+	job->mjpeg = mjpeg;
+	job->mjpeg_size = mjpeg_size;
+	job->argb = argb;
+	job->user = user;
+	job->failed = 0;
+	job->decode_time_us = 0;
+	job->sequence = decoder->submitted;
+	job->state = KRAD_V4L2_MJPEG_JOB_PENDING;
+
+	decoder->submitted++;
+
+	pthread_cond_signal (&decoder->work_cond);
+	pthread_mutex_unlock (&decoder->lock);
+
+	return 0;
+}
+
+krad_v4l2_mjpeg_decoder_t *kradv4l2_mjpeg_decoder_create (int width, int height, int threads, int yuv,
+															 void (*frame_callback)(void *, krad_v4l2_mjpeg_job_t *),
+															 void *callback_pointer) {
+
+	krad_v4l2_mjpeg_decoder_t *decoder;
+	int yuv_size;
+	int t;
+	int j;
+
+	decoder = calloc (1, sizeof (krad_v4l2_mjpeg_decoder_t));
+
+	if (threads < 1) {
+		threads = 1;
+	}
+	
+	if (threads > KRAD_V4L2_MJPEG_MAX_THREADS) {
+		threads = KRAD_V4L2_MJPEG_MAX_THREADS;
+	}
+
+	decoder->width = width;
+	decoder->height = height;
+	decoder->threads = threads;
+	decoder->yuv = yuv;
+	decoder->frame_callback = frame_callback;
+	decoder->callback_pointer = callback_pointer;
+
+	pthread_mutex_init (&decoder->lock, NULL);
+	pthread_cond_init (&decoder->work_cond, NULL);
+	
+	if (decoder->yuv) {
+		/* enough for 4:4:4 with padding */
+		yuv_size = KRAD_V4L2_PAD (width, 4) * KRAD_V4L2_PAD (height, 2) * 3;
+		for (j = 0; j < KRAD_V4L2_MJPEG_QUEUE_SIZE; j++) {
+			decoder->jobs[j].yuv = malloc (yuv_size);
+			if (decoder->jobs[j].yuv == NULL) {
+				failfast ("Krad V4L2: Out of memory");
+			}
+		}
+	}
+
+	for (t = 0; t < decoder->threads; t++) {
+		decoder->workers[t].decoder = decoder;
+		decoder->workers[t].jpeg_dec = tjInitDecompress ();
+		decoder->workers[t].jpeg_buffer = malloc (KRAD_V4L2_JPEG_BUFFER_SIZE);
+		if (decoder->workers[t].jpeg_buffer == NULL) {
+			failfast ("Krad V4L2: Out of memory");
+		}
+		pthread_create (&decoder->workers[t].thread, NULL, kradv4l2_mjpeg_decoder_thread, &decoder->workers[t]);
+	}
+	
+	printk ("Krad V4L2: MJPEG decoder %dx%d with %d threads to %s", width, height, threads, yuv ? "YUV" : "RGB");
+	
+	return decoder;
+}
+
+/* frames already submitted are decoded and handed over before this returns */
+
+void kradv4l2_mjpeg_decoder_destroy (krad_v4l2_mjpeg_decoder_t *decoder) {
+
+	int t;
+	int j;
+
+	pthread_mutex_lock (&decoder->lock);
+	decoder->shutdown = 1;
+	pthread_cond_broadcast (&decoder->work_cond);
+	pthread_mutex_unlock (&decoder->lock);
+
+	for (t = 0; t < decoder->threads; t++) {
+		pthread_join (decoder->workers[t].thread, NULL);
+		tjDestroy (decoder->workers[t].jpeg_dec);
+		free (decoder->workers[t].jpeg_buffer);
+	}
+
+	if (decoder->frames > 0) {
+		printk ("Krad V4L2: MJPEG decoded %"PRIu64" frames, %"PRIu64" failed, avg %"PRIu64"us max %"PRIu64"us",
+				decoder->frames, decoder->failures, decoder->decode_time_total_us / decoder->frames,
+				decoder->decode_time_max_us);
+	}
+
+	for (j = 0; j < KRAD_V4L2_MJPEG_QUEUE_SIZE; j++) {
+		free (decoder->jobs[j].yuv);
+	}
+
+	pthread_cond_destroy (&decoder->work_cond);
+	pthread_mutex_destroy (&decoder->lock);
+
+	free (decoder);
+}
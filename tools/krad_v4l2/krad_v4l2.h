@@ -9,6 +9,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <malloc.h>
+#include <time.h>
+#include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -17,6 +19,7 @@
 #include <math.h>
 #include <asm/types.h>
 #include <linux/videodev2.h>
+#include <pthread.h>
 
 #include <turbojpeg.h>
 
@@ -26,9 +29,17 @@
 
 #define CLEAR(x) memset (&(x), 0, sizeof (x))
 
+#define KRAD_V4L2_MJPEG_DEFAULT_THREADS 3
+#define KRAD_V4L2_MJPEG_MAX_THREADS 8
+#define KRAD_V4L2_MJPEG_QUEUE_SIZE 16
+#define KRAD_V4L2_JPEG_BUFFER_SIZE 4200000
+
 typedef struct krad_v4l2_ret_buffer_St krad_v4l2_ret_buffer_t;
 typedef struct krad_v4l2_buffer_St krad_v4l2_buffer_t;
 typedef struct krad_v4l2_St krad_v4l2_t;
+typedef struct krad_v4l2_mjpeg_job_St krad_v4l2_mjpeg_job_t;
+typedef struct krad_v4l2_mjpeg_worker_St krad_v4l2_mjpeg_worker_t;
+typedef struct krad_v4l2_mjpeg_decoder_St krad_v4l2_mjpeg_decoder_t;
 
 typedef enum {
 	IO_METHOD_READ,
@@ -65,6 +76,13 @@ struct krad_v4l2_St {
 	krad_v4l2_buffer_t *buffers;
 	unsigned int n_buffers;
 	struct v4l2_buffer buf;
+	/* buffers are requeued from other threads, this keeps them from
+	   doing it while streaming is being turned off */
+	pthread_mutex_t streaming_lock;
+	int streaming;
+	/* set when frames still point into the mmap'd buffers at close,
+	   they are left mapped rather than pulled out from under them */
+	int keep_mapped;
 	
 	char device[512];
 
@@ -80,6 +98,75 @@ struct krad_v4l2_St {
 };
 
 
+typedef enum {
+	KRAD_V4L2_MJPEG_JOB_FREE,
+	KRAD_V4L2_MJPEG_JOB_PENDING,
+	KRAD_V4L2_MJPEG_JOB_DECODING,
+	KRAD_V4L2_MJPEG_JOB_DONE,
+} krad_v4l2_mjpeg_job_state_t;
+
+/* one frame going through the decoder, when decoding to yuv the planes
+   point into a buffer the decoder owns, valid until the callback returns */
+
+struct krad_v4l2_mjpeg_job_St {
+
+	unsigned char *mjpeg;
+	unsigned int mjpeg_size;
+	unsigned char *argb;
+	void *user;
+
+	unsigned char *yuv;
+	uint8_t *yuv_pixels[4];
+	int yuv_strides[4];
+	int yuv_subsampling;
+
+	int failed;
+	uint64_t sequence;
+	uint64_t decode_time_us;
+	krad_v4l2_mjpeg_job_state_t state;
+
+};
+
+struct krad_v4l2_mjpeg_worker_St {
+
+	krad_v4l2_mjpeg_decoder_t *decoder;
+	pthread_t thread;
+	tjhandle jpeg_dec;
+	unsigned char *jpeg_buffer;
+
+};
+
+/* N decode threads with their own turbojpeg handle each, frames are
+   handed to the callback in the order they were submitted */
+
+struct krad_v4l2_mjpeg_decoder_St {
+
+	int width;
+	int height;
+	int yuv;
+	int threads;
+
+	krad_v4l2_mjpeg_worker_t workers[KRAD_V4L2_MJPEG_MAX_THREADS];
+	krad_v4l2_mjpeg_job_t jobs[KRAD_V4L2_MJPEG_QUEUE_SIZE];
+
+	uint64_t submitted;
+	uint64_t taken;
+	uint64_t delivered;
+	int delivering;
+	int shutdown;
+
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;
+
+	void (*frame_callback)(void *, krad_v4l2_mjpeg_job_t *);
+	void *callback_pointer;
+
+	uint64_t frames;
+	uint64_t failures;
+	uint64_t decode_time_total_us;
+	uint64_t decode_time_max_us;
+
+};
 
 /* public */
 
@@ -87,6 +174,13 @@ int kradv4l2_mjpeg_to_jpeg (krad_v4l2_t *kradv4l2, unsigned char *jpeg_buffer, u
 
 void kradv4l2_mjpeg_to_rgb (krad_v4l2_t *kradv4l2, unsigned char *argb_buffer, unsigned char *mjpeg_buffer, unsigned int mjpeg_size);
 
+krad_v4l2_mjpeg_decoder_t *kradv4l2_mjpeg_decoder_create (int width, int height, int threads, int yuv,
+															 void (*frame_callback)(void *, krad_v4l2_mjpeg_job_t *),
+															 void *callback_pointer);
+void kradv4l2_mjpeg_decoder_destroy (krad_v4l2_mjpeg_decoder_t *decoder);
+int kradv4l2_mjpeg_decoder_submit (krad_v4l2_mjpeg_decoder_t *decoder, unsigned char *mjpeg, unsigned int mjpeg_size,
+								   unsigned char *argb, void *user);
+
 krad_v4l2_t *kradv4l2_create();
 void kradv4l2_destroy(krad_v4l2_t *kradv4l2);
 
@@ -102,6 +196,7 @@ void kradv4l2_read_frames (krad_v4l2_t *kradv4l2);
 char *kradv4l2_read_frame_adv (krad_v4l2_t *kradv4l2);
 char *kradv4l2_read_frame_wait_adv (krad_v4l2_t *kradv4l2);
 void kradv4l2_frame_done (krad_v4l2_t *kradv4l2);
+void kradv4l2_buffer_done (krad_v4l2_t *kradv4l2, int index);
 
 /* private */
 
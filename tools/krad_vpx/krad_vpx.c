@@ -2,6 +2,79 @@
 
 static void krad_vpx_fail (vpx_codec_ctx_t *ctx, const char *s);
 
+static const int krad_vpx_speed_realtime[KRAD_VPX_SPEED_LEVELS] = { 0, 0, 0, 1, 1, 1, 1, 1, 1, 1 };
+static const int krad_vpx_speed_cpu_used[KRAD_VPX_SPEED_LEVELS] = { 0, 2, 4, 4, 6, 8, 10, 12, 14, 16 };
+#define KRAD_VPX_FIRST_REALTIME_LEVEL 3
+
+static int krad_vpx_auto_threads (int height) {
+
+	int threads;
+	int mb_rows;
+	
+	// leave a core for the compositor and audio
+	threads = sysconf (_SC_NPROCESSORS_ONLN) - 1;
+	
+	// each thread wants a few macroblock rows to itself
+	mb_rows = (height + 15) / 16;
+	if (threads > mb_rows / 4) {
+		threads = mb_rows / 4;
+	}
+	
+	if (threads > KRAD_VPX_MAX_THREADS) {
+		threads = KRAD_VPX_MAX_THREADS;
+	}
+	
+	if (threads < 1) {
+		threads = 1;
+	}
+	
+	return threads;
+
+}
+
+/* one token partition per thread so the decoder side can thread too,
+   libvpx takes it as log2 and tops out at 8 */
+static int krad_vpx_token_partitions (int threads) {
+
+	int partitions;
+	
+	partitions = 0;
+	
+	while ((partitions < 3) && ((2 << partitions) <= threads)) {
+		partitions++;
+	}
+	
+	return partitions;
+
+}
+
+static void krad_vpx_encoder_apply_speed_level (krad_vpx_encoder_t *kradvpx) {
+
+	int cpu_used;
+
+	if (kradvpx->speed_pinned == KRAD_VPX_SPEED_AUTO) {
+		cpu_used = krad_vpx_speed_cpu_used[kradvpx->speed_level];
+	} else {
+		cpu_used = kradvpx->speed_pinned;
+	}
+	
+	if (cpu_used != kradvpx->cpu_used) {
+		kradvpx->cpu_used = cpu_used;
+		kradvpx->update_speed = 1;
+	}
+
+	if (kradvpx->deadline_pinned != KRAD_VPX_DEADLINE_AUTO) {
+		kradvpx->quality = kradvpx->deadline_pinned;
+	} else {
+		if (krad_vpx_speed_realtime[kradvpx->speed_level]) {
+			kradvpx->quality = VPX_DL_REALTIME;
+		} else {
+			kradvpx->quality = (kradvpx->frame_budget_us / 3) * 2;
+		}
+	}
+
+}
+
 krad_vpx_encoder_t *krad_vpx_encoder_create (int width, int height, int fps_numerator,
 											 int fps_denominator, int bitrate) {
 
@@ -27,6 +100,8 @@ krad_vpx_encoder_t *krad_vpx_encoder_create (int width, int height, int fps_nume
 		failfast ("Failed to get config: %s\n", vpx_codec_err_to_string(kradvpx->res));
     }
 
+	kradvpx->default_cfg = kradvpx->cfg;
+
 	krad_vpx_encoder_print_config (kradvpx);
 
 	kradvpx->cfg.g_w = kradvpx->width;
@@ -35,25 +110,35 @@ krad_vpx_encoder_t *krad_vpx_encoder_create (int width, int height, int fps_nume
 	kradvpx->cfg.g_timebase.num = kradvpx->fps_denominator;
 	kradvpx->cfg.g_timebase.den = kradvpx->fps_numerator;
 	kradvpx->cfg.rc_target_bitrate = bitrate;	
-	kradvpx->cfg.g_threads = 3;
+	kradvpx->threads = krad_vpx_auto_threads (kradvpx->height);
+	kradvpx->threads_created = kradvpx->threads;
+	kradvpx->token_partitions = krad_vpx_token_partitions (kradvpx->threads);
+	kradvpx->cfg.g_threads = kradvpx->threads;
 	kradvpx->cfg.kf_mode = VPX_KF_AUTO;
-	kradvpx->cfg.rc_end_usage = VPX_VBR;
+	kradvpx->rate_control = VPX_VBR;
+	kradvpx->buffer_ms = KRAD_VPX_DEFAULT_BUFFER_MS;
+	kradvpx->cfg.rc_end_usage = kradvpx->rate_control;
 	
 	//kradvpx->cfg.g_lag_in_frames = 1;
 	
-	//kradvpx->cfg.rc_buf_sz = 8000;
-	//kradvpx->cfg.rc_buf_initial_sz = 4300;
-	//kradvpx->cfg.rc_buf_optimal_sz = 6500;
-	
 	//kradvpx->cfg.rc_max_quantizer = 55;
 	
-	kradvpx->quality = 15 * 1000;
+	kradvpx->frame_budget_us = (1000000ULL * kradvpx->fps_denominator) / kradvpx->fps_numerator;
+	kradvpx->speed_level = 0;
+	kradvpx->speed_pinned = KRAD_VPX_SPEED_AUTO;
+	kradvpx->deadline_pinned = KRAD_VPX_DEADLINE_AUTO;
+	kradvpx->cpu_used = -1;
+	krad_vpx_encoder_apply_speed_level (kradvpx);
 
 	krad_vpx_encoder_print_config (kradvpx);
 
 	if (vpx_codec_enc_init(&kradvpx->encoder, interface, &kradvpx->cfg, 0)) {
 		 krad_vpx_fail (&kradvpx->encoder, "Failed to initialize encoder");
 	}
+	
+	if (vpx_codec_control (&kradvpx->encoder, VP8E_SET_TOKEN_PARTITIONS, kradvpx->token_partitions)) {
+		printke ("Krad VP8: could not set %d token partitions", 1 << kradvpx->token_partitions);
+	}
 
 	krad_vpx_encoder_print_config (kradvpx);
 
@@ -66,6 +151,8 @@ void krad_vpx_encoder_print_config (krad_vpx_encoder_t *kradvpx) {
 	printk ("Krad VP8 Encoder config");
 	printk ("WxH %dx%d", kradvpx->cfg.g_w, kradvpx->cfg.g_h);
 	printk ("Threads: %d", kradvpx->cfg.g_threads);
+	printk ("Token partitions: %d", 1 << kradvpx->token_partitions);
+	printk ("rc_end_usage: %s", krad_vpx_encoder_rate_control_to_string (kradvpx->cfg.rc_end_usage));
 	printk ("rc_target_bitrate: %d", kradvpx->cfg.rc_target_bitrate);
 	printk ("kf_max_dist: %d", kradvpx->cfg.kf_max_dist);
 	printk ("kf_min_dist: %d", kradvpx->cfg.kf_min_dist);	
@@ -87,13 +174,187 @@ void krad_vpx_encoder_bitrate_set (krad_vpx_encoder_t *kradvpx, int bitrate) {
 }
 
 void krad_vpx_encoder_quality_set (krad_vpx_encoder_t *kradvpx, int quality) {
-	kradvpx->quality = quality;
+	if (quality < 0) {
+		quality = KRAD_VPX_DEADLINE_AUTO;
+	}
+	kradvpx->deadline_pinned = quality;
+	krad_vpx_encoder_apply_speed_level (kradvpx);
 }
 
 int krad_vpx_encoder_quality_get (krad_vpx_encoder_t *kradvpx) {
 	return kradvpx->quality;
 }
 
+void krad_vpx_encoder_speed_set (krad_vpx_encoder_t *kradvpx, int cpu_used) {
+
+	if (cpu_used < 0) {
+		kradvpx->speed_pinned = KRAD_VPX_SPEED_AUTO;
+	} else {
+		if (cpu_used > 16) {
+			cpu_used = 16;
+		}
+		kradvpx->speed_pinned = cpu_used;
+	}
+	
+	krad_vpx_encoder_apply_speed_level (kradvpx);
+
+}
+
+void krad_vpx_encoder_threads_set (krad_vpx_encoder_t *kradvpx, int threads) {
+
+	if (threads < 1) {
+		threads = krad_vpx_auto_threads (kradvpx->height);
+	}
+	
+	if (threads > kradvpx->threads_created) {
+		printke ("Krad VP8: encoder was created with %d threads, can't go to %d",
+				 kradvpx->threads_created, threads);
+		threads = kradvpx->threads_created;
+	}
+	
+	kradvpx->threads = threads;
+	kradvpx->token_partitions = krad_vpx_token_partitions (threads);
+	kradvpx->cfg.g_threads = threads;
+	kradvpx->update_config = 1;
+
+}
+
+int krad_vpx_encoder_string_to_rate_control (char *string) {
+
+	if (strncmp (string, "cbr", 3) == 0) {
+		return VPX_CBR;
+	}
+	
+	if (strncmp (string, "cq", 2) == 0) {
+		return VPX_CQ;
+	}
+
+	return VPX_VBR;
+
+}
+
+char *krad_vpx_encoder_rate_control_to_string (int rate_control) {
+
+	switch (rate_control) {
+		case VPX_CBR:
+			return "cbr";
+		case VPX_CQ:
+			return "cq";
+		default:
+			return "vbr";
+	}
+
+}
+
+void krad_vpx_encoder_rate_control_set (krad_vpx_encoder_t *kradvpx, int rate_control, int buffer_ms) {
+
+	if (buffer_ms < 1) {
+		buffer_ms = kradvpx->buffer_ms;
+	}
+
+	kradvpx->rate_control = rate_control;
+	kradvpx->buffer_ms = buffer_ms;
+	kradvpx->cfg.rc_end_usage = rate_control;
+	
+	if (rate_control == VPX_CBR) {
+		/* Live: a small decoder buffer keeps frame sizes close to the
+		   target instead of letting a busy scene blow out the link. */
+		kradvpx->cfg.g_lag_in_frames = 0;
+		kradvpx->cfg.rc_buf_sz = buffer_ms;
+		kradvpx->cfg.rc_buf_initial_sz = (buffer_ms / 2);
+		kradvpx->cfg.rc_buf_optimal_sz = (buffer_ms * 3) / 5;
+		kradvpx->cfg.rc_undershoot_pct = 95;
+		kradvpx->cfg.rc_overshoot_pct = 15;
+		kradvpx->cfg.rc_min_quantizer = 4;
+		kradvpx->cfg.rc_max_quantizer = 56;
+	} else {
+		kradvpx->cfg.g_lag_in_frames = kradvpx->default_cfg.g_lag_in_frames;
+		kradvpx->cfg.rc_buf_sz = kradvpx->default_cfg.rc_buf_sz;
+		kradvpx->cfg.rc_buf_initial_sz = kradvpx->default_cfg.rc_buf_initial_sz;
+		kradvpx->cfg.rc_buf_optimal_sz = kradvpx->default_cfg.rc_buf_optimal_sz;
+		kradvpx->cfg.rc_undershoot_pct = kradvpx->default_cfg.rc_undershoot_pct;
+		kradvpx->cfg.rc_overshoot_pct = kradvpx->default_cfg.rc_overshoot_pct;
+		kradvpx->cfg.rc_min_quantizer = kradvpx->default_cfg.rc_min_quantizer;
+		kradvpx->cfg.rc_max_quantizer = kradvpx->default_cfg.rc_max_quantizer;
+	}
+	
+	kradvpx->update_config = 1;
+
+}
+
+void krad_vpx_encoder_adapt (krad_vpx_encoder_t *kradvpx, int frames_queued) {
+
+	float load;
+	int level;
+	
+	if ((kradvpx->speed_pinned != KRAD_VPX_SPEED_AUTO) && (kradvpx->deadline_pinned != KRAD_VPX_DEADLINE_AUTO)) {
+		return;
+	}
+	
+	kradvpx->frames_since_change++;
+	level = kradvpx->speed_level;
+	
+	if ((frames_queued > KRAD_VPX_BACKLOG_PANIC) && (level < KRAD_VPX_FIRST_REALTIME_LEVEL + 2)) {
+		level = KRAD_VPX_FIRST_REALTIME_LEVEL + 2;
+		printk ("Alert! VP8 encoder %d frames behind, jumping to speed level %d", frames_queued, level);
+	} else {
+	
+		if (kradvpx->encode_us_average == 0.0f) {
+			return;
+		}
+	
+		load = kradvpx->encode_us_average / kradvpx->frame_budget_us;
+		
+		if ((load > KRAD_VPX_LOAD_HIGH) || (frames_queued > 2)) {
+			kradvpx->frames_over++;
+			kradvpx->frames_under = 0;
+		} else if ((load < KRAD_VPX_LOAD_LOW) && (frames_queued == 0)) {
+			kradvpx->frames_under++;
+			kradvpx->frames_over = 0;
+		} else {
+			kradvpx->frames_over = 0;
+			kradvpx->frames_under = 0;
+		}
+		
+		if (kradvpx->frames_since_change < KRAD_VPX_ADAPT_HOLDOFF) {
+			return;
+		}
+		
+		if ((kradvpx->frames_over >= KRAD_VPX_FRAMES_OVER) && (level < KRAD_VPX_SPEED_LEVELS - 1)) {
+			level++;
+		} else if ((kradvpx->frames_under >= KRAD_VPX_FRAMES_UNDER) && (level > 0)) {
+			level--;
+		} else {
+			return;
+		}
+	}
+	
+	kradvpx->speed_level = level;
+	kradvpx->speed_changes++;
+	kradvpx->frames_since_change = 0;
+	kradvpx->frames_over = 0;
+	kradvpx->frames_under = 0;
+	
+	krad_vpx_encoder_apply_speed_level (kradvpx);
+	
+	printk ("Krad VP8: speed level %d cpu-used %d deadline %lu encode %.1fms of %.1fms budget",
+			kradvpx->speed_level, kradvpx->cpu_used, kradvpx->quality,
+			kradvpx->encode_us_average / 1000.0f, kradvpx->frame_budget_us / 1000.0f);
+
+}
+
+void krad_vpx_encoder_print_speed (krad_vpx_encoder_t *kradvpx) {
+
+	printk ("Krad VP8: %s %dk threads %d partitions %d speed level %d%s cpu-used %d deadline %lu%s "
+			"encode %.1fms of %.1fms budget, %d speed changes",
+			krad_vpx_encoder_rate_control_to_string (kradvpx->rate_control), kradvpx->cfg.rc_target_bitrate,
+			kradvpx->threads, 1 << kradvpx->token_partitions, kradvpx->speed_level,
+			kradvpx->speed_pinned == KRAD_VPX_SPEED_AUTO ? "" : " (pinned)", kradvpx->cpu_used,
+			kradvpx->quality, kradvpx->deadline_pinned == KRAD_VPX_DEADLINE_AUTO ? "" : " (pinned)",
+			kradvpx->encode_us_average / 1000.0f, kradvpx->frame_budget_us / 1000.0f, kradvpx->speed_changes);
+
+}
+
 void krad_vpx_encoder_config_set (krad_vpx_encoder_t *kradvpx, vpx_codec_enc_cfg_t *cfg) {
 
 	int ret;
@@ -133,16 +394,41 @@ void krad_vpx_encoder_want_keyframe (krad_vpx_encoder_t *kradvpx) {
 
 int krad_vpx_encoder_write (krad_vpx_encoder_t *kradvpx, unsigned char **packet, int *keyframe) {
 
+	struct timespec start;
+	struct timespec end;
+
 	if (kradvpx->update_config == 1) {
 		krad_vpx_encoder_config_set (kradvpx, &kradvpx->cfg);
+		if (vpx_codec_control (&kradvpx->encoder, VP8E_SET_TOKEN_PARTITIONS, kradvpx->token_partitions)) {
+			printke ("Krad VP8: could not set %d token partitions", 1 << kradvpx->token_partitions);
+		}
 		kradvpx->update_config = 0;
 		//printk ("Krad VP8: bitrate should now be: %dk", kradvpx->cfg.rc_target_bitrate);
 		krad_vpx_encoder_print_config (kradvpx);
 	}
+	
+	if (kradvpx->update_speed == 1) {
+		if (vpx_codec_control (&kradvpx->encoder, VP8E_SET_CPUUSED, kradvpx->cpu_used)) {
+			printke ("Krad VP8: could not set cpu-used %d", kradvpx->cpu_used);
+		}
+		kradvpx->update_speed = 0;
+	}
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
 
 	if (vpx_codec_encode(&kradvpx->encoder, kradvpx->image, kradvpx->frames, 1, kradvpx->flags, kradvpx->quality)) {
 		krad_vpx_fail (&kradvpx->encoder, "Failed to encode frame");
 	}
+	
+	if (kradvpx->image != NULL) {
+		clock_gettime (CLOCK_MONOTONIC, &end);
+		kradvpx->encode_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+		if (kradvpx->encode_us_average == 0.0f) {
+			kradvpx->encode_us_average = kradvpx->encode_us;
+		} else {
+			kradvpx->encode_us_average += ((float)kradvpx->encode_us - kradvpx->encode_us_average) / 8.0f;
+		}
+	}
 
 	kradvpx->frames++;
 
@@ -154,6 +440,7 @@ int krad_vpx_encoder_write (krad_vpx_encoder_t *kradvpx, unsigned char **packet,
 		if (kradvpx->pkt->kind == VPX_CODEC_CX_FRAME_PKT) {
 			*packet = kradvpx->pkt->data.frame.buf;
 			*keyframe = kradvpx->pkt->data.frame.flags & VPX_FRAME_IS_KEY;
+			kradvpx->pts = kradvpx->pkt->data.frame.pts;
 			if (*keyframe == 0) {
 				kradvpx->frames_since_keyframe++;
 			} else {
@@ -169,8 +456,42 @@ int krad_vpx_encoder_write (krad_vpx_encoder_t *kradvpx, unsigned char **packet,
 
 /* decoder */
 
+static int krad_vpx_decoder_init (krad_vpx_decoder_t *kradvpx, void *buffer, int len) {
+
+	if ((vpx_codec_peek_stream_info (vpx_codec_vp8_dx(), buffer, len, &kradvpx->stream_info)) ||
+		(!kradvpx->stream_info.is_kf)) {
+		return -1;
+	}
+
+	/* libvpx decodes macroblock rows in parallel, so it scales with height
+	   the same way the encoder does */
+	kradvpx->threads = krad_vpx_auto_threads (kradvpx->stream_info.h);
+	kradvpx->cfg.threads = kradvpx->threads;
+	kradvpx->cfg.w = kradvpx->stream_info.w;
+	kradvpx->cfg.h = kradvpx->stream_info.h;
+
+	if (vpx_codec_dec_init (&kradvpx->decoder, vpx_codec_vp8_dx(), &kradvpx->cfg, kradvpx->dec_flags)) {
+		failfast ("Krad VPX: could not init decoder: %s", vpx_codec_error (&kradvpx->decoder));
+	}
+
+	vpx_codec_control (&kradvpx->decoder, VP8_SET_POSTPROC, &kradvpx->ppcfg);
+
+	kradvpx->initialized = 1;
+
+	printk ("Krad VPX: decoding %dx%d with %d threads", kradvpx->stream_info.w, kradvpx->stream_info.h,
+			kradvpx->threads);
+
+	return 0;
+
+}
+
 void krad_vpx_decoder_decode (krad_vpx_decoder_t *kradvpx, void *buffer, int len) {
 
+	if ((!kradvpx->initialized) && (krad_vpx_decoder_init (kradvpx, buffer, len))) {
+		/* nothing can be decoded before the first keyframe */
+		kradvpx->img = NULL;
+		return;
+	}
 
 	if (vpx_codec_decode(&kradvpx->decoder, buffer, len, 0, 0))
 	{
@@ -208,7 +529,9 @@ void krad_vpx_decoder_decode (krad_vpx_decoder_t *kradvpx, void *buffer, int len
 
 void krad_vpx_decoder_destroy (krad_vpx_decoder_t *kradvpx) {
 
-	vpx_codec_destroy (&kradvpx->decoder);
+	if (kradvpx->initialized) {
+		vpx_codec_destroy (&kradvpx->decoder);
+	}
 	vpx_img_free (kradvpx->img);
 	free (kradvpx);
 }
@@ -221,9 +544,6 @@ krad_vpx_decoder_t *krad_vpx_decoder_create () {
 
 	kradvpx->stream_info.sz = sizeof(kradvpx->stream_info);
 	kradvpx->dec_flags = 0;
-	kradvpx->cfg.threads = 3;
-	
-    vpx_codec_dec_init(&kradvpx->decoder, vpx_codec_vp8_dx(), &kradvpx->cfg, kradvpx->dec_flags);
 
 	//kradvpx->ppcfg.post_proc_flag = VP8_DEBLOCK;
 	//kradvpx->ppcfg.deblocking_level = 1;
@@ -233,8 +553,6 @@ krad_vpx_decoder_t *krad_vpx_decoder_create () {
 	kradvpx->ppcfg.deblocking_level = 5;
 	kradvpx->ppcfg.noise_level = 1;
 
-	vpx_codec_control (&kradvpx->decoder, VP8_SET_POSTPROC, &kradvpx->ppcfg);
-
 	kradvpx->img = NULL;
 
 	return kradvpx;
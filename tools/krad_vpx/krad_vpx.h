@@ -28,6 +28,26 @@
 typedef struct krad_vpx_encoder_St krad_vpx_encoder_t;
 typedef struct krad_vpx_decoder_St krad_vpx_decoder_t;
 
+/* The speed ladder runs from the good quality deadline at cpu-used 0 up
+   to realtime at cpu-used 16. krad_vpx_encoder_adapt steps along it one
+   level at a time, from the measured encode time against the frame
+   budget. Stepping up takes a short run of frames over budget, stepping
+   back down a long run well under it, and nothing moves for a while
+   after a step, so it settles rather than hunting. */
+
+#define KRAD_VPX_SPEED_LEVELS 10
+#define KRAD_VPX_SPEED_AUTO -1
+#define KRAD_VPX_DEADLINE_AUTO 0
+#define KRAD_VPX_MAX_THREADS 8
+#define KRAD_VPX_LOAD_HIGH 0.85f
+#define KRAD_VPX_LOAD_LOW 0.5f
+#define KRAD_VPX_FRAMES_OVER 8
+#define KRAD_VPX_FRAMES_UNDER 90
+#define KRAD_VPX_ADAPT_HOLDOFF 30
+/* compositor frames queued before we jump straight to realtime */
+#define KRAD_VPX_BACKLOG_PANIC 25
+#define KRAD_VPX_DEFAULT_BUFFER_MS 1000
+
 struct krad_vpx_encoder_St {
 
 	int width;
@@ -48,8 +68,33 @@ struct krad_vpx_encoder_St {
     int flags;
 	unsigned int frames;
 	unsigned int frames_since_keyframe;	
+	/* pts of the last packet out, in frames */
+	int64_t pts;
+	/* the encode deadline in microseconds, 1 is realtime */
 	unsigned long quality;
 	
+	int threads;
+	int threads_created;
+	int token_partitions;
+	int rate_control;
+	int buffer_ms;
+	/* libvpx's own rate control settings, put back leaving cbr */
+	vpx_codec_enc_cfg_t default_cfg;
+
+	int speed_level;
+	int speed_pinned;
+	unsigned long deadline_pinned;
+	int cpu_used;
+	int update_speed;
+	int speed_changes;
+
+	uint64_t frame_budget_us;
+	uint64_t encode_us;
+	float encode_us_average;
+	int frames_over;
+	int frames_under;
+	int frames_since_change;
+	
 };
 
 struct krad_vpx_decoder_St {
@@ -61,6 +106,10 @@ struct krad_vpx_decoder_St {
 	int frames;
 	int quality;
     int dec_flags;
+	/* the decoder is set up on the first keyframe, once its size says
+	   how many threads are worth having */
+	int initialized;
+	int threads;
 
     vpx_codec_err_t	res;
     vpx_codec_ctx_t decoder;
@@ -79,9 +128,23 @@ struct krad_vpx_decoder_St {
 
 void krad_vpx_encoder_print_config (krad_vpx_encoder_t *kradvpx);
 void krad_vpx_encoder_bitrate_set (krad_vpx_encoder_t *kradvpx, int bitrate);
+/* pins the deadline in microseconds, KRAD_VPX_DEADLINE_AUTO hands it back to adapt */
 void krad_vpx_encoder_quality_set (krad_vpx_encoder_t *kradvpx, int quality);
 int krad_vpx_encoder_quality_get (krad_vpx_encoder_t *kradvpx);
 
+/* pins cpu-used (0 to 16), KRAD_VPX_SPEED_AUTO hands it back to adapt */
+void krad_vpx_encoder_speed_set (krad_vpx_encoder_t *kradvpx, int cpu_used);
+/* 0 picks from the cores we have, libvpx can't start threads it wasn't created with */
+void krad_vpx_encoder_threads_set (krad_vpx_encoder_t *kradvpx, int threads);
+/* VPX_CBR with a buffer_ms decoder buffer for live, VPX_VBR for files */
+void krad_vpx_encoder_rate_control_set (krad_vpx_encoder_t *kradvpx, int rate_control, int buffer_ms);
+int krad_vpx_encoder_string_to_rate_control (char *string);
+char *krad_vpx_encoder_rate_control_to_string (int rate_control);
+
+/* call once a frame before write, frames_queued is the input backlog */
+void krad_vpx_encoder_adapt (krad_vpx_encoder_t *kradvpx, int frames_queued);
+void krad_vpx_encoder_print_speed (krad_vpx_encoder_t *kradvpx);
+
 void krad_vpx_encoder_finish (krad_vpx_encoder_t *kradvpx);
 void krad_vpx_encoder_config_set (krad_vpx_encoder_t *kradvpx, vpx_codec_enc_cfg_t *cfg);
 krad_vpx_encoder_t *krad_vpx_encoder_create (int width, int height, int fps_numerator,
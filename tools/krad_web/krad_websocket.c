@@ -13,6 +13,16 @@ struct libwebsocket_protocols protocols[] = {
 		callback_krad_ipc,
 		sizeof(krad_ipc_session_data_t),
 	},
+	{
+		"krad-json",
+		callback_krad_json,
+		sizeof(krad_direct_session_data_t),
+	},
+	{
+		"krad-bin",
+		callback_krad_bin,
+		sizeof(krad_direct_session_data_t),
+	},
 	{
 		NULL, NULL, 0		/* End of list */
 	}
@@ -126,12 +136,8 @@ void krad_websocket_set_tag (krad_ipc_session_data_t *krad_ipc_session_data, cha
 }
 
 
-void krad_websocket_add_link ( krad_ipc_session_data_t *krad_ipc_session_data, krad_link_rep_t *krad_link, int link_num) {
+static void krad_websocket_link_to_json (cJSON *msg, krad_link_rep_t *krad_link, int link_num) {
 
-	cJSON *msg;
-	
-	cJSON_AddItemToArray(krad_ipc_session_data->msgs, msg = cJSON_CreateObject());
-	
 	cJSON_AddStringToObject (msg, "com", "kradlink");
 	cJSON_AddStringToObject (msg, "cmd", "add_link");
 	cJSON_AddNumberToObject (msg, "link_num", link_num);
@@ -174,15 +180,17 @@ void krad_websocket_add_link ( krad_ipc_session_data_t *krad_ipc_session_data, k
 
 }
 
-
-void krad_websocket_add_portgroup ( krad_ipc_session_data_t *krad_ipc_session_data, char *portname, float floatval, char *crossfade_name, float crossfade_val ) {
-
-	printkd ("add a portgroup called %s withe a volume of %f", portname, floatval);
+void krad_websocket_add_link ( krad_ipc_session_data_t *krad_ipc_session_data, krad_link_rep_t *krad_link, int link_num) {
 
 	cJSON *msg;
 	
 	cJSON_AddItemToArray(krad_ipc_session_data->msgs, msg = cJSON_CreateObject());
 	
+	krad_websocket_link_to_json (msg, krad_link, link_num);
+}
+
+static void krad_websocket_portgroup_to_json (cJSON *msg, char *portname, float floatval, char *crossfade_name, float crossfade_val) {
+
 	cJSON_AddStringToObject (msg, "com", "kradmixer");
 	
 	cJSON_AddStringToObject (msg, "cmd", "add_portgroup");
@@ -191,6 +199,17 @@ void krad_websocket_add_portgroup ( krad_ipc_session_data_t *krad_ipc_session_da
 	
 	cJSON_AddStringToObject (msg, "crossfade_name", crossfade_name);
 	cJSON_AddNumberToObject (msg, "crossfade", crossfade_val);
+}
+
+void krad_websocket_add_portgroup ( krad_ipc_session_data_t *krad_ipc_session_data, char *portname, float floatval, char *crossfade_name, float crossfade_val ) {
+
+	printkd ("add a portgroup called %s withe a volume of %f", portname, floatval);
+
+	cJSON *msg;
+	
+	cJSON_AddItemToArray(krad_ipc_session_data->msgs, msg = cJSON_CreateObject());
+	
+	krad_websocket_portgroup_to_json (msg, portname, floatval, crossfade_name, crossfade_val);
 	
 	krad_ipc_get_tags (krad_ipc_session_data->krad_ipc_client, portname);
 
@@ -410,6 +429,579 @@ int ebml_frag_to_js (char *js_data, unsigned char *ebml_frag) {
 }
 */
 
+/* Direct Sessions
+
+   krad-json and krad-bin sessions do not go through a krad ipc client,
+   the ipc server hands us each broadcast and commands from the browser
+   are applied to the mixer in process. Broadcasts arrive on the ipc
+   thread, so they are queued per session under direct_lock and the
+   server thread is woken with the event pipe to do the websocket writes. */
+
+static int krad_websocket_bin_put_string (unsigned char *buffer, char *string) {
+
+	int len;
+	
+	len = strlen (string);
+	
+	if (len > 255) {
+		len = 255;
+	}
+	
+	buffer[0] = len;
+	memcpy (buffer + 1, string, len);
+	
+	return len + 1;
+}
+
+static int krad_websocket_bin_get_string (unsigned char *buffer, int remaining, char *string, int max) {
+
+	int len;
+	
+	if (remaining < 1) {
+		return -1;
+	}
+	
+	len = buffer[0];
+	
+	if ((len + 1 > remaining) || (len >= max)) {
+		return -1;
+	}
+	
+	memcpy (string, buffer + 1, len);
+	string[len] = '\0';
+	
+	return len + 1;
+}
+
+static void krad_websocket_bin_put_float (unsigned char *buffer, float value) {
+
+	uint32_t bits;
+	
+	memcpy (&bits, &value, 4);
+	
+	buffer[0] = (bits >> 24) & 0xff;
+	buffer[1] = (bits >> 16) & 0xff;
+	buffer[2] = (bits >> 8) & 0xff;
+	buffer[3] = bits & 0xff;
+}
+
+static float krad_websocket_bin_get_float (unsigned char *buffer) {
+
+	uint32_t bits;
+	float value;
+	
+	bits = ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+	memcpy (&value, &bits, 4);
+	
+	return value;
+}
+
+static int krad_websocket_json_escape (char *dest, char *string, int max) {
+
+	int pos;
+
+	pos = 0;
+
+	while ((*string != '\0') && (pos < max - 7)) {
+		if ((*string == '"') || (*string == '\\')) {
+			dest[pos++] = '\\';
+			dest[pos++] = *string;
+		} else if ((unsigned char)*string < 0x20) {
+			pos += sprintf (dest + pos, "\\u%04x", (unsigned char)*string);
+		} else {
+			dest[pos++] = *string;
+		}
+		string++;
+	}
+	
+	dest[pos] = '\0';
+	
+	return pos;
+}
+
+/* must be called with direct_lock held */
+
+static krad_websocket_template_t *krad_websocket_get_template (krad_websocket_t *krad_websocket, int type,
+															   char *item, char *name) {
+
+	krad_websocket_template_t *template;
+	char escaped_item[256];
+	char escaped_name[256];
+	int t;
+	int pos;
+
+	for (t = 0; t < krad_websocket->template_count; t++) {
+		template = &krad_websocket->templates[t];
+		if ((template->type == type) && (strcmp (template->name, name) == 0) && (strcmp (template->item, item) == 0)) {
+			return template;
+		}
+	}
+	
+	if (krad_websocket->template_count < KRAD_WEBSOCKET_MAX_TEMPLATES) {
+		template = &krad_websocket->templates[krad_websocket->template_count++];
+	} else {
+		template = &krad_websocket->templates[krad_websocket->template_next];
+		krad_websocket->template_next = (krad_websocket->template_next + 1) % KRAD_WEBSOCKET_MAX_TEMPLATES;
+	}
+	
+	template->type = type;
+	snprintf (template->item, sizeof (template->item), "%s", item);
+	snprintf (template->name, sizeof (template->name), "%s", name);
+
+	krad_websocket_json_escape (escaped_item, template->item, sizeof (escaped_item));
+	krad_websocket_json_escape (escaped_name, template->name, sizeof (escaped_name));
+
+	pos = 0;
+	template->bin[pos++] = type;
+	pos += krad_websocket_bin_put_string (template->bin + pos, template->item);
+	pos += krad_websocket_bin_put_string (template->bin + pos, template->name);
+	template->bin_len = pos;
+
+	if (type == KRAD_WEBSOCKET_BIN_CONTROL) {
+		template->json_len = snprintf (template->json, sizeof (template->json),
+									   "{\"com\":\"kradmixer\",\"cmd\":\"update_portgroup\","
+									   "\"portgroup_name\":\"%s\",\"control_name\":\"%s\",\"value\":",
+									   escaped_item, escaped_name);
+	} else {
+		template->json_len = snprintf (template->json, sizeof (template->json),
+									   "{\"com\":\"kradradio\",\"info\":\"tag\","
+									   "\"tag_item\":\"%s\",\"tag_name\":\"%s\",\"tag_value\":\"",
+									   escaped_item, escaped_name);
+	}
+
+	/* snprintf gives the length it would have written */
+	if (template->json_len > sizeof (template->json) - 1) {
+		template->json_len = sizeof (template->json) - 1;
+	}
+	
+	return template;
+}
+
+/* must be called with direct_lock held, bin must hold 1024 bytes and json 2048 */
+
+static void krad_websocket_direct_message (krad_websocket_t *krad_websocket, int type, char *item, char *name,
+										   float value, char *string, unsigned char *bin, int *bin_len,
+										   char *json, int *json_len) {
+
+	krad_websocket_template_t *template;
+	int len;
+
+	template = krad_websocket_get_template (krad_websocket, type, item, name);
+
+	memcpy (bin, template->bin, template->bin_len);
+	*bin_len = template->bin_len;
+	memcpy (json, template->json, template->json_len);
+	*json_len = template->json_len;
+
+	if (type == KRAD_WEBSOCKET_BIN_CONTROL) {
+		krad_websocket_bin_put_float (bin + *bin_len, value);
+		*bin_len += 4;
+		*json_len += sprintf (json + *json_len, "%f}", value);
+	} else {
+		len = strlen (string);
+		if (len > 1024 - *bin_len - 2) {
+			len = 1024 - *bin_len - 2;
+		}
+		bin[(*bin_len)++] = (len >> 8) & 0xff;
+		bin[(*bin_len)++] = len & 0xff;
+		memcpy (bin + *bin_len, string, len);
+		*bin_len += len;
+		*json_len += krad_websocket_json_escape (json + *json_len, string, 2048 - *json_len - 3);
+		json[(*json_len)++] = '"';
+		json[(*json_len)++] = '}';
+	}
+}
+
+static void krad_websocket_wake (krad_websocket_t *krad_websocket) {
+
+	char wake;
+	
+	wake = 'k';
+	
+	if (write (krad_websocket->event_pipe[1], &wake, 1) != 1) {
+		/* pipe full, the server thread already has a wakeup pending */
+	}
+}
+
+/* must be called with direct_lock held */
+
+static void krad_direct_session_queue (krad_direct_session_data_t *pss, unsigned char *data, int len) {
+
+	if (pss->buffer_len + len + 2 > KRAD_WEBSOCKET_DIRECT_BUFFER_SIZE) {
+		pss->dropped++;
+		if ((pss->dropped % 1000) == 1) {
+			printke ("Krad Websocket: browser is not keeping up, %"PRIu64" messages dropped", pss->dropped);
+		}
+		return;
+	}
+	
+	if ((pss->format == KRAD_WEBSOCKET_JSON) && (pss->msg_count > 0)) {
+		pss->buffer[pss->buffer_len++] = ',';
+	}
+	
+	memcpy (pss->buffer + pss->buffer_len, data, len);
+	pss->buffer_len += len;
+	pss->msg_count++;
+	pss->pending = 1;
+}
+
+static void krad_direct_session_queue_message (krad_direct_session_data_t *pss, unsigned char *bin, int bin_len,
+											   char *json, int json_len) {
+
+	if (pss->format == KRAD_WEBSOCKET_BINARY) {
+		krad_direct_session_queue (pss, bin, bin_len);
+	} else {
+		krad_direct_session_queue (pss, (unsigned char *)json, json_len);
+	}
+}
+
+static void krad_direct_session_queue_json (krad_direct_session_data_t *pss, cJSON *msg) {
+
+	char *text;
+
+	text = cJSON_PrintUnformatted (msg);
+	krad_direct_session_queue (pss, (unsigned char *)text, strlen (text));
+	free (text);
+	cJSON_Delete (msg);
+}
+
+static void krad_websocket_direct_broadcast (krad_websocket_t *krad_websocket, int type, char *item, char *name,
+											 float value, char *string) {
+
+	unsigned char bin[1024];
+	char json[2048];
+	int bin_len;
+	int json_len;
+	int s;
+
+	pthread_mutex_lock (&krad_websocket->direct_lock);
+
+	krad_websocket_direct_message (krad_websocket, type, item, name, value, string, bin, &bin_len, json, &json_len);
+
+	for (s = 0; s < KRAD_WEBSOCKET_MAX_POLL_FDS; s++) {
+		if (krad_websocket->direct_sessions[s] != NULL) {
+			krad_direct_session_queue_message (krad_websocket->direct_sessions[s], bin, bin_len, json, json_len);
+		}
+	}
+
+	pthread_mutex_unlock (&krad_websocket->direct_lock);
+	
+	krad_websocket_wake (krad_websocket);
+}
+
+void krad_websocket_broadcast_control (void *pointer, char *portname, char *controlname, float value) {
+
+	krad_websocket_direct_broadcast ((krad_websocket_t *)pointer, KRAD_WEBSOCKET_BIN_CONTROL,
+									 portname, controlname, value, NULL);
+}
+
+void krad_websocket_broadcast_tag (void *pointer, char *tag_item, char *tag_name, char *tag_value) {
+
+	krad_websocket_direct_broadcast ((krad_websocket_t *)pointer, KRAD_WEBSOCKET_BIN_TAG,
+									 tag_item, tag_name, 0.0f, tag_value);
+}
+
+/* must be called with direct_lock held */
+
+static void krad_direct_session_tags (krad_direct_session_data_t *pss, char *item, krad_tags_t *krad_tags) {
+
+	unsigned char bin[1024];
+	char json[2048];
+	int bin_len;
+	int json_len;
+	char *tag_name;
+	char *tag_value;
+	int tagnum;
+
+	if (krad_tags == NULL) {
+		return;
+	}
+
+	tagnum = 0;
+
+	while (krad_tags_get_next_tag (krad_tags, &tagnum, &tag_name, &tag_value)) {
+		krad_websocket_direct_message (pss->krad_websocket, KRAD_WEBSOCKET_BIN_TAG, item, tag_name, 0.0f, tag_value,
+									   bin, &bin_len, json, &json_len);
+		krad_direct_session_queue_message (pss, bin, bin_len, json, json_len);
+	}
+}
+
+static void krad_direct_session_hello (krad_direct_session_data_t *pss) {
+
+	krad_websocket_t *krad_websocket;
+	krad_mixer_t *krad_mixer;
+	krad_mixer_portgroup_t *portgroup;
+	krad_linker_t *krad_linker;
+	krad_link_t *krad_link;
+	krad_link_rep_t krad_link_rep;
+	unsigned char bin[1024];
+	char *crossfade_name;
+	float crossfade_value;
+	int pos;
+	int p;
+	cJSON *msg;
+
+	krad_websocket = pss->krad_websocket;
+	krad_mixer = krad_websocket->krad_radio->krad_mixer;
+	krad_linker = krad_websocket->krad_radio->krad_linker;
+
+	pthread_mutex_lock (&krad_websocket->direct_lock);
+
+	if (pss->format == KRAD_WEBSOCKET_BINARY) {
+		pos = 0;
+		bin[pos++] = KRAD_WEBSOCKET_BIN_HELLO;
+		pos += krad_websocket_bin_put_string (bin + pos, krad_websocket->sysname);
+		krad_direct_session_queue (pss, bin, pos);
+	} else {
+		msg = cJSON_CreateObject ();
+		cJSON_AddStringToObject (msg, "com", "kradradio");
+		cJSON_AddStringToObject (msg, "info", "sysname");
+		cJSON_AddStringToObject (msg, "infoval", krad_websocket->sysname);
+		krad_direct_session_queue_json (pss, msg);
+
+		msg = cJSON_CreateObject ();
+		cJSON_AddStringToObject (msg, "com", "kradradio");
+		cJSON_AddStringToObject (msg, "info", "motd");
+		cJSON_AddStringToObject (msg, "infoval", "kradradio json direct");
+		krad_direct_session_queue_json (pss, msg);
+	}
+
+	krad_direct_session_tags (pss, "station", krad_websocket->krad_radio->krad_tags);
+
+	pthread_mutex_lock (&krad_mixer->portgroup_lock);
+
+	for (p = 0; p < KRAD_MIXER_MAX_PORTGROUPS; p++) {
+		portgroup = krad_mixer->portgroup[p];
+		if ((portgroup == NULL) || (!portgroup->active) || (portgroup->direction != INPUT)) {
+			continue;
+		}
+		crossfade_name = "";
+		crossfade_value = 0.0f;
+		if (portgroup->crossfade_group != NULL) {
+			if (portgroup->crossfade_group->portgroup[0] == portgroup) {
+				crossfade_name = portgroup->crossfade_group->portgroup[1]->sysname;
+				crossfade_value = portgroup->crossfade_group->fade;
+			}
+		}
+		if (pss->format == KRAD_WEBSOCKET_BINARY) {
+			pos = 0;
+			bin[pos++] = KRAD_WEBSOCKET_BIN_PORTGROUP;
+			pos += krad_websocket_bin_put_string (bin + pos, portgroup->sysname);
+			krad_websocket_bin_put_float (bin + pos, portgroup->volume[0]);
+			pos += 4;
+			pos += krad_websocket_bin_put_string (bin + pos, crossfade_name);
+			krad_websocket_bin_put_float (bin + pos, crossfade_value);
+			pos += 4;
+			krad_direct_session_queue (pss, bin, pos);
+		} else {
+			msg = cJSON_CreateObject ();
+			krad_websocket_portgroup_to_json (msg, portgroup->sysname, portgroup->volume[0], crossfade_name, crossfade_value);
+			krad_direct_session_queue_json (pss, msg);
+		}
+		krad_direct_session_tags (pss, portgroup->sysname, portgroup->krad_tags);
+	}
+
+	pthread_mutex_unlock (&krad_mixer->portgroup_lock);
+
+	pthread_mutex_unlock (&krad_websocket->direct_lock);
+
+	if (pss->format == KRAD_WEBSOCKET_BINARY) {
+		return;
+	}
+
+	/* links are json only, the binary protocol is for mixer surfaces */
+
+	pthread_mutex_lock (&krad_linker->change_lock);
+	
+	for (p = 0; p < KRAD_LINKER_MAX_LINKS; p++) {
+		krad_link = krad_linker->krad_link[p];
+		if (krad_link == NULL) {
+			continue;
+		}
+		memset (&krad_link_rep, 0, sizeof (krad_link_rep_t));
+		krad_link_rep.operation_mode = krad_link->operation_mode;
+		krad_link_rep.av_mode = krad_link->av_mode;
+		krad_link_rep.video_source = krad_link->video_source;
+		krad_link_rep.audio_codec = krad_link->audio_codec;
+		krad_link_rep.video_codec = krad_link->video_codec;
+		krad_link_rep.port = krad_link->port;
+		strncpy (krad_link_rep.host, krad_link->host, sizeof (krad_link_rep.host) - 1);
+		strncpy (krad_link_rep.mount, krad_link->mount, sizeof (krad_link_rep.mount) - 1);
+		if ((krad_link->audio_codec == OPUS) && (krad_link->krad_opus != NULL)) {
+			krad_link_rep.opus_signal = krad_opus_get_signal (krad_link->krad_opus);
+			krad_link_rep.opus_bandwidth = krad_opus_get_bandwidth (krad_link->krad_opus);
+			krad_link_rep.opus_bitrate = krad_opus_get_bitrate (krad_link->krad_opus);
+			krad_link_rep.opus_complexity = krad_opus_get_complexity (krad_link->krad_opus);
+			krad_link_rep.opus_frame_size = krad_opus_get_frame_size (krad_link->krad_opus);
+		}
+		msg = cJSON_CreateObject ();
+		krad_websocket_link_to_json (msg, &krad_link_rep, p);
+		pthread_mutex_lock (&krad_websocket->direct_lock);
+		krad_direct_session_queue_json (pss, msg);
+		pthread_mutex_unlock (&krad_websocket->direct_lock);
+	}
+	
+	pthread_mutex_unlock (&krad_linker->change_lock);
+}
+
+/* the ipc handler normally does this, so let the other clients know too */
+
+static void krad_websocket_direct_set_control (krad_websocket_t *krad_websocket, char *portname,
+											   char *controlname, float value) {
+
+	krad_radio_t *krad_radio;
+	
+	krad_radio = krad_websocket->krad_radio;
+
+	if (krad_mixer_set_portgroup_control (krad_radio->krad_mixer, portname, controlname, value)) {
+		krad_ipc_server_mixer_broadcast_skip (krad_radio->krad_ipc, EBML_ID_KRAD_MIXER_MSG, EBML_ID_KRAD_MIXER_CONTROL,
+											  portname, controlname, value, NULL);
+	}
+}
+
+static void krad_websocket_direct_push_tone (krad_websocket_t *krad_websocket, char *tone) {
+	krad_mixer_push_tone (krad_websocket->krad_radio->krad_mixer, tone);
+}
+
+static void krad_websocket_direct_update_link (krad_websocket_t *krad_websocket, int link_num,
+											   char *control_name, cJSON *value) {
+
+	krad_linker_t *krad_linker;
+	krad_link_t *krad_link;
+
+	if ((link_num < 0) || (link_num >= KRAD_LINKER_MAX_LINKS)) {
+		return;
+	}
+
+	krad_linker = krad_websocket->krad_radio->krad_linker;
+
+	pthread_mutex_lock (&krad_linker->change_lock);
+	
+	krad_link = krad_linker->krad_link[link_num];
+	
+	if ((krad_link != NULL) && (krad_link->audio_codec == OPUS) && (krad_link->krad_opus != NULL)) {
+		if ((strcmp (control_name, "opus_bitrate") == 0) && (value->type == cJSON_Number)) {
+			krad_opus_set_bitrate (krad_link->krad_opus, value->valueint);
+		}
+		if ((strcmp (control_name, "opus_complexity") == 0) && (value->type == cJSON_Number)) {
+			krad_opus_set_complexity (krad_link->krad_opus, value->valueint);
+		}
+		if ((strcmp (control_name, "opus_frame_size") == 0) && (value->type == cJSON_Number)) {
+			krad_opus_set_frame_size (krad_link->krad_opus, value->valueint);
+		}
+		if ((strcmp (control_name, "opus_signal") == 0) && (value->type == cJSON_String)) {
+			krad_opus_set_signal (krad_link->krad_opus, krad_opus_string_to_signal (value->valuestring));
+		}
+		if ((strcmp (control_name, "opus_bandwidth") == 0) && (value->type == cJSON_String)) {
+			krad_opus_set_bandwidth (krad_link->krad_opus, krad_opus_string_to_bandwidth (value->valuestring));
+		}
+	}
+	
+	pthread_mutex_unlock (&krad_linker->change_lock);
+}
+
+static void krad_direct_session_from_json (krad_direct_session_data_t *pss, char *value, int len) {
+
+	cJSON *cmd;
+	cJSON *com;
+	cJSON *part;
+	cJSON *part2;
+	cJSON *part3;
+	char *text;
+	
+	text = strndup (value, len);
+	cmd = cJSON_Parse (text);
+	free (text);
+	
+	if (cmd == NULL) {
+		printke ("Krad Websocket: could not parse json from browser");
+		return;
+	}
+	
+	com = cJSON_GetObjectItem (cmd, "com");
+	part = cJSON_GetObjectItem (cmd, "cmd");
+	
+	if ((com == NULL) || (part == NULL) || (com->type != cJSON_String) || (part->type != cJSON_String)) {
+		cJSON_Delete (cmd);
+		return;
+	}
+
+	if (strcmp (com->valuestring, "kradmixer") == 0) {
+		if (strcmp (part->valuestring, "update_portgroup") == 0) {
+			part = cJSON_GetObjectItem (cmd, "portgroup_name");
+			part2 = cJSON_GetObjectItem (cmd, "control_name");
+			part3 = cJSON_GetObjectItem (cmd, "value");
+			if ((part != NULL) && (part2 != NULL) && (part3 != NULL) &&
+				(part->type == cJSON_String) && (part2->type == cJSON_String) && (part3->type == cJSON_Number)) {
+				krad_websocket_direct_set_control (pss->krad_websocket, part->valuestring,
+												   part2->valuestring, part3->valuedouble);
+			}
+		}
+		if (strcmp (part->valuestring, "push_dtmf") == 0) {
+			part = cJSON_GetObjectItem (cmd, "dtmf");
+			if ((part != NULL) && (part->type == cJSON_String)) {
+				krad_websocket_direct_push_tone (pss->krad_websocket, part->valuestring);
+			}
+		}
+	}
+
+	if (strcmp (com->valuestring, "kradlink") == 0) {
+		if (strcmp (part->valuestring, "update_link") == 0) {
+			part = cJSON_GetObjectItem (cmd, "link_num");
+			part2 = cJSON_GetObjectItem (cmd, "control_name");
+			part3 = cJSON_GetObjectItem (cmd, "value");
+			if ((part != NULL) && (part2 != NULL) && (part3 != NULL) &&
+				(part->type == cJSON_Number) && (part2->type == cJSON_String)) {
+				krad_websocket_direct_update_link (pss->krad_websocket, part->valueint, part2->valuestring, part3);
+			}
+		}
+	}
+	
+	cJSON_Delete (cmd);
+}
+
+static void krad_direct_session_from_bin (krad_direct_session_data_t *pss, unsigned char *value, int len) {
+
+	char portname[256];
+	char controlname[256];
+	char tone[64];
+	int pos;
+	int ret;
+	
+	pos = 0;
+	
+	while (pos < len) {
+		switch (value[pos++]) {
+			case KRAD_WEBSOCKET_BIN_CONTROL:
+				ret = krad_websocket_bin_get_string (value + pos, len - pos, portname, sizeof (portname));
+				if (ret < 0) {
+					return;
+				}
+				pos += ret;
+				ret = krad_websocket_bin_get_string (value + pos, len - pos, controlname, sizeof (controlname));
+				if ((ret < 0) || (pos + ret + 4 > len)) {
+					return;
+				}
+				pos += ret;
+				krad_websocket_direct_set_control (pss->krad_websocket, portname, controlname,
+												   krad_websocket_bin_get_float (value + pos));
+				pos += 4;
+				break;
+			case KRAD_WEBSOCKET_BIN_DTMF:
+				ret = krad_websocket_bin_get_string (value + pos, len - pos, tone, sizeof (tone));
+				if (ret < 0) {
+					return;
+				}
+				pos += ret;
+				krad_websocket_direct_push_tone (pss->krad_websocket, tone);
+				break;
+			default:
+				printke ("Krad Websocket: unknown binary message type %d from browser", value[pos - 1]);
+				return;
+		}
+	}
+}
+
 /****	Poll Functions	****/
 
 void add_poll_fd (int fd, short events, int fd_is, krad_ipc_session_data_t *pss, void *bspointer) {
@@ -428,6 +1020,12 @@ void add_poll_fd (int fd, short events, int fd_is, krad_ipc_session_data_t *pss,
 		strcpy(fd_text, "Krad IPC");
 	}
 
+	if (fd_is == KRAD_EVENT) {
+		krad_websocket->fdof[krad_websocket->count_pollfds] = KRAD_EVENT;
+		krad_websocket->sessions[krad_websocket->count_pollfds] = NULL;
+		strcpy(fd_text, "Krad Event");
+	}
+
 	krad_websocket->pollfds[krad_websocket->count_pollfds].fd = fd;
 	krad_websocket->pollfds[krad_websocket->count_pollfds].events = events;
 	krad_websocket->pollfds[krad_websocket->count_pollfds++].revents = 0;
@@ -625,7 +1223,148 @@ int callback_krad_ipc (struct libwebsocket_context *this, struct libwebsocket *w
 }
 
 
-krad_websocket_t *krad_websocket_server_create (char *sysname, int port) {
+static int callback_krad_direct (struct libwebsocket_context *this, struct libwebsocket *wsi, 
+								 enum libwebsocket_callback_reasons reason, 
+								 void *user, void *in, size_t len, krad_websocket_format_t format)
+{
+	int s;
+	int ret;
+	int msglen;
+	krad_websocket_t *krad_websocket = krad_websocket_glob;
+	krad_direct_session_data_t *pss = user;
+	unsigned char *p = &krad_websocket->buffer[LWS_SEND_BUFFER_PRE_PADDING];
+	
+	switch (reason) {
+
+		case LWS_CALLBACK_ESTABLISHED:
+
+			pss->context = this;
+			pss->wsi = wsi;
+			pss->krad_websocket = krad_websocket;
+			pss->format = format;
+			pss->buffer = malloc (KRAD_WEBSOCKET_DIRECT_BUFFER_SIZE);
+			if (pss->buffer == NULL) {
+				printke ("krad_direct could not allocate a session buffer");
+				return 1;
+			}
+			pss->buffer_len = 0;
+			pss->msg_count = 0;
+			pss->pending = 0;
+			pss->dropped = 0;
+
+			pthread_mutex_lock (&krad_websocket->direct_lock);
+			for (s = 0; s < KRAD_WEBSOCKET_MAX_POLL_FDS; s++) {
+				if (krad_websocket->direct_sessions[s] == NULL) {
+					krad_websocket->direct_sessions[s] = pss;
+					break;
+				}
+			}
+			pthread_mutex_unlock (&krad_websocket->direct_lock);
+
+			if (s == KRAD_WEBSOCKET_MAX_POLL_FDS) {
+				printke ("Krad Websocket: too many browsers connected, turning one away");
+				free (pss->buffer);
+				pss->buffer = NULL;
+				return 1;
+			}
+
+			krad_direct_session_hello (pss);
+			libwebsocket_callback_on_writable (this, wsi);
+
+			break;
+
+		case LWS_CALLBACK_CLOSED:
+
+			pthread_mutex_lock (&krad_websocket->direct_lock);
+			for (s = 0; s < KRAD_WEBSOCKET_MAX_POLL_FDS; s++) {
+				if (krad_websocket->direct_sessions[s] == pss) {
+					krad_websocket->direct_sessions[s] = NULL;
+				}
+			}
+			pthread_mutex_unlock (&krad_websocket->direct_lock);
+
+			if (pss->dropped > 0) {
+				printke ("Krad Websocket: %"PRIu64" messages were dropped for this browser", pss->dropped);
+			}
+
+			free (pss->buffer);
+			pss->buffer = NULL;
+			pss->context = NULL;
+			pss->wsi = NULL;
+		
+			break;
+
+		case LWS_CALLBACK_SERVER_WRITEABLE:
+
+			pthread_mutex_lock (&krad_websocket->direct_lock);
+			
+			if (pss->pending == 0) {
+				pthread_mutex_unlock (&krad_websocket->direct_lock);
+				break;
+			}
+
+			if (pss->format == KRAD_WEBSOCKET_JSON) {
+				p[0] = '[';
+				memcpy (p + 1, pss->buffer, pss->buffer_len);
+				p[pss->buffer_len + 1] = ']';
+				msglen = pss->buffer_len + 2;
+			} else {
+				memcpy (p, pss->buffer, pss->buffer_len);
+				msglen = pss->buffer_len;
+			}
+
+			pss->buffer_len = 0;
+			pss->msg_count = 0;
+			pss->pending = 0;
+			
+			pthread_mutex_unlock (&krad_websocket->direct_lock);
+
+			if (pss->format == KRAD_WEBSOCKET_JSON) {
+				ret = libwebsocket_write (wsi, p, msglen, LWS_WRITE_TEXT);
+			} else {
+				ret = libwebsocket_write (wsi, p, msglen, LWS_WRITE_BINARY);
+			}
+
+			if (ret < 0) {
+				printke ("krad_direct ERROR writing to socket");
+				return 1;
+			}
+
+			break;
+
+		case LWS_CALLBACK_RECEIVE:
+
+			if (pss->format == KRAD_WEBSOCKET_JSON) {
+				krad_direct_session_from_json (pss, in, len);
+			} else {
+				krad_direct_session_from_bin (pss, in, len);
+			}
+		
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+int callback_krad_json (struct libwebsocket_context *this, struct libwebsocket *wsi, 
+						enum libwebsocket_callback_reasons reason, 
+						void *user, void *in, size_t len)
+{
+	return callback_krad_direct (this, wsi, reason, user, in, len, KRAD_WEBSOCKET_JSON);
+}
+
+int callback_krad_bin (struct libwebsocket_context *this, struct libwebsocket *wsi, 
+					   enum libwebsocket_callback_reasons reason, 
+					   void *user, void *in, size_t len)
+{
+	return callback_krad_direct (this, wsi, reason, user, in, len, KRAD_WEBSOCKET_BINARY);
+}
+
+
+krad_websocket_t *krad_websocket_server_create (krad_radio_t *krad_radio, char *sysname, int port) {
 
 
 	krad_websocket_t *krad_websocket = calloc (1, sizeof (krad_websocket_t));
@@ -634,8 +1373,12 @@ krad_websocket_t *krad_websocket_server_create (char *sysname, int port) {
 
 	krad_websocket->shutdown = KRAD_WEBSOCKET_STARTING;
 
+	krad_websocket->krad_radio = krad_radio;
 	krad_websocket->port = port;
 	strcpy (krad_websocket->sysname, sysname);
+	krad_websocket->event_pipe[0] = -1;
+	krad_websocket->event_pipe[1] = -1;
+	pthread_mutex_init (&krad_websocket->direct_lock, NULL);
 
 	krad_websocket->buffer = calloc(1, 32768 * 8);
 
@@ -647,6 +1390,19 @@ krad_websocket_t *krad_websocket_server_create (char *sysname, int port) {
 		krad_websocket_server_destroy (krad_websocket);
 		return NULL;
 	}
+
+	if (pipe (krad_websocket->event_pipe) != 0) {
+		printke ("Krad Websocket: could not create event pipe");
+		krad_websocket_server_destroy (krad_websocket);
+		return NULL;
+	}
+
+	fcntl (krad_websocket->event_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl (krad_websocket->event_pipe[1], F_SETFL, O_NONBLOCK);
+	add_poll_fd (krad_websocket->event_pipe[0], POLLIN, KRAD_EVENT, NULL, NULL);
+
+	krad_ipc_server_set_subscriber (krad_radio->krad_ipc, krad_websocket,
+									krad_websocket_broadcast_control, krad_websocket_broadcast_tag);
 	
 	pthread_create (&krad_websocket->server_thread, NULL, krad_websocket_server_run, (void *)krad_websocket);
 	pthread_detach (krad_websocket->server_thread);	
@@ -660,7 +1416,9 @@ void *krad_websocket_server_run (void *arg) {
 	krad_websocket_t *krad_websocket = (krad_websocket_t *)arg;
 
 	int n = 0;
+	int s;
 	char info[256] = "";
+	char drain[64];
 
 	krad_websocket->shutdown = KRAD_WEBSOCKET_RUNNING;
 
@@ -723,6 +1481,20 @@ void *krad_websocket_server_run (void *arg) {
 							sprintf(info + strlen(info), "Poll IN on FD number %d", n);
 							
 							switch ( krad_websocket->fdof[n] ) {
+								case KRAD_EVENT:
+
+									while (read (krad_websocket->pollfds[n].fd, drain, sizeof (drain)) > 0);
+
+									pthread_mutex_lock (&krad_websocket->direct_lock);
+									for (s = 0; s < KRAD_WEBSOCKET_MAX_POLL_FDS; s++) {
+										if ((krad_websocket->direct_sessions[s] != NULL) && (krad_websocket->direct_sessions[s]->pending)) {
+											libwebsocket_callback_on_writable (krad_websocket->direct_sessions[s]->context,
+																			   krad_websocket->direct_sessions[s]->wsi);
+										}
+									}
+									pthread_mutex_unlock (&krad_websocket->direct_lock);
+									break;
+
 								case KRAD_IPC:
 								
 									krad_websocket->sessions[n]->msgs = cJSON_CreateArray();
@@ -806,6 +1578,10 @@ void krad_websocket_server_destroy (krad_websocket_t *krad_websocket) {
 	int patience;
 	
 	if (krad_websocket != NULL) {
+
+		if ((krad_websocket->krad_radio != NULL) && (krad_websocket->krad_radio->krad_ipc != NULL)) {
+			krad_ipc_server_set_subscriber (krad_websocket->krad_radio->krad_ipc, NULL, NULL, NULL);
+		}
 	
 		patience = KRAD_WEBSOCKET_SERVER_TIMEOUT_US * 3;
 	
@@ -819,7 +1595,14 @@ void krad_websocket_server_destroy (krad_websocket_t *krad_websocket) {
 		}
 
 		free (krad_websocket->buffer);
-		libwebsocket_context_destroy (krad_websocket->context);
+		if (krad_websocket->context != NULL) {
+			libwebsocket_context_destroy (krad_websocket->context);
+		}
+		if (krad_websocket->event_pipe[0] != -1) {
+			close (krad_websocket->event_pipe[0]);
+			close (krad_websocket->event_pipe[1]);
+		}
+		pthread_mutex_destroy (&krad_websocket->direct_lock);
 		free (krad_websocket);
 		krad_websocket_glob = NULL;
 	}
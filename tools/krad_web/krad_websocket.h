@@ -4,6 +4,7 @@
 #include <string.h>
 #include <sys/time.h>
 #include <poll.h>
+#include <fcntl.h>
 #include <pthread.h>
 
 #include <libwebsockets.h>
@@ -14,15 +15,42 @@
 
 #include "cJSON.h"
 
+typedef struct krad_websocket_St krad_websocket_t;
+typedef struct krad_ipc_session_data_St krad_ipc_session_data_t;
+typedef struct krad_direct_session_data_St krad_direct_session_data_t;
+typedef struct krad_websocket_template_St krad_websocket_template_t;
+
+#include "krad_radio.h"
+
+#ifndef KRAD_WEBSOCKET_H
+#define KRAD_WEBSOCKET_H
+
 #define KRAD_WEBSOCKET_MAX_POLL_FDS 200
+#define KRAD_WEBSOCKET_DIRECT_BUFFER_SIZE 65536
+#define KRAD_WEBSOCKET_MAX_TEMPLATES 96
+
+/* krad-bin message types, strings are a length byte followed by the bytes,
+   floats are 4 byte big endian IEEE 754 */
+
+#define KRAD_WEBSOCKET_BIN_HELLO 0x01 /* sysname */
+#define KRAD_WEBSOCKET_BIN_CONTROL 0x02 /* portgroup, control, float value */
+#define KRAD_WEBSOCKET_BIN_TAG 0x03 /* item, name, 2 byte big endian length + value */
+#define KRAD_WEBSOCKET_BIN_PORTGROUP 0x04 /* portgroup, float volume, crossfade name, float crossfade */
+#define KRAD_WEBSOCKET_BIN_DTMF 0x05 /* tone */
 #define KRAD_WEBSOCKET_SERVER_TIMEOUT_MS 250
 #define KRAD_WEBSOCKET_SERVER_TIMEOUT_US KRAD_WEBSOCKET_SERVER_TIMEOUT_MS * 1000
 
 enum fdclass {
 	MYSTERY = 0,
 	KRAD_IPC = 1,
+	KRAD_EVENT = 2,
 };
 
+typedef enum {
+	KRAD_WEBSOCKET_JSON,
+	KRAD_WEBSOCKET_BINARY,
+} krad_websocket_format_t;
+
 enum krad_websocket_shutdown {
 	KRAD_WEBSOCKET_STARTING = -1,
 	KRAD_WEBSOCKET_RUNNING,
@@ -31,9 +59,6 @@ enum krad_websocket_shutdown {
 
 };
 
-typedef struct krad_websocket_St krad_websocket_t;
-typedef struct krad_ipc_session_data_St krad_ipc_session_data_t;
-
 struct krad_ipc_session_data_St {
 
 	krad_websocket_t *krad_websocket;
@@ -51,6 +76,40 @@ struct krad_ipc_session_data_St {
 	
 };
 
+/* krad-json and krad-bin sessions are fed straight from the daemon broadcasts */
+
+struct krad_direct_session_data_St {
+
+	krad_websocket_t *krad_websocket;
+	krad_websocket_format_t format;
+	struct libwebsocket_context *context;
+	struct libwebsocket *wsi;
+
+	unsigned char *buffer;
+	int buffer_len;
+	int msg_count;
+	int pending;
+	uint64_t dropped;
+
+};
+
+/* prebuilt messages for high frequency updates, only the value is patched in */
+
+struct krad_websocket_template_St {
+
+	char item[128];
+	char name[128];
+	int type;
+
+	unsigned char bin[272];
+	int bin_len;
+
+	/* the longest prefix around an escaped item and name of up to 256 each */
+	char json[640];
+	int json_len;
+
+};
+
 struct krad_websocket_St {
 	krad_ipc_session_data_t *sessions[KRAD_WEBSOCKET_MAX_POLL_FDS];
 	struct pollfd pollfds[KRAD_WEBSOCKET_MAX_POLL_FDS];
@@ -63,6 +122,14 @@ struct krad_websocket_St {
 	char sysname[64];
 	pthread_t server_thread;
 	int shutdown;
+
+	krad_radio_t *krad_radio;
+	krad_direct_session_data_t *direct_sessions[KRAD_WEBSOCKET_MAX_POLL_FDS];
+	krad_websocket_template_t templates[KRAD_WEBSOCKET_MAX_TEMPLATES];
+	int template_count;
+	int template_next;
+	pthread_mutex_t direct_lock;
+	int event_pipe[2];
 };
 
 int callback_http (struct libwebsocket_context *this, struct libwebsocket *wsi,
@@ -74,9 +141,24 @@ int callback_krad_ipc (struct libwebsocket_context * this,
 					   enum libwebsocket_callback_reasons reason, void *user,
 					   void *in, size_t len);
 
+int callback_krad_json (struct libwebsocket_context *this,
+						struct libwebsocket *wsi,
+						enum libwebsocket_callback_reasons reason, void *user,
+						void *in, size_t len);
+
+int callback_krad_bin (struct libwebsocket_context *this,
+					   struct libwebsocket *wsi,
+					   enum libwebsocket_callback_reasons reason, void *user,
+					   void *in, size_t len);
+
+void krad_websocket_broadcast_control (void *pointer, char *portname, char *controlname, float value);
+void krad_websocket_broadcast_tag (void *pointer, char *tag_item, char *tag_name, char *tag_value);
+
 void set_poll_mode_pollfd(struct pollfd *apollfd, short events);
 void set_poll_mode_fd(int fd, short events);
 
 void krad_websocket_server_destroy (krad_websocket_t *krad_websocket);
-krad_websocket_t *krad_websocket_server_create (char *sysname, int port);
+krad_websocket_t *krad_websocket_server_create (krad_radio_t *krad_radio, char *sysname, int port);
 void *krad_websocket_server_run (void *arg);
+
+#endif
@@ -61,7 +61,7 @@ Kradwebsocket.prototype.connect = function() {
 		if (this.connecting != true) {
 			this.connecting = true;
 			this.debug ("Connecting..");
-			this.websocket = new WebSocket (this.uri, "krad-ipc");
+			this.websocket = new WebSocket (this.uri, "krad-json");
 			this.websocket.onopen = create_handler (this, this.on_open);
 			this.websocket.onclose = create_handler (this, this.on_close);
 			this.websocket.onmessage = create_handler (this, this.on_message);